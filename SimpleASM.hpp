@@ -73,6 +73,27 @@ namespace svm
                         return number_of_arguments(command, 2);
                     }
                 }
+                else if (command == "LOAD" || command == "STORE")
+                {
+                    if (inst.size() != 3 && inst.size() != 4)
+                    {
+                        return number_of_arguments(command, 3);
+                    }
+                }
+                else if (is_alu(command))
+                {
+                    if (inst.size() != 4)
+                    {
+                        return number_of_arguments(command, 3);
+                    }
+                }
+                else if (command == "CMP")
+                {
+                    if (inst.size() != 3)
+                    {
+                        return number_of_arguments(command, 2);
+                    }
+                }
                 else if (command == "SYSCALL")
                 {
                     if (inst.size() != 1)
@@ -100,6 +121,19 @@ namespace svm
                 return false;
             }
 
+            if (!data.empty())
+            {
+                // 数据定义原样写出，由EXEParser解析
+                fout << "section data" << std::endl;
+                for (size_t i = 0; i < data.size(); i++)
+                {
+                    const std::vector<std::string> &line = data.at(i);
+                    for (size_t j = 0; j < line.size(); j++)
+                        fout << (j == 0 ? "" : " ") << line.at(j);
+                    fout << std::endl;
+                }
+            }
+
             fout << "section text" << std::endl;
             for (size_t i = 0; i < text.size(); i++)
             {
@@ -126,10 +160,48 @@ namespace svm
 
                     fout << " " << p1 << " " << p2 << std::endl;
                 }
+                else if (command == "LOAD" || command == "STORE")
+                {
+                    if (!is_register(inst.at(1)) || !is_register(inst.at(2)))
+                    {
+                        return bad_parameters("Must be a register");
+                    }
+
+                    fout << command << " " << inst.at(1) << " " << inst.at(2);
+                    if (inst.size() > 3)
+                        fout << " " << inst.at(3);
+                    fout << std::endl;
+                }
+                else if (is_alu(command))
+                {
+                    // ADD AX, BX, CX -> ADDRRR; ADD AX, BX, 1 -> ADDRRI
+                    if (!is_register(inst.at(1)) || !is_register(inst.at(2)))
+                    {
+                        return bad_parameters("Must be a register");
+                    }
+
+                    fout << command << (is_register(inst.at(3)) ? "RRR" : "RRI") << " " << inst.at(1) << " " << inst.at(2) << " " << inst.at(3) << std::endl;
+                }
+                else if (command == "CMP")
+                {
+                    if (!is_register(inst.at(1)))
+                    {
+                        return bad_parameters("Must be a register");
+                    }
+
+                    fout << (is_register(inst.at(2)) ? "CMPRR" : "CMPRI") << " " << inst.at(1) << " " << inst.at(2) << std::endl;
+                }
                 else if (command == "SYSCALL")
                 {
                     fout << command << std::endl;
                 }
+                else
+                {
+                    // 标签和其余指令原样写出，由EXEParser检查
+                    for (size_t j = 0; j < inst.size(); j++)
+                        fout << (j == 0 ? "" : " ") << inst.at(j);
+                    fout << std::endl;
+                }
             }
 
             fout.close();
@@ -173,6 +245,15 @@ namespace svm
             }
         }
 
+        /// @brief 判断是否是三操作数的算术逻辑指令
+        /// @param command 指令名
+        /// @return 是否是算术逻辑指令
+        virtual bool is_alu(const std::string &command)
+        {
+            static const std::vector<std::string> alu_commands = {"ADD", "SUB", "MUL", "DIV", "AND", "OR", "XOR", "SHL", "SHR"};
+            return std::find(alu_commands.cbegin(), alu_commands.cend(), command) != alu_commands.cend();
+        }
+
         /// @brief 判断是否是立即数
         /// @param param 要判断的值
         /// @return 是否是立即数
@@ -0,0 +1,385 @@
+#ifndef __SIMPLE_CHANNEL_HPP__
+#define __SIMPLE_CHANNEL_HPP__
+
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include "SimpleInst.hpp"
+
+namespace svm
+{
+    /// @brief 通道类型
+    namespace ChannelEnum
+    {
+        enum Kind
+        {
+            /// @brief 单生产者单消费者，批量收发直接复制整段内存
+            SPSC = 0,
+
+            /// @brief 多生产者多消费者，批量收发用一次CAS占下一段位置
+            MPMC,
+        };
+    } // namespace ChannelEnum
+
+    /// @brief 缓存行大小，生产者和消费者各自修改的计数器放在不同的缓存行上
+    static const size_t CHANNEL_CACHE_LINE = 64;
+
+    /// @brief 虚拟机之间传递机器字的有界通道（无锁）
+    /// 收发都不会阻塞：满了或空了时返回0，由调用者决定是否暂停（参见SEND/RECV系统调用）。
+    /// @tparam WordT 机器字类型
+    template <typename WordT>
+    class BasicChannel
+    {
+    public:
+        /// @brief 机器字类型
+        using DWORD = WordT;
+
+    private:
+        /// @brief 是否已经关闭
+        std::atomic<bool> m_closed{false};
+
+    public:
+        virtual ~BasicChannel() {}
+
+    public:
+        /// @brief 尽量多地发送
+        /// @param values 要发送的值
+        /// @param count 个数
+        /// @return 实际发送的个数，通道满了或已经关闭时为0
+        virtual size_t try_send(const DWORD *values, size_t count) = 0;
+
+        /// @brief 尽量多地接收
+        /// @param values 接收缓冲区
+        /// @param count 最多接收的个数
+        /// @return 实际接收的个数，通道空了时为0
+        virtual size_t try_receive(DWORD *values, size_t count) = 0;
+
+        /// @brief 获取已经发送和接收的机器字总数之和
+        /// 每次成功的收发都会让它增大，阻塞的虚拟机据此判断通道是否有了变化
+        virtual uint64_t progress() const = 0;
+
+        /// @brief 获取容量（单位为机器字）
+        virtual size_t capacity() const = 0;
+
+    public:
+        /// @brief 关闭通道，之后发送都会失败，接收方取完剩下的数据后也会失败
+        void close()
+        {
+            m_closed.store(true, std::memory_order_release);
+        }
+
+        /// @brief 是否已经关闭
+        bool is_closed() const
+        {
+            return m_closed.load(std::memory_order_acquire);
+        }
+
+        /// @brief 获取通道的状态，收发和关闭都会改变它
+        uint64_t state() const
+        {
+            return progress() * 2 + (is_closed() ? 1 : 0);
+        }
+
+    protected:
+        /// @brief 把容量向上取整为2的幂
+        static size_t round_capacity(size_t capacity)
+        {
+            size_t result = 2;
+            while (result < capacity)
+                result *= 2;
+            return result;
+        }
+    };
+
+    /// @brief 单生产者单消费者通道
+    /// 同一时刻只能有一个虚拟机发送、一个虚拟机接收（可以先后由不同的线程运行）。
+    /// 双方只在自己的计数器上写入，另一方的计数器缓存在本地，只有看起来满了或空了时才重新读取。
+    /// @tparam WordT 机器字类型
+    template <typename WordT>
+    class BasicSPSCChannel : public BasicChannel<WordT>
+    {
+    public:
+        /// @brief 机器字类型
+        using DWORD = WordT;
+
+    private:
+        /// @brief 环形缓冲区
+        std::vector<DWORD> m_buffer;
+        /// @brief 容量减1，用于取模
+        size_t m_mask;
+        /// @brief 已经写入的总数（只由生产者修改）
+        alignas(CHANNEL_CACHE_LINE) std::atomic<uint64_t> m_tail{0};
+        /// @brief 生产者缓存的m_head
+        uint64_t m_cached_head = 0;
+        /// @brief 已经读出的总数（只由消费者修改）
+        alignas(CHANNEL_CACHE_LINE) std::atomic<uint64_t> m_head{0};
+        /// @brief 消费者缓存的m_tail
+        uint64_t m_cached_tail = 0;
+
+    public:
+        /// @brief 构造函数
+        /// @param capacity 容量（单位为机器字），向上取整为2的幂
+        BasicSPSCChannel(size_t capacity) : m_buffer(BasicChannel<WordT>::round_capacity(capacity)), m_mask(m_buffer.size() - 1) {}
+
+    public:
+        virtual size_t try_send(const DWORD *values, size_t count)
+        {
+            if (this->is_closed())
+                return 0;
+            const uint64_t tail = m_tail.load(std::memory_order_relaxed);
+            if (tail - m_cached_head + count > m_buffer.size())
+                m_cached_head = m_head.load(std::memory_order_acquire);
+            const size_t n = std::min<size_t>(count, m_buffer.size() - size_t(tail - m_cached_head));
+            copy_ring(values, n, size_t(tail & m_mask), true);
+            m_tail.store(tail + n, std::memory_order_release);
+            return n;
+        }
+
+        virtual size_t try_receive(DWORD *values, size_t count)
+        {
+            const uint64_t head = m_head.load(std::memory_order_relaxed);
+            if (m_cached_tail - head < count)
+                m_cached_tail = m_tail.load(std::memory_order_acquire);
+            const size_t n = std::min<size_t>(count, size_t(m_cached_tail - head));
+            copy_ring(values, n, size_t(head & m_mask), false);
+            m_head.store(head + n, std::memory_order_release);
+            return n;
+        }
+
+        virtual uint64_t progress() const
+        {
+            return m_head.load(std::memory_order_acquire) + m_tail.load(std::memory_order_acquire);
+        }
+
+        virtual size_t capacity() const
+        {
+            return m_buffer.size();
+        }
+
+    private:
+        /// @brief 在环形缓冲区和线性内存之间复制，跨过末尾时分两段
+        /// @param values 线性内存
+        /// @param count 个数
+        /// @param position 缓冲区中的起始位置
+        /// @param to_ring 是否写入缓冲区
+        void copy_ring(const DWORD *values, size_t count, size_t position, bool to_ring)
+        {
+            const size_t first = std::min(count, m_buffer.size() - position);
+            DWORD *ring = m_buffer.data();
+            DWORD *linear = const_cast<DWORD *>(values);
+            if (to_ring)
+            {
+                memcpy(ring + position, linear, first * sizeof(DWORD));
+                memcpy(ring, linear + first, (count - first) * sizeof(DWORD));
+            }
+            else
+            {
+                memcpy(linear, ring + position, first * sizeof(DWORD));
+                memcpy(linear + first, ring, (count - first) * sizeof(DWORD));
+            }
+        }
+    };
+
+    /// @brief 多生产者多消费者通道
+    /// 每个格子带一个序号，生产者和消费者分别用CAS抢占一段连续的位置，然后通过序号交接数据
+    /// @tparam WordT 机器字类型
+    template <typename WordT>
+    class BasicMPMCChannel : public BasicChannel<WordT>
+    {
+    public:
+        /// @brief 机器字类型
+        using DWORD = WordT;
+
+    private:
+        /// @brief 格子
+        struct Cell
+        {
+            /// @brief 序号：等于位置时可以写入，等于位置加1时可以读取
+            std::atomic<uint64_t> sequence;
+            /// @brief 数据
+            DWORD value;
+        };
+
+        /// @brief 环形缓冲区
+        std::unique_ptr<Cell[]> m_cells;
+        /// @brief 容量
+        size_t m_capacity;
+        /// @brief 下一个写入位置
+        alignas(CHANNEL_CACHE_LINE) std::atomic<uint64_t> m_tail{0};
+        /// @brief 下一个读取位置
+        alignas(CHANNEL_CACHE_LINE) std::atomic<uint64_t> m_head{0};
+        /// @brief 已经完成（数据已经交接）的收发总数
+        /// 位置在交接数据之前就被占下了，不能用位置判断通道是否有了变化，否则阻塞的一方可能错过交接
+        alignas(CHANNEL_CACHE_LINE) std::atomic<uint64_t> m_completed{0};
+
+    public:
+        /// @brief 构造函数
+        /// @param capacity 容量（单位为机器字），向上取整为2的幂
+        BasicMPMCChannel(size_t capacity) : m_capacity(BasicChannel<WordT>::round_capacity(capacity))
+        {
+            m_cells.reset(new Cell[m_capacity]);
+            for (size_t i = 0; i < m_capacity; i++)
+                m_cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+
+    public:
+        virtual size_t try_send(const DWORD *values, size_t count)
+        {
+            if (this->is_closed())
+                return 0;
+            uint64_t position = m_tail.load(std::memory_order_relaxed);
+            while (true)
+            {
+                // 一次CAS占下从position开始连续的空格子，格子的序号等于位置时说明消费者已经取走了上一轮的数据
+                const size_t n = available(position, count, 0);
+                if (n == 0)
+                {
+                    // 可能是别的生产者已经占了position，重新读取后再判断是否真的满了
+                    const uint64_t current = m_tail.load(std::memory_order_relaxed);
+                    if (current == position)
+                        return 0;
+                    position = current;
+                    continue;
+                }
+                if (m_tail.compare_exchange_weak(position, position + n, std::memory_order_relaxed))
+                {
+                    for (size_t i = 0; i < n; i++)
+                    {
+                        Cell &cell = m_cells[(position + i) & (m_capacity - 1)];
+                        cell.value = values[i];
+                        cell.sequence.store(position + i + 1, std::memory_order_release);
+                    }
+                    m_completed.fetch_add(n, std::memory_order_release);
+                    return n;
+                }
+            }
+        }
+
+        virtual size_t try_receive(DWORD *values, size_t count)
+        {
+            uint64_t position = m_head.load(std::memory_order_relaxed);
+            while (true)
+            {
+                // 序号等于位置加1的格子已经写好了数据
+                const size_t n = available(position, count, 1);
+                if (n == 0)
+                {
+                    const uint64_t current = m_head.load(std::memory_order_relaxed);
+                    if (current == position)
+                        return 0;
+                    position = current;
+                    continue;
+                }
+                if (m_head.compare_exchange_weak(position, position + n, std::memory_order_relaxed))
+                {
+                    for (size_t i = 0; i < n; i++)
+                    {
+                        Cell &cell = m_cells[(position + i) & (m_capacity - 1)];
+                        values[i] = cell.value;
+                        cell.sequence.store(position + i + m_capacity, std::memory_order_release);
+                    }
+                    m_completed.fetch_add(n, std::memory_order_release);
+                    return n;
+                }
+            }
+        }
+
+        virtual uint64_t progress() const
+        {
+            return m_completed.load(std::memory_order_acquire);
+        }
+
+        virtual size_t capacity() const
+        {
+            return m_capacity;
+        }
+
+    private:
+        /// @brief 计算从某个位置开始有多少个连续的格子处于期望的状态
+        /// CAS成功说明这期间没有别人占用这些位置，这些格子的状态也就不会再变
+        /// @param position 起始位置
+        /// @param count 最多检查的个数
+        /// @param offset 期望的序号和位置的差（写入为0，读取为1）
+        /// @return 个数
+        size_t available(uint64_t position, size_t count, uint64_t offset) const
+        {
+            count = std::min(count, m_capacity);
+            size_t n = 0;
+            while (n < count && m_cells[(position + n) & (m_capacity - 1)].sequence.load(std::memory_order_acquire) == position + n + offset)
+                n++;
+            return n;
+        }
+    };
+
+    /// @brief 通道表，客户程序用编号访问其中的通道
+    /// 查找不加锁：编号对应的指针一旦设置就不再改变，通道的生命周期和表相同
+    /// @tparam WordT 机器字类型
+    template <typename WordT>
+    class BasicChannelTable
+    {
+    public:
+        /// @brief 机器字类型
+        using DWORD = WordT;
+        using Channel = BasicChannel<WordT>;
+
+        /// @brief 最多的通道数
+        static const size_t MAX_CHANNELS = 256;
+
+    private:
+        /// @brief 编号到通道的映射
+        std::array<std::atomic<Channel *>, MAX_CHANNELS> m_slots;
+        /// @brief 通道的所有权
+        std::vector<std::unique_ptr<Channel>> m_channels;
+        /// @brief 保护创建过程
+        std::mutex m_mutex;
+
+    public:
+        BasicChannelTable()
+        {
+            for (size_t i = 0; i < m_slots.size(); i++)
+                m_slots[i].store(nullptr, std::memory_order_relaxed);
+        }
+
+        BasicChannelTable(const BasicChannelTable &) = delete;
+        BasicChannelTable &operator=(const BasicChannelTable &) = delete;
+
+    public:
+        /// @brief 创建通道
+        /// @param capacity 容量（单位为机器字）
+        /// @param kind 通道类型
+        /// @return 通道编号，表满了时为MAX_CHANNELS
+        virtual size_t create(size_t capacity, ChannelEnum::Kind kind = ChannelEnum::Kind::MPMC)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            const size_t id = m_channels.size();
+            if (id >= MAX_CHANNELS)
+                return MAX_CHANNELS;
+            if (kind == ChannelEnum::Kind::SPSC)
+                m_channels.emplace_back(new BasicSPSCChannel<WordT>(capacity));
+            else
+                m_channels.emplace_back(new BasicMPMCChannel<WordT>(capacity));
+            m_slots[id].store(m_channels.back().get(), std::memory_order_release);
+            return id;
+        }
+
+        /// @brief 查找通道
+        /// @param id 通道编号
+        /// @return 通道的指针，不存在时为nullptr
+        Channel *find(DWORD id) const
+        {
+            if (id >= MAX_CHANNELS)
+                return nullptr;
+            return m_slots[size_t(id)].load(std::memory_order_acquire);
+        }
+    };
+
+    using ChannelTable = BasicChannelTable<DWORD64>;
+    using ChannelTable32 = BasicChannelTable<DWORD32>;
+} // namespace svm
+
+#endif
@@ -0,0 +1,479 @@
+#ifndef __SIMPLE_CHECKPOINT_HPP__
+#define __SIMPLE_CHECKPOINT_HPP__
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <filesystem>
+#include <algorithm>
+#include <iostream>
+#include <type_traits>
+#include "SimpleVM.hpp"
+
+#if SVM_GUARD_PAGES
+#include <fcntl.h>
+#endif
+
+namespace svm
+{
+    /// @brief 计算程序映像的指纹（FNV-1a），检查点用它来确认恢复时加载的是同一个程序
+    /// @param program 程序
+    /// @return 指纹
+    template <typename WordT>
+    uint64_t program_hash(const BasicProgramData<WordT> &program)
+    {
+        uint64_t hash = 1469598103934665603ULL;
+        auto mix = [&hash](uint64_t value, size_t bytes)
+        {
+            for (size_t i = 0; i < bytes; i++)
+            {
+                hash ^= (value >> (i * 8)) & 0xff;
+                hash *= 1099511628211ULL;
+            }
+        };
+
+        mix(sizeof(WordT), 1);
+        mix(program.instructions.size(), 8);
+        for (size_t i = 0; i < program.instructions.size(); i++)
+        {
+            const BasicInstruction<WordT> &inst = program.instructions.at(i);
+            mix(inst.command, 1);
+            mix(inst.register1, 1);
+            mix(inst.register2, 1);
+            mix(inst.register3, 1);
+            mix(inst.operand1, sizeof(WordT));
+            mix(inst.operand2, sizeof(WordT));
+        }
+        mix(program.data.size(), 8);
+        for (size_t i = 0; i < program.data.size(); i++)
+            mix(program.data.at(i), sizeof(WordT));
+        return hash;
+    }
+
+    /// @brief 检查点文件头，占文件的第一页
+    /// 文件依次是：文件头（一页）、修正数据（调用帧和向量寄存器，页对齐）、内存映像（页对齐）。
+    /// 内存映像和虚拟机内存所在的页一一对应，恢复时直接映射，不需要解析。
+    struct CheckpointHeader
+    {
+        /// @brief 固定为"SVMCKPT"
+        char magic[8];
+        /// @brief 格式版本
+        uint32_t version;
+        /// @brief 虚拟机的机器字位数
+        uint32_t word_bits;
+        /// @brief 写入时的页大小
+        uint64_t page_size;
+        /// @brief 程序映像的指纹，参见program_hash()
+        uint64_t program_hash;
+        /// @brief 程序的指令条数
+        uint64_t instruction_count;
+        /// @brief 下一条要执行的指令索引
+        uint64_t instruction_index;
+        /// @brief 栈顶索引
+        uint64_t stack_top;
+        /// @brief 异常状态
+        uint64_t exception;
+        /// @brief 执行过的指令总数
+        uint64_t retired_instructions;
+        /// @brief 执行过的系统调用总数
+        uint64_t retired_syscalls;
+        /// @brief 通用寄存器
+        uint64_t general_registers[RegisterEnum::GeneralRegister::GRCOUNT];
+        /// @brief 标志寄存器
+        uint64_t status_registers[RegisterEnum::StatusRegister::SRCOUNT];
+        /// @brief 调用帧的个数
+        uint64_t call_frame_count;
+        /// @brief 调用帧的位置
+        uint64_t call_frame_offset;
+        /// @brief 向量寄存器的位置
+        uint64_t vector_offset;
+        /// @brief 向量寄存器的长度（单位为字节）
+        uint64_t vector_bytes;
+        /// @brief 内存映像的位置（页对齐）
+        uint64_t memory_offset;
+        /// @brief 内存映像开头的填充长度，参见GuardedRegion::lead_bytes()
+        uint64_t memory_lead;
+        /// @brief 内存的长度（单位为字节）
+        uint64_t memory_bytes;
+        /// @brief 客户程序的陷阱处理函数（指令索引，按陷阱类型，为0时没有）
+        uint64_t trap_vectors[TrapEnum::Trap::DIV + 1];
+        /// @brief 是否正在执行陷阱处理函数
+        uint64_t in_trap;
+        /// @brief 陷阱处理函数返回后调用帧的个数
+        uint64_t trap_frame_depth;
+        /// @brief 最近一次交给处理函数的陷阱的类型、指令索引和越界地址（TRAP_INFO的结果）
+        uint64_t last_trap[3];
+        /// @brief 程序文件的路径（可以为空，只用于提示）
+        char program_path[256];
+    };
+
+    static_assert(sizeof(CheckpointHeader) <= 4096, "CheckpointHeader must fit in one page");
+
+    /// @brief 调用帧在文件中的格式
+    struct CheckpointCallFrame
+    {
+        uint64_t return_index;
+        uint64_t stack_base;
+    };
+
+    /// @brief 虚拟机检查点
+    /// 第一次save()写入完整的文件，之后的save()只重写和上次相比有变化的内存页（以及文件头和修正数据）。
+    /// 恢复时内存映像以写时复制的方式映射进虚拟机内存，恢复之后的写入不会改动文件。
+    /// 文件可能正被其它虚拟机映射着（MAP_PRIVATE下没有复制过的页仍然跟着文件变化），所以save()从不原地改写：
+    /// 增量写入先复制旧文件（支持的文件系统上是共享数据块的浅复制），在副本上改写有变化的页，再改名替换。
+    /// 写入后不调用fsync，只保证进程重启后可以恢复。
+    /// @tparam WordT 机器字类型
+    template <typename WordT>
+    class BasicCheckpoint
+    {
+    public:
+        /// @brief 机器字类型
+        using DWORD = WordT;
+        using VM = BasicSimpleVM<WordT>;
+        using ISData = typename VM::ISData;
+        using VectorValue = typename VM::VectorValue;
+
+        /// @brief 格式版本
+        static const uint32_t VERSION = 2;
+
+        static_assert(std::is_trivially_copyable<VectorValue>::value, "VectorValue must be trivially copyable");
+
+    private:
+        /// @brief 检查点文件
+        std::string m_filename;
+        /// @brief 上一次保存或恢复时的内存页（包括开头的填充），用于找出有变化的页
+        std::vector<unsigned char> m_shadow;
+        /// @brief 上一次save()写入的内存页数
+        size_t m_pages_written = 0;
+        /// @brief 上一次restore()是否是映射的（否则是读取的）
+        bool m_mapped = false;
+
+    public:
+        /// @brief 构造函数
+        /// @param filename 检查点文件
+        BasicCheckpoint(const std::string &filename) : m_filename(filename) {}
+        ~BasicCheckpoint() {}
+
+    public:
+        /// @brief 保存虚拟机（不能在run()的过程中调用）
+        /// @param vm 虚拟机
+        /// @param program_path 程序文件的路径，写入文件头用于提示
+        /// @return 是否成功
+        virtual bool save(VM &vm, const std::string &program_path = "")
+        {
+            const GuardedRegion &region = vm.get_internal_storage_data().get_region();
+            const size_t page = GuardedRegion::page_size();
+            const size_t lead = region.lead_bytes();
+            const size_t memory_bytes = ISData::TOTAL_CAPACITY * sizeof(DWORD);
+            const unsigned char *image = static_cast<const unsigned char *>(region.data()) - lead;
+            const size_t image_bytes = lead + memory_bytes;
+
+            CheckpointHeader header;
+            std::vector<unsigned char> fixups;
+            if (!build_header(vm, program_path, header, fixups))
+                return false;
+
+            // 只有文件还是上次写入的样子时才能增量写入
+            CheckpointHeader old;
+            const bool incremental = m_shadow.size() == image_bytes && read_header(m_filename, old) &&
+                                     old.memory_offset == header.memory_offset && old.memory_lead == lead && old.page_size == page;
+
+            // 总是写临时文件再改名，不会改动可能正被映射着的旧文件
+            const std::string target = m_filename + ".tmp";
+            std::error_code error;
+            std::fstream file;
+            if (incremental && std::filesystem::copy_file(m_filename, target, std::filesystem::copy_options::overwrite_existing, error))
+                file.open(target, std::ios::in | std::ios::out | std::ios::binary);
+            else if (!incremental)
+                file.open(target, std::ios::out | std::ios::trunc | std::ios::binary);
+            else
+                file.setstate(std::ios::failbit);
+            if (file.fail())
+            {
+                std::cout << "Unable to open file \"" << target << "\"" << std::endl;
+                return false;
+            }
+
+            // 先写内存和修正数据，最后写文件头
+            m_pages_written = 0;
+            for (size_t offset = 0; offset < image_bytes; offset += page)
+            {
+                const size_t length = std::min(page, image_bytes - offset);
+                if (incremental && memcmp(m_shadow.data() + offset, image + offset, length) == 0)
+                    continue;
+                file.seekp(std::streamoff(header.memory_offset + offset));
+                file.write(reinterpret_cast<const char *>(image + offset), length);
+                m_pages_written++;
+            }
+            file.seekp(std::streamoff(header.call_frame_offset));
+            file.write(reinterpret_cast<const char *>(fixups.data()), fixups.size());
+            file.seekp(0);
+            file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+            if (!incremental)
+            {
+                // 补齐文件头所在的页
+                std::vector<char> padding(page - sizeof(header), 0);
+                file.write(padding.data(), padding.size());
+            }
+            file.close();
+            if (file.fail() || std::rename(target.c_str(), m_filename.c_str()) != 0)
+            {
+                std::cout << "Unable to write checkpoint \"" << m_filename << "\"" << std::endl;
+                m_shadow.clear();
+                return false;
+            }
+
+            m_shadow.assign(image, image + image_bytes);
+            return true;
+        }
+
+        /// @brief 恢复虚拟机
+        /// 虚拟机必须已经加载了和保存时相同的程序（检查指纹），设备的映射保持不变
+        /// @param vm 虚拟机
+        /// @return 是否成功，失败时虚拟机的状态不变
+        virtual bool restore(VM &vm)
+        {
+            CheckpointHeader header;
+            if (!read_header(m_filename, header))
+                return false;
+
+            GuardedRegion &region = vm.get_internal_storage_data().get_region();
+            const size_t lead = region.lead_bytes();
+            const size_t memory_bytes = ISData::TOTAL_CAPACITY * sizeof(DWORD);
+            if (header.word_bits != sizeof(DWORD) * 8 || header.memory_bytes != memory_bytes ||
+                header.call_frame_count > ISData::STACK_CAPACITY || header.vector_bytes != sizeof(VectorValue) * RegisterEnum::VectorRegister::VRCOUNT ||
+                !valid_layout(header))
+            {
+                std::cout << "Checkpoint \"" << m_filename << "\" does not match this VM" << std::endl;
+                return false;
+            }
+            if (header.instruction_count != vm.get_program_data().instructions.size() || header.program_hash != program_hash(vm.get_program_data()))
+            {
+                std::cout << "Checkpoint \"" << m_filename << "\" was taken with a different program" << std::endl;
+                return false;
+            }
+
+            // 先确认文件完整，后面映射或读取内存时就不会失败到一半
+            std::ifstream fin(m_filename, std::ios::binary | std::ios::ate);
+            std::vector<unsigned char> fixups(size_t(header.memory_offset - header.call_frame_offset));
+            const uint64_t file_size = uint64_t(fin.tellg());
+            fin.seekg(std::streamoff(header.call_frame_offset));
+            if (file_size < header.memory_offset + header.memory_lead + memory_bytes || !fin.read(reinterpret_cast<char *>(fixups.data()), fixups.size()))
+            {
+                std::cout << "Truncated checkpoint \"" << m_filename << "\"" << std::endl;
+                return false;
+            }
+            for (size_t i = 0; i < header.call_frame_count; i++)
+            {
+                CheckpointCallFrame frame;
+                memcpy(&frame, fixups.data() + i * sizeof(frame), sizeof(frame));
+                if (frame.stack_base >= ISData::STACK_CAPACITY || frame.return_index > header.instruction_count)
+                {
+                    std::cout << "Bad checkpoint file:\"" << m_filename << "\"" << std::endl;
+                    return false;
+                }
+            }
+
+            // 页大小和填充都相同时直接映射，否则读进内存
+            m_mapped = false;
+#if SVM_GUARD_PAGES
+            if (header.memory_lead == lead && header.page_size == GuardedRegion::page_size())
+            {
+                int fd = open(m_filename.c_str(), O_RDONLY);
+                if (fd >= 0)
+                {
+                    m_mapped = region.map_file(fd, header.memory_offset);
+                    // 映射建立后就不再需要文件描述符了
+                    close(fd);
+                }
+            }
+#endif
+            if (!m_mapped)
+            {
+                fin.seekg(std::streamoff(header.memory_offset + header.memory_lead));
+                if (!fin.read(static_cast<char *>(region.data()), memory_bytes))
+                {
+                    std::cout << "Truncated checkpoint \"" << m_filename << "\"" << std::endl;
+                    return false;
+                }
+            }
+
+            apply_fixups(vm, header, fixups);
+            // 内存整个被替换了，之后restart()要恢复所有块
+            vm.mark_all_dirty();
+
+            const unsigned char *image = static_cast<const unsigned char *>(region.data()) - lead;
+            if (header.memory_lead == lead)
+                m_shadow.assign(image, image + lead + memory_bytes);
+            else
+                m_shadow.clear();
+            return true;
+        }
+
+    public:
+        /// @brief 读取检查点的文件头
+        /// @param filename 文件名
+        /// @param header 文件头
+        /// @return 是否成功
+        static bool read_header(const std::string &filename, CheckpointHeader &header)
+        {
+            std::ifstream fin(filename, std::ios::binary);
+            if (fin.fail())
+                return false;
+            if (!fin.read(reinterpret_cast<char *>(&header), sizeof(header)) || memcmp(header.magic, "SVMCKPT", 8) != 0 || header.version != VERSION)
+            {
+                std::cout << "Bad checkpoint file:\"" << filename << "\"" << std::endl;
+                return false;
+            }
+            return true;
+        }
+
+        /// @brief 获取上一次save()写入的内存页数
+        size_t get_pages_written() const
+        {
+            return m_pages_written;
+        }
+
+        /// @brief 上一次restore()是否是直接映射的
+        bool is_mapped() const
+        {
+            return m_mapped;
+        }
+
+    private:
+        /// @brief 生成文件头和修正数据
+        /// @param vm 虚拟机
+        /// @param program_path 程序文件的路径
+        /// @param header 文件头
+        /// @param fixups 修正数据（调用帧和向量寄存器）
+        /// @return 是否成功
+        bool build_header(VM &vm, const std::string &program_path, CheckpointHeader &header, std::vector<unsigned char> &fixups)
+        {
+            typename VM::VMState &state = vm.get_vm_state();
+            const std::vector<CallFrame> &frames = vm.get_call_frames();
+            const size_t page = GuardedRegion::page_size();
+            if (frames.size() > ISData::STACK_CAPACITY)
+                return false;
+
+            memset(&header, 0, sizeof(header));
+            memcpy(header.magic, "SVMCKPT", 8);
+            header.version = VERSION;
+            header.word_bits = sizeof(DWORD) * 8;
+            header.page_size = page;
+            header.program_hash = program_hash(vm.get_program_data());
+            header.instruction_count = vm.get_program_data().instructions.size();
+            header.instruction_index = vm.get_program_data().current_instruction_index;
+            header.stack_top = vm.get_internal_storage_data().get_stack_top();
+            header.exception = state.exception;
+            header.retired_instructions = vm.get_retired_instructions();
+            header.retired_syscalls = vm.get_retired_syscalls();
+            for (size_t i = 0; i < state.general_registers.size(); i++)
+                header.general_registers[i] = state.general_registers[i];
+            for (size_t i = 0; i < state.status_registers.size(); i++)
+                header.status_registers[i] = state.status_registers[i];
+            strncpy(header.program_path, program_path.c_str(), sizeof(header.program_path) - 1);
+
+            // 客户程序设置的陷阱处理函数，以及正在执行的处理函数
+            const std::array<size_t, TrapEnum::Trap::DIV + 1> &vectors = vm.get_trap_vectors();
+            for (size_t i = 0; i < vectors.size(); i++)
+                header.trap_vectors[i] = vectors[i];
+            header.in_trap = vm.is_in_trap();
+            header.trap_frame_depth = vm.get_trap_frame_depth();
+            header.last_trap[0] = vm.get_last_trap().trap;
+            header.last_trap[1] = vm.get_last_trap().index;
+            header.last_trap[2] = vm.get_last_trap().address;
+
+            // 调用帧按最大个数预留空间，这样内存映像的位置固定，可以增量写入
+            header.call_frame_count = frames.size();
+            header.call_frame_offset = page;
+            header.vector_offset = header.call_frame_offset + ISData::STACK_CAPACITY * sizeof(CheckpointCallFrame);
+            header.vector_bytes = sizeof(VectorValue) * RegisterEnum::VectorRegister::VRCOUNT;
+            header.memory_offset = (header.vector_offset + header.vector_bytes + page - 1) / page * page;
+            header.memory_lead = vm.get_internal_storage_data().get_region().lead_bytes();
+            header.memory_bytes = ISData::TOTAL_CAPACITY * sizeof(DWORD);
+
+            fixups.assign(size_t(header.memory_offset - header.call_frame_offset), 0);
+            for (size_t i = 0; i < frames.size(); i++)
+            {
+                CheckpointCallFrame frame = {frames.at(i).return_index, frames.at(i).stack_base};
+                memcpy(fixups.data() + i * sizeof(frame), &frame, sizeof(frame));
+            }
+            memcpy(fixups.data() + (header.vector_offset - header.call_frame_offset), state.vector_registers.data(), size_t(header.vector_bytes));
+            return true;
+        }
+
+        /// @brief 检查文件头中的位置和状态是否和save()写出的布局一致
+        /// 恢复时要按这些位置分配和复制，所以在使用之前全部检查一遍
+        /// @param header 文件头
+        /// @return 是否一致
+        static bool valid_layout(const CheckpointHeader &header)
+        {
+            const uint64_t page = header.page_size;
+            if (page < sizeof(CheckpointHeader) || page > (uint64_t(1) << 24) || (page & (page - 1)) != 0)
+                return false;
+            const uint64_t vector_offset = page + ISData::STACK_CAPACITY * sizeof(CheckpointCallFrame);
+            return header.call_frame_offset == page && header.vector_offset == vector_offset &&
+                   header.memory_offset == (vector_offset + header.vector_bytes + page - 1) / page * page && header.memory_lead < page &&
+                   header.stack_top < ISData::STACK_CAPACITY && header.instruction_index <= header.instruction_count &&
+                   header.exception <= ExceptionEnum::Exception::AOK && valid_trap_state(header);
+        }
+
+        /// @brief 检查文件头中的陷阱处理函数和执行状态
+        /// @param header 文件头
+        /// @return 是否合法
+        static bool valid_trap_state(const CheckpointHeader &header)
+        {
+            for (size_t i = 0; i < TrapEnum::Trap::DIV + 1; i++)
+            {
+                if (header.trap_vectors[i] != 0 && (i < TrapEnum::Trap::ADR || header.trap_vectors[i] >= header.instruction_count))
+                    return false;
+            }
+            return header.in_trap <= 1 && header.trap_frame_depth <= header.call_frame_count && header.last_trap[0] < TrapEnum::Trap::TCOUNT;
+        }
+
+        /// @brief 把文件头和修正数据写回虚拟机
+        void apply_fixups(VM &vm, const CheckpointHeader &header, const std::vector<unsigned char> &fixups)
+        {
+            typename VM::VMState &state = vm.get_vm_state();
+            for (size_t i = 0; i < state.general_registers.size(); i++)
+                state.general_registers[i] = DWORD(header.general_registers[i]);
+            for (size_t i = 0; i < state.status_registers.size(); i++)
+                state.status_registers[i] = header.status_registers[i] != 0;
+            state.flag_source = VM::VMState::FLAGS_READY;
+            memcpy(state.vector_registers.data(), fixups.data() + (header.vector_offset - header.call_frame_offset), size_t(header.vector_bytes));
+            state.exception = ExceptionEnum::Exception(header.exception);
+            state.is_running = false;
+
+            std::vector<CallFrame> &frames = vm.get_call_frames();
+            frames.clear();
+            for (size_t i = 0; i < header.call_frame_count; i++)
+            {
+                CheckpointCallFrame frame;
+                memcpy(&frame, fixups.data() + i * sizeof(frame), sizeof(frame));
+                frames.push_back({size_t(frame.return_index), size_t(frame.stack_base)});
+            }
+
+            vm.get_program_data().current_instruction_index = size_t(header.instruction_index);
+            vm.get_internal_storage_data().get_stack_top() = size_t(header.stack_top);
+            vm.restore_retired_counts(header.retired_instructions, header.retired_syscalls);
+
+            std::array<size_t, TrapEnum::Trap::DIV + 1> &vectors = vm.get_trap_vectors();
+            for (size_t i = 0; i < vectors.size(); i++)
+                vectors[i] = size_t(header.trap_vectors[i]);
+            typename VM::TrapRecord last_trap{};
+            last_trap.trap = TrapEnum::Trap(header.last_trap[0]);
+            last_trap.index = size_t(header.last_trap[1]);
+            last_trap.address = DWORD(header.last_trap[2]);
+            last_trap.vectored = true;
+            vm.restore_trap_state(header.in_trap != 0, size_t(header.trap_frame_depth), last_trap);
+        }
+    };
+
+    using Checkpoint = BasicCheckpoint<DWORD64>;
+    using Checkpoint32 = BasicCheckpoint<DWORD32>;
+} // namespace svm
+
+#endif
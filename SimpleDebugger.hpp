@@ -0,0 +1,401 @@
+#ifndef __SIMPLE_DEBUGGER_HPP__
+#define __SIMPLE_DEBUGGER_HPP__
+
+#include <map>
+#include <vector>
+#include <string>
+#include "SimpleVM.hpp"
+
+namespace svm
+{
+    /// @brief 调试器事件
+    namespace DebugEnum
+    {
+        enum Event
+        {
+            /// @brief 执行完一条指令
+            STEP = 0,
+
+            /// @brief 停在断点上，断点处的指令还没有执行
+            BREAKPOINT,
+
+            /// @brief 触发了观察点，访问内存的指令还没有完成
+            WATCHPOINT,
+
+            /// @brief 程序正常结束
+            EXITED,
+
+            /// @brief 程序因为异常而中止
+            EXCEPTION,
+        };
+    } // namespace DebugEnum
+
+    /// @brief 调试器
+    /// 断点通过把指令换成BRK实现，观察点通过保护所在的内存页实现，
+    /// 所以两次暂停之间程序以正常的速度运行，run()的主循环中没有任何额外的检查。
+    /// 观察点的粒度是页：虚拟机的全部内存（默认1024个机器字）只有两三页，数据段、栈和堆往往和被观察的数据在同一页上，
+    /// 这时几乎每次访问内存都会先触发一次保护页错误（一次信号和两次mprotect，微秒级），确认不是被观察的位置后再单步越过，
+    /// 程序会慢上千倍。get_false_hits()给出这种误触发的次数，用来判断观察点是否值得保留。
+    /// 断点要在加载程序之后设置；调试器析构时会恢复所有被换掉的指令。
+    /// @tparam WordT 机器字类型
+    template <typename WordT>
+    class BasicDebugger
+    {
+    public:
+        /// @brief 机器字类型
+        using DWORD = WordT;
+        using VM = BasicSimpleVM<WordT>;
+        using Instruction = BasicInstruction<WordT>;
+
+        /// @brief 观察点
+        struct Watchpoint
+        {
+            /// @brief 起始位置（单位为机器字）
+            size_t address;
+            /// @brief 长度（单位为机器字）
+            size_t count;
+            /// @brief 读取时是否也触发（否则只在写入时触发）
+            bool on_read;
+        };
+
+    private:
+        /// @brief 被调试的虚拟机
+        VM &m_vm;
+        /// @brief 断点位置和被换掉的原指令
+        std::map<size_t, Instruction> m_breakpoints;
+        /// @brief 观察点
+        std::vector<Watchpoint> m_watchpoints;
+        /// @brief 下一条指令是否要在不保护内存的情况下执行（刚刚停在它的观察点上）
+        bool m_skip_watch = false;
+        /// @brief 程序是否已经结束
+        bool m_finished = false;
+        /// @brief 上一次触发观察点的位置（单位为机器字）
+        size_t m_watch_address = 0;
+        /// @brief 访问了被保护的页、但不是被观察的位置的次数
+        uint64_t m_false_hits = 0;
+
+    public:
+        /// @brief 构造函数
+        /// @param vm 被调试的虚拟机，必须比调试器活得久
+        BasicDebugger(VM &vm) : m_vm(vm) {}
+
+        BasicDebugger(const BasicDebugger &) = delete;
+        BasicDebugger &operator=(const BasicDebugger &) = delete;
+
+        ~BasicDebugger()
+        {
+            clear_breakpoints();
+        }
+
+    public:
+        /// @brief 设置断点
+        /// @param index 指令索引
+        /// @return 是否成功（索引越界时失败，重复设置视为成功）
+        virtual bool set_breakpoint(size_t index)
+        {
+            std::vector<Instruction> &instructions = m_vm.get_program_data().instructions;
+            if (index >= instructions.size())
+                return false;
+            if (m_breakpoints.count(index) > 0)
+                return true;
+            m_breakpoints[index] = instructions.at(index);
+            instructions.at(index) = Instruction(CommandEnum::Command::BRK);
+            return true;
+        }
+
+        /// @brief 删除断点，恢复原指令
+        /// @param index 指令索引
+        /// @return 是否有这个断点
+        virtual bool remove_breakpoint(size_t index)
+        {
+            auto iter = m_breakpoints.find(index);
+            if (iter == m_breakpoints.end())
+                return false;
+            std::vector<Instruction> &instructions = m_vm.get_program_data().instructions;
+            if (index < instructions.size())
+                instructions.at(index) = iter->second;
+            m_breakpoints.erase(iter);
+            return true;
+        }
+
+        /// @brief 删除所有断点
+        virtual void clear_breakpoints()
+        {
+            while (!m_breakpoints.empty())
+                remove_breakpoint(m_breakpoints.begin()->first);
+        }
+
+        /// @brief 判断某条指令上是否有断点
+        bool has_breakpoint(size_t index) const
+        {
+            return m_breakpoints.count(index) > 0;
+        }
+
+        /// @brief 添加观察点
+        /// @param address 起始位置（单位为机器字，和LOAD/STORE的地址相同）
+        /// @param count 长度（单位为机器字）
+        /// @param on_read 读取时是否也触发
+        /// @return 是否成功（不使用保护页时不支持观察点）
+        /// 同一页上其他位置的访问也会被拦下来再放行，参见类的说明
+        virtual bool add_watchpoint(size_t address, size_t count = 1, bool on_read = false)
+        {
+            const GuardedRegion &region = m_vm.get_internal_storage_data().get_region();
+            if (!GuardedRegion::GUARD_PAGES || count == 0 || address >= region.size() || count > region.size() - address)
+                return false;
+            m_watchpoints.push_back({address, count, on_read});
+            return true;
+        }
+
+        /// @brief 删除从某个位置开始的观察点
+        /// @param address 起始位置（单位为机器字）
+        /// @return 是否有这个观察点
+        virtual bool remove_watchpoint(size_t address)
+        {
+            for (size_t i = 0; i < m_watchpoints.size(); i++)
+            {
+                if (m_watchpoints.at(i).address == address)
+                {
+                    m_watchpoints.erase(m_watchpoints.begin() + i);
+                    return true;
+                }
+            }
+            return false;
+        }
+
+    public:
+        /// @brief 执行一条指令
+        /// 停在断点上时执行原指令；停在观察点上时完成那次内存访问
+        /// @return 事件
+        virtual DebugEnum::Event step()
+        {
+            if (m_finished)
+                return finished_event();
+
+            std::vector<Instruction> &instructions = m_vm.get_program_data().instructions;
+            const size_t index = m_vm.get_program_data().current_instruction_index;
+
+            // 程序自带的BRK（不是调试器设置的断点）直接跳过
+            if (!has_breakpoint(index) && index < instructions.size() && instructions.at(index).command == CommandEnum::Command::BRK)
+            {
+                m_vm.get_program_data().current_instruction_index++;
+                return DebugEnum::Event::STEP;
+            }
+
+            while (true)
+            {
+                // 临时换回原指令执行一次，然后再换成BRK
+                auto iter = m_breakpoints.find(index);
+                if (iter != m_breakpoints.end())
+                    instructions.at(index) = iter->second;
+
+                const bool armed = !m_skip_watch && arm_watchpoints();
+                m_skip_watch = false;
+                const bool alive = m_vm.step();
+                if (armed)
+                    disarm_watchpoints();
+
+                if (iter != m_breakpoints.end())
+                    instructions.at(index) = Instruction(CommandEnum::Command::BRK);
+
+                if (!alive)
+                {
+                    m_finished = true;
+                    return finished_event();
+                }
+                if (m_vm.get_stop_reason() != StopEnum::Reason::WATCHPOINT)
+                    return DebugEnum::Event::STEP;
+
+                // 被打断的指令还要再执行一次，这次不保护内存
+                m_skip_watch = true;
+                if (is_watched(m_vm.get_stop_address()))
+                {
+                    m_watch_address = m_vm.get_stop_address();
+                    return DebugEnum::Event::WATCHPOINT;
+                }
+                m_false_hits++;
+            }
+        }
+
+        /// @brief 继续运行直到断点、观察点或者程序结束
+        /// @return 事件
+        virtual DebugEnum::Event resume()
+        {
+            if (m_finished)
+                return finished_event();
+
+            // 先越过当前位置上的断点或观察点
+            const size_t index = m_vm.get_program_data().current_instruction_index;
+            const std::vector<Instruction> &instructions = m_vm.get_program_data().instructions;
+            if (m_skip_watch || (index < instructions.size() && instructions.at(index).command == CommandEnum::Command::BRK))
+            {
+                DebugEnum::Event event = step();
+                if (event != DebugEnum::Event::STEP)
+                    return event;
+            }
+
+            while (true)
+            {
+                const bool armed = arm_watchpoints();
+                m_vm.run();
+                if (armed)
+                    disarm_watchpoints();
+
+                switch (m_vm.get_stop_reason())
+                {
+                case StopEnum::Reason::BREAKPOINT:
+                    return DebugEnum::Event::BREAKPOINT;
+
+                case StopEnum::Reason::WATCHPOINT:
+                {
+                    m_skip_watch = true;
+                    if (is_watched(m_vm.get_stop_address()))
+                    {
+                        m_watch_address = m_vm.get_stop_address();
+                        return DebugEnum::Event::WATCHPOINT;
+                    }
+                    // 同一页上没有被观察的数据：越过这条指令后继续运行
+                    m_false_hits++;
+                    DebugEnum::Event event = step();
+                    if (event != DebugEnum::Event::STEP)
+                        return event;
+                    break;
+                }
+
+                default:
+                    m_finished = true;
+                    return finished_event();
+                }
+            }
+        }
+
+    public:
+        /// @brief 获取下一条要执行的指令索引
+        size_t get_index()
+        {
+            return m_vm.get_program_data().current_instruction_index;
+        }
+
+        /// @brief 获取某条指令（有断点时返回原指令）
+        /// @param index 指令索引
+        /// @return 指令
+        Instruction get_instruction(size_t index)
+        {
+            auto iter = m_breakpoints.find(index);
+            if (iter != m_breakpoints.end())
+                return iter->second;
+            return m_vm.get_program_data().instructions.at(index);
+        }
+
+        /// @brief 反汇编下一条要执行的指令
+        std::string disassemble_current()
+        {
+            const size_t index = get_index();
+            if (index >= m_vm.get_program_data().instructions.size())
+                return "?";
+            return disassemble(get_instruction(index));
+        }
+
+        /// @brief 获取通用寄存器的值
+        DWORD get_register(RegisterEnum::GeneralRegister reg)
+        {
+            return m_vm.get_vm_state().general_registers.at(reg);
+        }
+
+        /// @brief 修改通用寄存器的值
+        void set_register(RegisterEnum::GeneralRegister reg, DWORD value)
+        {
+            m_vm.get_vm_state().general_registers.at(reg) = value;
+        }
+
+        /// @brief 获取标志寄存器的值
+        bool get_flag(RegisterEnum::StatusRegister reg)
+        {
+            return m_vm.get_vm_state().status_registers.at(reg);
+        }
+
+        /// @brief 读取虚拟机内存
+        /// @param address 位置（单位为机器字）
+        /// @param value 读到的值
+        /// @return 是否成功（位置是否在内存内）
+        bool read_memory(size_t address, DWORD &value)
+        {
+            if (address >= m_vm.get_internal_storage_data().get_region().size())
+                return false;
+            value = *m_vm.get_internal_storage_data().access(address);
+            return true;
+        }
+
+        /// @brief 获取上一次触发的观察点的位置（单位为机器字）
+        size_t get_watch_address() const
+        {
+            return m_watch_address;
+        }
+
+        /// @brief 获取观察点误触发的次数（访问了被观察的页上的其他位置）
+        uint64_t get_false_hits() const
+        {
+            return m_false_hits;
+        }
+
+        /// @brief 程序是否已经结束
+        bool is_finished() const
+        {
+            return m_finished;
+        }
+
+    private:
+        /// @brief 程序结束时的事件
+        DebugEnum::Event finished_event()
+        {
+            return m_vm.get_vm_state().exception == ExceptionEnum::Exception::AOK ? DebugEnum::Event::EXITED : DebugEnum::Event::EXCEPTION;
+        }
+
+        /// @brief 判断某个位置是否在观察点内
+        /// @param address 位置（单位为机器字）
+        bool is_watched(size_t address) const
+        {
+            for (size_t i = 0; i < m_watchpoints.size(); i++)
+            {
+                const Watchpoint &watch = m_watchpoints.at(i);
+                if (address >= watch.address && address < watch.address + watch.count)
+                    return true;
+            }
+            return false;
+        }
+
+        /// @brief 保护所有观察点所在的页
+        /// 页是共享的：读写观察点所在的页上，读取写观察点的数据也会暂停
+        /// @return 是否保护了任何页
+        bool arm_watchpoints()
+        {
+            const GuardedRegion &region = m_vm.get_internal_storage_data().get_region();
+            // 先保护只观察写入的页，再保护读取也观察的页，同一页上后者优先
+            for (int on_read = 0; on_read <= 1; on_read++)
+            {
+                for (size_t i = 0; i < m_watchpoints.size(); i++)
+                {
+                    const Watchpoint &watch = m_watchpoints.at(i);
+                    if (watch.on_read == bool(on_read))
+                        region.protect(watch.address * sizeof(DWORD), watch.count * sizeof(DWORD), !watch.on_read, false);
+                }
+            }
+            return !m_watchpoints.empty();
+        }
+
+        /// @brief 恢复观察点所在页的读写权限
+        void disarm_watchpoints()
+        {
+            const GuardedRegion &region = m_vm.get_internal_storage_data().get_region();
+            for (size_t i = 0; i < m_watchpoints.size(); i++)
+            {
+                const Watchpoint &watch = m_watchpoints.at(i);
+                region.protect(watch.address * sizeof(DWORD), watch.count * sizeof(DWORD), true, true);
+            }
+        }
+    };
+
+    using Debugger = BasicDebugger<DWORD64>;
+    using Debugger32 = BasicDebugger<DWORD32>;
+} // namespace svm
+
+#endif
@@ -0,0 +1,182 @@
+#ifndef __SIMPLE_DEVICE_HPP__
+#define __SIMPLE_DEVICE_HPP__
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include "SimpleInst.hpp"
+
+namespace svm
+{
+    /// @brief 内存映射设备（MMIO）
+    /// 设备占用虚拟机内存中的一段连续区域，程序通过普通的内存读写与设备交互，
+    /// 宿主只在轮询（service）时才去处理这段内存，不需要每个字符都走一次SYSCALL。
+    /// @tparam WordT 机器字类型
+    template <typename WordT>
+    class BasicMMIODevice
+    {
+    public:
+        /// @brief 机器字类型
+        using DWORD = WordT;
+
+    private:
+        /// @brief 设备在虚拟机内存中的起始位置
+        size_t m_base = 0;
+
+    public:
+        BasicMMIODevice() {}
+        virtual ~BasicMMIODevice() {}
+
+    public:
+        /// @brief 获取设备在虚拟机内存中的起始位置
+        /// @return 起始位置
+        size_t get_base() const
+        {
+            return m_base;
+        }
+
+        /// @brief 设置设备在虚拟机内存中的起始位置（由虚拟机在映射时调用）
+        /// @param base 起始位置
+        void set_base(size_t base)
+        {
+            m_base = base;
+        }
+
+    public:
+        /// @brief 设备占用的内存大小（单位为DWORD）
+        /// @return 大小
+        virtual size_t size() const = 0;
+
+        /// @brief 设备被映射到内存时调用，用于初始化设备寄存器
+        /// @param memory 设备区域的首地址
+        virtual void attach(DWORD *memory) {}
+
+        /// @brief 设备被映射时以及虚拟机的控制台流改变（set_console/reset_console）时调用
+        /// @param input 虚拟机当前的输入流
+        /// @param output 虚拟机当前的输出流
+        virtual void set_console(std::istream &input, std::ostream &output) {}
+
+        /// @brief 轮询设备，处理程序写入的数据
+        /// @param memory 设备区域的首地址
+        virtual void service(DWORD *memory) = 0;
+    };
+
+    /// @brief 控制台输出设备
+    /// 设备内存布局（相对于设备的起始位置）：
+    /// [DOORBELL] 门铃，程序写入数据后置为非0，宿主处理完后清0
+    /// [HEAD]     读索引，只由宿主修改
+    /// [TAIL]     写索引，只由程序修改
+    /// [CAPACITY] 环形缓冲区容量，只读
+    /// [BUFFER]   环形缓冲区，每个DWORD存放一个字符
+    /// 当(TAIL + 1) % CAPACITY == HEAD时缓冲区已满，程序应当等待宿主处理。
+    /// @tparam WordT 机器字类型
+    template <typename WordT>
+    class BasicConsoleDevice : public BasicMMIODevice<WordT>
+    {
+    public:
+        /// @brief 机器字类型
+        using DWORD = WordT;
+
+        /// @brief 设备寄存器的偏移
+        enum Register
+        {
+            DOORBELL = 0,
+            HEAD,
+            TAIL,
+            CAPACITY,
+            BUFFER,
+        };
+
+    private:
+        /// @brief 环形缓冲区容量
+        size_t m_capacity;
+        /// @brief 输出流（不拥有）
+        std::ostream *m_output;
+        /// @brief 是否跟随虚拟机的控制台流（构造时没有指定输出流）
+        bool m_follow_console;
+        /// @brief 批量输出时使用的缓冲区，避免每次处理都重新分配
+        std::string m_pending;
+
+    public:
+        /// @brief 构造函数，输出到虚拟机的控制台流（随set_console改变）
+        /// @param capacity 环形缓冲区容量（单位为DWORD）
+        BasicConsoleDevice(size_t capacity = 60) : m_capacity(capacity), m_output(&std::cout), m_follow_console(true)
+        {
+            m_pending.reserve(capacity);
+        }
+
+        /// @brief 构造函数，总是输出到指定的流
+        /// @param capacity 环形缓冲区容量（单位为DWORD）
+        /// @param output 输出流，由调用者拥有
+        BasicConsoleDevice(size_t capacity, std::ostream &output) : m_capacity(capacity), m_output(&output), m_follow_console(false)
+        {
+            m_pending.reserve(capacity);
+        }
+        ~BasicConsoleDevice() {}
+
+    public:
+        virtual size_t size() const override
+        {
+            return BUFFER + m_capacity;
+        }
+
+        virtual void attach(DWORD *memory) override
+        {
+            memory[DOORBELL] = 0;
+            memory[HEAD] = 0;
+            memory[TAIL] = 0;
+            memory[CAPACITY] = m_capacity;
+        }
+
+        virtual void set_console(std::istream &input, std::ostream &output) override
+        {
+            if (m_follow_console)
+                m_output = &output;
+        }
+
+        virtual void service(DWORD *memory) override
+        {
+            if (memory[DOORBELL] == 0)
+                return;
+
+            DWORD head = memory[HEAD];
+            DWORD tail = memory[TAIL];
+            // 程序写坏了索引时丢弃缓冲区内容，而不是越界读取
+            if (head >= m_capacity || tail >= m_capacity)
+            {
+                memory[HEAD] = tail < m_capacity ? tail : 0;
+                memory[TAIL] = memory[HEAD];
+                memory[DOORBELL] = 0;
+                return;
+            }
+
+            const DWORD *buffer = memory + BUFFER;
+            m_pending.clear();
+            while (head != tail)
+            {
+                // 一次取出一段连续的字符（最多两段）
+                DWORD end = tail > head ? tail : m_capacity;
+                for (DWORD i = head; i < end; i++)
+                    m_pending.push_back(static_cast<char>(buffer[i]));
+                head = end % m_capacity;
+            }
+            m_output->write(m_pending.data(), m_pending.size());
+
+            memory[HEAD] = tail;
+            memory[DOORBELL] = 0;
+        }
+
+        /// @brief 刷新输出流
+        void flush()
+        {
+            m_output->flush();
+        }
+    };
+
+    using MMIODevice = BasicMMIODevice<DWORD64>;
+    using MMIODevice32 = BasicMMIODevice<DWORD32>;
+    using ConsoleDevice = BasicConsoleDevice<DWORD64>;
+    using ConsoleDevice32 = BasicConsoleDevice<DWORD32>;
+} // namespace svm
+
+#endif
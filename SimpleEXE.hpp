@@ -24,15 +24,63 @@ namespace svm
         };
     } // namespace SectionEnum
 
+    /// @brief 读取程序头中的bits声明（在第一个段声明之前）
+    /// @param lines 程序的每一行
+    /// @return 机器字的位数，没有声明时为64
+    inline size_t detect_word_bits(const std::vector<std::string> &lines)
+    {
+        for (size_t i = 0; i < lines.size(); i++)
+        {
+            const std::vector<std::string> tokens = split(lines.at(i), {' ', ',', '\t', '\r'});
+            if (tokens.empty())
+                continue;
+            if (tokens.at(0) == "section")
+                break;
+            if (tokens.at(0) == "bits" && tokens.size() > 1)
+                return std::stoul(tokens.at(1));
+        }
+        return 64;
+    }
+
+    /// @brief 读取程序文件头中的bits声明（在第一个段声明之前）
+    /// @param filename 文件名
+    /// @return 机器字的位数，没有声明时为64，文件无法打开时为0
+    inline size_t detect_word_bits(const std::string &filename)
+    {
+        std::vector<std::string> lines;
+        if (!load_from_file(filename, lines))
+            return 0;
+        return detect_word_bits(lines);
+    }
+
     /// @brief EXE解析器
-    class EXEParser
+    /// 文件头（第一个段声明之前）可以用“bits 32”或“bits 64”声明程序的机器字宽度，
+    /// 声明和解析器的宽度不一致时解析失败。
+    /// @tparam WordT 机器字类型
+    template <typename WordT>
+    class BasicEXEParser
     {
+    public:
+        /// @brief 机器字类型
+        using DWORD = WordT;
+        using Instruction = BasicInstruction<WordT>;
+        using ProgramData = BasicProgramData<WordT>;
+
+        /// @brief 数据段最多占用的字节数，超过时虚拟机的数据段放不下
+        static const size_t DATA_BYTES = InternalStorageData<WordT>::DATA_CAPACITY * sizeof(WordT);
+
     private:
         ProgramData m_result;
+        /// @brief 标签映射表（文本段标签为指令索引，数据段标签为字节地址）
+        std::map<std::string, size_t> m_labels;
+        /// @brief 尚未解析的标签引用（指令索引, 标签名）
+        std::vector<std::pair<size_t, std::string>> m_unresolved_labels;
+        /// @brief 按字节紧凑存放的数据段
+        std::vector<unsigned char> m_data_bytes;
 
     public:
-        EXEParser() {}
-        ~EXEParser() {}
+        BasicEXEParser() {}
+        ~BasicEXEParser() {}
 
     public:
         /// @brief 解析EXE文件
@@ -40,20 +88,49 @@ namespace svm
         /// @return 是否成功
         virtual bool parse(const std::string &filename)
         {
-            std::vector<std::vector<std::string>> result;
-            bool success = load_from_file(filename, {' ', ','}, result);
+            std::vector<std::string> lines;
+            bool success = load_from_file(filename, lines);
             if (!success)
                 return false;
+            return parse_lines(lines);
+        }
 
+        /// @brief 解析已经读入的EXE文件
+        /// @param lines 文件的每一行
+        /// @return 是否成功
+        virtual bool parse_lines(const std::vector<std::string> &lines)
+        {
             SectionEnum::Section current_section = SectionEnum::Section::UNKNOWN;
 
-            for (size_t i = 0; i < result.size(); i++)
+            for (size_t i = 0; i < lines.size(); i++)
             {
-                const std::vector<std::string> &inst = result.at(i);
+                const std::vector<std::string> inst = split(lines.at(i), {' ', ',', '\t', '\r'});
+                // 跳过空行
+                if (inst.empty())
+                    continue;
                 const std::string &command = inst.at(0);
 
+                // 数据段中的每一行都是数据定义
+                if (current_section == SectionEnum::Section::DATA && command != "section")
+                {
+                    if (!parse_data(lines.at(i), inst))
+                        return false;
+                    if (m_data_bytes.size() > DATA_BYTES)
+                        return data_overflow(lines.at(i));
+                    continue;
+                }
+
                 Instruction inst2;
-                if (command == "section")
+                if (command.back() == ':')
+                {
+                    // 标签，指向下一条指令
+                    if (current_section != SectionEnum::Section::TEXT)
+                        return section_error(command, "TEXT");
+
+                    m_labels[command.substr(0, command.size() - 1)] = m_result.instructions.size();
+                    continue;
+                }
+                else if (command == "section")
                 {
                     const std::string &p1 = inst.at(1);
                     if (p1 == "data")
@@ -68,6 +145,20 @@ namespace svm
                     {
                         current_section = SectionEnum::Section::UNKNOWN;
                     }
+                    // 段声明本身不是指令
+                    continue;
+                }
+                else if (command == "bits")
+                {
+                    if (current_section != SectionEnum::Section::UNKNOWN || inst.size() < 2)
+                        return section_error("bits", "header");
+
+                    if (std::stoul(inst.at(1)) != sizeof(DWORD) * 8)
+                    {
+                        std::cout << "The program is " << inst.at(1) << "-bit, but the parser is " << sizeof(DWORD) * 8 << "-bit" << std::endl;
+                        return false;
+                    }
+                    continue;
                 }
                 else if (command == "MOVRI")
                 {
@@ -78,7 +169,8 @@ namespace svm
                     const std::string &p2 = inst.at(2);
                     inst2.command = CommandEnum::Command::MOVRI;
                     inst2.register1 = RegisterEnum::GeneralRegister(find(gregister_name_list, p1));
-                    inst2.operand1 = std::stoul(p2);
+                    // 立即数也可以是数据段标签（字节地址）或文本段标签（指令索引）
+                    inst2.operand1 = parse_target(p2);
                 }
                 else if (command == "MOVRR")
                 {
@@ -91,6 +183,140 @@ namespace svm
                     inst2.register1 = RegisterEnum::GeneralRegister(find(gregister_name_list, p1));
                     inst2.register2 = RegisterEnum::GeneralRegister(find(gregister_name_list, p2));
                 }
+                else if (command == "LOAD" || command == "STORE" || command == "LOADB" || command == "STOREB" || command == "LOADH" || command == "STOREH" || command == "LOADW" || command == "STOREW")
+                {
+                    if (current_section != SectionEnum::Section::TEXT)
+                        return section_error(command, "TEXT");
+
+                    // LOAD 寄存器1, 基址寄存器, [偏移]
+                    const std::string &p1 = inst.at(1);
+                    const std::string &p2 = inst.at(2);
+                    inst2.command = CommandEnum::Command(find(command_name_list, command));
+                    inst2.register1 = RegisterEnum::GeneralRegister(find(gregister_name_list, p1));
+                    inst2.register2 = RegisterEnum::GeneralRegister(find(gregister_name_list, p2));
+                    inst2.operand1 = inst.size() > 3 ? std::stoul(inst.at(3)) : 0;
+                }
+                else if (command == "PUSH" || command == "POP")
+                {
+                    if (current_section != SectionEnum::Section::TEXT)
+                        return section_error(command, "TEXT");
+
+                    const std::string &p1 = inst.at(1);
+                    inst2.command = command == "PUSH" ? CommandEnum::Command::PUSH : CommandEnum::Command::POP;
+                    inst2.register1 = RegisterEnum::GeneralRegister(find(gregister_name_list, p1));
+                }
+                else if (command == "CALL")
+                {
+                    if (current_section != SectionEnum::Section::TEXT)
+                        return section_error("CALL", "TEXT");
+
+                    // CALL 标签
+                    // 旧程序中的第二个参数（栈帧大小）仍然接受，但已经不再使用
+                    inst2.command = CommandEnum::Command::CALL;
+                    inst2.operand1 = parse_target(inst.at(1));
+                }
+                else if (command == "RET")
+                {
+                    if (current_section != SectionEnum::Section::TEXT)
+                        return section_error("RET", "TEXT");
+
+                    inst2.command = CommandEnum::Command::RET;
+                }
+                else if (command == "MEMCPY" || command == "MEMSET" || command == "MEMCMP")
+                {
+                    if (current_section != SectionEnum::Section::TEXT)
+                        return section_error(command, "TEXT");
+
+                    // MEMCPY 寄存器1, 寄存器2, 长度寄存器
+                    inst2.command = command == "MEMCPY" ? CommandEnum::Command::MEMCPY : (command == "MEMSET" ? CommandEnum::Command::MEMSET : CommandEnum::Command::MEMCMP);
+                    inst2.register1 = RegisterEnum::GeneralRegister(find(gregister_name_list, inst.at(1)));
+                    inst2.register2 = RegisterEnum::GeneralRegister(find(gregister_name_list, inst.at(2)));
+                    inst2.register3 = RegisterEnum::GeneralRegister(find(gregister_name_list, inst.at(3)));
+                }
+                else if (command == "STRLEN" || command == "STRLENB")
+                {
+                    if (current_section != SectionEnum::Section::TEXT)
+                        return section_error(command, "TEXT");
+
+                    inst2.command = command == "STRLEN" ? CommandEnum::Command::STRLEN : CommandEnum::Command::STRLENB;
+                    inst2.register1 = RegisterEnum::GeneralRegister(find(gregister_name_list, inst.at(1)));
+                    inst2.register2 = RegisterEnum::GeneralRegister(find(gregister_name_list, inst.at(2)));
+                }
+                else if (command == "VLOAD" || command == "VSTORE")
+                {
+                    if (current_section != SectionEnum::Section::TEXT)
+                        return section_error(command, "TEXT");
+
+                    // VLOAD 向量寄存器, 基址寄存器, [偏移]
+                    inst2.command = command == "VLOAD" ? CommandEnum::Command::VLOAD : CommandEnum::Command::VSTORE;
+                    inst2.register1 = RegisterEnum::GeneralRegister(find(vregister_name_list, inst.at(1)));
+                    inst2.register2 = RegisterEnum::GeneralRegister(find(gregister_name_list, inst.at(2)));
+                    inst2.operand1 = inst.size() > 3 ? std::stoul(inst.at(3)) : 0;
+                }
+                else if (command == "VBROADCAST")
+                {
+                    if (current_section != SectionEnum::Section::TEXT)
+                        return section_error(command, "TEXT");
+
+                    inst2.command = CommandEnum::Command::VBROADCAST;
+                    inst2.register1 = RegisterEnum::GeneralRegister(find(vregister_name_list, inst.at(1)));
+                    inst2.register2 = RegisterEnum::GeneralRegister(find(gregister_name_list, inst.at(2)));
+                }
+                else if (command == "VADD" || command == "VSUB" || command == "VMUL" || command == "VMIN" || command == "VMAX" || command == "VCMPEQ" || command == "VCMPGT")
+                {
+                    if (current_section != SectionEnum::Section::TEXT)
+                        return section_error(command, "TEXT");
+
+                    inst2.command = CommandEnum::Command(find(command_name_list, command));
+                    inst2.register1 = RegisterEnum::GeneralRegister(find(vregister_name_list, inst.at(1)));
+                    inst2.register2 = RegisterEnum::GeneralRegister(find(vregister_name_list, inst.at(2)));
+                    inst2.register3 = RegisterEnum::GeneralRegister(find(vregister_name_list, inst.at(3)));
+                }
+                else if (command == "VREDADD" || command == "VREDMIN" || command == "VREDMAX")
+                {
+                    if (current_section != SectionEnum::Section::TEXT)
+                        return section_error(command, "TEXT");
+
+                    inst2.command = CommandEnum::Command(find(command_name_list, command));
+                    inst2.register1 = RegisterEnum::GeneralRegister(find(gregister_name_list, inst.at(1)));
+                    inst2.register2 = RegisterEnum::GeneralRegister(find(vregister_name_list, inst.at(2)));
+                }
+                else if (is_command_between(command, CommandEnum::Command::ADDRRR, CommandEnum::Command::SHRRRI))
+                {
+                    if (current_section != SectionEnum::Section::TEXT)
+                        return section_error(command, "TEXT");
+
+                    // ADDRRR 寄存器1, 寄存器2, 寄存器3
+                    // ADDRRI 寄存器1, 寄存器2, 立即数（也可以是标签）
+                    inst2.command = CommandEnum::Command(find(command_name_list, command));
+                    inst2.register1 = RegisterEnum::GeneralRegister(find(gregister_name_list, inst.at(1)));
+                    inst2.register2 = RegisterEnum::GeneralRegister(find(gregister_name_list, inst.at(2)));
+                    if (command.back() == 'R')
+                        inst2.register3 = RegisterEnum::GeneralRegister(find(gregister_name_list, inst.at(3)));
+                    else
+                        inst2.operand1 = parse_target(inst.at(3));
+                }
+                else if (command == "CMPRR" || command == "CMPRI")
+                {
+                    if (current_section != SectionEnum::Section::TEXT)
+                        return section_error(command, "TEXT");
+
+                    inst2.command = command == "CMPRR" ? CommandEnum::Command::CMPRR : CommandEnum::Command::CMPRI;
+                    inst2.register1 = RegisterEnum::GeneralRegister(find(gregister_name_list, inst.at(1)));
+                    if (command == "CMPRR")
+                        inst2.register2 = RegisterEnum::GeneralRegister(find(gregister_name_list, inst.at(2)));
+                    else
+                        inst2.operand1 = parse_target(inst.at(2));
+                }
+                else if (is_command_between(command, CommandEnum::Command::JMP, CommandEnum::Command::JLE))
+                {
+                    if (current_section != SectionEnum::Section::TEXT)
+                        return section_error(command, "TEXT");
+
+                    // JE 标签
+                    inst2.command = CommandEnum::Command(find(command_name_list, command));
+                    inst2.operand1 = parse_target(inst.at(1));
+                }
                 else if (command == "SYSCALL")
                 {
                     if (current_section != SectionEnum::Section::TEXT)
@@ -98,16 +324,233 @@ namespace svm
 
                     inst2.command = CommandEnum::Command::SYSCALL;
                 }
+                else if (command == "CAS" || command == "XADD")
+                {
+                    if (current_section != SectionEnum::Section::TEXT)
+                        return section_error(command, "TEXT");
+
+                    // CAS 寄存器1, 基址寄存器, 寄存器3, [偏移]
+                    inst2.command = command == "CAS" ? CommandEnum::Command::CAS : CommandEnum::Command::XADD;
+                    inst2.register1 = RegisterEnum::GeneralRegister(find(gregister_name_list, inst.at(1)));
+                    inst2.register2 = RegisterEnum::GeneralRegister(find(gregister_name_list, inst.at(2)));
+                    inst2.register3 = RegisterEnum::GeneralRegister(find(gregister_name_list, inst.at(3)));
+                    inst2.operand1 = inst.size() > 4 ? std::stoul(inst.at(4)) : 0;
+                }
+                else if (command == "XCHG")
+                {
+                    if (current_section != SectionEnum::Section::TEXT)
+                        return section_error(command, "TEXT");
+
+                    // XCHG 寄存器1, 基址寄存器, [偏移]
+                    inst2.command = CommandEnum::Command::XCHG;
+                    inst2.register1 = RegisterEnum::GeneralRegister(find(gregister_name_list, inst.at(1)));
+                    inst2.register2 = RegisterEnum::GeneralRegister(find(gregister_name_list, inst.at(2)));
+                    inst2.operand1 = inst.size() > 3 ? std::stoul(inst.at(3)) : 0;
+                }
+                else if (command == "FENCE")
+                {
+                    if (current_section != SectionEnum::Section::TEXT)
+                        return section_error(command, "TEXT");
+
+                    inst2.command = CommandEnum::Command::FENCE;
+                }
+                else if (command == "SPAWN")
+                {
+                    if (current_section != SectionEnum::Section::TEXT)
+                        return section_error(command, "TEXT");
+
+                    // SPAWN 句柄寄存器, 标签
+                    inst2.command = CommandEnum::Command::SPAWN;
+                    inst2.register1 = RegisterEnum::GeneralRegister(find(gregister_name_list, inst.at(1)));
+                    inst2.operand1 = parse_target(inst.at(2));
+                }
+                else if (command == "JOIN")
+                {
+                    if (current_section != SectionEnum::Section::TEXT)
+                        return section_error(command, "TEXT");
+
+                    // JOIN 句柄寄存器
+                    inst2.command = CommandEnum::Command::JOIN;
+                    inst2.register1 = RegisterEnum::GeneralRegister(find(gregister_name_list, inst.at(1)));
+                }
                 else
                 {
                     std::cout << "Unknown command:\"" << command << "\"" << std::endl;
                     return false;
                 }
+                if (!valid_registers(inst2))
+                    return register_error(lines.at(i));
                 m_result.instructions.push_back(inst2);
             }
+
+            // 数据段按字节紧凑存放，再按DWORD补齐
+            m_result.data.assign((m_data_bytes.size() + sizeof(DWORD) - 1) / sizeof(DWORD), 0);
+            if (!m_data_bytes.empty())
+                memcpy(m_result.data.data(), m_data_bytes.data(), m_data_bytes.size());
+
+            return resolve_labels();
+        }
+
+        /// @brief 解析数据段中的一行
+        /// 支持的格式（标签可选，值为字节地址）：
+        /// 标签: byte 1, 2, 3     每个值占1个字节
+        /// 标签: half 1, 2        每个值占2个字节
+        /// 标签: word 1, 2        每个值占4个字节
+        /// 标签: dword 1, 2       每个值占8个字节
+        /// 标签: string "Hello"   字符串，自动添加\0
+        /// 标签: space 16         16个0字节
+        /// align 8                填充到8字节对齐
+        /// 多字节的值按小端序存放，不会自动对齐。
+        /// @param line 原始的一行
+        /// @param tokens 分割后的一行
+        /// @return 是否成功
+        virtual bool parse_data(const std::string &line, const std::vector<std::string> &tokens)
+        {
+            size_t first = 0;
+            if (tokens.at(0).back() == ':')
+            {
+                m_labels[tokens.at(0).substr(0, tokens.at(0).size() - 1)] = m_data_bytes.size();
+                first = 1;
+                if (tokens.size() == 1)
+                    return true;
+            }
+
+            const std::string &directive = tokens.at(first);
+            size_t width = 0;
+            if (directive == "byte")
+                width = 1;
+            else if (directive == "half")
+                width = 2;
+            else if (directive == "word")
+                width = 4;
+            else if (directive == "dword")
+                width = 8;
+
+            if (width > 0)
+            {
+                for (size_t i = first + 1; i < tokens.size(); i++)
+                {
+                    // 数据的宽度和机器字宽度无关
+                    uint64_t value = std::stoull(tokens.at(i));
+                    for (size_t j = 0; j < width; j++)
+                        m_data_bytes.push_back(static_cast<unsigned char>((value >> (8 * j)) & 0xFF));
+                }
+            }
+            else if (directive == "string")
+            {
+                size_t begin = line.find('"');
+                size_t end = line.rfind('"');
+                if (begin == std::string::npos || end == begin)
+                {
+                    std::cout << "Bad string:" << line << std::endl;
+                    return false;
+                }
+                for (size_t i = begin + 1; i < end; i++)
+                {
+                    char ch = line.at(i);
+                    if (ch == '\\' && i + 1 < end)
+                    {
+                        ch = line.at(++i);
+                        ch = ch == 'n' ? '\n' : (ch == 't' ? '\t' : (ch == '0' ? '\0' : ch));
+                    }
+                    m_data_bytes.push_back(static_cast<unsigned char>(ch));
+                }
+                m_data_bytes.push_back('\0');
+            }
+            else if (directive == "space")
+            {
+                // 先检查大小，超大的值不能真的去分配
+                const size_t size = std::stoull(tokens.at(first + 1));
+                if (size > DATA_BYTES - m_data_bytes.size())
+                    return data_overflow(line);
+                m_data_bytes.resize(m_data_bytes.size() + size, 0);
+            }
+            else if (directive == "align")
+            {
+                size_t alignment = std::stoul(tokens.at(first + 1));
+                if (alignment == 0)
+                    return bad_data(line);
+                const size_t padding = (alignment - m_data_bytes.size() % alignment) % alignment;
+                if (padding > DATA_BYTES - m_data_bytes.size())
+                    return data_overflow(line);
+                m_data_bytes.resize(m_data_bytes.size() + padding, 0);
+            }
+            else
+            {
+                return bad_data(line);
+            }
             return true;
         }
 
+        /// @brief 当数据定义有误时
+        /// @param line 出错的一行
+        /// @return 永远返回false
+        virtual bool bad_data(const std::string &line)
+        {
+            std::cout << "Bad data definition:\"" << line << "\"" << std::endl;
+            return false;
+        }
+
+        /// @brief 当数据段超过虚拟机数据段的容量时
+        /// @param line 超出容量的一行
+        /// @return 永远返回false
+        virtual bool data_overflow(const std::string &line)
+        {
+            std::cout << "Data section exceeds " << DATA_BYTES << " bytes at:\"" << line << "\"" << std::endl;
+            return false;
+        }
+
+        /// @brief 当指令中有不认识的寄存器时
+        /// @param line 出错的一行
+        /// @return 永远返回false
+        virtual bool register_error(const std::string &line)
+        {
+            std::cout << "Unknown register at:\"" << line << "\"" << std::endl;
+            return false;
+        }
+
+        /// @brief 解析跳转目标。如果是数字则直接作为指令索引，否则记录下来等全部解析完后再回填。
+        /// @param target 跳转目标
+        /// @return 指令索引（标签时暂时为0）
+        virtual DWORD parse_target(const std::string &target)
+        {
+            if (!target.empty() && ((target.at(0) >= '0' && target.at(0) <= '9') || target.at(0) == '-' || target.at(0) == '+'))
+                return DWORD(std::stoull(target));
+
+            m_unresolved_labels.push_back({m_result.instructions.size(), target});
+            return 0;
+        }
+
+        /// @brief 回填所有标签引用
+        /// @return 是否所有标签都已定义
+        virtual bool resolve_labels()
+        {
+            for (size_t i = 0; i < m_unresolved_labels.size(); i++)
+            {
+                const std::pair<size_t, std::string> &ref = m_unresolved_labels.at(i);
+                auto iter = m_labels.find(ref.second);
+                if (iter == m_labels.end())
+                {
+                    std::cout << "Undefined label:\"" << ref.second << "\"" << std::endl;
+                    return false;
+                }
+                m_result.instructions.at(ref.first).operand1 = iter->second;
+            }
+            m_unresolved_labels.clear();
+            return true;
+        }
+
+        /// @brief 判断指令名是否在指令枚举的某个范围内
+        /// @param command 指令名
+        /// @param first 范围的第一个指令
+        /// @param last 范围的最后一个指令
+        /// @return 是否在范围内
+        virtual bool is_command_between(const std::string &command, CommandEnum::Command first, CommandEnum::Command last)
+        {
+            size_t index = find(command_name_list, command);
+            return index >= size_t(first) && index <= size_t(last);
+        }
+
         /// @brief 当代码不在应该在的段中时
         /// @param command 指令名
         /// @param section 段名
@@ -124,6 +567,9 @@ namespace svm
             return m_result;
         }
     };
+
+    using EXEParser = BasicEXEParser<DWORD64>;
+    using EXEParser32 = BasicEXEParser<DWORD32>;
 } // namespace svm
 
 #endif
\ No newline at end of file
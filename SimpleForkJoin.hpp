@@ -0,0 +1,298 @@
+#ifndef __SIMPLE_FORK_JOIN_HPP__
+#define __SIMPLE_FORK_JOIN_HPP__
+
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <condition_variable>
+#include "SimpleMultiCore.hpp"
+
+namespace svm
+{
+    /// @brief 分叉-汇合虚拟机
+    /// 主程序用SPAWN创建子任务，用JOIN等待子任务结束并取回它的AX、BX、CX、DX。
+    /// 子任务只是一条记录（开始时的寄存器和入口），由固定个数的工作核轮流执行，所以创建几千个子任务也很便宜；
+    /// 每个工作核有一个常驻的工作线程，构造时创建，析构时结束，多次run()之间不会重新创建线程；
+    /// 工作核和主程序共享内存和程序（每个核一份指令，而不是每个子任务一份），主程序和每个工作核都有自己完整大小的栈。
+    /// 子任务不能再创建子任务（SPAWN发出ins异常），否则等待孙任务的工作核会占住线程。
+    /// 任何一个子任务发生异常，整个虚拟机都会停止，还没开始的子任务不再执行。
+    /// @tparam WordT 机器字类型
+    template <typename WordT>
+    class BasicForkJoinVM : public BasicForkJoinHost<WordT>
+    {
+    public:
+        /// @brief 机器字类型
+        using DWORD = WordT;
+        using VM = BasicSimpleVM<WordT>;
+        using ISData = typename VM::ISData;
+        using ProgramData = typename VM::ProgramData;
+        using Registers = std::array<DWORD, RegisterEnum::GeneralRegister::GRCOUNT>;
+        using Results = std::array<DWORD, BasicForkJoinHost<WordT>::RESULT_COUNT>;
+
+    private:
+        /// @brief 子任务
+        struct Task
+        {
+            /// @brief 开始时的通用寄存器
+            Registers registers;
+            /// @brief 入口的指令索引
+            size_t index = 0;
+            /// @brief 结束时的AX、BX、CX、DX
+            Results results{};
+            /// @brief 是否已经结束
+            bool done = false;
+            /// @brief 槽位是否空闲（已经被JOIN过）
+            bool free = true;
+        };
+
+    private:
+        /// @brief 所有核共享的内存
+        std::shared_ptr<ISData> m_storage;
+        /// @brief 所有核共享的资源
+        std::shared_ptr<CoreGroup> m_group;
+        /// @brief 执行主程序的核
+        std::unique_ptr<VM> m_main;
+        /// @brief 执行子任务的核
+        std::vector<std::unique_ptr<VM>> m_workers;
+        /// @brief 工作线程，和m_workers一一对应
+        std::vector<std::thread> m_threads;
+
+        /// @brief 保护下面的任务状态
+        std::mutex m_mutex;
+        /// @brief 有新的子任务或者要退出时通知工作线程
+        std::condition_variable m_work_ready;
+        /// @brief 有子任务结束时通知等待的主程序和run()
+        std::condition_variable m_task_done;
+        /// @brief 子任务槽位，句柄就是槽位的下标
+        std::vector<Task> m_tasks;
+        /// @brief 空闲的槽位
+        std::vector<size_t> m_free_slots;
+        /// @brief 等待执行的子任务
+        std::deque<size_t> m_queue;
+        /// @brief 正在执行的子任务个数
+        size_t m_running = 0;
+        /// @brief 虚拟机正在析构，工作线程退出
+        bool m_shutdown = false;
+        /// @brief 创建过的子任务总数
+        uint64_t m_spawned = 0;
+        /// @brief 子任务发生的第一个异常
+        ExceptionEnum::Exception m_task_exception = ExceptionEnum::Exception::AOK;
+
+    public:
+        /// @brief 构造函数
+        /// @param worker_count 工作核数，为0时使用宿主的硬件线程数
+        BasicForkJoinVM(size_t worker_count = 0) : m_storage(std::make_shared<ISData>()), m_group(std::make_shared<CoreGroup>())
+        {
+            if (worker_count == 0)
+                worker_count = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+            m_main.reset(new VM(m_storage, m_group));
+            m_main->attach_fork_join(this);
+            for (size_t i = 0; i < worker_count; i++)
+                m_workers.emplace_back(new VM(m_storage, m_group));
+            for (size_t i = 0; i < worker_count; i++)
+                m_threads.emplace_back([this, i]()
+                                       { work(*m_workers.at(i)); });
+        }
+
+        BasicForkJoinVM(const BasicForkJoinVM &) = delete;
+        BasicForkJoinVM &operator=(const BasicForkJoinVM &) = delete;
+
+        ~BasicForkJoinVM()
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_shutdown = true;
+            }
+            m_work_ready.notify_all();
+            for (size_t i = 0; i < m_threads.size(); i++)
+                m_threads.at(i).join();
+        }
+
+    public:
+        /// @brief 加载程序，数据段只写入一次共享内存
+        /// @param program_data 程序
+        virtual void load_program(const ProgramData &program_data)
+        {
+            m_main->load_program(program_data);
+            for (size_t i = 0; i < m_workers.size(); i++)
+                m_workers.at(i)->get_program_data() = program_data;
+        }
+
+        /// @brief 运行主程序，直到它停止并且所有子任务都结束
+        /// 主程序在调用者的线程上运行，子任务由常驻的工作线程执行
+        virtual void run()
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_tasks.clear();
+                m_free_slots.clear();
+                m_queue.clear();
+                m_task_exception = ExceptionEnum::Exception::AOK;
+            }
+            m_group->abort.store(false);
+
+            m_main->run();
+
+            // 主程序没有JOIN的子任务也要执行完，下一次run()才能清空槽位
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_task_done.wait(lock, [this]()
+                             { return m_queue.empty() && m_running == 0; });
+        }
+
+        /// @brief 重置所有核和共享内存
+        virtual void reset()
+        {
+            m_storage->clear();
+            m_main->reset();
+            for (size_t i = 0; i < m_workers.size(); i++)
+                m_workers.at(i)->reset();
+            m_group->abort.store(false);
+            m_spawned = 0;
+        }
+
+    public:
+        /// @brief 创建子任务（由主程序的SPAWN调用）
+        virtual bool spawn(const Registers &registers, size_t index, DWORD &handle) override
+        {
+            if (index >= m_main->get_program_data().instructions.size())
+                return false;
+
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                size_t slot;
+                if (m_free_slots.empty())
+                {
+                    slot = m_tasks.size();
+                    m_tasks.emplace_back();
+                }
+                else
+                {
+                    slot = m_free_slots.back();
+                    m_free_slots.pop_back();
+                }
+
+                Task &task = m_tasks.at(slot);
+                task.registers = registers;
+                task.index = index;
+                task.done = false;
+                task.free = false;
+                m_queue.push_back(slot);
+                m_spawned++;
+                handle = DWORD(slot);
+            }
+            m_work_ready.notify_one();
+            return true;
+        }
+
+        /// @brief 等待子任务结束（由主程序的JOIN调用）
+        virtual bool join(DWORD handle, Results &results) override
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            if (handle >= m_tasks.size() || m_tasks.at(handle).free)
+                return false;
+
+            Task &task = m_tasks.at(handle);
+            m_task_done.wait(lock, [&task]()
+                             { return task.done; });
+            results = task.results;
+            task.free = true;
+            m_free_slots.push_back(handle);
+            return true;
+        }
+
+    public:
+        /// @brief 获取工作核数
+        size_t get_worker_count() const
+        {
+            return m_workers.size();
+        }
+
+        /// @brief 获取执行主程序的核
+        VM &get_main()
+        {
+            return *m_main;
+        }
+
+        /// @brief 获取发生的异常（先看主程序，再看子任务中第一个发生的），都正常时为AOK
+        ExceptionEnum::Exception get_exception()
+        {
+            if (m_main->get_vm_state().exception != ExceptionEnum::Exception::AOK)
+                return m_main->get_vm_state().exception;
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_task_exception;
+        }
+
+        /// @brief 获取所有核执行过的指令总数
+        uint64_t get_retired_instructions() const
+        {
+            uint64_t total = m_main->get_retired_instructions();
+            for (size_t i = 0; i < m_workers.size(); i++)
+                total += m_workers.at(i)->get_retired_instructions();
+            return total;
+        }
+
+        /// @brief 获取创建过的子任务总数
+        uint64_t get_spawned() const
+        {
+            return m_spawned;
+        }
+
+        /// @brief 获取共享内存
+        /// @return 运行时数据的引用
+        ISData &get_internal_storage_data()
+        {
+            return *m_storage;
+        }
+
+    private:
+        /// @brief 工作线程：逐个取出子任务在自己的核上执行，直到虚拟机析构
+        /// @param core 这个线程使用的核
+        void work(VM &core)
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            while (true)
+            {
+                m_work_ready.wait(lock, [this]()
+                                  { return !m_queue.empty() || m_shutdown; });
+                if (m_shutdown)
+                    break;
+
+                const size_t slot = m_queue.front();
+                m_queue.pop_front();
+                m_running++;
+                const Registers registers = m_tasks.at(slot).registers;
+                const size_t index = m_tasks.at(slot).index;
+                lock.unlock();
+
+                // 已经有核发生异常时不再执行，结果为0
+                Results results{};
+                ExceptionEnum::Exception exception = ExceptionEnum::Exception::AOK;
+                if (!m_group->abort.load())
+                {
+                    core.enter(registers, index);
+                    core.run();
+                    const Registers &final_registers = core.get_vm_state().general_registers;
+                    std::copy(final_registers.begin(), final_registers.begin() + results.size(), results.begin());
+                    exception = core.get_vm_state().exception;
+                }
+
+                lock.lock();
+                if (m_task_exception == ExceptionEnum::Exception::AOK)
+                    m_task_exception = exception;
+                Task &task = m_tasks.at(slot);
+                task.results = results;
+                task.done = true;
+                m_running--;
+                m_task_done.notify_all();
+            }
+        }
+    };
+
+    using ForkJoinVM = BasicForkJoinVM<DWORD64>;
+    using ForkJoinVM32 = BasicForkJoinVM<DWORD32>;
+} // namespace svm
+
+#endif
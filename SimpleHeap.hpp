@@ -0,0 +1,181 @@
+#ifndef __SIMPLE_HEAP_HPP__
+#define __SIMPLE_HEAP_HPP__
+
+#include "SimpleInst.hpp"
+
+namespace svm
+{
+    /// @brief 分级（size class）堆分配器
+    /// 所有元数据都放在虚拟机的堆内存里，所以全零的堆就是一个合法的空堆，不需要额外初始化。
+    /// 堆内存布局（相对于堆的起始位置）：
+    /// [BUMP]        下一个未分配位置（相对于BLOCKS）
+    /// [FREE_LISTS]  每个级别的空闲链表头（客户地址，0表示空）
+    /// [BLOCKS]      内存块，每块前面有一个DWORD的头，记录它的级别
+    /// 第k级的块可以容纳2^k个DWORD，空闲块的第一个DWORD存放链表中下一个块的地址。
+    /// @tparam WordT 机器字类型
+    template <typename WordT>
+    class BasicHeapAllocator
+    {
+    public:
+        /// @brief 机器字类型
+        using DWORD = WordT;
+
+        /// @brief 级别总数
+        static const size_t CLASS_COUNT = 16;
+
+        /// @brief 元数据的偏移
+        enum Layout
+        {
+            BUMP = 0,
+            FREE_LISTS,
+            BLOCKS = FREE_LISTS + CLASS_COUNT,
+        };
+
+    private:
+        /// @brief 虚拟机内存首地址
+        DWORD *m_memory;
+        /// @brief 堆的起始位置
+        size_t m_begin;
+        /// @brief 堆的容量
+        size_t m_capacity;
+
+    public:
+        /// @brief 构造函数
+        /// @param memory 虚拟机内存首地址
+        /// @param begin 堆的起始位置
+        /// @param capacity 堆的容量
+        BasicHeapAllocator(DWORD *memory, size_t begin, size_t capacity) : m_memory(memory), m_begin(begin), m_capacity(capacity) {}
+        ~BasicHeapAllocator() {}
+
+    public:
+        /// @brief 分配内存，O(1)
+        /// @param size 大小（单位为DWORD）
+        /// @return 客户地址，失败时为0
+        DWORD allocate(DWORD size)
+        {
+            size_t cls = size_class(size);
+            if (cls >= CLASS_COUNT)
+                return 0;
+
+            // 优先复用同级别的空闲块
+            // 链表头在客户内存里，可能被程序改坏，所以用之前先确认它指向堆内
+            DWORD &head = heap(FREE_LISTS + cls);
+            if (head != 0 && is_block(head))
+            {
+                DWORD address = head;
+                head = m_memory[address];
+                return address;
+            }
+
+            return bump(DWORD(1) << cls, cls);
+        }
+
+        /// @brief 以竞技场（arena）方式分配内存：没有块头，不能单独释放，只能由reset()整体丢弃
+        /// @param size 大小（单位为DWORD）
+        /// @return 客户地址，失败时为0
+        DWORD allocate_arena(DWORD size)
+        {
+            DWORD &top = heap(BUMP);
+            if (size == 0 || size > available())
+                return 0;
+
+            DWORD address = DWORD(m_begin + BLOCKS + top);
+            top += size;
+            return address;
+        }
+
+        /// @brief 释放内存，O(1)
+        /// @param address allocate()返回的客户地址
+        /// @return 是否成功（地址是否像是一个合法的块）
+        bool free(DWORD address)
+        {
+            if (address == 0)
+                return true;
+            if (!is_block(address))
+                return false;
+
+            DWORD cls = m_memory[address - 1];
+            if (cls >= CLASS_COUNT)
+                return false;
+
+            DWORD &head = heap(FREE_LISTS + cls);
+            m_memory[address] = head;
+            head = address;
+            return true;
+        }
+
+        /// @brief 一次性丢弃所有分配（包括普通分配和竞技场分配）
+        void reset()
+        {
+            for (size_t i = 0; i < BLOCKS; i++)
+                heap(i) = 0;
+        }
+
+    public:
+        /// @brief 计算大小对应的级别，即不小于size的最小的2的幂的指数
+        /// @param size 大小（单位为DWORD）
+        /// @return 级别
+        static size_t size_class(DWORD size)
+        {
+            if (size <= 1)
+                return 0;
+#if defined(__GNUC__) || defined(__clang__)
+            return size_t(64 - __builtin_clzll((unsigned long long)(size - 1)));
+#else
+            size_t cls = 0;
+            for (DWORD rest = size - 1; rest != 0; rest >>= 1)
+                cls++;
+            return cls;
+#endif
+        }
+
+    private:
+        /// @brief 判断客户地址是否可能是一个块（块头和第一个DWORD都在堆内）
+        /// @param address 客户地址
+        /// @return 是否在堆内
+        bool is_block(DWORD address)
+        {
+            return address > m_begin + BLOCKS && address < m_begin + m_capacity;
+        }
+
+        /// @brief 访问堆的元数据
+        /// @param offset 相对于堆起始位置的偏移
+        /// @return 引用
+        DWORD &heap(size_t offset)
+        {
+            return m_memory[m_begin + offset];
+        }
+
+        /// @brief 剩余的未分配空间
+        /// @return 大小（单位为DWORD）
+        DWORD available()
+        {
+            // BUMP同样可能被程序改坏，先和容量比较再做减法，避免回绕
+            DWORD top = heap(BUMP);
+            if (m_capacity <= BLOCKS || top >= m_capacity - BLOCKS)
+                return 0;
+            return DWORD(m_capacity - BLOCKS - top);
+        }
+
+        /// @brief 从未分配空间中切出一个带块头的块
+        /// @param size 块的大小（不含块头）
+        /// @param cls 块的级别
+        /// @return 客户地址，失败时为0
+        DWORD bump(DWORD size, size_t cls)
+        {
+            if (size + 1 > available())
+                return 0;
+
+            DWORD &top = heap(BUMP);
+            DWORD header = DWORD(m_begin + BLOCKS + top);
+            m_memory[header] = cls;
+            top += size + 1;
+            return header + 1;
+        }
+    };
+
+    using HeapAllocator = BasicHeapAllocator<DWORD64>;
+    using HeapAllocator32 = BasicHeapAllocator<DWORD32>;
+} // namespace svm
+
+#endif
@@ -0,0 +1,385 @@
+#ifndef __SIMPLE_IMAGE_CACHE_HPP__
+#define __SIMPLE_IMAGE_CACHE_HPP__
+
+#include <atomic>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <iostream>
+#include <algorithm>
+#include <filesystem>
+#include "SimpleEXE.hpp"
+
+// 在类Unix系统上用flock保护淘汰过程，其他平台不加锁
+#if (defined(__unix__) || defined(__APPLE__)) && !defined(SVM_NO_IMAGE_FLOCK)
+#define SVM_IMAGE_FLOCK 1
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+#else
+#define SVM_IMAGE_FLOCK 0
+#endif
+
+namespace svm
+{
+    /// @brief 程序映像缓存文件的文件头
+    /// 文件依次是文件头、instruction_count条ImageInstruction、data_count个uint64_t
+    struct ImageHeader
+    {
+        /// @brief 固定为"SVMIMAGE"
+        char magic[8];
+        /// @brief 格式版本
+        uint32_t version;
+        /// @brief 虚拟机的机器字位数
+        uint32_t word_bits;
+        /// @brief 指令总数（CMDCOUNT），指令编号变化后旧的缓存自动失效
+        uint32_t command_count;
+        uint32_t reserved;
+        /// @brief 源文件内容的指纹
+        uint64_t source_hash;
+        /// @brief 源文件的长度
+        uint64_t source_size;
+        /// @brief 指令条数
+        uint64_t instruction_count;
+        /// @brief 数据段的长度（单位为机器字）
+        uint64_t data_count;
+        /// @brief 文件头之后所有内容的校验和
+        uint64_t payload_checksum;
+    };
+
+    /// @brief 缓存文件中的一条指令
+    struct ImageInstruction
+    {
+        uint8_t command;
+        uint8_t register1;
+        uint8_t register2;
+        uint8_t register3;
+        uint32_t reserved;
+        uint64_t operand1;
+        uint64_t operand2;
+    };
+
+    static_assert(sizeof(ImageInstruction) == 24, "ImageInstruction must stay 24 bytes");
+
+    /// @brief 计算一段数据的FNV-1a指纹
+    /// @param data 数据
+    /// @param size 长度（单位为字节）
+    /// @param hash 初始值，用于把多段数据连起来计算
+    /// @return 指纹
+    inline uint64_t fnv1a64(const void *data, size_t size, uint64_t hash = 1469598103934665603ULL)
+    {
+        const unsigned char *bytes = static_cast<const unsigned char *>(data);
+        for (size_t i = 0; i < size; i++)
+        {
+            hash ^= bytes[i];
+            hash *= 1099511628211ULL;
+        }
+        return hash;
+    }
+
+    /// @brief 解析结果的缓存，以源文件内容的指纹为键
+    /// 源文件内容变化后指纹随之变化，旧的缓存不会再被使用，最终被淘汰。
+    /// 多个进程可以同时使用同一个目录：新的缓存文件先写到临时文件再改名，读到的总是完整的文件；
+    /// 被淘汰的文件只是被删除，正在使用它的进程不受影响。淘汰按最后使用时间（修改时间）进行。
+    /// @tparam WordT 机器字类型
+    template <typename WordT>
+    class BasicImageCache
+    {
+    public:
+        /// @brief 机器字类型
+        using DWORD = WordT;
+        using Instruction = BasicInstruction<WordT>;
+        using ProgramData = BasicProgramData<WordT>;
+        using EXEParser = BasicEXEParser<WordT>;
+
+        /// @brief 格式版本
+        static const uint32_t VERSION = 1;
+
+    private:
+        /// @brief 缓存目录
+        std::filesystem::path m_directory;
+        /// @brief 缓存目录的最大总大小（单位为字节）
+        uint64_t m_max_bytes;
+        /// @brief 命中次数
+        uint64_t m_hits = 0;
+        /// @brief 未命中次数
+        uint64_t m_misses = 0;
+
+    public:
+        /// @brief 构造函数
+        /// @param directory 缓存目录，不存在时自动创建
+        /// @param max_bytes 缓存目录的最大总大小（单位为字节）
+        BasicImageCache(const std::string &directory, uint64_t max_bytes = 64 * 1024 * 1024) : m_directory(directory), m_max_bytes(max_bytes)
+        {
+            std::error_code error;
+            std::filesystem::create_directories(m_directory, error);
+        }
+        ~BasicImageCache() {}
+
+    public:
+        /// @brief 加载程序：命中缓存时直接读取映像，否则解析源文件并写入缓存
+        /// @param filename 源文件
+        /// @param program 程序
+        /// @return 是否成功
+        virtual bool load(const std::string &filename, ProgramData &program)
+        {
+            std::string source;
+            if (!read_file(filename, source))
+            {
+                std::cout << "Unable to open file \"" << filename << "\"" << std::endl;
+                return false;
+            }
+
+            const uint64_t hash = fnv1a64(source.data(), source.size());
+            const std::filesystem::path path = image_path(hash);
+            if (load_image(path, hash, source.size(), program))
+            {
+                m_hits++;
+                touch(path);
+                return true;
+            }
+
+            // 解析已经读入的内容，而不是重新打开文件，这样缓存的内容和指纹一定对应
+            m_misses++;
+            std::vector<std::string> lines;
+            std::istringstream sstr(source);
+            std::string line;
+            while (std::getline(sstr, line))
+                lines.push_back(line);
+            EXEParser parser;
+            if (!parser.parse_lines(lines))
+                return false;
+            program = parser.get_program();
+            if (store_image(path, hash, source.size(), program))
+                evict();
+            return true;
+        }
+
+        /// @brief 淘汰最久没有使用的缓存文件，直到总大小不超过上限
+        /// 另一个进程正在淘汰时直接返回
+        virtual void evict()
+        {
+#if SVM_IMAGE_FLOCK
+            const std::string lock_path = (m_directory / ".lock").string();
+            int lock = open(lock_path.c_str(), O_RDWR | O_CREAT, 0644);
+            if (lock < 0)
+                return;
+            if (flock(lock, LOCK_EX | LOCK_NB) != 0)
+            {
+                close(lock);
+                return;
+            }
+#endif
+            struct Entry
+            {
+                std::filesystem::path path;
+                std::filesystem::file_time_type time;
+                uint64_t size;
+            };
+            std::vector<Entry> entries;
+            uint64_t total = 0;
+            std::error_code error;
+            for (const std::filesystem::directory_entry &entry : std::filesystem::directory_iterator(m_directory, error))
+            {
+                if (entry.path().extension() != ".simg")
+                    continue;
+                std::error_code entry_error;
+                Entry item = {entry.path(), entry.last_write_time(entry_error), entry.file_size(entry_error)};
+                if (entry_error)
+                    continue;
+                entries.push_back(item);
+                total += item.size;
+            }
+
+            std::sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b)
+                      { return a.time < b.time; });
+            for (size_t i = 0; i < entries.size() && total > m_max_bytes; i++)
+            {
+                std::filesystem::remove(entries.at(i).path, error);
+                total -= entries.at(i).size;
+            }
+#if SVM_IMAGE_FLOCK
+            flock(lock, LOCK_UN);
+            close(lock);
+#endif
+        }
+
+        /// @brief 获取命中次数
+        uint64_t get_hits() const
+        {
+            return m_hits;
+        }
+
+        /// @brief 获取未命中次数
+        uint64_t get_misses() const
+        {
+            return m_misses;
+        }
+
+    private:
+        /// @brief 读取整个文件（按文件大小一次读入）
+        static bool read_file(const std::string &filename, std::string &content)
+        {
+            std::ifstream fin(filename, std::ios::binary | std::ios::ate);
+            if (fin.fail())
+                return false;
+            const std::streamoff size = fin.tellg();
+            if (size < 0)
+                return false;
+            content.resize(size_t(size));
+            fin.seekg(0);
+            return bool(fin.read(&content[0], std::streamsize(content.size())));
+        }
+
+        /// @brief 获取缓存文件的路径
+        std::filesystem::path image_path(uint64_t hash) const
+        {
+            std::ostringstream sstr;
+            sstr << std::hex << std::setw(16) << std::setfill('0') << hash << "-" << std::dec << sizeof(DWORD) * 8 << ".simg";
+            return m_directory / sstr.str();
+        }
+
+        /// @brief 把缓存文件标记为刚刚使用过
+        static void touch(const std::filesystem::path &path)
+        {
+            std::error_code error;
+            std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now(), error);
+        }
+
+        /// @brief 读取并校验缓存文件
+        /// 映像要逐条解码成指令，所以直接读入再解码：映射文件省不掉这次复制，只会多出建立和拆除映射的开销
+        /// @return 是否成功，文件不存在或损坏时失败（损坏的文件会被删除）
+        bool load_image(const std::filesystem::path &path, uint64_t hash, uint64_t source_size, ProgramData &program)
+        {
+            std::string content;
+            if (!read_file(path.string(), content))
+                return false;
+            const bool success = decode(reinterpret_cast<const unsigned char *>(content.data()), content.size(), hash, source_size, program);
+            if (!success)
+            {
+                std::error_code error;
+                std::filesystem::remove(path, error);
+            }
+            return success;
+        }
+
+        /// @brief 校验并解码缓存文件的内容
+        bool decode(const unsigned char *bytes, size_t size, uint64_t hash, uint64_t source_size, ProgramData &program) const
+        {
+            if (size < sizeof(ImageHeader))
+                return false;
+            ImageHeader header;
+            memcpy(&header, bytes, sizeof(header));
+            if (memcmp(header.magic, "SVMIMAGE", sizeof(header.magic)) != 0 || header.version != VERSION || header.word_bits != sizeof(DWORD) * 8 ||
+                header.command_count != CommandEnum::Command::CMDCOUNT || header.source_hash != hash || header.source_size != source_size)
+                return false;
+
+            const uint64_t payload = size - sizeof(header);
+            if (header.instruction_count > payload / sizeof(ImageInstruction) || header.data_count > payload / sizeof(uint64_t) || header.data_count > InternalStorageData<WordT>::DATA_CAPACITY ||
+                payload != header.instruction_count * sizeof(ImageInstruction) + header.data_count * sizeof(uint64_t) ||
+                fnv1a64(bytes + sizeof(header), size_t(payload)) != header.payload_checksum)
+                return false;
+
+            const unsigned char *cursor = bytes + sizeof(header);
+            program.instructions.resize(size_t(header.instruction_count));
+            for (size_t i = 0; i < program.instructions.size(); i++)
+            {
+                ImageInstruction record;
+                memcpy(&record, cursor + i * sizeof(record), sizeof(record));
+                if (record.command >= CommandEnum::Command::CMDCOUNT)
+                    return false;
+                Instruction &inst = program.instructions[i];
+                inst.command = CommandEnum::Command(record.command);
+                inst.register1 = RegisterEnum::GeneralRegister(record.register1);
+                inst.register2 = RegisterEnum::GeneralRegister(record.register2);
+                inst.register3 = RegisterEnum::GeneralRegister(record.register3);
+                inst.operand1 = DWORD(record.operand1);
+                inst.operand2 = DWORD(record.operand2);
+                // 和解析器一样检查寄存器编号，执行时就不会越界
+                if (!valid_registers(inst))
+                    return false;
+            }
+            cursor += header.instruction_count * sizeof(ImageInstruction);
+
+            program.data.resize(size_t(header.data_count));
+            for (size_t i = 0; i < program.data.size(); i++)
+            {
+                uint64_t value;
+                memcpy(&value, cursor + i * sizeof(value), sizeof(value));
+                program.data[i] = DWORD(value);
+            }
+            program.current_instruction_index = 0;
+            return true;
+        }
+
+        /// @brief 写入缓存文件（先写临时文件再改名）
+        /// @return 是否成功
+        bool store_image(const std::filesystem::path &path, uint64_t hash, uint64_t source_size, const ProgramData &program)
+        {
+            std::string payload;
+            payload.reserve(program.instructions.size() * sizeof(ImageInstruction) + program.data.size() * sizeof(uint64_t));
+            for (size_t i = 0; i < program.instructions.size(); i++)
+            {
+                const Instruction &inst = program.instructions.at(i);
+                ImageInstruction record = {uint8_t(inst.command), uint8_t(inst.register1), uint8_t(inst.register2), uint8_t(inst.register3), 0, uint64_t(inst.operand1), uint64_t(inst.operand2)};
+                payload.append(reinterpret_cast<const char *>(&record), sizeof(record));
+            }
+            for (size_t i = 0; i < program.data.size(); i++)
+            {
+                const uint64_t value = program.data.at(i);
+                payload.append(reinterpret_cast<const char *>(&value), sizeof(value));
+            }
+
+            ImageHeader header;
+            memset(&header, 0, sizeof(header));
+            memcpy(header.magic, "SVMIMAGE", sizeof(header.magic));
+            header.version = VERSION;
+            header.word_bits = sizeof(DWORD) * 8;
+            header.command_count = CommandEnum::Command::CMDCOUNT;
+            header.source_hash = hash;
+            header.source_size = source_size;
+            header.instruction_count = program.instructions.size();
+            header.data_count = program.data.size();
+            header.payload_checksum = fnv1a64(payload.data(), payload.size());
+
+            // 临时文件名要在进程之间唯一
+            static std::atomic<uint64_t> counter{0};
+            std::ostringstream temp_name;
+            temp_name << path.filename().string() << ".tmp."
+#if SVM_IMAGE_FLOCK
+                      << getpid() << "."
+#endif
+                      << counter++;
+            const std::filesystem::path temp = m_directory / temp_name.str();
+            {
+                std::ofstream fout(temp, std::ios::binary | std::ios::trunc);
+                fout.write(reinterpret_cast<const char *>(&header), sizeof(header));
+                fout.write(payload.data(), payload.size());
+                if (fout.fail())
+                {
+                    std::error_code error;
+                    std::filesystem::remove(temp, error);
+                    return false;
+                }
+            }
+
+            std::error_code error;
+            std::filesystem::rename(temp, path, error);
+            if (error)
+            {
+                std::filesystem::remove(temp, error);
+                return false;
+            }
+            return true;
+        }
+    };
+
+    using ImageCache = BasicImageCache<DWORD64>;
+    using ImageCache32 = BasicImageCache<DWORD32>;
+} // namespace svm
+
+#endif
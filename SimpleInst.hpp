@@ -1,13 +1,17 @@
 #ifndef __SIMPLE_INST_HPP__
 #define __SIMPLE_INST_HPP__
 
+#include <cstdint>
+#include <string>
+#include <vector>
+
 namespace svm
 {
     /// @brief 指令枚举的命名空间
     namespace CommandEnum
     {
-        /// @brief 指令枚举
-        enum Command
+        /// @brief 指令枚举（用1个字节存放，减小指令体积）
+        enum Command : uint8_t
         {
             // 无操作
             // 虚拟机不会执行任何操作
@@ -25,11 +29,240 @@ namespace svm
             /// @brief 直接终止虚拟机运行
             HLT,
 
+            // 内存读写类指令
+            // 地址为寄存器2的值加上操作数1（偏移），超出内存和窗口区（GUEST_LIMIT）的地址触发ADR异常
+
+            /// @brief 从内存读取到寄存器1
+            LOAD,
+
+            /// @brief 把寄存器1的值写入内存
+            STORE,
+
+            // 按字节寻址的内存读写类指令
+            // 地址为寄存器2的值加上操作数1，单位是字节（DWORD地址乘以DWORD的字节数），越界的处理和LOAD/STORE相同
+            // 读取时做零扩展，写入时只写低位
+
+            /// @brief 读取1个字节到寄存器1
+            LOADB,
+
+            /// @brief 把寄存器1的低8位写入内存
+            STOREB,
+
+            /// @brief 读取2个字节到寄存器1
+            LOADH,
+
+            /// @brief 把寄存器1的低16位写入内存
+            STOREH,
+
+            /// @brief 读取4个字节到寄存器1
+            LOADW,
+
+            /// @brief 把寄存器1的低32位写入内存
+            STOREW,
+
+            // 栈和调用类指令
+            // 每次PUSH和CALL都检查栈顶是否还在栈区内，POP和RET检查栈是否为空，越界时触发ADR异常
+
+            /// @brief 把寄存器1的值入栈
+            PUSH,
+
+            /// @brief 出栈到寄存器1
+            POP,
+
+            /// @brief 把返回地址入栈，调用操作数1处的函数
+            CALL,
+
+            /// @brief 从函数返回
+            RET,
+
+            // 批量内存类指令
+            // 长度都以DWORD为单位，整个范围只检查一次边界，越界时触发ADR异常
+
+            /// @brief 把寄存器2处的寄存器3个DWORD复制到寄存器1处（允许重叠）
+            MEMCPY,
+
+            /// @brief 把寄存器1处的寄存器3个DWORD都设为寄存器2的值
+            MEMSET,
+
+            /// @brief 比较寄存器1处和寄存器2处的寄存器3个DWORD，结果写入寄存器1：相等为0，大于为1，小于为-1
+            MEMCMP,
+
+            /// @brief 计算寄存器2处以0结尾的数据的长度，结果写入寄存器1
+            STRLEN,
+
+            /// @brief 计算字节地址寄存器2处以0结尾的字符串的长度（字节数），结果写入寄存器1
+            STRLENB,
+
+            // 向量类指令
+            // 寄存器字段为向量寄存器编号（VLOAD/VSTORE的寄存器2、VBROADCAST的寄存器2、
+            // 归约指令的寄存器1为通用寄存器），各通道按有符号数处理
+
+            /// @brief 从寄存器2加操作数1处读取一个向量到向量寄存器1
+            VLOAD,
+
+            /// @brief 把向量寄存器1写入寄存器2加操作数1处
+            VSTORE,
+
+            /// @brief 把通用寄存器2的值复制到向量寄存器1的每个通道
+            VBROADCAST,
+
+            /// @brief 向量寄存器1 = 向量寄存器2 + 向量寄存器3（逐通道）
+            VADD,
+
+            /// @brief 向量寄存器1 = 向量寄存器2 - 向量寄存器3（逐通道）
+            VSUB,
+
+            /// @brief 向量寄存器1 = 向量寄存器2 * 向量寄存器3（逐通道）
+            VMUL,
+
+            /// @brief 向量寄存器1 = min(向量寄存器2, 向量寄存器3)（逐通道）
+            VMIN,
+
+            /// @brief 向量寄存器1 = max(向量寄存器2, 向量寄存器3)（逐通道）
+            VMAX,
+
+            /// @brief 向量寄存器2 == 向量寄存器3的通道在向量寄存器1中为全1，否则为0
+            VCMPEQ,
+
+            /// @brief 向量寄存器2 > 向量寄存器3的通道在向量寄存器1中为全1，否则为0
+            VCMPGT,
+
+            /// @brief 通用寄存器1 = 向量寄存器2所有通道之和
+            VREDADD,
+
+            /// @brief 通用寄存器1 = 向量寄存器2所有通道的最小值
+            VREDMIN,
+
+            /// @brief 通用寄存器1 = 向量寄存器2所有通道的最大值
+            VREDMAX,
+
+            // 算术逻辑类指令
+            // RRR形式：寄存器1 = 寄存器2 运算 寄存器3
+            // RRI形式：寄存器1 = 寄存器2 运算 操作数1
+            // 运算结果会被记录下来，ZF/SF在条件跳转读取时才计算
+
+            /// @brief 寄存器1 = 寄存器2 + 寄存器3
+            ADDRRR,
+
+            /// @brief 寄存器1 = 寄存器2 + 操作数1
+            ADDRRI,
+
+            /// @brief 寄存器1 = 寄存器2 - 寄存器3
+            SUBRRR,
+
+            /// @brief 寄存器1 = 寄存器2 - 操作数1
+            SUBRRI,
+
+            /// @brief 寄存器1 = 寄存器2 * 寄存器3
+            MULRRR,
+
+            /// @brief 寄存器1 = 寄存器2 * 操作数1
+            MULRRI,
+
+            /// @brief 寄存器1 = 寄存器2 / 寄存器3（无符号，除数为0时触发DIV异常）
+            DIVRRR,
+
+            /// @brief 寄存器1 = 寄存器2 / 操作数1（无符号，除数为0时触发DIV异常）
+            DIVRRI,
+
+            /// @brief 寄存器1 = 寄存器2 & 寄存器3
+            ANDRRR,
+
+            /// @brief 寄存器1 = 寄存器2 & 操作数1
+            ANDRRI,
+
+            /// @brief 寄存器1 = 寄存器2 | 寄存器3
+            ORRRR,
+
+            /// @brief 寄存器1 = 寄存器2 | 操作数1
+            ORRRI,
+
+            /// @brief 寄存器1 = 寄存器2 ^ 寄存器3
+            XORRRR,
+
+            /// @brief 寄存器1 = 寄存器2 ^ 操作数1
+            XORRRI,
+
+            /// @brief 寄存器1 = 寄存器2 << 寄存器3（移位数取低位）
+            SHLRRR,
+
+            /// @brief 寄存器1 = 寄存器2 << 操作数1（移位数取低位）
+            SHLRRI,
+
+            /// @brief 寄存器1 = 寄存器2 >> 寄存器3（逻辑右移，移位数取低位）
+            SHRRRR,
+
+            /// @brief 寄存器1 = 寄存器2 >> 操作数1（逻辑右移，移位数取低位）
+            SHRRRI,
+
+            /// @brief 比较寄存器1和寄存器2（有符号），只设置标志
+            CMPRR,
+
+            /// @brief 比较寄存器1和操作数1（有符号），只设置标志
+            CMPRI,
+
+            // 跳转类指令
+            // 跳转目标为操作数1（指令索引），条件由上一次算术逻辑指令的结果决定
+
+            /// @brief 无条件跳转
+            JMP,
+
+            /// @brief ZF为1时跳转（相等/结果为0）
+            JE,
+
+            /// @brief ZF为0时跳转（不相等/结果不为0）
+            JNE,
+
+            /// @brief SF为1时跳转（小于/结果为负）
+            JL,
+
+            /// @brief SF为0时跳转（大于或等于/结果非负）
+            JGE,
+
+            /// @brief ZF和SF都为0时跳转（大于/结果为正）
+            JG,
+
+            /// @brief ZF或SF为1时跳转（小于或等于）
+            JLE,
+
             // 系统调用
             // AX为调用号
             // 返回值会从AX开始覆盖
             SYSCALL,
 
+            /// @brief 断点，由调试器换入指令流，执行到时虚拟机暂停在这条指令上
+            BRK,
+
+            // 原子指令（多核虚拟机使用，单核时同样可用）
+            // 地址为寄存器2的值加上操作数1，越界的处理和LOAD/STORE相同
+            // 内存模型：每个核按程序顺序执行自己的指令；原子指令是顺序一致（seq_cst）的读-改-写，
+            // 它们之间存在一个所有核都认同的全序，并且同时起到获取（acquire）和释放（release）的作用。
+            // 普通的读写不是原子的：两个核不经过原子指令同步就访问同一个机器字（至少一方是写），读到的值不确定。
+            // 只用原子指令同步的程序（没有数据竞争），其执行结果等同于各个核的指令按某种顺序交错执行。
+            // 原子地读取可以用加数为0的XADD，原子地写入可以用XCHG。
+
+            /// @brief 比较并交换：内存中的值等于寄存器1时写入寄存器3；寄存器1得到原来的值，成功时ZF为1
+            CAS,
+
+            /// @brief 取出并相加：内存中的值加上寄存器3，寄存器1得到原来的值
+            XADD,
+
+            /// @brief 交换寄存器1和内存中的值
+            XCHG,
+
+            /// @brief 内存屏障（顺序一致），屏障前的读写不会被重排到屏障之后，反之亦然
+            FENCE,
+
+            // 分叉-汇合指令（只能在BasicForkJoinVM的主程序中使用，参见SimpleForkJoin.hpp）
+            // 子任务和父程序共享程序和内存，在工作线程上并行执行，入口函数执行RET时结束
+            // SPAWN之前父程序的写入对子任务可见，JOIN之后子任务的写入对父程序可见
+
+            /// @brief 创建子任务：从操作数1处开始执行，通用寄存器的初值和当前相同，寄存器1得到子任务的句柄
+            SPAWN,
+
+            /// @brief 等待寄存器1中句柄对应的子任务结束，把它的AX、BX、CX、DX复制到当前的AX、BX、CX、DX
+            JOIN,
+
             /// @brief 指令总数
             CMDCOUNT,
         };
@@ -45,7 +278,7 @@ namespace svm
 
             // 打印字符串
             // BX为输出目标，参见SystemEnum
-            // CX为要打印的字符串的首地址，以\0结束
+            // CX为要打印的字符串的首地址（字节地址），以\0结束
             // 如果BX为FILE，则DX为文件句柄
             PRINT_STRING,
 
@@ -58,7 +291,8 @@ namespace svm
             // 扫描字符串
             // BX为输入源，参见SystemEnum
             // 如果BX为FILE，则CX为文件句柄
-            // AX为返回的字符串缓冲区首地址，以\0结尾
+            // AX为返回的字符串缓冲区首地址（字节地址，从堆中以竞技场方式分配），以\0结尾
+            // 读取一个以空白分隔的单词，失败时AX为0
             SCAN_STRING,
 
             // 退出程序，结束虚拟机
@@ -67,6 +301,68 @@ namespace svm
             // FAILURE为程序错误
             EXIT,
 
+            // 从堆中分配内存，O(1)
+            // BX为大小（单位为DWORD）
+            // AX为返回的地址，失败时为0
+            ALLOC,
+
+            // 释放ALLOC分配的内存，O(1)
+            // BX为地址
+            // AX为SUCCESS或FAILURE
+            FREE,
+
+            // 以竞技场方式分配内存，不能单独释放
+            // BX为大小（单位为DWORD）
+            // AX为返回的地址，失败时为0
+            ARENA_ALLOC,
+
+            // 一次性丢弃堆中的所有分配
+            // AX为SUCCESS
+            HEAP_RESET,
+
+            // 通道类调用（参见SimpleChannel.hpp），BX为通道编号
+            // 满了或空了时虚拟机暂停在这条SYSCALL上（StopEnum::PARKED），再次运行时重新执行，
+            // 调度器会在通道有了变化后再运行它
+
+            // 发送一个机器字
+            // CX为要发送的值
+            // AX为SUCCESS，通道不存在或已经关闭时为FAILURE
+            SEND,
+
+            // 接收一个机器字
+            // AX为收到的值
+            // BX为SUCCESS，通道不存在或已经关闭并且取完时为FAILURE
+            RECV,
+
+            // 批量发送
+            // CX为数据的首地址（机器字地址），DX为个数
+            // AX为实际发送的个数（至少1个，放不下的部分由程序再次发送），失败时为0
+            SEND_BLOCK,
+
+            // 批量接收
+            // CX为缓冲区的首地址（机器字地址），DX为最多接收的个数
+            // AX为实际接收的个数（至少1个），通道不存在或已经关闭并且取完时为0
+            RECV_BLOCK,
+
+            // 关闭通道，之后发送都会失败，接收方取完剩下的数据后也会失败
+            // AX为SUCCESS，通道不存在时为FAILURE
+            CLOSE_CHANNEL,
+
+            // 陷阱类调用：ADR、INS、DIV可以交给程序自己的处理函数，而不是中止虚拟机
+            // 陷阱发生时相当于从出错的指令CALL处理函数，处理函数RET后从出错的下一条指令继续；
+            // 处理函数执行期间再发生陷阱（或者栈放不下返回地址）时虚拟机照常中止；
+            // 跳转或返回到程序之外（指令索引越界）时没有可以返回的指令，同样照常中止
+
+            // 设置陷阱处理函数
+            // BX为陷阱类型（ADR、INS、DIV，参见ExceptionEnum）
+            // CX为处理函数的指令索引（文本段标签），为0时取消
+            // AX为SUCCESS，类型不能处理或索引超出程序时为FAILURE
+            TRAP_VECTOR,
+
+            // 获取最近一次交给处理函数的陷阱
+            // AX为陷阱类型，BX为出错的指令索引，CX为越界的机器字地址（只有ADR并且使用保护页时才有，否则为0）
+            TRAP_INFO,
+
             /// @brief 指令总数
             SCCOUNT,
         };
@@ -106,6 +402,9 @@ namespace svm
             /// @brief 当遇到指令名非法时触发
             INS,
 
+            /// @brief 当除数为0时触发
+            DIV,
+
             /// @brief 虚拟机运行正常（其实不应该放在异常这）
             AOK
         };
@@ -115,7 +414,7 @@ namespace svm
     namespace RegisterEnum
     {
         /// @brief 通用寄存器枚举
-        enum GeneralRegister
+        enum GeneralRegister : uint8_t
         {
             AX = 0,
             BX,
@@ -167,33 +466,64 @@ namespace svm
             /// @brief 寄存器总数
             SRCOUNT,
         };
+
+        /// @brief 向量寄存器
+        /// 向量指令的寄存器字段存放的是向量寄存器的编号
+        enum VectorRegister
+        {
+            V0 = 0,
+            V1,
+            V2,
+            V3,
+            V4,
+            V5,
+            V6,
+            V7,
+
+            /// @brief 寄存器总数
+            VRCOUNT,
+        };
     } // namespace RegisterEnum
 
     static const std::vector<std::string> gregister_name_list = {"AX", "BX", "CX", "DX", "EX", "FX", "GX", "HX", "IX", "JX", "KX", "LX", "MX", "NX", "OX", "PX", "QX", "RX", "SX", "TX", "UX", "VX", "WX", "XX", "YX", "ZX", "GRCOUNT", "NONE"};
     static const std::vector<std::string> sregister_name_list = {"ZF", "SF", "SRCOUNT"};
-    static const std::vector<std::string> command_name_list = {"NOP", "MOVRI", "MOVRR", "HLT", "SYSCALL", "CMDCOUNT"};
+    static const std::vector<std::string> vregister_name_list = {"V0", "V1", "V2", "V3", "V4", "V5", "V6", "V7", "VRCOUNT"};
+    static const std::vector<std::string> command_name_list = {"NOP", "MOVRI", "MOVRR", "HLT", "LOAD", "STORE", "LOADB", "STOREB", "LOADH", "STOREH", "LOADW", "STOREW", "PUSH", "POP", "CALL", "RET", "MEMCPY", "MEMSET", "MEMCMP", "STRLEN", "STRLENB", "VLOAD", "VSTORE", "VBROADCAST", "VADD", "VSUB", "VMUL", "VMIN", "VMAX", "VCMPEQ", "VCMPGT", "VREDADD", "VREDMIN", "VREDMAX", "ADDRRR", "ADDRRI", "SUBRRR", "SUBRRI", "MULRRR", "MULRRI", "DIVRRR", "DIVRRI", "ANDRRR", "ANDRRI", "ORRRR", "ORRRI", "XORRRR", "XORRRI", "SHLRRR", "SHLRRI", "SHRRRR", "SHRRRI", "CMPRR", "CMPRI", "JMP", "JE", "JNE", "JL", "JGE", "JG", "JLE", "SYSCALL", "BRK", "CAS", "XADD", "XCHG", "FENCE", "SPAWN", "JOIN", "CMDCOUNT"};
+    static const std::vector<std::string> syscall_name_list = {"PRINT_CHAR", "PRINT_STRING", "SCAN_CHAR", "SCAN_STRING", "EXIT", "ALLOC", "FREE", "ARENA_ALLOC", "HEAP_RESET", "SEND", "RECV", "SEND_BLOCK", "RECV_BLOCK", "CLOSE_CHANNEL", "TRAP_VECTOR", "TRAP_INFO", "SCCOUNT"};
     // SystemCallNumber和SystemEnum中的内容会被作为包含文件的宏定义
 
-    // 四字类型，即长整数（long）
-    // 本虚拟机的不论是寄存器还是操作数，都是这个类型
-    using DWORD = unsigned long;
+    // 机器字类型
+    // 虚拟机的寄存器、操作数和内存单元都是机器字，机器字的宽度由模板参数WordT决定，
+    // 同一个程序中可以同时使用64位和32位的虚拟机，具体用哪种由程序文件头的bits声明决定
+    using DWORD64 = uint64_t;
+    using DWORD32 = uint32_t;
+
+    // 默认的机器字类型（64位）
+    using DWORD = DWORD64;
 
     /// @brief 指令
-    struct Instruction
+    /// @tparam WordT 机器字类型
+    template <typename WordT>
+    struct BasicInstruction
     {
+        /// @brief 机器字类型
+        using DWORD = WordT;
+
         /// @brief 指令名
         CommandEnum::Command command = CommandEnum::Command::NOP;
         /// @brief 寄存器1
         RegisterEnum::GeneralRegister register1 = RegisterEnum::GeneralRegister::NONE;
         /// @brief 寄存器2
         RegisterEnum::GeneralRegister register2 = RegisterEnum::GeneralRegister::NONE;
+        /// @brief 寄存器3
+        RegisterEnum::GeneralRegister register3 = RegisterEnum::GeneralRegister::NONE;
         /// @brief 操作数1
         DWORD operand1 = 0;
         /// @brief 操作数2
         DWORD operand2 = 0;
 
         /// @brief 构造函数
-        Instruction() {}
+        BasicInstruction() {}
 
         /// @brief 构造函数
         /// @param cmd 指令名
@@ -201,44 +531,79 @@ namespace svm
         /// @param reg2 寄存器2
         /// @param opd1 操作数1
         /// @param opd2 操作数2
-        Instruction(CommandEnum::Command cmd, RegisterEnum::GeneralRegister reg1, RegisterEnum::GeneralRegister reg2, DWORD opd1, DWORD opd2) : command(cmd), register1(reg1), register2(reg2), operand1(opd1), operand2(opd2) {}
+        BasicInstruction(CommandEnum::Command cmd, RegisterEnum::GeneralRegister reg1, RegisterEnum::GeneralRegister reg2, DWORD opd1, DWORD opd2) : command(cmd), register1(reg1), register2(reg2), operand1(opd1), operand2(opd2) {}
 
         /// @brief 构造函数
         /// @param cmd 指令名
         /// @param reg1 寄存器1
         /// @param reg2 寄存器2
-        Instruction(CommandEnum::Command cmd, RegisterEnum::GeneralRegister reg1, RegisterEnum::GeneralRegister reg2) : command(cmd), register1(reg1), register2(reg2) {}
+        BasicInstruction(CommandEnum::Command cmd, RegisterEnum::GeneralRegister reg1, RegisterEnum::GeneralRegister reg2) : command(cmd), register1(reg1), register2(reg2) {}
+
+        /// @brief 构造函数
+        /// @param cmd 指令名
+        /// @param reg1 寄存器1
+        /// @param reg2 寄存器2
+        /// @param reg3 寄存器3
+        BasicInstruction(CommandEnum::Command cmd, RegisterEnum::GeneralRegister reg1, RegisterEnum::GeneralRegister reg2, RegisterEnum::GeneralRegister reg3) : command(cmd), register1(reg1), register2(reg2), register3(reg3) {}
 
         /// @brief 构造函数
         /// @param cmd 指令名
         /// @param reg1 寄存器1
         /// @param opd1 操作数2
-        Instruction(CommandEnum::Command cmd, RegisterEnum::GeneralRegister reg1, DWORD opd1) : command(cmd), register1(reg1), operand1(opd1) {}
+        BasicInstruction(CommandEnum::Command cmd, RegisterEnum::GeneralRegister reg1, DWORD opd1) : command(cmd), register1(reg1), operand1(opd1) {}
 
         /// @brief 构造函数
         /// @param cmd 指令名
-        Instruction(CommandEnum::Command cmd) : command(cmd) {}
+        BasicInstruction(CommandEnum::Command cmd) : command(cmd) {}
 
         /// @brief 构造函数
         /// @param from 要被赋予的值
-        Instruction(const Instruction &from) { operator=(from); }
+        BasicInstruction(const BasicInstruction &from) { operator=(from); }
 
-        ~Instruction() {}
+        ~BasicInstruction() {}
 
         /// @brief 赋值函数
         /// @param from 要被赋予的值
         /// @return 自身
-        Instruction &operator=(const Instruction &from)
+        BasicInstruction &operator=(const BasicInstruction &from)
         {
             command = from.command;
             register1 = from.register1;
             register2 = from.register2;
+            register3 = from.register3;
             operand1 = from.operand1;
             operand2 = from.operand2;
             return *this;
         }
     };
 
+    /// @brief 64位指令
+    using Instruction = BasicInstruction<DWORD64>;
+    /// @brief 32位指令
+    using Instruction32 = BasicInstruction<DWORD32>;
+
+    /// @brief 检查指令的寄存器字段是否都在范围内（没有用到的字段为NONE）
+    /// 向量指令中存放向量寄存器编号的字段按向量寄存器的个数检查，其余按通用寄存器的个数检查
+    /// @param inst 指令
+    /// @return 是否都在范围内
+    template <typename WordT>
+    bool valid_registers(const BasicInstruction<WordT> &inst)
+    {
+        bool vector1 = false, vector2 = false, vector3 = false;
+        if (inst.command == CommandEnum::Command::VLOAD || inst.command == CommandEnum::Command::VSTORE || inst.command == CommandEnum::Command::VBROADCAST)
+            vector1 = true;
+        else if (inst.command >= CommandEnum::Command::VADD && inst.command <= CommandEnum::Command::VCMPGT)
+            vector1 = vector2 = vector3 = true;
+        else if (inst.command >= CommandEnum::Command::VREDADD && inst.command <= CommandEnum::Command::VREDMAX)
+            vector2 = true;
+
+        auto valid = [](RegisterEnum::GeneralRegister reg, bool vector)
+        {
+            return reg == RegisterEnum::GeneralRegister::NONE || size_t(reg) < (vector ? size_t(RegisterEnum::VectorRegister::VRCOUNT) : size_t(RegisterEnum::GeneralRegister::GRCOUNT));
+        };
+        return valid(inst.register1, vector1) && valid(inst.register2, vector2) && valid(inst.register3, vector3);
+    }
+
 } // namespace svm
 
 #endif
\ No newline at end of file
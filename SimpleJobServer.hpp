@@ -0,0 +1,800 @@
+#ifndef __SIMPLE_JOB_SERVER_HPP__
+#define __SIMPLE_JOB_SERVER_HPP__
+
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <streambuf>
+#include "SimpleEXE.hpp"
+#include "SimpleImageCache.hpp"
+#include "SimpleVMPool.hpp"
+#include "SimpleSocket.hpp"
+
+// 作业服务使用Unix域套接字，只在类Unix系统上提供
+#if SVM_UNIX_SOCKETS && !defined(SVM_NO_JOB_SERVER)
+#define SVM_JOB_SERVER 1
+#include <fcntl.h>
+#include <signal.h>
+#include <pthread.h>
+#else
+#define SVM_JOB_SERVER 0
+#endif
+
+// 协议（文本头部加上按长度读取的内容，一个连接上可以依次提交任意多个作业）：
+//   请求：JOB\n，然后是若干行"名字 值"，空行结束，之后紧跟image和input的内容
+//     path <程序文件>        服务进程可以访问的EXE文件（和image二选一）
+//     image <字节数>         直接发送的EXE文本
+//     input <字节数>         程序从STDIO读到的内容
+//     budget <指令数>        最多执行的指令数，0表示使用服务的上限
+//     output-limit <字节数>  最多返回的输出，0表示使用服务的上限
+//   回复：程序运行期间输出的片段"OUT <字节数>\n<内容>"，最后是一行
+//     END <exit|halt|exception|budget|stopped> <退出码> <异常> <执行的指令数> <运行时间（纳秒）> <输出是否被截断>
+//   或者在程序无法加载时回复一行"ERR <原因>"，连接可以继续使用。
+
+namespace svm
+{
+    /// @brief 作业的状态
+    namespace JobEnum
+    {
+        enum Status
+        {
+            /// @brief 程序通过EXIT系统调用结束
+            EXIT = 0,
+            /// @brief 执行到HLT指令
+            HALT,
+            /// @brief 发生异常
+            EXCEPTION,
+            /// @brief 用完了指令预算，程序被终止
+            BUDGET,
+            /// @brief 程序暂停在断点、观察点或通道上，被终止
+            STOPPED,
+            /// @brief 程序无法加载，或者请求不合法
+            ERROR,
+        };
+
+        /// @brief 状态在协议中的名字
+        inline const char *status_name(Status status)
+        {
+            static const char *names[] = {"exit", "halt", "exception", "budget", "stopped", "error"};
+            return names[status];
+        }
+    } // namespace JobEnum
+
+    /// @brief 一个作业
+    struct JobRequest
+    {
+        /// @brief 程序文件（服务进程中的路径），为空时使用image
+        std::string path;
+        /// @brief EXE文本
+        std::string image;
+        /// @brief 程序从STDIO读到的内容
+        std::string input;
+        /// @brief 最多执行的指令数，0表示使用服务的上限
+        uint64_t budget = 0;
+        /// @brief 最多返回的输出（单位为字节），0表示使用服务的上限
+        uint64_t output_limit = 0;
+    };
+
+    /// @brief 作业的结果
+    struct JobResult
+    {
+        /// @brief 状态
+        JobEnum::Status status = JobEnum::Status::ERROR;
+        /// @brief 退出码（EXIT时的BX）
+        uint64_t exit_code = 0;
+        /// @brief 异常类型（ExceptionEnum）
+        uint64_t exception = ExceptionEnum::Exception::AOK;
+        /// @brief 执行的指令数
+        uint64_t retired_instructions = 0;
+        /// @brief 运行时间（纳秒，不包括加载程序）
+        uint64_t elapsed_ns = 0;
+        /// @brief 输出是否因为超过上限被截断
+        bool truncated = false;
+        /// @brief ERROR时的原因
+        std::string message;
+    };
+
+    /// @brief 作业服务默认给每个作业的指令预算（解释执行大约一秒）
+    const uint64_t JOB_DEFAULT_BUDGET = 100000000;
+
+#if SVM_JOB_SERVER
+    /// @brief 从套接字按行或按长度读取，带缓冲
+    class SocketReader
+    {
+    private:
+        /// @brief 套接字
+        int m_fd;
+        /// @brief 置位时放弃等待（为空时一直等）
+        const std::atomic<bool> *m_stop;
+        /// @brief 已经收到还没有读走的数据
+        std::string m_buffer;
+        /// @brief m_buffer中下一个没有读走的位置
+        size_t m_position = 0;
+
+    public:
+        /// @brief 一行最多多少字节，超过时当作读取失败（防止客户端不发换行符让缓冲区无限增长）
+        static const size_t MAX_LINE = 4096;
+
+    public:
+        /// @brief 构造函数
+        /// @param fd 套接字（不拥有）
+        /// @param stop 置位时放弃等待，可以为nullptr
+        SocketReader(int fd, const std::atomic<bool> *stop = nullptr) : m_fd(fd), m_stop(stop) {}
+
+    public:
+        /// @brief 读取一行（不包括换行符）
+        /// @return 是否成功，对方关闭连接或者被要求停止时为false
+        bool read_line(std::string &line)
+        {
+            while (true)
+            {
+                const size_t end = m_buffer.find('\n', m_position);
+                if (end != std::string::npos)
+                {
+                    if (end - m_position > MAX_LINE)
+                        return false;
+                    line.assign(m_buffer, m_position, end - m_position);
+                    m_position = end + 1;
+                    return true;
+                }
+                if (m_buffer.size() - m_position > MAX_LINE || !fill())
+                    return false;
+            }
+        }
+
+        /// @brief 读取指定字节数
+        /// @return 是否成功
+        bool read_bytes(size_t size, std::string &bytes)
+        {
+            while (m_buffer.size() - m_position < size)
+                if (!fill())
+                    return false;
+            bytes.assign(m_buffer, m_position, size);
+            m_position += size;
+            return true;
+        }
+
+    private:
+        /// @brief 从套接字再收一些数据
+        bool fill()
+        {
+            if (m_position > 0)
+            {
+                m_buffer.erase(0, m_position);
+                m_position = 0;
+            }
+            char chunk[16384];
+            while (true)
+            {
+                if (m_stop)
+                {
+                    if (m_stop->load())
+                        return false;
+                    pollfd descriptor = {m_fd, POLLIN, 0};
+                    if (poll(&descriptor, 1, 100) <= 0)
+                        continue;
+                }
+                const ssize_t count = recv(m_fd, chunk, sizeof(chunk), 0);
+                if (count <= 0)
+                    return false;
+                m_buffer.append(chunk, size_t(count));
+                return true;
+            }
+        }
+    };
+
+    /// @brief 作业的输出流：攒够一块就作为OUT片段发给客户端，超过上限的部分丢弃
+    class JobOutputBuffer : public std::streambuf
+    {
+    private:
+        /// @brief 客户端套接字
+        int m_fd;
+        /// @brief 最多发送的字节数，0表示不限
+        uint64_t m_limit;
+        /// @brief 已经发送的字节数
+        uint64_t m_sent = 0;
+        /// @brief 是否丢弃过输出
+        bool m_truncated = false;
+        /// @brief 客户端是否已经断开
+        bool m_broken = false;
+        /// @brief 还没有发送的输出
+        char m_chunk[4096];
+
+    public:
+        /// @brief 构造函数
+        /// @param fd 客户端套接字
+        /// @param limit 最多发送的字节数，0表示不限
+        JobOutputBuffer(int fd, uint64_t limit) : m_fd(fd), m_limit(limit)
+        {
+            setp(m_chunk, m_chunk + sizeof(m_chunk));
+        }
+
+    public:
+        /// @brief 是否丢弃过输出
+        bool is_truncated() const
+        {
+            return m_truncated;
+        }
+
+        /// @brief 客户端是否已经断开
+        bool is_broken() const
+        {
+            return m_broken;
+        }
+
+    protected:
+        virtual int_type overflow(int_type ch) override
+        {
+            flush_chunk();
+            if (!traits_type::eq_int_type(ch, traits_type::eof()))
+            {
+                *pptr() = traits_type::to_char_type(ch);
+                pbump(1);
+            }
+            // 超过上限或者客户端断开后仍然告诉虚拟机写成功了，程序照常运行到结束
+            return traits_type::not_eof(ch);
+        }
+
+        virtual int sync() override
+        {
+            flush_chunk();
+            return 0;
+        }
+
+    private:
+        /// @brief 把攒下的输出作为一个OUT片段发送，超过上限的部分丢弃
+        void flush_chunk()
+        {
+            size_t size = size_t(pptr() - pbase());
+            setp(m_chunk, m_chunk + sizeof(m_chunk));
+            if (m_limit != 0 && m_sent + size > m_limit)
+            {
+                m_truncated = true;
+                size = size_t(m_limit - m_sent);
+            }
+            if (size == 0 || m_broken)
+                return;
+            m_sent += size;
+            const std::string header = "OUT " + std::to_string(size) + "\n";
+            m_broken = !send_all(m_fd, header.data(), header.size()) || !send_all(m_fd, m_chunk, size);
+        }
+    };
+
+    /// @brief 作业服务
+    /// 在Unix域套接字上接受作业，用预热的虚拟机池运行，把输出和退出状态流式地发回客户端。
+    /// 解析过的程序按EXE文本的指纹缓存在内存中，每个程序有自己的虚拟机池，同一程序的作业不再重新解析和创建虚拟机。
+    /// 每个工作线程同一时间服务一个连接，一个连接上的作业依次执行；按路径提交的程序每次都会重新读取文件，文件变化后自动使用新的版本。
+    class JobServer
+    {
+    private:
+        /// @brief 缓存的程序和它的虚拟机池
+        struct ProgramEntry
+        {
+            /// @brief 机器字的位数
+            size_t word_bits = 64;
+            /// @brief 64位程序的虚拟机池
+            std::unique_ptr<VMPool> pool64;
+            /// @brief 32位程序的虚拟机池
+            std::unique_ptr<VMPool32> pool32;
+            /// @brief 最后一次使用的序号，用于淘汰
+            uint64_t last_use = 0;
+            /// @brief EXE文本，命中时和请求比较，指纹相同但内容不同的程序不会被当成同一个
+            std::string image;
+        };
+
+    private:
+        /// @brief 监听的套接字，-1表示没有启动
+        int m_fd = -1;
+        /// @brief 套接字路径
+        std::string m_path;
+        /// @brief 工作线程
+        std::vector<std::thread> m_threads;
+        /// @brief 是否要求工作线程退出
+        std::atomic<bool> m_stop{false};
+
+        /// @brief 每个新程序预先创建的虚拟机数
+        size_t m_prewarm = 1;
+        /// @brief 最多缓存的程序数
+        size_t m_max_programs = 64;
+        /// @brief 每个作业最多执行的指令数，0表示不限（不限时死循环的作业会一直占着工作线程，stop()也等不到它结束）
+        uint64_t m_max_budget = JOB_DEFAULT_BUDGET;
+        /// @brief 每个作业最多返回的输出，0表示不限
+        uint64_t m_max_output = 0;
+        /// @brief 每个作业的程序最多多少字节（直接发送的和按路径读取的都算）
+        uint64_t m_max_image = uint64_t(1) << 20;
+        /// @brief 每个作业的输入最多多少字节
+        uint64_t m_max_input = uint64_t(16) << 20;
+
+        /// @brief 保护程序缓存
+        std::mutex m_mutex;
+        /// @brief 程序缓存，以EXE文本的指纹为键，命中时再比较文本
+        std::map<uint64_t, std::shared_ptr<ProgramEntry>> m_programs;
+        /// @brief 使用程序缓存的次数
+        uint64_t m_use_clock = 0;
+        /// @brief 程序缓存的命中次数
+        uint64_t m_hits = 0;
+        /// @brief 完成的作业数
+        std::atomic<uint64_t> m_jobs{0};
+
+    public:
+        JobServer() {}
+        JobServer(const JobServer &) = delete;
+        JobServer &operator=(const JobServer &) = delete;
+        ~JobServer()
+        {
+            stop();
+        }
+
+    public:
+        /// @brief 设置每个作业的上限（请求中更大或为0的值会被限制到这里）
+        /// @param max_budget 最多执行的指令数，0表示不限
+        /// @param max_output 最多返回的输出（单位为字节），0表示不限
+        /// @param max_image 程序最多多少字节，超过时回复ERR并关闭连接
+        /// @param max_input 输入最多多少字节，超过时回复ERR并关闭连接
+        void set_limits(uint64_t max_budget, uint64_t max_output, uint64_t max_image = uint64_t(1) << 20, uint64_t max_input = uint64_t(16) << 20)
+        {
+            m_max_budget = max_budget;
+            m_max_output = max_output;
+            m_max_image = max_image;
+            m_max_input = max_input;
+        }
+
+        /// @brief 设置程序缓存
+        /// @param prewarm 每个新程序预先创建的虚拟机数
+        /// @param max_programs 最多缓存的程序数，超过时淘汰最久没有使用的
+        void set_cache(size_t prewarm, size_t max_programs)
+        {
+            m_prewarm = prewarm;
+            m_max_programs = std::max<size_t>(max_programs, 1);
+        }
+
+        /// @brief 开始在指定路径上监听
+        /// @param path 套接字路径（已存在的文件会被删除）
+        /// @param workers 工作线程数，即同时服务的连接数，0表示使用所有核
+        /// @return 是否成功
+        bool start(const std::string &path, size_t workers = 0)
+        {
+            stop();
+            m_fd = listen_unix_socket(path, 128);
+            if (m_fd < 0)
+                return false;
+            // 所有工作线程在同一个套接字上等待连接，没抢到的线程不能阻塞在accept()上
+            fcntl(m_fd, F_SETFL, fcntl(m_fd, F_GETFL) | O_NONBLOCK);
+
+            if (workers == 0)
+                workers = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+            m_path = path;
+            m_stop.store(false);
+            for (size_t i = 0; i < workers; i++)
+                m_threads.emplace_back([this]()
+                                       { serve(); });
+            return true;
+        }
+
+        /// @brief 停止服务并删除套接字文件，正在运行的作业会先完成
+        void stop()
+        {
+            if (m_fd < 0)
+                return;
+            m_stop.store(true);
+            for (std::thread &thread : m_threads)
+                thread.join();
+            m_threads.clear();
+            close_unix_socket(m_fd, m_path);
+            m_fd = -1;
+        }
+
+    public:
+        /// @brief 获取完成的作业数
+        uint64_t get_job_count() const
+        {
+            return m_jobs.load();
+        }
+
+        /// @brief 获取缓存的程序数
+        size_t get_program_count()
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_programs.size();
+        }
+
+        /// @brief 获取程序缓存的命中次数
+        uint64_t get_cache_hits()
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_hits;
+        }
+
+    private:
+        /// @brief 工作线程：接受连接，依次执行连接上的作业
+        void serve()
+        {
+            while (!m_stop.load())
+            {
+                int client = accept_unix_socket(m_fd, 100);
+                if (client < 0)
+                    continue;
+                fcntl(client, F_SETFL, fcntl(client, F_GETFL) & ~O_NONBLOCK);
+                SocketReader reader(client, &m_stop);
+                try
+                {
+                    while (serve_job(reader, client))
+                        ;
+                }
+                catch (...)
+                {
+                    // 读请求时内存不足之类的错误只断开这个连接，工作线程继续服务
+                }
+                close(client);
+            }
+        }
+
+        /// @brief 读取并执行一个作业
+        /// @return 连接是否还能继续使用
+        bool serve_job(SocketReader &reader, int client)
+        {
+            JobRequest request;
+            size_t image_size = 0;
+            size_t input_size = 0;
+            std::string line;
+            if (!reader.read_line(line) || line != "JOB")
+                return false;
+            while (reader.read_line(line) && !line.empty())
+            {
+                const size_t space = line.find(' ');
+                const std::string name = line.substr(0, space);
+                const std::string value = space == std::string::npos ? "" : line.substr(space + 1);
+                try
+                {
+                    if (name == "path")
+                        request.path = value;
+                    else if (name == "image")
+                        image_size = std::stoull(value);
+                    else if (name == "input")
+                        input_size = std::stoull(value);
+                    else if (name == "budget")
+                        request.budget = std::stoull(value);
+                    else if (name == "output-limit")
+                        request.output_limit = std::stoull(value);
+                }
+                catch (...)
+                {
+                    // 长度读不出来就无法找到下一个作业的开头
+                    return false;
+                }
+            }
+            if (!line.empty())
+                return false;
+            // 长度是客户端给的，先检查再分配；超过上限时后面的内容无法跳过，只能关闭连接
+            if (image_size > m_max_image || input_size > m_max_input)
+            {
+                const std::string reply = std::string("ERR ") + (image_size > m_max_image ? "image" : "input") + " too large\n";
+                send_all(client, reply.data(), reply.size());
+                return false;
+            }
+            if (!reader.read_bytes(image_size, request.image) || !reader.read_bytes(input_size, request.input))
+                return false;
+
+            JobResult result;
+            bool connected;
+            try
+            {
+                std::shared_ptr<ProgramEntry> entry = find_program(request, result.message);
+                if (!entry)
+                {
+                    const std::string reply = "ERR " + result.message + "\n";
+                    return send_all(client, reply.data(), reply.size());
+                }
+
+                request.budget = clamp_limit(request.budget, m_max_budget);
+                request.output_limit = clamp_limit(request.output_limit, m_max_output);
+                if (entry->word_bits == 32)
+                    connected = run_job(*entry->pool32, request, client, result);
+                else
+                    connected = run_job(*entry->pool64, request, client, result);
+            }
+            catch (const std::exception &error)
+            {
+                // 例如创建虚拟机时预留地址空间失败（bad_alloc），只让这个作业失败
+                const std::string reply = std::string("ERR ") + error.what() + "\n";
+                return send_all(client, reply.data(), reply.size());
+            }
+            m_jobs++;
+            if (!connected)
+                return false;
+
+            std::ostringstream reply;
+            reply << "END " << JobEnum::status_name(result.status) << " " << result.exit_code << " " << result.exception << " "
+                  << result.retired_instructions << " " << result.elapsed_ns << " " << (result.truncated ? 1 : 0) << "\n";
+            return send_all(client, reply.str().data(), reply.str().size());
+        }
+
+        /// @brief 在虚拟机池中的一台虚拟机上运行作业，输出直接发给客户端
+        /// @return 客户端是否还连着
+        template <typename WordT>
+        bool run_job(BasicVMPool<WordT> &pool, const JobRequest &request, int client, JobResult &result)
+        {
+            std::unique_ptr<BasicSimpleVM<WordT>> vm = pool.acquire();
+            std::istringstream input(request.input);
+            JobOutputBuffer output_buffer(client, request.output_limit);
+            std::ostream output(&output_buffer);
+            vm->set_console(input, output);
+            vm->set_run_budget(request.budget);
+            // 执行的指令数在重置后继续累加
+            const uint64_t retired = vm->get_retired_instructions();
+
+            const auto begin = std::chrono::steady_clock::now();
+            try
+            {
+                vm->run();
+            }
+            catch (...)
+            {
+                // 流马上就要销毁了，虚拟机重置后仍然可以放回池中
+                vm->reset_console();
+                vm->set_run_budget(0);
+                pool.release(std::move(vm));
+                throw;
+            }
+            const auto end = std::chrono::steady_clock::now();
+            output.flush();
+
+            const ExceptionEnum::Exception exception = vm->get_vm_state().exception;
+            result.exception = exception;
+            result.retired_instructions = vm->get_retired_instructions() - retired;
+            result.elapsed_ns = uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count());
+            result.truncated = output_buffer.is_truncated();
+            if (exception == ExceptionEnum::Exception::HLT)
+                result.status = JobEnum::Status::HALT;
+            else if (exception != ExceptionEnum::Exception::AOK)
+                result.status = JobEnum::Status::EXCEPTION;
+            else if (vm->get_stop_reason() == StopEnum::Reason::NONE)
+            {
+                result.status = JobEnum::Status::EXIT;
+                result.exit_code = vm->get_vm_state().general_registers[RegisterEnum::GeneralRegister::BX];
+            }
+            else if (vm->get_stop_reason() == StopEnum::Reason::BUDGET)
+                result.status = JobEnum::Status::BUDGET;
+            else
+                result.status = JobEnum::Status::STOPPED;
+
+            // 流是这次作业的局部变量，放回池之前换回默认的
+            vm->reset_console();
+            vm->set_run_budget(0);
+            pool.release(std::move(vm));
+            return !output_buffer.is_broken();
+        }
+
+        /// @brief 找到作业的程序，没有缓存时解析并创建虚拟机池
+        /// @param request 作业
+        /// @param message 失败的原因
+        /// @return 程序，失败时为空
+        std::shared_ptr<ProgramEntry> find_program(JobRequest &request, std::string &message)
+        {
+            if (!request.path.empty())
+            {
+                std::ifstream fin(request.path, std::ios::binary | std::ios::ate);
+                if (fin.fail())
+                {
+                    message = "unable to open " + request.path;
+                    return nullptr;
+                }
+                if (uint64_t(fin.tellg()) > m_max_image)
+                {
+                    message = "image too large";
+                    return nullptr;
+                }
+                fin.seekg(0);
+                std::ostringstream sstr;
+                sstr << fin.rdbuf();
+                request.image = sstr.str();
+            }
+            if (request.image.empty())
+            {
+                message = "no program";
+                return nullptr;
+            }
+
+            const uint64_t hash = fnv1a64(request.image.data(), request.image.size());
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                auto found = m_programs.find(hash);
+                if (found != m_programs.end() && found->second->image == request.image)
+                {
+                    m_hits++;
+                    found->second->last_use = ++m_use_clock;
+                    return found->second;
+                }
+            }
+
+            // 解析和预热在锁外进行，同时到达的同一个程序可能被解析两次，只保留先放进缓存的那份
+            std::shared_ptr<ProgramEntry> entry = create_program(request.image, message);
+            if (!entry)
+                return nullptr;
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto inserted = m_programs.emplace(hash, entry);
+            // 指纹冲突（缓存中是另一个程序）时不替换它，这个作业单独使用刚解析的程序
+            if (!inserted.second && inserted.first->second->image != request.image)
+                return entry;
+            if (inserted.second && m_programs.size() > m_max_programs)
+                evict_program(hash);
+            inserted.first->second->last_use = ++m_use_clock;
+            return inserted.first->second;
+        }
+
+        /// @brief 解析程序并创建它的虚拟机池
+        std::shared_ptr<ProgramEntry> create_program(const std::string &image, std::string &message)
+        {
+            std::vector<std::string> lines;
+            std::istringstream sstr(image);
+            std::string line;
+            while (std::getline(sstr, line))
+                lines.push_back(line);
+
+            std::shared_ptr<ProgramEntry> entry = std::make_shared<ProgramEntry>();
+            entry->image = image;
+            try
+            {
+                entry->word_bits = detect_word_bits(lines);
+                if (entry->word_bits == 32)
+                {
+                    BasicEXEParser<DWORD32> parser;
+                    if (parser.parse_lines(lines))
+                        entry->pool32.reset(new VMPool32(parser.get_program(), m_prewarm));
+                }
+                else if (entry->word_bits == 64)
+                {
+                    BasicEXEParser<DWORD64> parser;
+                    if (parser.parse_lines(lines))
+                        entry->pool64.reset(new VMPool(parser.get_program(), m_prewarm));
+                }
+            }
+            catch (...)
+            {
+            }
+            if (!entry->pool32 && !entry->pool64)
+            {
+                message = "unable to parse program";
+                return nullptr;
+            }
+            return entry;
+        }
+
+        /// @brief 淘汰最久没有使用的程序（正在运行的作业仍然持有它，不受影响）
+        /// @param keep 不能淘汰的程序
+        void evict_program(uint64_t keep)
+        {
+            auto oldest = m_programs.end();
+            for (auto it = m_programs.begin(); it != m_programs.end(); ++it)
+                if (it->first != keep && (oldest == m_programs.end() || it->second->last_use < oldest->second->last_use))
+                    oldest = it;
+            if (oldest != m_programs.end())
+                m_programs.erase(oldest);
+        }
+
+        /// @brief 把请求的上限限制在服务的上限之内
+        static uint64_t clamp_limit(uint64_t requested, uint64_t maximum)
+        {
+            if (maximum == 0)
+                return requested;
+            return requested == 0 ? maximum : std::min(requested, maximum);
+        }
+    };
+
+    /// @brief 作业服务的客户端，一个连接上可以依次提交任意多个作业
+    class JobClient
+    {
+    private:
+        /// @brief 连接的套接字，-1表示没有连接
+        int m_fd = -1;
+        /// @brief 读取回复
+        std::unique_ptr<SocketReader> m_reader;
+
+    public:
+        JobClient() {}
+        JobClient(const JobClient &) = delete;
+        JobClient &operator=(const JobClient &) = delete;
+        ~JobClient()
+        {
+            disconnect();
+        }
+
+    public:
+        /// @brief 连接到作业服务
+        /// @param path 套接字路径
+        /// @return 是否成功
+        bool connect(const std::string &path)
+        {
+            disconnect();
+            m_fd = connect_unix_socket(path);
+            if (m_fd < 0)
+                return false;
+            m_reader.reset(new SocketReader(m_fd));
+            return true;
+        }
+
+        /// @brief 断开连接
+        void disconnect()
+        {
+            if (m_fd < 0)
+                return;
+            m_reader.reset();
+            close(m_fd);
+            m_fd = -1;
+        }
+
+        /// @brief 提交作业并等待它结束
+        /// @param request 作业
+        /// @param output 程序的全部输出
+        /// @param result 结果，程序无法加载时status为ERROR，原因在message中
+        /// @return 是否收到了完整的回复（否则连接已经不能使用）
+        bool submit(const JobRequest &request, std::string &output, JobResult &result)
+        {
+            output.clear();
+            result = JobResult();
+            if (m_fd < 0)
+                return false;
+
+            std::string message = "JOB\n";
+            if (!request.path.empty())
+                message += "path " + request.path + "\n";
+            else
+                message += "image " + std::to_string(request.image.size()) + "\n";
+            message += "input " + std::to_string(request.input.size()) + "\n";
+            message += "budget " + std::to_string(request.budget) + "\n";
+            message += "output-limit " + std::to_string(request.output_limit) + "\n\n";
+            if (request.path.empty())
+                message += request.image;
+            message += request.input;
+            if (!send_all(m_fd, message.data(), message.size()))
+                return false;
+
+            std::string line;
+            std::string chunk;
+            while (m_reader->read_line(line))
+            {
+                if (line.compare(0, 4, "OUT ") == 0)
+                {
+                    if (!m_reader->read_bytes(std::stoull(line.substr(4)), chunk))
+                        return false;
+                    output += chunk;
+                }
+                else if (line.compare(0, 4, "ERR ") == 0)
+                {
+                    result.status = JobEnum::Status::ERROR;
+                    result.message = line.substr(4);
+                    return true;
+                }
+                else if (line.compare(0, 4, "END ") == 0)
+                {
+                    std::istringstream sstr(line.substr(4));
+                    std::string status;
+                    int truncated = 0;
+                    sstr >> status >> result.exit_code >> result.exception >> result.retired_instructions >> result.elapsed_ns >> truncated;
+                    result.truncated = truncated != 0;
+                    for (int i = JobEnum::Status::EXIT; i <= JobEnum::Status::ERROR; i++)
+                        if (status == JobEnum::status_name(JobEnum::Status(i)))
+                            result.status = JobEnum::Status(i);
+                    return !sstr.fail();
+                }
+                else
+                    return false;
+            }
+            return false;
+        }
+    };
+#endif
+} // namespace svm
+
+#endif
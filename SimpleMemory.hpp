@@ -0,0 +1,433 @@
+#ifndef __SIMPLE_MEMORY_HPP__
+#define __SIMPLE_MEMORY_HPP__
+
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <map>
+#include <mutex>
+
+// 在支持mmap和信号的平台上，用保护页（guard page）来检查虚拟机内存的边界，
+// 否则退化为每次访问时显式检查。定义SVM_NO_GUARD_PAGES可以强制关闭保护页。
+#if !defined(SVM_NO_GUARD_PAGES) && (defined(__unix__) || defined(__APPLE__))
+#define SVM_GUARD_PAGES 1
+#include <sys/mman.h>
+#include <signal.h>
+#include <setjmp.h>
+#include <unistd.h>
+#else
+#define SVM_GUARD_PAGES 0
+#endif
+
+namespace svm
+{
+    /// @brief 带保护页的内存区域
+    /// 预留的地址空间依次是：对齐用的填充、size个可读写的机器字、WINDOW_BYTES字节的窗口区和一页末尾保护页。
+    /// 窗口区平时也是保护页，可以映射共享内存（map_window()）。内存的末尾和页边界对齐，所以哪怕只越界一个机器字也会触发SIGSEGV；
+    /// 更远的地址由访问者截到末尾保护页（见guard_limit()），不需要为整个客户地址空间预留。
+    class GuardedRegion
+    {
+    public:
+        /// @brief 是否使用保护页
+        static const bool GUARD_PAGES = SVM_GUARD_PAGES;
+        /// @brief 内存之后留给窗口的地址空间（单位为字节，页的整数倍）
+        static const size_t WINDOW_BYTES = size_t(256) << 20;
+
+    private:
+        /// @brief 虚拟机内存的首地址
+        void *m_base = nullptr;
+        /// @brief 内存大小（单位为机器字）
+        size_t m_size = 0;
+        /// @brief 机器字的字节数
+        size_t m_word_size = 0;
+        /// @brief 预留区域的首地址
+        void *m_reservation = nullptr;
+        /// @brief 预留区域的大小（单位为字节）
+        size_t m_reservation_size = 0;
+        /// @brief 已经映射的窗口：相对内存首地址的位置 -> 长度（单位为字节，页的整数倍）
+        std::map<size_t, size_t> m_windows;
+
+    public:
+        /// @brief 构造函数
+        /// @param size 内存大小（单位为机器字）
+        /// @param word_size 机器字的字节数
+        GuardedRegion(size_t size, size_t word_size) : m_size(size), m_word_size(word_size)
+        {
+            const size_t bytes = size * word_size;
+#if SVM_GUARD_PAGES
+            const size_t page = page_size();
+            const size_t committed = (bytes + page - 1) / page * page;
+            m_reservation_size = committed + WINDOW_BYTES + page;
+
+            m_reservation = mmap(nullptr, m_reservation_size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+            if (m_reservation == MAP_FAILED)
+                throw std::bad_alloc();
+            if (committed > 0 && mprotect(m_reservation, committed, PROT_READ | PROT_WRITE) != 0)
+            {
+                munmap(m_reservation, m_reservation_size);
+                throw std::bad_alloc();
+            }
+            m_base = static_cast<char *>(m_reservation) + (committed - bytes);
+#else
+            m_base = new uint64_t[(bytes + sizeof(uint64_t) - 1) / sizeof(uint64_t)]();
+#endif
+        }
+
+        GuardedRegion(const GuardedRegion &) = delete;
+        GuardedRegion &operator=(const GuardedRegion &) = delete;
+
+        ~GuardedRegion()
+        {
+#if SVM_GUARD_PAGES
+            munmap(m_reservation, m_reservation_size);
+#else
+            delete[] static_cast<uint64_t *>(m_base);
+#endif
+        }
+
+    public:
+        /// @brief 获取内存首地址
+        /// @return 首地址
+        void *data() const
+        {
+            return m_base;
+        }
+
+        /// @brief 获取内存大小
+        /// @return 大小（单位为机器字）
+        size_t size() const
+        {
+            return m_size;
+        }
+
+        /// @brief 获取末尾保护页相对内存首地址的位置，超出窗口区的客户访问都应该落在这里
+        /// @return 位置（单位为字节）
+        size_t guard_limit() const
+        {
+            return m_size * m_word_size + WINDOW_BYTES;
+        }
+
+        /// @brief 判断宿主地址是否在这片区域（包括保护页）内
+        /// @param address 宿主地址
+        /// @return 是否在区域内
+        bool contains(const void *address) const
+        {
+#if SVM_GUARD_PAGES
+            const char *begin = static_cast<const char *>(m_reservation);
+            const char *addr = static_cast<const char *>(address);
+            return addr >= begin && addr < begin + m_reservation_size;
+#else
+            const char *begin = static_cast<const char *>(m_base);
+            const char *addr = static_cast<const char *>(address);
+            return addr >= begin && addr < begin + m_size * m_word_size;
+#endif
+        }
+
+        /// @brief 判断宿主地址是否在虚拟机内存（不包括保护页）内
+        /// @param address 宿主地址
+        /// @param offset 相对内存首地址的偏移（单位为字节）
+        /// @return 是否在内存内
+        bool offset_of(const void *address, size_t &offset) const
+        {
+            const char *begin = static_cast<const char *>(m_base);
+            const char *addr = static_cast<const char *>(address);
+            if (addr < begin || addr >= begin + m_size * m_word_size)
+                return false;
+            offset = size_t(addr - begin);
+            return true;
+        }
+
+        /// @brief 修改一段内存所在的页的访问权限（调试器的观察点使用）
+        /// 权限以页为单位，同一页上的其他数据也会受到影响
+        /// @param offset 起始位置（单位为字节）
+        /// @param bytes 长度（单位为字节）
+        /// @param readable 是否可读
+        /// @param writable 是否可写
+        /// @return 是否成功（不使用保护页时总是失败）
+        bool protect(size_t offset, size_t bytes, bool readable, bool writable) const
+        {
+#if SVM_GUARD_PAGES
+            if (bytes == 0 || offset >= m_size * m_word_size || bytes > m_size * m_word_size - offset)
+                return false;
+            const size_t page = page_size();
+            const uintptr_t begin = reinterpret_cast<uintptr_t>(m_base) + offset;
+            const uintptr_t first = begin / page * page;
+            const uintptr_t last = (begin + bytes + page - 1) / page * page;
+            const int access = (readable ? PROT_READ : 0) | (writable ? PROT_WRITE : 0);
+            return mprotect(reinterpret_cast<void *>(first), last - first, access == 0 ? PROT_NONE : access) == 0;
+#else
+            return false;
+#endif
+        }
+
+        /// @brief 获取内存之前的填充长度
+        /// 内存的末尾和页边界对齐，所以第一页的开头有一段填充，不使用保护页时为0
+        /// @return 长度（单位为字节）
+        size_t lead_bytes() const
+        {
+#if SVM_GUARD_PAGES
+            return static_cast<const char *>(m_base) - static_cast<const char *>(m_reservation);
+#else
+            return 0;
+#endif
+        }
+
+        /// @brief 把文件映射为虚拟机内存（写时复制，之后的写入不会改动文件）
+        /// 文件从offset开始依次是lead_bytes()字节的填充和整个内存
+        /// @param fd 文件描述符
+        /// @param offset 文件中的位置（必须和页对齐）
+        /// @return 是否成功（不使用保护页时总是失败）
+        bool map_file(int fd, uint64_t offset)
+        {
+#if SVM_GUARD_PAGES
+            const size_t committed = lead_bytes() + m_size * m_word_size;
+            if (committed == 0 || offset % page_size() != 0)
+                return false;
+            void *mapped = mmap(m_reservation, committed, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, off_t(offset));
+            if (mapped == m_reservation)
+                return true;
+            // 失败时原来的映射可能已经被拆掉了，换回匿名内存，由调用者重新填充内容
+            mmap(m_reservation, committed, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0);
+            return false;
+#else
+            (void)fd;
+            (void)offset;
+            return false;
+#endif
+        }
+
+        /// @brief 把共享内存文件映射到内存之后的保护页区域（窗口），两边看到的是同一份数据
+        /// @param fd 文件描述符，映射从文件开头开始
+        /// @param offset 窗口相对内存首地址的位置（单位为字节），必须在内存之后，并且离内存末尾是页的整数倍
+        /// @param bytes 窗口大小（单位为字节，向上取整到页）
+        /// @return 是否成功（不使用保护页时总是失败）
+        bool map_window(int fd, size_t offset, size_t bytes)
+        {
+#if SVM_GUARD_PAGES
+            const size_t page = page_size();
+            const size_t length = (bytes + page - 1) / page * page;
+            if (!window_fits(offset, length))
+                return false;
+            void *address = static_cast<char *>(m_base) + offset;
+            // MAP_FIXED失败时原来的映射可能已经被拆掉了，所以先把这段从窗口表中去掉
+            forget_windows(offset, length);
+            if (mmap(address, length, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) != address)
+                return false;
+            m_windows[offset] = length;
+            return true;
+#else
+            (void)fd;
+            (void)offset;
+            (void)bytes;
+            return false;
+#endif
+        }
+
+        /// @brief 取消map_window()映射的窗口，恢复为保护页
+        /// @param offset 窗口相对内存首地址的位置（单位为字节）
+        /// @param bytes 窗口大小（单位为字节，向上取整到页）
+        /// @return 是否成功
+        bool unmap_window(size_t offset, size_t bytes)
+        {
+#if SVM_GUARD_PAGES
+            const size_t page = page_size();
+            const size_t length = (bytes + page - 1) / page * page;
+            if (!window_fits(offset, length))
+                return false;
+            void *address = static_cast<char *>(m_base) + offset;
+            forget_windows(offset, length);
+            return mmap(address, length, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED, -1, 0) == address;
+#else
+            (void)offset;
+            (void)bytes;
+            return false;
+#endif
+        }
+
+        /// @brief 从某个位置开始连续可以访问的字节数：内存的剩余部分，以及紧接着的、首尾相接的已映射窗口
+        /// 批量访问用它检查整个范围，不依赖SIGSEGV（复制到一半出错会留下半截数据）
+        /// @param offset 相对内存首地址的位置（单位为字节）
+        /// @return 字节数，位置既不在内存中也不在窗口中时为0
+        size_t accessible_bytes(size_t offset) const
+        {
+            const size_t memory_bytes = m_size * m_word_size;
+            size_t end = offset < memory_bytes ? memory_bytes : offset;
+            auto it = m_windows.upper_bound(end);
+            if (it != m_windows.begin())
+                --it;
+            while (it != m_windows.end() && it->first <= end && end < it->first + it->second)
+            {
+                end = it->first + it->second;
+                ++it;
+            }
+            return end - offset;
+        }
+
+        /// @brief 获取系统的页大小
+        /// @return 页大小（单位为字节）
+        static size_t page_size()
+        {
+#if SVM_GUARD_PAGES
+            static const size_t size = size_t(sysconf(_SC_PAGESIZE));
+            return size;
+#else
+            return 4096;
+#endif
+        }
+
+    private:
+        /// @brief 把一段地址从窗口表中去掉，部分重叠的窗口被截短或拆成两段
+        /// @param offset 位置（单位为字节）
+        /// @param length 长度（单位为字节）
+        void forget_windows(size_t offset, size_t length)
+        {
+            const size_t end = offset + length;
+            auto it = m_windows.lower_bound(offset);
+            if (it != m_windows.begin())
+                --it;
+            while (it != m_windows.end() && it->first < end)
+            {
+                const size_t first = it->first;
+                const size_t last = it->first + it->second;
+                if (last <= offset)
+                {
+                    ++it;
+                    continue;
+                }
+                it = m_windows.erase(it);
+                if (first < offset)
+                    m_windows[first] = offset - first;
+                if (last > end)
+                    m_windows[end] = last - end;
+            }
+        }
+
+        /// @brief 判断窗口是否整个落在内存之后的保护页区域内
+        bool window_fits(size_t offset, size_t length) const
+        {
+            const size_t memory_bytes = m_size * m_word_size;
+            return length > 0 && offset >= memory_bytes && (offset - memory_bytes) % page_size() == 0 &&
+                   offset - memory_bytes <= WINDOW_BYTES && length <= WINDOW_BYTES - (offset - memory_bytes);
+        }
+    };
+
+#if SVM_GUARD_PAGES
+    /// @brief 保护页异常的上下文
+    /// 每个正在运行虚拟机的线程都有一个，信号处理函数通过它跳回run()
+    struct GuardContext
+    {
+        /// @brief 跳回run()的位置
+        sigjmp_buf env;
+        /// @brief 正在运行的虚拟机的内存区域
+        const GuardedRegion *region = nullptr;
+        /// @brief 触发异常的宿主地址
+        const void *fault_address = nullptr;
+        /// @brief 外层的上下文（虚拟机嵌套运行时）
+        GuardContext *previous = nullptr;
+    };
+
+    /// @brief 当前线程的保护页上下文
+    inline GuardContext *&current_guard_context()
+    {
+        static thread_local GuardContext *context = nullptr;
+        return context;
+    }
+
+    /// @brief 安装信号处理函数前的SIGSEGV处理方式
+    inline struct sigaction &previous_segv_action()
+    {
+        static struct sigaction action;
+        return action;
+    }
+
+    /// @brief 安装信号处理函数前的SIGBUS处理方式
+    inline struct sigaction &previous_bus_action()
+    {
+        static struct sigaction action;
+        return action;
+    }
+
+    /// @brief SIGSEGV/SIGBUS的处理函数
+    /// 如果出错地址落在当前线程正在运行的虚拟机的内存区域里，就跳回run()并发出ADR异常，
+    /// 否则交给安装之前的处理方式。这里的处理函数始终保持安装，之后虚拟机的越界访问仍然会被捕获。
+    inline void guard_signal_handler(int signal, siginfo_t *info, void *ucontext)
+    {
+        GuardContext *context = current_guard_context();
+        if (context != nullptr && context->region != nullptr && context->region->contains(info->si_addr))
+        {
+            context->fault_address = info->si_addr;
+            siglongjmp(context->env, 1);
+        }
+
+        const struct sigaction &previous = signal == SIGBUS ? previous_bus_action() : previous_segv_action();
+        if (previous.sa_flags & SA_SIGINFO)
+        {
+            if (previous.sa_sigaction != nullptr)
+                previous.sa_sigaction(signal, info, ucontext);
+            return;
+        }
+        // 访问出错产生的信号被忽略时，返回后会重新执行出错的指令而无限循环，所以和默认处理方式一样结束进程
+        if (previous.sa_handler != SIG_DFL && previous.sa_handler != SIG_IGN)
+        {
+            previous.sa_handler(signal);
+            return;
+        }
+        // 默认处理方式是结束进程（并生成core文件），只能恢复默认处理后重新发出信号
+        struct sigaction action;
+        memset(&action, 0, sizeof(action));
+        action.sa_handler = SIG_DFL;
+        sigemptyset(&action.sa_mask);
+        sigaction(signal, &action, nullptr);
+        raise(signal);
+    }
+
+    /// @brief 安装信号处理函数（只安装一次）
+    inline void install_guard_signal_handler()
+    {
+        static std::once_flag flag;
+        std::call_once(flag, []()
+                       {
+                           struct sigaction action;
+                           memset(&action, 0, sizeof(action));
+                           action.sa_sigaction = guard_signal_handler;
+                           // SA_NODEFER：跳出处理函数后不需要恢复信号屏蔽字，sigsetjmp也就不必保存它
+                           action.sa_flags = SA_SIGINFO | SA_NODEFER;
+                           sigemptyset(&action.sa_mask);
+                           sigaction(SIGSEGV, &action, &previous_segv_action());
+                           sigaction(SIGBUS, &action, &previous_bus_action()); });
+    }
+
+    /// @brief 在作用域内把当前线程的保护页上下文设为指定区域
+    class GuardScope
+    {
+    private:
+        GuardContext m_context;
+
+    public:
+        /// @brief 构造函数
+        /// @param region 正在运行的虚拟机的内存区域
+        GuardScope(const GuardedRegion &region)
+        {
+            install_guard_signal_handler();
+            m_context.region = &region;
+            m_context.previous = current_guard_context();
+            current_guard_context() = &m_context;
+        }
+
+        ~GuardScope()
+        {
+            current_guard_context() = m_context.previous;
+        }
+
+    public:
+        /// @brief 获取上下文
+        /// @return 上下文的引用
+        GuardContext &context()
+        {
+            return m_context;
+        }
+    };
+#endif
+} // namespace svm
+
+#endif
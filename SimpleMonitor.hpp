@@ -0,0 +1,389 @@
+#ifndef __SIMPLE_MONITOR_HPP__
+#define __SIMPLE_MONITOR_HPP__
+
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <string>
+#include <memory>
+#include <cstdint>
+#include <cstring>
+#include <sstream>
+#include <iostream>
+#include <type_traits>
+#include "SimpleInst.hpp"
+#include "SimpleSocket.hpp"
+
+// 指标服务使用Unix域套接字，只在类Unix系统上提供
+#if SVM_UNIX_SOCKETS && !defined(SVM_NO_METRICS_SERVER)
+#define SVM_METRICS_SERVER 1
+#else
+#define SVM_METRICS_SERVER 0
+#endif
+
+namespace svm
+{
+    /// @brief 发布给监控方的虚拟机状态快照
+    /// 所有字段都是uint64_t，这样可以按字逐个原子地复制
+    struct MonitorSnapshot
+    {
+        /// @brief 通用寄存器（32位虚拟机只用低32位）
+        std::array<uint64_t, RegisterEnum::GeneralRegister::GRCOUNT> general_registers;
+        /// @brief 下一条要执行的指令索引
+        uint64_t instruction_index;
+        /// @brief 执行过的指令总数
+        uint64_t retired_instructions;
+        /// @brief 执行过的系统调用总数
+        uint64_t retired_syscalls;
+        /// @brief 异常状态，参见ExceptionEnum::Exception
+        uint64_t exception;
+        /// @brief 是否正在运行
+        uint64_t is_running;
+        /// @brief ZF标志
+        uint64_t zero_flag;
+        /// @brief SF标志
+        uint64_t sign_flag;
+        /// @brief 虚拟机的机器字位数
+        uint64_t word_bits;
+        /// @brief 发布的次数
+        uint64_t publish_count;
+    };
+
+    static_assert(std::is_trivially_copyable<MonitorSnapshot>::value && sizeof(MonitorSnapshot) % sizeof(uint64_t) == 0, "MonitorSnapshot must be copyable word by word");
+
+    /// @brief 一个虚拟机的监控槽（顺序锁）
+    /// 只有运行虚拟机的线程调用publish()，写入方从不加锁也不等待；
+    /// 读取方在写入期间读到的数据会被丢弃并重试，所以读取不会让虚拟机暂停。
+    class MonitorSlot
+    {
+    public:
+        /// @brief 快照占的字数
+        static const size_t WORDS = sizeof(MonitorSnapshot) / sizeof(uint64_t);
+
+    private:
+        /// @brief 序号，为奇数时表示正在写入
+        std::atomic<uint64_t> m_sequence{0};
+        /// @brief 快照数据
+        std::array<std::atomic<uint64_t>, WORDS> m_words;
+        /// @brief 虚拟机的名字（指标中的vm标签）
+        std::string m_name;
+
+    public:
+        /// @brief 构造函数
+        /// @param name 虚拟机的名字
+        MonitorSlot(const std::string &name) : m_name(name)
+        {
+            for (size_t i = 0; i < WORDS; i++)
+                m_words[i].store(0, std::memory_order_relaxed);
+        }
+        ~MonitorSlot() {}
+
+    public:
+        /// @brief 发布一份快照（只能由一个线程调用）
+        /// @param snapshot 快照
+        void publish(const MonitorSnapshot &snapshot)
+        {
+            uint64_t words[WORDS];
+            memcpy(words, &snapshot, sizeof(words));
+
+            const uint64_t sequence = m_sequence.load(std::memory_order_relaxed);
+            m_sequence.store(sequence + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            for (size_t i = 0; i < WORDS; i++)
+                m_words[i].store(words[i], std::memory_order_relaxed);
+            m_sequence.store(sequence + 2, std::memory_order_release);
+        }
+
+        /// @brief 读取最近一次发布的快照
+        /// @param snapshot 快照
+        /// @param max_retries 遇到正在写入时最多重试的次数
+        /// @return 是否读到了完整的快照（还没有发布过时也返回false）
+        bool read(MonitorSnapshot &snapshot, size_t max_retries = 64) const
+        {
+            uint64_t words[WORDS];
+            for (size_t attempt = 0; attempt <= max_retries; attempt++)
+            {
+                const uint64_t begin = m_sequence.load(std::memory_order_acquire);
+                if (begin == 0)
+                    return false;
+                if (begin % 2 == 1)
+                {
+                    std::this_thread::yield();
+                    continue;
+                }
+                for (size_t i = 0; i < WORDS; i++)
+                    words[i] = m_words[i].load(std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (m_sequence.load(std::memory_order_relaxed) == begin)
+                {
+                    memcpy(&snapshot, words, sizeof(words));
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        /// @brief 获取虚拟机的名字
+        const std::string &get_name() const
+        {
+            return m_name;
+        }
+    };
+
+    /// @brief 进程中所有被监控的虚拟机
+    /// 只有注册、注销和收集时加锁，虚拟机发布快照时不经过这里
+    class MonitorRegistry
+    {
+    private:
+        std::mutex m_mutex;
+        std::vector<std::shared_ptr<MonitorSlot>> m_slots;
+        /// @brief 用于生成默认名字
+        uint64_t m_next_id = 0;
+        /// @brief 已注销的虚拟机执行过的指令和系统调用，保证进程级的计数只增不减
+        uint64_t m_removed_instructions = 0;
+        uint64_t m_removed_syscalls = 0;
+
+    public:
+        /// @brief 获取进程唯一的注册表
+        static MonitorRegistry &instance()
+        {
+            static MonitorRegistry registry;
+            return registry;
+        }
+
+    public:
+        /// @brief 注册一个虚拟机
+        /// @param name 虚拟机的名字，为空时自动生成
+        /// @return 监控槽
+        std::shared_ptr<MonitorSlot> add(const std::string &name)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            std::shared_ptr<MonitorSlot> slot = std::make_shared<MonitorSlot>(name.empty() ? "vm" + std::to_string(m_next_id) : name);
+            m_next_id++;
+            m_slots.push_back(slot);
+            return slot;
+        }
+
+        /// @brief 注销一个虚拟机
+        /// @param slot 监控槽
+        void remove(const std::shared_ptr<MonitorSlot> &slot)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            for (size_t i = 0; i < m_slots.size(); i++)
+            {
+                if (m_slots.at(i) == slot)
+                {
+                    MonitorSnapshot snapshot;
+                    if (slot->read(snapshot))
+                    {
+                        m_removed_instructions += snapshot.retired_instructions;
+                        m_removed_syscalls += snapshot.retired_syscalls;
+                    }
+                    m_slots.erase(m_slots.begin() + i);
+                    break;
+                }
+            }
+        }
+
+        /// @brief 获取当前注册的所有监控槽
+        /// 返回的是共享指针，虚拟机在收集期间被销毁也没有关系
+        std::vector<std::shared_ptr<MonitorSlot>> slots()
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_slots;
+        }
+
+        /// @brief 以Prometheus文本格式输出所有虚拟机的指标
+        /// @param out 输出流
+        void write_prometheus(std::ostream &out)
+        {
+            std::vector<std::shared_ptr<MonitorSlot>> all;
+            uint64_t total_instructions;
+            uint64_t total_syscalls;
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                all = m_slots;
+                total_instructions = m_removed_instructions;
+                total_syscalls = m_removed_syscalls;
+            }
+
+            std::vector<std::pair<std::string, MonitorSnapshot>> snapshots;
+            for (size_t i = 0; i < all.size(); i++)
+            {
+                MonitorSnapshot snapshot;
+                if (all.at(i)->read(snapshot))
+                    snapshots.push_back({all.at(i)->get_name(), snapshot});
+            }
+
+            uint64_t running = 0;
+            for (size_t i = 0; i < snapshots.size(); i++)
+            {
+                total_instructions += snapshots.at(i).second.retired_instructions;
+                total_syscalls += snapshots.at(i).second.retired_syscalls;
+                running += snapshots.at(i).second.is_running;
+            }
+
+            out << "# HELP svm_vms Number of monitored VMs.\n# TYPE svm_vms gauge\n";
+            out << "svm_vms " << all.size() << "\n";
+            out << "# HELP svm_vms_running Number of monitored VMs that are running.\n# TYPE svm_vms_running gauge\n";
+            out << "svm_vms_running " << running << "\n";
+            out << "# HELP svm_process_instructions_retired_total Instructions retired by all monitored VMs.\n# TYPE svm_process_instructions_retired_total counter\n";
+            out << "svm_process_instructions_retired_total " << total_instructions << "\n";
+            out << "# HELP svm_process_syscalls_retired_total System calls retired by all monitored VMs.\n# TYPE svm_process_syscalls_retired_total counter\n";
+            out << "svm_process_syscalls_retired_total " << total_syscalls << "\n";
+
+            write_metric(out, snapshots, "svm_instructions_retired_total", "counter", "Instructions retired by the VM.", [](const MonitorSnapshot &s)
+                         { return s.retired_instructions; });
+            write_metric(out, snapshots, "svm_syscalls_retired_total", "counter", "System calls retired by the VM.", [](const MonitorSnapshot &s)
+                         { return s.retired_syscalls; });
+            write_metric(out, snapshots, "svm_instruction_index", "gauge", "Index of the next instruction.", [](const MonitorSnapshot &s)
+                         { return s.instruction_index; });
+            write_metric(out, snapshots, "svm_running", "gauge", "Whether the VM is running.", [](const MonitorSnapshot &s)
+                         { return s.is_running; });
+            write_metric(out, snapshots, "svm_exception", "gauge", "Exception state of the VM (see ExceptionEnum).", [](const MonitorSnapshot &s)
+                         { return s.exception; });
+            write_metric(out, snapshots, "svm_zero_flag", "gauge", "ZF status register.", [](const MonitorSnapshot &s)
+                         { return s.zero_flag; });
+            write_metric(out, snapshots, "svm_sign_flag", "gauge", "SF status register.", [](const MonitorSnapshot &s)
+                         { return s.sign_flag; });
+
+            out << "# HELP svm_register General register value.\n# TYPE svm_register gauge\n";
+            for (size_t i = 0; i < snapshots.size(); i++)
+            {
+                const std::string name = escape_label(snapshots.at(i).first);
+                for (size_t reg = 0; reg < RegisterEnum::GeneralRegister::GRCOUNT; reg++)
+                    out << "svm_register{vm=\"" << name << "\",reg=\"" << gregister_name_list.at(reg) << "\"} " << snapshots.at(i).second.general_registers.at(reg) << "\n";
+            }
+        }
+
+    private:
+        MonitorRegistry() {}
+
+        /// @brief 输出一个按虚拟机分组的指标
+        template <typename Getter>
+        static void write_metric(std::ostream &out, const std::vector<std::pair<std::string, MonitorSnapshot>> &snapshots, const char *name, const char *type, const char *help, Getter getter)
+        {
+            out << "# HELP " << name << " " << help << "\n# TYPE " << name << " " << type << "\n";
+            for (size_t i = 0; i < snapshots.size(); i++)
+                out << name << "{vm=\"" << escape_label(snapshots.at(i).first) << "\"} " << getter(snapshots.at(i).second) << "\n";
+        }
+
+        /// @brief 转义标签值中的反斜杠、双引号和换行，虚拟机的名字由使用者指定，可能包含它们
+        static std::string escape_label(const std::string &value)
+        {
+            std::string result;
+            result.reserve(value.size());
+            for (char c : value)
+            {
+                if (c == '\\' || c == '"')
+                    result += '\\';
+                if (c == '\n')
+                    result += "\\n";
+                else
+                    result += c;
+            }
+            return result;
+        }
+    };
+
+    /// @brief 指标服务
+    /// 在Unix域套接字上监听，每个连接返回一次MonitorRegistry的Prometheus文本后关闭。
+    /// 请求以"GET"开头时按HTTP/1.0回复，否则直接输出文本（可以用nc -U读取）。
+    class MetricsServer
+    {
+    private:
+        /// @brief 监听的套接字，-1表示没有启动
+        int m_fd = -1;
+        /// @brief 套接字路径
+        std::string m_path;
+        /// @brief 服务线程
+        std::thread m_thread;
+        /// @brief 是否要求服务线程退出
+        std::atomic<bool> m_stop{false};
+
+    public:
+        MetricsServer() {}
+        MetricsServer(const MetricsServer &) = delete;
+        MetricsServer &operator=(const MetricsServer &) = delete;
+        ~MetricsServer()
+        {
+            stop();
+        }
+
+    public:
+        /// @brief 开始在指定路径上监听
+        /// @param path 套接字路径（已存在的文件会被删除）
+        /// @return 是否成功
+        bool start(const std::string &path)
+        {
+#if SVM_METRICS_SERVER
+            stop();
+            m_fd = listen_unix_socket(path, 16);
+            if (m_fd < 0)
+                return false;
+
+            m_path = path;
+            m_stop.store(false);
+            m_thread = std::thread([this]()
+                                   { serve(); });
+            return true;
+#else
+            std::cout << "Metrics server is not supported on this platform" << std::endl;
+            return false;
+#endif
+        }
+
+        /// @brief 停止监听并删除套接字文件
+        void stop()
+        {
+#if SVM_METRICS_SERVER
+            if (m_fd < 0)
+                return;
+            m_stop.store(true);
+            if (m_thread.joinable())
+                m_thread.join();
+            close_unix_socket(m_fd, m_path);
+            m_fd = -1;
+#endif
+        }
+
+    private:
+#if SVM_METRICS_SERVER
+        /// @brief 服务线程，定期检查是否要退出
+        void serve()
+        {
+            while (!m_stop.load())
+            {
+                int client = accept_unix_socket(m_fd, 100);
+                if (client < 0)
+                    continue;
+                respond(client);
+                close(client);
+            }
+        }
+
+        /// @brief 回复一个连接
+        /// @param client 连接的套接字
+        void respond(int client)
+        {
+            // 客户端可能不发送任何内容，只等一小会儿
+            char request[512];
+            ssize_t received = 0;
+            pollfd descriptor = {client, POLLIN, 0};
+            if (poll(&descriptor, 1, 50) > 0)
+                received = recv(client, request, sizeof(request), 0);
+
+            std::ostringstream body;
+            MonitorRegistry::instance().write_prometheus(body);
+            std::string response = body.str();
+            if (received >= 3 && memcmp(request, "GET", 3) == 0)
+                response = "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: " + std::to_string(response.size()) + "\r\n\r\n" + response;
+            send_all(client, response.data(), response.size());
+        }
+#endif
+    };
+} // namespace svm
+
+#endif
@@ -0,0 +1,138 @@
+#ifndef __SIMPLE_MULTI_CORE_HPP__
+#define __SIMPLE_MULTI_CORE_HPP__
+
+#include <thread>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include "SimpleVM.hpp"
+
+namespace svm
+{
+    /// @brief 多核虚拟机
+    /// 每个核是一个BasicSimpleVM，有自己的寄存器、指令索引和完整大小的栈（不在共享内存中），在自己的宿主线程上运行；
+    /// 所有核共享同一份内存，通过原子指令（CAS/XADD/XCHG/FENCE）同步，内存模型见CommandEnum中的说明。
+    /// 所有核从同一个程序的第0条指令开始执行，开始时AX为核的编号，BX为核的总数。
+    /// 一个核执行EXIT只结束这个核；任何一个核发生异常（包括HLT），其他核会在下次轮询设备时停止。
+    /// 系统调用在所有核之间逐个执行。
+    /// @tparam WordT 机器字类型
+    template <typename WordT>
+    class BasicMultiCoreVM
+    {
+    public:
+        /// @brief 机器字类型
+        using DWORD = WordT;
+        using VM = BasicSimpleVM<WordT>;
+        using ISData = typename VM::ISData;
+        using ProgramData = typename VM::ProgramData;
+
+    private:
+        /// @brief 所有核共享的内存
+        std::shared_ptr<ISData> m_storage;
+        /// @brief 所有核共享的资源
+        std::shared_ptr<CoreGroup> m_group;
+        /// @brief 各个核
+        std::vector<std::unique_ptr<VM>> m_cores;
+
+    public:
+        /// @brief 构造函数
+        /// @param core_count 核数，为0时使用宿主的硬件线程数
+        BasicMultiCoreVM(size_t core_count = 0) : m_storage(std::make_shared<ISData>()), m_group(std::make_shared<CoreGroup>())
+        {
+            if (core_count == 0)
+                core_count = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+            for (size_t i = 0; i < core_count; i++)
+                m_cores.emplace_back(new VM(m_storage, m_group));
+        }
+
+        BasicMultiCoreVM(const BasicMultiCoreVM &) = delete;
+        BasicMultiCoreVM &operator=(const BasicMultiCoreVM &) = delete;
+
+        ~BasicMultiCoreVM() {}
+
+    public:
+        /// @brief 加载程序，并设置每个核的AX和BX
+        /// @param program_data 程序
+        virtual void load_program(const ProgramData &program_data)
+        {
+            for (size_t i = 0; i < m_cores.size(); i++)
+            {
+                VM &core = *m_cores.at(i);
+                core.load_program(program_data);
+                core.get_vm_state().general_registers.at(RegisterEnum::GeneralRegister::AX) = DWORD(i);
+                core.get_vm_state().general_registers.at(RegisterEnum::GeneralRegister::BX) = DWORD(m_cores.size());
+            }
+        }
+
+        /// @brief 运行所有核，直到它们都停止
+        /// 第0个核在调用者的线程上运行，其余的核各自使用一个新线程
+        virtual void run()
+        {
+            m_group->abort.store(false);
+            std::vector<std::thread> threads;
+            for (size_t i = 1; i < m_cores.size(); i++)
+                threads.emplace_back([this, i]()
+                                     { m_cores.at(i)->run(); });
+            m_cores.at(0)->run();
+            for (size_t i = 0; i < threads.size(); i++)
+                threads.at(i).join();
+        }
+
+        /// @brief 重置所有核和共享内存
+        virtual void reset()
+        {
+            m_storage->clear();
+            for (size_t i = 0; i < m_cores.size(); i++)
+                m_cores.at(i)->reset();
+            m_group->abort.store(false);
+        }
+
+    public:
+        /// @brief 获取核数
+        size_t get_core_count() const
+        {
+            return m_cores.size();
+        }
+
+        /// @brief 获取某个核
+        /// @param index 核的编号
+        /// @return 核的引用
+        VM &get_core(size_t index)
+        {
+            return *m_cores.at(index);
+        }
+
+        /// @brief 获取第一个发生的异常（各核按编号检查），都正常时为AOK
+        ExceptionEnum::Exception get_exception()
+        {
+            for (size_t i = 0; i < m_cores.size(); i++)
+            {
+                const ExceptionEnum::Exception exception = m_cores.at(i)->get_vm_state().exception;
+                if (exception != ExceptionEnum::Exception::AOK)
+                    return exception;
+            }
+            return ExceptionEnum::Exception::AOK;
+        }
+
+        /// @brief 获取所有核执行过的指令总数
+        uint64_t get_retired_instructions() const
+        {
+            uint64_t total = 0;
+            for (size_t i = 0; i < m_cores.size(); i++)
+                total += m_cores.at(i)->get_retired_instructions();
+            return total;
+        }
+
+        /// @brief 获取共享内存
+        /// @return 运行时数据的引用
+        ISData &get_internal_storage_data()
+        {
+            return *m_storage;
+        }
+    };
+
+    using MultiCoreVM = BasicMultiCoreVM<DWORD64>;
+    using MultiCoreVM32 = BasicMultiCoreVM<DWORD32>;
+} // namespace svm
+
+#endif
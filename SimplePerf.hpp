@@ -0,0 +1,261 @@
+#ifndef __SIMPLE_PERF_HPP__
+#define __SIMPLE_PERF_HPP__
+
+#include <array>
+#include <string>
+#include <thread>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+
+// 只有Linux提供perf_event_open，其他平台上所有计数器都不可用
+#if defined(__linux__) && !defined(SVM_NO_PERF_EVENTS)
+#define SVM_PERF_EVENTS 1
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#else
+#define SVM_PERF_EVENTS 0
+#endif
+
+namespace svm
+{
+    /// @brief 硬件性能计数器枚举
+    namespace PerfEnum
+    {
+        enum Counter
+        {
+            /// @brief CPU周期
+            CYCLES = 0,
+
+            /// @brief 宿主指令数
+            INSTRUCTIONS,
+
+            /// @brief 分支预测失败
+            BRANCH_MISSES,
+
+            /// @brief L1数据缓存读缺失
+            L1D_MISSES,
+
+            /// @brief 末级缓存读缺失
+            LLC_MISSES,
+
+            /// @brief 指令TLB缺失
+            ITLB_MISSES,
+
+            /// @brief 计数器总数
+            PCOUNT,
+        };
+    } // namespace PerfEnum
+
+    static const std::array<const char *, PerfEnum::Counter::PCOUNT> perf_counter_name_list = {"cycles", "instructions", "branch-misses", "L1-dcache-load-misses", "LLC-load-misses", "iTLB-load-misses"};
+
+    /// @brief 一次运行的计数结果
+    struct PerfReport
+    {
+        /// @brief 各计数器的值（按多路复用的运行时间折算过）
+        std::array<uint64_t, PerfEnum::Counter::PCOUNT> values{};
+        /// @brief 各计数器是否可用
+        std::array<bool, PerfEnum::Counter::PCOUNT> available{};
+        /// @brief 执行的客户指令数
+        uint64_t guest_instructions = 0;
+        /// @brief 执行的系统调用数
+        uint64_t guest_syscalls = 0;
+
+        /// @brief 计算每条客户指令平均的计数
+        /// @param counter 计数器
+        /// @return 平均值，计数器不可用或没有执行指令时为负数
+        double per_guest_instruction(PerfEnum::Counter counter) const
+        {
+            if (!available.at(counter) || guest_instructions == 0)
+                return -1;
+            return double(values.at(counter)) / guest_instructions;
+        }
+
+        /// @brief 输出报告
+        /// @param out 输出流
+        void print(std::ostream &out) const
+        {
+            out << "guest instructions:" << guest_instructions << std::endl;
+            out << "guest syscalls:" << guest_syscalls << std::endl;
+            for (size_t i = 0; i < PerfEnum::Counter::PCOUNT; i++)
+            {
+                out << std::left << std::setw(24) << perf_counter_name_list.at(i) << std::right;
+                if (available.at(i))
+                    out << std::setw(16) << values.at(i) << std::setw(12) << std::fixed << std::setprecision(3) << per_guest_instruction(PerfEnum::Counter(i)) << " /guest inst" << std::endl;
+                else
+                    out << std::setw(16) << "n/a" << std::endl;
+            }
+            if (available.at(PerfEnum::Counter::CYCLES) && available.at(PerfEnum::Counter::INSTRUCTIONS) && values.at(PerfEnum::Counter::CYCLES) > 0)
+                out << "host IPC:" << std::fixed << std::setprecision(3) << double(values.at(PerfEnum::Counter::INSTRUCTIONS)) / values.at(PerfEnum::Counter::CYCLES) << std::endl;
+        }
+    };
+
+    /// @brief 硬件性能计数器
+    /// 每个计数器单独打开（不组成一组），某个计数器不被支持或没有权限时只影响它自己。
+    /// 只统计一个线程在用户态的事件，所以perf_event_paranoid为2时也能使用。
+    /// 计数器绑定在打开它的线程上：start()发现换了线程（例如虚拟机在线程池中的另一个线程上运行）时重新打开。
+    class PerfCounters
+    {
+    private:
+        /// @brief 各计数器的文件描述符，-1表示不可用
+        std::array<int, PerfEnum::Counter::PCOUNT> m_fds;
+        /// @brief 计数器统计的线程
+        std::thread::id m_thread;
+
+    public:
+        /// @brief 构造函数，在当前线程上打开计数器（用于判断是否可用）
+        PerfCounters()
+        {
+            m_fds.fill(-1);
+            open_all();
+        }
+
+        PerfCounters(const PerfCounters &) = delete;
+        PerfCounters &operator=(const PerfCounters &) = delete;
+
+        ~PerfCounters()
+        {
+            close_all();
+        }
+
+    public:
+        /// @brief 是否至少有一个计数器可用
+        bool any_available() const
+        {
+            for (size_t i = 0; i < m_fds.size(); i++)
+            {
+                if (m_fds.at(i) >= 0)
+                    return true;
+            }
+            return false;
+        }
+
+        /// @brief 清零并开始计数，只统计调用它的线程
+        void start()
+        {
+            if (m_thread != std::this_thread::get_id())
+            {
+                close_all();
+                open_all();
+            }
+#if SVM_PERF_EVENTS
+            for (size_t i = 0; i < m_fds.size(); i++)
+            {
+                if (m_fds.at(i) < 0)
+                    continue;
+                ioctl(m_fds.at(i), PERF_EVENT_IOC_RESET, 0);
+                ioctl(m_fds.at(i), PERF_EVENT_IOC_ENABLE, 0);
+            }
+#endif
+        }
+
+        /// @brief 停止计数并读取结果
+        /// @param report 结果（只填写计数器部分）
+        void stop(PerfReport &report)
+        {
+            report.available.fill(false);
+            report.values.fill(0);
+#if SVM_PERF_EVENTS
+            for (size_t i = 0; i < m_fds.size(); i++)
+            {
+                if (m_fds.at(i) >= 0)
+                    ioctl(m_fds.at(i), PERF_EVENT_IOC_DISABLE, 0);
+            }
+            for (size_t i = 0; i < m_fds.size(); i++)
+            {
+                if (m_fds.at(i) < 0)
+                    continue;
+                // value, time_enabled, time_running
+                uint64_t data[3];
+                if (read(m_fds.at(i), data, sizeof(data)) != sizeof(data))
+                    continue;
+                report.available.at(i) = true;
+                // 计数器被多路复用时按实际运行时间折算
+                if (data[2] > 0 && data[2] < data[1])
+                    report.values.at(i) = uint64_t(double(data[0]) * data[1] / data[2]);
+                else
+                    report.values.at(i) = data[0];
+            }
+#endif
+        }
+
+    private:
+        /// @brief 在当前线程上打开所有计数器
+        void open_all()
+        {
+            m_thread = std::this_thread::get_id();
+#if SVM_PERF_EVENTS
+            for (size_t i = 0; i < PerfEnum::Counter::PCOUNT; i++)
+                m_fds.at(i) = open_counter(PerfEnum::Counter(i));
+#endif
+        }
+
+        /// @brief 关闭所有计数器
+        void close_all()
+        {
+#if SVM_PERF_EVENTS
+            for (size_t i = 0; i < m_fds.size(); i++)
+            {
+                if (m_fds.at(i) >= 0)
+                    close(m_fds.at(i));
+                m_fds.at(i) = -1;
+            }
+#endif
+        }
+
+#if SVM_PERF_EVENTS
+        /// @brief 打开一个计数器（pid为0，即调用它的线程）
+        /// @param counter 计数器
+        /// @return 文件描述符，失败时为-1
+        static int open_counter(PerfEnum::Counter counter)
+        {
+            struct perf_event_attr attr;
+            memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.disabled = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+            const uint64_t cache_read_miss = (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+            switch (counter)
+            {
+            case PerfEnum::Counter::CYCLES:
+                attr.type = PERF_TYPE_HARDWARE;
+                attr.config = PERF_COUNT_HW_CPU_CYCLES;
+                break;
+            case PerfEnum::Counter::INSTRUCTIONS:
+                attr.type = PERF_TYPE_HARDWARE;
+                attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+                break;
+            case PerfEnum::Counter::BRANCH_MISSES:
+                attr.type = PERF_TYPE_HARDWARE;
+                attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+                break;
+            case PerfEnum::Counter::L1D_MISSES:
+                attr.type = PERF_TYPE_HW_CACHE;
+                attr.config = PERF_COUNT_HW_CACHE_L1D | cache_read_miss;
+                break;
+            case PerfEnum::Counter::LLC_MISSES:
+                attr.type = PERF_TYPE_HW_CACHE;
+                attr.config = PERF_COUNT_HW_CACHE_LL | cache_read_miss;
+                break;
+            case PerfEnum::Counter::ITLB_MISSES:
+                attr.type = PERF_TYPE_HW_CACHE;
+                attr.config = PERF_COUNT_HW_CACHE_ITLB | cache_read_miss;
+                break;
+            default:
+                return -1;
+            }
+
+            long fd = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+            return fd < 0 ? -1 : int(fd);
+        }
+#endif
+    };
+} // namespace svm
+
+#endif
@@ -0,0 +1,290 @@
+#ifndef __SIMPLE_PROFILER_HPP__
+#define __SIMPLE_PROFILER_HPP__
+
+#include <array>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <algorithm>
+#include "SimpleInst.hpp"
+
+// 定义SVM_NO_PROFILER可以在编译期去掉性能分析器，run()中不会留下任何检查
+#if !defined(SVM_NO_PROFILER)
+#define SVM_PROFILER 1
+#else
+#define SVM_PROFILER 0
+#endif
+
+namespace svm
+{
+    /// @brief 反汇编一条指令
+    /// 只输出这条指令实际用到的寄存器和操作数，格式和EXE文件相同
+    /// @param inst 指令
+    /// @return 反汇编文本
+    template <typename WordT>
+    std::string disassemble(const BasicInstruction<WordT> &inst)
+    {
+        using CommandEnum::Command;
+        const Command cmd = inst.command;
+        if (size_t(cmd) >= command_name_list.size())
+            return "?";
+
+        // 各个寄存器字段是否是向量寄存器
+        const bool vector1 = (cmd >= Command::VLOAD && cmd <= Command::VCMPGT);
+        const bool vector2 = (cmd >= Command::VADD && cmd <= Command::VREDMAX);
+        const bool vector3 = (cmd >= Command::VADD && cmd <= Command::VCMPGT);
+        // 用到操作数1的指令
+        const bool uses_operand1 = cmd == Command::MOVRI || (cmd >= Command::LOAD && cmd <= Command::STOREW) || cmd == Command::CALL ||
+                                   cmd == Command::VLOAD || cmd == Command::VSTORE || cmd == Command::CMPRI || (cmd >= Command::JMP && cmd <= Command::JLE) ||
+                                   (cmd >= Command::ADDRRR && cmd <= Command::SHRRRI && (cmd - Command::ADDRRR) % 2 == 1) ||
+                                   (cmd >= Command::CAS && cmd <= Command::XCHG) || cmd == Command::SPAWN;
+
+        std::ostringstream sstr;
+        sstr << command_name_list.at(cmd);
+        const char *separator = " ";
+        auto append_register = [&](RegisterEnum::GeneralRegister reg, bool vector)
+        {
+            if (reg == RegisterEnum::GeneralRegister::NONE)
+                return;
+            const std::vector<std::string> &names = vector ? vregister_name_list : gregister_name_list;
+            sstr << separator << (size_t(reg) < names.size() ? names.at(reg) : "?");
+            separator = ", ";
+        };
+        append_register(inst.register1, vector1);
+        append_register(inst.register2, vector2);
+        append_register(inst.register3, vector3);
+        if (uses_operand1)
+        {
+            sstr << separator << inst.operand1;
+            separator = ", ";
+        }
+        return sstr.str();
+    }
+
+    /// @brief 性能分析器
+    /// 记录每种指令、每条指令（按指令索引）的执行次数，以及每种系统调用的次数和耗时。
+    /// 虚拟机只在开启分析时才调用它，所以关闭时几乎没有开销。
+    class Profiler
+    {
+    public:
+        /// @brief 一个热点（按执行次数排序后的一条指令）
+        struct HotSpot
+        {
+            /// @brief 指令索引
+            size_t index;
+            /// @brief 执行次数
+            uint64_t count;
+        };
+
+    private:
+        /// @brief 每种指令的执行次数
+        std::array<uint64_t, CommandEnum::Command::CMDCOUNT> m_opcode_counts{};
+        /// @brief 每条指令的执行次数
+        std::vector<uint64_t> m_pc_counts;
+        /// @brief 每种系统调用的次数
+        std::array<uint64_t, CommandEnum::SystemCallNumber::SCCOUNT> m_syscall_counts{};
+        /// @brief 每种系统调用的总耗时（纳秒）
+        std::array<uint64_t, CommandEnum::SystemCallNumber::SCCOUNT> m_syscall_nanoseconds{};
+        /// @brief 执行的指令总数
+        uint64_t m_total = 0;
+
+    public:
+        Profiler() {}
+        ~Profiler() {}
+
+    public:
+        /// @brief 清空所有计数
+        /// @param instruction_count 程序的指令条数
+        void reset(size_t instruction_count)
+        {
+            m_opcode_counts.fill(0);
+            m_pc_counts.assign(instruction_count, 0);
+            m_syscall_counts.fill(0);
+            m_syscall_nanoseconds.fill(0);
+            m_total = 0;
+        }
+
+        /// @brief 保证能记录指定条数的指令，已有的计数保留
+        /// @param instruction_count 程序的指令条数
+        void prepare(size_t instruction_count)
+        {
+            if (m_pc_counts.size() < instruction_count)
+                m_pc_counts.resize(instruction_count, 0);
+        }
+
+        /// @brief 记录一条指令的执行
+        /// @param index 指令索引（调用者保证小于reset()时的指令条数）
+        /// @param command 指令名
+        void record_instruction(size_t index, CommandEnum::Command command)
+        {
+            m_pc_counts[index]++;
+            if (command < CommandEnum::Command::CMDCOUNT)
+                m_opcode_counts[command]++;
+            m_total++;
+        }
+
+        /// @brief 记录一次系统调用
+        /// @param number 系统调用号
+        /// @param nanoseconds 耗时（纳秒）
+        void record_syscall(size_t number, uint64_t nanoseconds)
+        {
+            if (number >= CommandEnum::SystemCallNumber::SCCOUNT)
+                return;
+            m_syscall_counts[number]++;
+            m_syscall_nanoseconds[number] += nanoseconds;
+        }
+
+    public:
+        /// @brief 获取某种指令的执行次数
+        uint64_t get_opcode_count(CommandEnum::Command command) const
+        {
+            return m_opcode_counts.at(command);
+        }
+
+        /// @brief 获取某条指令的执行次数
+        uint64_t get_pc_count(size_t index) const
+        {
+            return index < m_pc_counts.size() ? m_pc_counts.at(index) : 0;
+        }
+
+        /// @brief 获取某种系统调用的次数
+        uint64_t get_syscall_count(size_t number) const
+        {
+            return m_syscall_counts.at(number);
+        }
+
+        /// @brief 获取某种系统调用的总耗时（纳秒）
+        uint64_t get_syscall_nanoseconds(size_t number) const
+        {
+            return m_syscall_nanoseconds.at(number);
+        }
+
+        /// @brief 获取执行的指令总数
+        uint64_t get_total() const
+        {
+            return m_total;
+        }
+
+        /// @brief 获取执行次数最多的指令
+        /// @param top 最多返回的条数
+        /// @return 按执行次数从大到小排序的热点
+        std::vector<HotSpot> get_hot_spots(size_t top) const
+        {
+            std::vector<HotSpot> result;
+            for (size_t i = 0; i < m_pc_counts.size(); i++)
+            {
+                if (m_pc_counts.at(i) > 0)
+                    result.push_back({i, m_pc_counts.at(i)});
+            }
+            std::stable_sort(result.begin(), result.end(), [](const HotSpot &a, const HotSpot &b)
+                             { return a.count > b.count; });
+            if (result.size() > top)
+                result.resize(top);
+            return result;
+        }
+
+    public:
+        /// @brief 输出文本报告
+        /// @param out 输出流
+        /// @param instructions 程序的指令，用于反汇编热点
+        /// @param top 热点条数
+        template <typename WordT>
+        void print_report(std::ostream &out, const std::vector<BasicInstruction<WordT>> &instructions, size_t top = 10) const
+        {
+            out << "Instructions executed:" << m_total << std::endl;
+
+            out << std::endl
+                << std::left << std::setw(12) << "Opcode" << std::right << std::setw(14) << "Count" << std::setw(9) << "%" << std::endl;
+            for (size_t i = 0; i < m_opcode_counts.size(); i++)
+            {
+                if (m_opcode_counts.at(i) == 0)
+                    continue;
+                out << std::left << std::setw(12) << command_name_list.at(i) << std::right << std::setw(14) << m_opcode_counts.at(i)
+                    << std::setw(9) << std::fixed << std::setprecision(2) << percent(m_opcode_counts.at(i)) << std::endl;
+            }
+
+            out << std::endl
+                << std::left << std::setw(14) << "Syscall" << std::right << std::setw(12) << "Count" << std::setw(14) << "Total(us)" << std::setw(12) << "Avg(ns)" << std::endl;
+            for (size_t i = 0; i < m_syscall_counts.size(); i++)
+            {
+                if (m_syscall_counts.at(i) == 0)
+                    continue;
+                out << std::left << std::setw(14) << syscall_name_list.at(i) << std::right << std::setw(12) << m_syscall_counts.at(i)
+                    << std::setw(14) << std::fixed << std::setprecision(1) << m_syscall_nanoseconds.at(i) / 1000.0
+                    << std::setw(12) << m_syscall_nanoseconds.at(i) / m_syscall_counts.at(i) << std::endl;
+            }
+
+            out << std::endl
+                << std::right << std::setw(8) << "Index" << std::setw(14) << "Count" << std::setw(9) << "%" << "  " << "Instruction" << std::endl;
+            std::vector<HotSpot> hot_spots = get_hot_spots(top);
+            for (size_t i = 0; i < hot_spots.size(); i++)
+            {
+                const HotSpot &spot = hot_spots.at(i);
+                out << std::right << std::setw(8) << spot.index << std::setw(14) << spot.count
+                    << std::setw(9) << std::fixed << std::setprecision(2) << percent(spot.count) << "  "
+                    << (spot.index < instructions.size() ? disassemble(instructions.at(spot.index)) : "?") << std::endl;
+            }
+        }
+
+        /// @brief 输出JSON报告
+        /// @param out 输出流
+        /// @param instructions 程序的指令，用于反汇编热点
+        /// @param top 热点条数
+        template <typename WordT>
+        void write_json(std::ostream &out, const std::vector<BasicInstruction<WordT>> &instructions, size_t top = 10) const
+        {
+            out << "{\"total\":" << m_total << ",\"opcodes\":{";
+            const char *separator = "";
+            for (size_t i = 0; i < m_opcode_counts.size(); i++)
+            {
+                if (m_opcode_counts.at(i) == 0)
+                    continue;
+                out << separator << "\"" << command_name_list.at(i) << "\":" << m_opcode_counts.at(i);
+                separator = ",";
+            }
+
+            out << "},\"syscalls\":{";
+            separator = "";
+            for (size_t i = 0; i < m_syscall_counts.size(); i++)
+            {
+                if (m_syscall_counts.at(i) == 0)
+                    continue;
+                out << separator << "\"" << syscall_name_list.at(i) << "\":{\"count\":" << m_syscall_counts.at(i)
+                    << ",\"nanoseconds\":" << m_syscall_nanoseconds.at(i) << "}";
+                separator = ",";
+            }
+
+            out << "},\"pc\":[";
+            separator = "";
+            for (size_t i = 0; i < m_pc_counts.size(); i++)
+            {
+                out << separator << m_pc_counts.at(i);
+                separator = ",";
+            }
+
+            out << "],\"hot_spots\":[";
+            separator = "";
+            std::vector<HotSpot> hot_spots = get_hot_spots(top);
+            for (size_t i = 0; i < hot_spots.size(); i++)
+            {
+                const HotSpot &spot = hot_spots.at(i);
+                out << separator << "{\"index\":" << spot.index << ",\"count\":" << spot.count << ",\"instruction\":\""
+                    << (spot.index < instructions.size() ? disassemble(instructions.at(spot.index)) : "?") << "\"}";
+                separator = ",";
+            }
+            out << "]}" << std::endl;
+        }
+
+    private:
+        /// @brief 计算占执行指令总数的百分比
+        double percent(uint64_t count) const
+        {
+            return m_total == 0 ? 0.0 : 100.0 * count / m_total;
+        }
+    };
+} // namespace svm
+
+#endif
@@ -0,0 +1,427 @@
+#ifndef __SIMPLE_SIMD_HPP__
+#define __SIMPLE_SIMD_HPP__
+
+#include <cstring>
+#include <type_traits>
+#include "SimpleInst.hpp"
+
+// x86上提供SSE2/AVX2版本的批量内存操作，运行时根据CPU特性选择，其余平台只有标量版本
+#if defined(__x86_64__) || defined(_M_X64)
+#define SVM_SIMD_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define SVM_TARGET_AVX2
+#else
+#define SVM_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#else
+#define SVM_SIMD_X86 0
+#endif
+
+namespace svm
+{
+    /// @brief 批量内存操作的实现
+    /// 所有函数都以机器字为单位，调用者负责保证范围合法
+    /// @tparam WordT 机器字类型
+    template <typename WordT>
+    struct BasicBulkKernels
+    {
+        /// @brief 实现的名称
+        const char *name;
+        /// @brief 把count个机器字设为value
+        void (*fill)(WordT *dst, WordT value, size_t count);
+        /// @brief 返回第一个不相等的位置，全部相等时返回count
+        size_t (*mismatch)(const WordT *a, const WordT *b, size_t count);
+        /// @brief 返回第一个0的位置，没有时返回count
+        size_t (*find_zero)(const WordT *src, size_t count);
+    };
+
+    using BulkKernels = BasicBulkKernels<DWORD64>;
+    using BulkKernels32 = BasicBulkKernels<DWORD32>;
+
+    namespace simd
+    {
+        template <typename WordT>
+        inline void fill_scalar(WordT *dst, WordT value, size_t count)
+        {
+            for (size_t i = 0; i < count; i++)
+                dst[i] = value;
+        }
+
+        template <typename WordT>
+        inline size_t mismatch_scalar(const WordT *a, const WordT *b, size_t count)
+        {
+            size_t i = 0;
+            while (i < count && a[i] == b[i])
+                i++;
+            return i;
+        }
+
+        template <typename WordT>
+        inline size_t find_zero_scalar(const WordT *src, size_t count)
+        {
+            size_t i = 0;
+            while (i < count && src[i] != 0)
+                i++;
+            return i;
+        }
+
+#if SVM_SIMD_X86
+        /// @brief 不同宽度机器字的向量指令
+        template <typename WordT>
+        struct SIMDTraits;
+
+        template <>
+        struct SIMDTraits<DWORD64>
+        {
+            static __m128i set1_128(DWORD64 value) { return _mm_set1_epi64x((long long)value); }
+            SVM_TARGET_AVX2 static __m256i set1_256(DWORD64 value) { return _mm256_set1_epi64x((long long)value); }
+            SVM_TARGET_AVX2 static __m256i cmpeq_256(__m256i a, __m256i b) { return _mm256_cmpeq_epi64(a, b); }
+        };
+
+        template <>
+        struct SIMDTraits<DWORD32>
+        {
+            static __m128i set1_128(DWORD32 value) { return _mm_set1_epi32((int)value); }
+            SVM_TARGET_AVX2 static __m256i set1_256(DWORD32 value) { return _mm256_set1_epi32((int)value); }
+            SVM_TARGET_AVX2 static __m256i cmpeq_256(__m256i a, __m256i b) { return _mm256_cmpeq_epi32(a, b); }
+        };
+
+        /// @brief 判断按字节的比较掩码中是否有一整个机器字都为1
+        /// @param mask _mm_movemask_epi8的结果
+        /// @param lanes 通道数
+        template <typename WordT>
+        inline bool has_full_lane(unsigned mask, size_t lanes)
+        {
+            const unsigned lane_mask = (1u << sizeof(WordT)) - 1;
+            for (size_t i = 0; i < lanes; i++)
+            {
+                if (((mask >> (i * sizeof(WordT))) & lane_mask) == lane_mask)
+                    return true;
+            }
+            return false;
+        }
+
+        template <typename WordT>
+        inline void fill_sse2(WordT *dst, WordT value, size_t count)
+        {
+            const size_t lanes = 16 / sizeof(WordT);
+            const __m128i v = SIMDTraits<WordT>::set1_128(value);
+            size_t i = 0;
+            for (; i + lanes <= count; i += lanes)
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), v);
+            fill_scalar(dst + i, value, count - i);
+        }
+
+        template <typename WordT>
+        inline size_t mismatch_sse2(const WordT *a, const WordT *b, size_t count)
+        {
+            const size_t lanes = 16 / sizeof(WordT);
+            size_t i = 0;
+            for (; i + lanes <= count; i += lanes)
+            {
+                __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i));
+                __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i));
+                // SSE2没有64位比较，用32位比较代替，所有字节都相等才算相等
+                if (_mm_movemask_epi8(_mm_cmpeq_epi32(x, y)) != 0xFFFF)
+                    break;
+            }
+            return i + mismatch_scalar(a + i, b + i, count - i);
+        }
+
+        template <typename WordT>
+        inline size_t find_zero_sse2(const WordT *src, size_t count)
+        {
+            const size_t lanes = 16 / sizeof(WordT);
+            const __m128i zero = _mm_setzero_si128();
+            size_t i = 0;
+            for (; i + lanes <= count; i += lanes)
+            {
+                __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+                // 一个机器字对应的所有字节都为0才是0
+                if (has_full_lane<WordT>(unsigned(_mm_movemask_epi8(_mm_cmpeq_epi32(x, zero))), lanes))
+                    break;
+            }
+            return i + find_zero_scalar(src + i, count - i);
+        }
+
+        template <typename WordT>
+        SVM_TARGET_AVX2 inline void fill_avx2(WordT *dst, WordT value, size_t count)
+        {
+            const size_t lanes = 32 / sizeof(WordT);
+            const __m256i v = SIMDTraits<WordT>::set1_256(value);
+            size_t i = 0;
+            for (; i + 2 * lanes <= count; i += 2 * lanes)
+            {
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), v);
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i + lanes), v);
+            }
+            for (; i < count; i++)
+                dst[i] = value;
+        }
+
+        template <typename WordT>
+        SVM_TARGET_AVX2 inline size_t mismatch_avx2(const WordT *a, const WordT *b, size_t count)
+        {
+            const size_t lanes = 32 / sizeof(WordT);
+            size_t i = 0;
+            for (; i + lanes <= count; i += lanes)
+            {
+                __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + i));
+                __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + i));
+                if (unsigned(_mm256_movemask_epi8(SIMDTraits<WordT>::cmpeq_256(x, y))) != 0xFFFFFFFFu)
+                    break;
+            }
+            for (; i < count && a[i] == b[i]; i++)
+                ;
+            return i;
+        }
+
+        template <typename WordT>
+        SVM_TARGET_AVX2 inline size_t find_zero_avx2(const WordT *src, size_t count)
+        {
+            const size_t lanes = 32 / sizeof(WordT);
+            const __m256i zero = _mm256_setzero_si256();
+            size_t i = 0;
+            for (; i + lanes <= count; i += lanes)
+            {
+                __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+                if (_mm256_movemask_epi8(SIMDTraits<WordT>::cmpeq_256(x, zero)) != 0)
+                    break;
+            }
+            for (; i < count && src[i] != 0; i++)
+                ;
+            return i;
+        }
+
+        /// @brief 判断CPU（和操作系统）是否支持AVX2
+        inline bool cpu_supports_avx2()
+        {
+#if defined(_MSC_VER)
+            int info[4];
+            __cpuid(info, 0);
+            if (info[0] < 7)
+                return false;
+            __cpuid(info, 1);
+            // OSXSAVE和AVX，并且操作系统保存了YMM寄存器
+            if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0 || (_xgetbv(0) & 0x6) != 0x6)
+                return false;
+            __cpuidex(info, 7, 0);
+            return (info[1] & (1 << 5)) != 0;
+#else
+            return __builtin_cpu_supports("avx2");
+#endif
+        }
+#endif
+    } // namespace simd
+
+    /// @brief 向量寄存器的宽度（字节），对应AVX2的256位
+    static const size_t VECTOR_BYTES = 32;
+
+    /// @brief 向量寄存器的值
+    /// @tparam WordT 机器字类型，决定通道的宽度
+    template <typename WordT>
+    struct alignas(VECTOR_BYTES) BasicVectorValue
+    {
+        /// @brief 每个向量寄存器的通道数
+        static const size_t LANES = VECTOR_BYTES / sizeof(WordT);
+
+        /// @brief 各通道的值
+        WordT lanes[LANES];
+    };
+
+    using VectorValue = BasicVectorValue<DWORD64>;
+    using VectorValue32 = BasicVectorValue<DWORD32>;
+
+    // 向量运算
+    // 每条指令只处理一个寄存器，运行时选择实现的间接调用比运算本身还贵，
+    // 所以这里按编译目标选择：开启AVX2编译时用256位指令，否则用SSE2（x86-64一定支持）或标量循环。
+    // 各通道按有符号数比较。
+    namespace simd
+    {
+        template <typename WordT>
+        using SignedWord = typename std::make_signed<WordT>::type;
+
+        template <typename WordT>
+        inline void vector_add(BasicVectorValue<WordT> &d, const BasicVectorValue<WordT> &a, const BasicVectorValue<WordT> &b)
+        {
+            for (size_t i = 0; i < BasicVectorValue<WordT>::LANES; i++)
+                d.lanes[i] = a.lanes[i] + b.lanes[i];
+        }
+
+        template <typename WordT>
+        inline void vector_sub(BasicVectorValue<WordT> &d, const BasicVectorValue<WordT> &a, const BasicVectorValue<WordT> &b)
+        {
+            for (size_t i = 0; i < BasicVectorValue<WordT>::LANES; i++)
+                d.lanes[i] = a.lanes[i] - b.lanes[i];
+        }
+
+        template <typename WordT>
+        inline void vector_mul(BasicVectorValue<WordT> &d, const BasicVectorValue<WordT> &a, const BasicVectorValue<WordT> &b)
+        {
+            for (size_t i = 0; i < BasicVectorValue<WordT>::LANES; i++)
+                d.lanes[i] = a.lanes[i] * b.lanes[i];
+        }
+
+        template <typename WordT>
+        inline void vector_cmpeq(BasicVectorValue<WordT> &d, const BasicVectorValue<WordT> &a, const BasicVectorValue<WordT> &b)
+        {
+            for (size_t i = 0; i < BasicVectorValue<WordT>::LANES; i++)
+                d.lanes[i] = a.lanes[i] == b.lanes[i] ? ~WordT(0) : 0;
+        }
+
+        template <typename WordT>
+        inline void vector_cmpgt(BasicVectorValue<WordT> &d, const BasicVectorValue<WordT> &a, const BasicVectorValue<WordT> &b)
+        {
+            for (size_t i = 0; i < BasicVectorValue<WordT>::LANES; i++)
+                d.lanes[i] = SignedWord<WordT>(a.lanes[i]) > SignedWord<WordT>(b.lanes[i]) ? ~WordT(0) : 0;
+        }
+
+        template <typename WordT>
+        inline void vector_min(BasicVectorValue<WordT> &d, const BasicVectorValue<WordT> &a, const BasicVectorValue<WordT> &b)
+        {
+            for (size_t i = 0; i < BasicVectorValue<WordT>::LANES; i++)
+                d.lanes[i] = SignedWord<WordT>(a.lanes[i]) < SignedWord<WordT>(b.lanes[i]) ? a.lanes[i] : b.lanes[i];
+        }
+
+        template <typename WordT>
+        inline void vector_max(BasicVectorValue<WordT> &d, const BasicVectorValue<WordT> &a, const BasicVectorValue<WordT> &b)
+        {
+            for (size_t i = 0; i < BasicVectorValue<WordT>::LANES; i++)
+                d.lanes[i] = SignedWord<WordT>(a.lanes[i]) > SignedWord<WordT>(b.lanes[i]) ? a.lanes[i] : b.lanes[i];
+        }
+
+#if SVM_SIMD_X86 && defined(__AVX2__)
+        inline __m256i vload(const void *v) { return _mm256_load_si256(static_cast<const __m256i *>(v)); }
+        inline void vstore(void *v, __m256i x) { _mm256_store_si256(static_cast<__m256i *>(v), x); }
+
+        template <>
+        inline void vector_add<DWORD64>(VectorValue &d, const VectorValue &a, const VectorValue &b) { vstore(d.lanes, _mm256_add_epi64(vload(a.lanes), vload(b.lanes))); }
+        template <>
+        inline void vector_sub<DWORD64>(VectorValue &d, const VectorValue &a, const VectorValue &b) { vstore(d.lanes, _mm256_sub_epi64(vload(a.lanes), vload(b.lanes))); }
+        template <>
+        inline void vector_cmpeq<DWORD64>(VectorValue &d, const VectorValue &a, const VectorValue &b) { vstore(d.lanes, _mm256_cmpeq_epi64(vload(a.lanes), vload(b.lanes))); }
+        template <>
+        inline void vector_cmpgt<DWORD64>(VectorValue &d, const VectorValue &a, const VectorValue &b) { vstore(d.lanes, _mm256_cmpgt_epi64(vload(a.lanes), vload(b.lanes))); }
+        // AVX2没有64位的乘法和最值指令，最值用比较加混合代替，乘法用标量循环
+        template <>
+        inline void vector_min<DWORD64>(VectorValue &d, const VectorValue &a, const VectorValue &b)
+        {
+            __m256i x = vload(a.lanes), y = vload(b.lanes);
+            vstore(d.lanes, _mm256_blendv_epi8(x, y, _mm256_cmpgt_epi64(x, y)));
+        }
+        template <>
+        inline void vector_max<DWORD64>(VectorValue &d, const VectorValue &a, const VectorValue &b)
+        {
+            __m256i x = vload(a.lanes), y = vload(b.lanes);
+            vstore(d.lanes, _mm256_blendv_epi8(y, x, _mm256_cmpgt_epi64(x, y)));
+        }
+
+        template <>
+        inline void vector_add<DWORD32>(VectorValue32 &d, const VectorValue32 &a, const VectorValue32 &b) { vstore(d.lanes, _mm256_add_epi32(vload(a.lanes), vload(b.lanes))); }
+        template <>
+        inline void vector_sub<DWORD32>(VectorValue32 &d, const VectorValue32 &a, const VectorValue32 &b) { vstore(d.lanes, _mm256_sub_epi32(vload(a.lanes), vload(b.lanes))); }
+        template <>
+        inline void vector_mul<DWORD32>(VectorValue32 &d, const VectorValue32 &a, const VectorValue32 &b) { vstore(d.lanes, _mm256_mullo_epi32(vload(a.lanes), vload(b.lanes))); }
+        template <>
+        inline void vector_cmpeq<DWORD32>(VectorValue32 &d, const VectorValue32 &a, const VectorValue32 &b) { vstore(d.lanes, _mm256_cmpeq_epi32(vload(a.lanes), vload(b.lanes))); }
+        template <>
+        inline void vector_cmpgt<DWORD32>(VectorValue32 &d, const VectorValue32 &a, const VectorValue32 &b) { vstore(d.lanes, _mm256_cmpgt_epi32(vload(a.lanes), vload(b.lanes))); }
+        template <>
+        inline void vector_min<DWORD32>(VectorValue32 &d, const VectorValue32 &a, const VectorValue32 &b) { vstore(d.lanes, _mm256_min_epi32(vload(a.lanes), vload(b.lanes))); }
+        template <>
+        inline void vector_max<DWORD32>(VectorValue32 &d, const VectorValue32 &a, const VectorValue32 &b) { vstore(d.lanes, _mm256_max_epi32(vload(a.lanes), vload(b.lanes))); }
+#elif SVM_SIMD_X86
+        template <>
+        inline void vector_add<DWORD64>(VectorValue &d, const VectorValue &a, const VectorValue &b)
+        {
+            for (size_t i = 0; i < VectorValue::LANES; i += 2)
+            {
+                __m128i x = _mm_load_si128(reinterpret_cast<const __m128i *>(a.lanes + i));
+                __m128i y = _mm_load_si128(reinterpret_cast<const __m128i *>(b.lanes + i));
+                _mm_store_si128(reinterpret_cast<__m128i *>(d.lanes + i), _mm_add_epi64(x, y));
+            }
+        }
+        template <>
+        inline void vector_sub<DWORD64>(VectorValue &d, const VectorValue &a, const VectorValue &b)
+        {
+            for (size_t i = 0; i < VectorValue::LANES; i += 2)
+            {
+                __m128i x = _mm_load_si128(reinterpret_cast<const __m128i *>(a.lanes + i));
+                __m128i y = _mm_load_si128(reinterpret_cast<const __m128i *>(b.lanes + i));
+                _mm_store_si128(reinterpret_cast<__m128i *>(d.lanes + i), _mm_sub_epi64(x, y));
+            }
+        }
+        template <>
+        inline void vector_add<DWORD32>(VectorValue32 &d, const VectorValue32 &a, const VectorValue32 &b)
+        {
+            for (size_t i = 0; i < VectorValue32::LANES; i += 4)
+            {
+                __m128i x = _mm_load_si128(reinterpret_cast<const __m128i *>(a.lanes + i));
+                __m128i y = _mm_load_si128(reinterpret_cast<const __m128i *>(b.lanes + i));
+                _mm_store_si128(reinterpret_cast<__m128i *>(d.lanes + i), _mm_add_epi32(x, y));
+            }
+        }
+        template <>
+        inline void vector_sub<DWORD32>(VectorValue32 &d, const VectorValue32 &a, const VectorValue32 &b)
+        {
+            for (size_t i = 0; i < VectorValue32::LANES; i += 4)
+            {
+                __m128i x = _mm_load_si128(reinterpret_cast<const __m128i *>(a.lanes + i));
+                __m128i y = _mm_load_si128(reinterpret_cast<const __m128i *>(b.lanes + i));
+                _mm_store_si128(reinterpret_cast<__m128i *>(d.lanes + i), _mm_sub_epi32(x, y));
+            }
+        }
+#endif
+
+        template <typename WordT>
+        inline WordT vector_reduce_add(const BasicVectorValue<WordT> &a)
+        {
+            WordT result = 0;
+            for (size_t i = 0; i < BasicVectorValue<WordT>::LANES; i++)
+                result += a.lanes[i];
+            return result;
+        }
+
+        template <typename WordT>
+        inline WordT vector_reduce_min(const BasicVectorValue<WordT> &a)
+        {
+            WordT result = a.lanes[0];
+            for (size_t i = 1; i < BasicVectorValue<WordT>::LANES; i++)
+                result = SignedWord<WordT>(a.lanes[i]) < SignedWord<WordT>(result) ? a.lanes[i] : result;
+            return result;
+        }
+
+        template <typename WordT>
+        inline WordT vector_reduce_max(const BasicVectorValue<WordT> &a)
+        {
+            WordT result = a.lanes[0];
+            for (size_t i = 1; i < BasicVectorValue<WordT>::LANES; i++)
+                result = SignedWord<WordT>(a.lanes[i]) > SignedWord<WordT>(result) ? a.lanes[i] : result;
+            return result;
+        }
+    } // namespace simd
+
+    /// @brief 获取当前CPU上最快的批量内存操作实现（只检测一次）
+    /// @tparam WordT 机器字类型
+    /// @return 实现的引用
+    template <typename WordT>
+    inline const BasicBulkKernels<WordT> &bulk_kernels()
+    {
+        static const BasicBulkKernels<WordT> kernels = []()
+        {
+#if SVM_SIMD_X86
+            if (simd::cpu_supports_avx2())
+                return BasicBulkKernels<WordT>{"avx2", simd::fill_avx2<WordT>, simd::mismatch_avx2<WordT>, simd::find_zero_avx2<WordT>};
+            // x86-64一定支持SSE2
+            return BasicBulkKernels<WordT>{"sse2", simd::fill_sse2<WordT>, simd::mismatch_sse2<WordT>, simd::find_zero_sse2<WordT>};
+#else
+            return BasicBulkKernels<WordT>{"scalar", simd::fill_scalar<WordT>, simd::mismatch_scalar<WordT>, simd::find_zero_scalar<WordT>};
+#endif
+        }();
+        return kernels;
+    }
+} // namespace svm
+
+#endif
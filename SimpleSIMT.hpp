@@ -0,0 +1,737 @@
+#ifndef __SIMPLE_SIMT_HPP__
+#define __SIMPLE_SIMT_HPP__
+
+#include <array>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <type_traits>
+#include "SimpleVM.hpp"
+
+namespace svm
+{
+    /// @brief 锁步执行的多实例虚拟机（SIMT）
+    /// 同一个程序的lanes个实例（线程）一起执行：寄存器按结构数组存放（每个通用寄存器一个数组，每个元素是一个线程），
+    /// 一条指令对当前组里的所有线程执行一次，所以指令分派的开销被所有线程分摊，整组执行时算术指令可以被编译器向量化。
+    /// 线程跳转方向不同时分成几组，总是先执行指令索引最小的一组（其余的线程停在各自的指令上），
+    /// 这一组追上其他线程时自动合并，结构化的分支和循环结束后就会重新汇合。
+    /// 每个线程有自己的内存（和BasicSimpleVM的地址空间相同，按[地址][线程]存放）、栈、标志和返回地址栈。
+    /// 支持的指令：NOP、HLT、MOVRI、MOVRR、LOAD、STORE、PUSH、POP、CALL、RET、整数运算和比较、跳转，
+    /// 以及EXIT系统调用（不输出，只记下退出码）；其他指令和系统调用让执行它的线程发生ins异常。
+    /// 线程的异常只记录下来，不输出，也不影响其他线程。
+    /// @tparam WordT 机器字类型
+    template <typename WordT>
+    class BasicSIMTVM
+    {
+    public:
+        /// @brief 机器字类型
+        using DWORD = WordT;
+        using Signed = typename std::make_signed<WordT>::type;
+        using Instruction = BasicInstruction<WordT>;
+        using ProgramData = BasicProgramData<WordT>;
+        using ISData = InternalStorageData<WordT>;
+
+        /// @brief 每个线程的内存大小（单位为机器字）
+        static const size_t MEMORY_WORDS = ISData::TOTAL_CAPACITY;
+        /// @brief 表示没有指令索引
+        static const size_t NO_INDEX = SIZE_MAX;
+
+    private:
+        /// @brief 线程数
+        size_t m_lanes;
+        /// @brief 所有线程共享的程序
+        ProgramData m_program_data;
+        /// @brief 通用寄存器，m_registers[寄存器][线程]
+        std::array<std::vector<DWORD>, RegisterEnum::GeneralRegister::GRCOUNT> m_registers;
+        /// @brief 标志：ZF为两者相等，SF为前者（有符号）小于后者；运算指令记为(结果, 0)
+        std::vector<DWORD> m_flag_operand1;
+        std::vector<DWORD> m_flag_operand2;
+        /// @brief 当前组的标志来自这个寄存器中的运算结果（还没有写入标志数组），为NONE时以标志数组为准
+        /// 运算指令只需要写一个数组；分组变化或者这个寄存器被其他指令改写之前才写入标志数组
+        RegisterEnum::GeneralRegister m_flag_register = RegisterEnum::GeneralRegister::NONE;
+        /// @brief 内存，m_memory[地址 * m_lanes + 线程]
+        std::vector<DWORD> m_memory;
+        /// @brief 栈顶索引
+        std::vector<size_t> m_stack_top;
+        /// @brief 返回地址栈的深度
+        std::vector<size_t> m_call_depth;
+        /// @brief 每个调用帧开始时的栈顶，m_frame_base[深度 * m_lanes + 线程]
+        std::vector<size_t> m_frame_base;
+        /// @brief 不在当前组里的线程停在的指令索引
+        std::vector<size_t> m_index;
+        /// @brief 线程是否还在运行（没有退出，也没有发生异常）
+        std::vector<uint8_t> m_running;
+        /// @brief 线程是否在当前组里
+        std::vector<uint8_t> m_mask;
+        /// @brief 当前组（不是所有线程时）里的线程，发生异常或退出的线程仍然留在这里，但m_mask为0
+        std::vector<size_t> m_group_lanes;
+        /// @brief 线程的异常
+        std::vector<ExceptionEnum::Exception> m_exceptions;
+        /// @brief 线程的退出码（EXIT时的BX）
+        std::vector<DWORD> m_exit_codes;
+
+        /// @brief 当前组执行的指令索引
+        size_t m_group_index = 0;
+        /// @brief 当前组的线程数
+        size_t m_group_count = 0;
+        /// @brief 其他线程中最小的指令索引，当前组到达这里时要合并
+        size_t m_next_index = NO_INDEX;
+        /// @brief 所有线程执行过的指令总数
+        uint64_t m_retired_instructions = 0;
+        /// @brief 发出的指令数（每组执行一条指令算一次）
+        uint64_t m_issued_instructions = 0;
+        /// @brief 重新分组的次数
+        uint64_t m_regroups = 0;
+
+    public:
+        /// @brief 构造函数
+        /// @param lanes 线程数
+        BasicSIMTVM(size_t lanes) : m_lanes(std::max<size_t>(lanes, 1))
+        {
+            reset();
+        }
+
+        ~BasicSIMTVM() {}
+
+    public:
+        /// @brief 加载程序：每个线程的数据段都写入一份，寄存器和栈清零，所有线程从第0条指令开始
+        /// 加载后再用get_register()/get_registers()/memory()设置每个线程的输入
+        /// @param program_data 程序
+        virtual void load_program(const ProgramData &program_data)
+        {
+            reset();
+            m_program_data = program_data;
+            const size_t words = std::min(program_data.data.size(), MEMORY_WORDS);
+            for (size_t address = 0; address < words; address++)
+                std::fill_n(m_memory.begin() + address * m_lanes, m_lanes, program_data.data.at(address));
+        }
+
+        /// @brief 重置所有线程和程序
+        virtual void reset()
+        {
+            m_program_data = ProgramData();
+            for (size_t reg = 0; reg < m_registers.size(); reg++)
+                m_registers.at(reg).assign(m_lanes, 0);
+            // 和BasicSimpleVM一样，开始时ZF和SF都为0
+            m_flag_operand1.assign(m_lanes, 1);
+            m_flag_operand2.assign(m_lanes, 0);
+            m_flag_register = RegisterEnum::GeneralRegister::NONE;
+            m_memory.assign(MEMORY_WORDS * m_lanes, 0);
+            m_stack_top.assign(m_lanes, 0);
+            m_call_depth.assign(m_lanes, 0);
+            m_frame_base.assign(ISData::STACK_CAPACITY * m_lanes, 0);
+            m_index.assign(m_lanes, 0);
+            m_running.assign(m_lanes, 1);
+            m_mask.assign(m_lanes, 1);
+            m_group_lanes.clear();
+            m_exceptions.assign(m_lanes, ExceptionEnum::Exception::AOK);
+            m_exit_codes.assign(m_lanes, 0);
+            m_group_index = 0;
+            m_group_count = m_lanes;
+            m_next_index = NO_INDEX;
+            m_retired_instructions = 0;
+            m_issued_instructions = 0;
+            m_regroups = 0;
+        }
+
+        /// @brief 运行所有线程，直到它们都退出或发生异常
+        virtual void run()
+        {
+            while (true)
+            {
+                // 当前组追上（或越过）了其他线程，或者全部结束了
+                if (m_group_count == 0 || m_group_index >= m_next_index)
+                {
+                    park_group();
+                    if (!regroup())
+                        break;
+                }
+
+                if (m_group_index >= m_program_data.instructions.size())
+                {
+                    // 越界时触发ADR异常
+                    for_group([this](size_t lane)
+                              { fault(lane, ExceptionEnum::Exception::ADR); });
+                    continue;
+                }
+
+                const Instruction &inst = m_program_data.instructions[m_group_index];
+                m_issued_instructions++;
+                m_retired_instructions += m_group_count;
+                // 跳转指令会改写下一条指令的索引
+                m_group_index++;
+                execute(inst);
+            }
+        }
+
+    public:
+        /// @brief 获取线程数
+        size_t get_lane_count() const
+        {
+            return m_lanes;
+        }
+
+        /// @brief 获取某个线程的通用寄存器
+        /// @param lane 线程
+        /// @param reg 寄存器
+        /// @return 寄存器的引用
+        DWORD &get_register(size_t lane, RegisterEnum::GeneralRegister reg)
+        {
+            return m_registers.at(reg).at(lane);
+        }
+
+        /// @brief 获取所有线程的某个通用寄存器，适合批量设置输入和读取结果
+        /// @param reg 寄存器
+        /// @return 按线程排列的数组
+        std::vector<DWORD> &get_registers(RegisterEnum::GeneralRegister reg)
+        {
+            return m_registers.at(reg);
+        }
+
+        /// @brief 访问某个线程的内存
+        /// @param lane 线程
+        /// @param address 地址（单位为机器字，和LOAD/STORE的地址相同）
+        /// @return 内存单元的引用
+        DWORD &memory(size_t lane, size_t address)
+        {
+            return m_memory.at(address * m_lanes + lane);
+        }
+
+        /// @brief 获取某个线程的异常，正常退出时为AOK
+        ExceptionEnum::Exception get_exception(size_t lane) const
+        {
+            return m_exceptions.at(lane);
+        }
+
+        /// @brief 获取某个线程的退出码
+        DWORD get_exit_code(size_t lane) const
+        {
+            return m_exit_codes.at(lane);
+        }
+
+        /// @brief 获取所有线程执行过的指令总数
+        uint64_t get_retired_instructions() const
+        {
+            return m_retired_instructions;
+        }
+
+        /// @brief 获取发出的指令数，get_retired_instructions() / (get_issued_instructions() * 线程数)就是锁步的效率
+        uint64_t get_issued_instructions() const
+        {
+            return m_issued_instructions;
+        }
+
+        /// @brief 获取重新分组的次数
+        uint64_t get_regroups() const
+        {
+            return m_regroups;
+        }
+
+    private:
+        /// @brief 对当前组的每个线程调用f
+        /// 整组执行时没有掩码判断，简单的循环体可以被向量化；分组后只遍历组里的线程，代价和组的大小成正比
+        /// @param f 参数为线程编号
+        template <typename Function>
+        void for_group(Function f)
+        {
+            const size_t lanes = m_lanes;
+            if (m_group_count == lanes)
+            {
+                for (size_t lane = 0; lane < lanes; lane++)
+                    f(lane);
+                return;
+            }
+            const uint8_t *mask = m_mask.data();
+            const size_t *members = m_group_lanes.data();
+            const size_t count = m_group_lanes.size();
+            for (size_t i = 0; i < count; i++)
+            {
+                if (mask[members[i]])
+                    f(members[i]);
+            }
+        }
+
+        /// @brief 线程发生异常，离开当前组并停止
+        void fault(size_t lane, ExceptionEnum::Exception exception)
+        {
+            m_exceptions[lane] = exception;
+            finish(lane);
+        }
+
+        /// @brief 线程结束，离开当前组
+        void finish(size_t lane)
+        {
+            // 整组执行时m_group_lanes没有内容，第一个离开的线程把所有线程补进去，for_group()之后按它遍历
+            if (m_group_count == m_lanes)
+            {
+                m_group_lanes.resize(m_lanes);
+                for (size_t i = 0; i < m_lanes; i++)
+                    m_group_lanes[i] = i;
+            }
+            m_running[lane] = 0;
+            m_mask[lane] = 0;
+            m_group_count--;
+        }
+
+        /// @brief 当前组的线程停在当前组的指令上
+        void park_group()
+        {
+            for_group([this](size_t lane)
+                      { m_index[lane] = m_group_index; });
+        }
+
+        /// @brief 把停在最小指令索引上的线程作为新的当前组
+        /// @return 是否还有线程在运行
+        bool regroup()
+        {
+            materialize_flags();
+            size_t first = NO_INDEX;
+            for (size_t lane = 0; lane < m_lanes; lane++)
+            {
+                if (m_running[lane])
+                    first = std::min(first, m_index[lane]);
+            }
+            if (first == NO_INDEX)
+            {
+                m_group_count = 0;
+                return false;
+            }
+
+            size_t next = NO_INDEX;
+            m_group_lanes.clear();
+            for (size_t lane = 0; lane < m_lanes; lane++)
+            {
+                const bool member = m_running[lane] && m_index[lane] == first;
+                m_mask[lane] = member;
+                if (member)
+                    m_group_lanes.push_back(lane);
+                else if (m_running[lane])
+                    next = std::min(next, m_index[lane]);
+            }
+            const size_t count = m_group_lanes.size();
+            m_group_index = first;
+            m_group_count = count;
+            m_next_index = next;
+            m_regroups++;
+            return true;
+        }
+
+        /// @brief 把当前组的标志写入标志数组
+        void materialize_flags()
+        {
+            if (m_flag_register == RegisterEnum::GeneralRegister::NONE)
+                return;
+            const DWORD *result = m_registers[m_flag_register].data();
+            DWORD *flag1 = m_flag_operand1.data();
+            DWORD *flag2 = m_flag_operand2.data();
+            for_group([=](size_t lane)
+                      {
+                          flag1[lane] = result[lane];
+                          flag2[lane] = 0; });
+            m_flag_register = RegisterEnum::GeneralRegister::NONE;
+        }
+
+        /// @brief 不影响标志的指令改写寄存器之前调用，保住来自这个寄存器的标志
+        void protect_flags(RegisterEnum::GeneralRegister reg)
+        {
+            if (reg == m_flag_register)
+                materialize_flags();
+        }
+
+        /// @brief 当前组的线程已经在m_index中写好了各自的下一条指令：都相同时继续作为一组，否则重新分组
+        void diverge()
+        {
+            if (m_group_count == 0)
+                return;
+            size_t target = NO_INDEX;
+            bool uniform = true;
+            for_group([&](size_t lane)
+                      {
+                          if (target == NO_INDEX)
+                              target = m_index[lane];
+                          else if (m_index[lane] != target)
+                              uniform = false; });
+            if (uniform)
+                m_group_index = target;
+            else
+                regroup();
+        }
+
+        /// @brief 对当前组执行一条指令
+        /// @param inst 要执行的指令
+        void execute(const Instruction &inst)
+        {
+            using CommandEnum::Command;
+
+            switch (inst.command)
+            {
+            case Command::NOP:
+                break;
+
+            case Command::HLT:
+                for_group([this](size_t lane)
+                          { fault(lane, ExceptionEnum::Exception::HLT); });
+                break;
+
+            case Command::MOVRI:
+            {
+                protect_flags(inst.register1);
+                DWORD *destination = m_registers[inst.register1].data();
+                const DWORD value = inst.operand1;
+                for_group([=](size_t lane)
+                          { destination[lane] = value; });
+                break;
+            }
+
+            case Command::MOVRR:
+            {
+                protect_flags(inst.register1);
+                DWORD *destination = m_registers[inst.register1].data();
+                const DWORD *source = m_registers[inst.register2].data();
+                for_group([=](size_t lane)
+                          { destination[lane] = source[lane]; });
+                break;
+            }
+
+            case Command::LOAD:
+            case Command::STORE:
+                inst_memory(inst);
+                break;
+
+            case Command::PUSH:
+            case Command::POP:
+                inst_stack(inst);
+                break;
+
+            case Command::CALL:
+            case Command::RET:
+                inst_call(inst);
+                break;
+
+            case Command::ADDRRR:
+                alu(inst, [](DWORD a, DWORD b)
+                    { return a + b; });
+                break;
+            case Command::ADDRRI:
+                alu_immediate(inst, [](DWORD a, DWORD b)
+                              { return a + b; });
+                break;
+            case Command::SUBRRR:
+                alu(inst, [](DWORD a, DWORD b)
+                    { return a - b; });
+                break;
+            case Command::SUBRRI:
+                alu_immediate(inst, [](DWORD a, DWORD b)
+                              { return a - b; });
+                break;
+            case Command::MULRRR:
+                alu(inst, [](DWORD a, DWORD b)
+                    { return a * b; });
+                break;
+            case Command::MULRRI:
+                alu_immediate(inst, [](DWORD a, DWORD b)
+                              { return a * b; });
+                break;
+            case Command::DIVRRR:
+            case Command::DIVRRI:
+                inst_div(inst);
+                break;
+            case Command::ANDRRR:
+                alu(inst, [](DWORD a, DWORD b)
+                    { return a & b; });
+                break;
+            case Command::ANDRRI:
+                alu_immediate(inst, [](DWORD a, DWORD b)
+                              { return a & b; });
+                break;
+            case Command::ORRRR:
+                alu(inst, [](DWORD a, DWORD b)
+                    { return a | b; });
+                break;
+            case Command::ORRRI:
+                alu_immediate(inst, [](DWORD a, DWORD b)
+                              { return a | b; });
+                break;
+            case Command::XORRRR:
+                alu(inst, [](DWORD a, DWORD b)
+                    { return a ^ b; });
+                break;
+            case Command::XORRRI:
+                alu_immediate(inst, [](DWORD a, DWORD b)
+                              { return a ^ b; });
+                break;
+            // 移位数只取低位，和BasicSimpleVM相同
+            case Command::SHLRRR:
+                alu(inst, [](DWORD a, DWORD b)
+                    { return DWORD(a << (b & (sizeof(DWORD) * 8 - 1))); });
+                break;
+            case Command::SHLRRI:
+                alu_immediate(inst, [](DWORD a, DWORD b)
+                              { return DWORD(a << (b & (sizeof(DWORD) * 8 - 1))); });
+                break;
+            case Command::SHRRRR:
+                alu(inst, [](DWORD a, DWORD b)
+                    { return DWORD(a >> (b & (sizeof(DWORD) * 8 - 1))); });
+                break;
+            case Command::SHRRRI:
+                alu_immediate(inst, [](DWORD a, DWORD b)
+                              { return DWORD(a >> (b & (sizeof(DWORD) * 8 - 1))); });
+                break;
+
+            case Command::CMPRR:
+            case Command::CMPRI:
+                inst_compare(inst);
+                break;
+
+            case Command::JMP:
+                m_group_index = inst.operand1;
+                break;
+            case Command::JE:
+                branch(inst, [](DWORD a, DWORD b)
+                       { return a == b; });
+                break;
+            case Command::JNE:
+                branch(inst, [](DWORD a, DWORD b)
+                       { return a != b; });
+                break;
+            case Command::JL:
+                branch(inst, [](DWORD a, DWORD b)
+                       { return Signed(a) < Signed(b); });
+                break;
+            case Command::JGE:
+                branch(inst, [](DWORD a, DWORD b)
+                       { return Signed(a) >= Signed(b); });
+                break;
+            case Command::JG:
+                branch(inst, [](DWORD a, DWORD b)
+                       { return Signed(a) > Signed(b); });
+                break;
+            case Command::JLE:
+                branch(inst, [](DWORD a, DWORD b)
+                       { return Signed(a) <= Signed(b); });
+                break;
+
+            case Command::SYSCALL:
+                system_call();
+                break;
+
+            default:
+                for_group([this](size_t lane)
+                          { fault(lane, ExceptionEnum::Exception::INS); });
+                break;
+            }
+        }
+
+        /// @brief 执行寄存器和寄存器的运算，标志来自结果
+        template <typename Operation>
+        void alu(const Instruction &inst, Operation operation)
+        {
+            DWORD *destination = m_registers[inst.register1].data();
+            const DWORD *lhs = m_registers[inst.register2].data();
+            const DWORD *rhs = m_registers[inst.register3].data();
+            for_group([=](size_t lane)
+                      { destination[lane] = operation(lhs[lane], rhs[lane]); });
+            m_flag_register = inst.register1;
+        }
+
+        /// @brief 执行寄存器和立即数的运算，标志来自结果
+        template <typename Operation>
+        void alu_immediate(const Instruction &inst, Operation operation)
+        {
+            DWORD *destination = m_registers[inst.register1].data();
+            const DWORD *lhs = m_registers[inst.register2].data();
+            const DWORD rhs = inst.operand1;
+            for_group([=](size_t lane)
+                      { destination[lane] = operation(lhs[lane], rhs); });
+            m_flag_register = inst.register1;
+        }
+
+        /// @brief 执行除法，除数为0的线程发生div异常
+        void inst_div(const Instruction &inst)
+        {
+            DWORD *destination = m_registers[inst.register1].data();
+            const DWORD *lhs = m_registers[inst.register2].data();
+            const DWORD *rhs = inst.command == CommandEnum::Command::DIVRRR ? m_registers[inst.register3].data() : nullptr;
+            for_group([&](size_t lane)
+                      {
+                          const DWORD divisor = rhs != nullptr ? rhs[lane] : inst.operand1;
+                          if (divisor == 0)
+                          {
+                              fault(lane, ExceptionEnum::Exception::DIV);
+                              return;
+                          }
+                          destination[lane] = lhs[lane] / divisor; });
+            m_flag_register = inst.register1;
+        }
+
+        /// @brief 执行比较指令
+        void inst_compare(const Instruction &inst)
+        {
+            const DWORD *lhs = m_registers[inst.register1].data();
+            const DWORD *rhs = inst.command == CommandEnum::Command::CMPRR ? m_registers[inst.register2].data() : nullptr;
+            DWORD *flag1 = m_flag_operand1.data();
+            DWORD *flag2 = m_flag_operand2.data();
+            m_flag_register = RegisterEnum::GeneralRegister::NONE;
+            if (rhs == nullptr)
+            {
+                const DWORD value = inst.operand1;
+                for_group([=](size_t lane)
+                          {
+                              flag1[lane] = lhs[lane];
+                              flag2[lane] = value; });
+                return;
+            }
+            for_group([=](size_t lane)
+                      {
+                          flag1[lane] = lhs[lane];
+                          flag2[lane] = rhs[lane]; });
+        }
+
+        /// @brief 执行条件跳转，各线程方向不同时分组
+        /// @param condition 参数为两个标志操作数，返回是否跳转
+        template <typename Condition>
+        void branch(const Instruction &inst, Condition condition)
+        {
+            size_t *index = m_index.data();
+            const size_t target = inst.operand1;
+            const size_t next = m_group_index;
+            size_t taken = 0;
+            if (m_flag_register != RegisterEnum::GeneralRegister::NONE)
+            {
+                const DWORD *result = m_registers[m_flag_register].data();
+                for_group([&](size_t lane)
+                          {
+                              const bool jump = condition(result[lane], 0);
+                              index[lane] = jump ? target : next;
+                              taken += jump; });
+            }
+            else
+            {
+                const DWORD *flag1 = m_flag_operand1.data();
+                const DWORD *flag2 = m_flag_operand2.data();
+                for_group([&](size_t lane)
+                          {
+                              const bool jump = condition(flag1[lane], flag2[lane]);
+                              index[lane] = jump ? target : next;
+                              taken += jump; });
+            }
+
+            if (taken == m_group_count)
+                m_group_index = target;
+            else if (taken != 0)
+                regroup();
+        }
+
+        /// @brief 执行LOAD/STORE，地址越界的线程发生adr异常
+        void inst_memory(const Instruction &inst)
+        {
+            DWORD *value = m_registers[inst.register1].data();
+            const DWORD *base = m_registers[inst.register2].data();
+            const DWORD offset = inst.operand1;
+            const bool load = inst.command == CommandEnum::Command::LOAD;
+            if (load)
+                protect_flags(inst.register1);
+            for_group([&](size_t lane)
+                      {
+                          const DWORD address = base[lane] + offset;
+                          if (address >= MEMORY_WORDS)
+                          {
+                              fault(lane, ExceptionEnum::Exception::ADR);
+                              return;
+                          }
+                          DWORD &word = m_memory[size_t(address) * m_lanes + lane];
+                          if (load)
+                              value[lane] = word;
+                          else
+                              word = value[lane]; });
+        }
+
+        /// @brief 执行PUSH/POP，和BasicSimpleVM一样要求栈顶留在栈区内
+        void inst_stack(const Instruction &inst)
+        {
+            DWORD *value = m_registers[inst.register1].data();
+            const bool push = inst.command == CommandEnum::Command::PUSH;
+            if (!push)
+                protect_flags(inst.register1);
+            for_group([&](size_t lane)
+                      {
+                          size_t &top = m_stack_top[lane];
+                          const size_t address = ISData::STACK_SECTION_BEGINNING + top + (push ? 1 : 0);
+                          if (push ? top + 1 >= ISData::STACK_CAPACITY : top == 0)
+                          {
+                              fault(lane, ExceptionEnum::Exception::ADR);
+                              return;
+                          }
+                          DWORD &word = m_memory[address * m_lanes + lane];
+                          if (push)
+                          {
+                              word = value[lane];
+                              top++;
+                          }
+                          else
+                          {
+                              value[lane] = word;
+                              top--;
+                          } });
+        }
+
+        /// @brief 执行CALL/RET，返回地址可能各不相同，所以RET之后可能分组
+        void inst_call(const Instruction &inst)
+        {
+            if (inst.command == CommandEnum::Command::CALL)
+            {
+                const size_t return_index = m_group_index;
+                for_group([&](size_t lane)
+                          {
+                              size_t &top = m_stack_top[lane];
+                              if (top + 1 >= ISData::STACK_CAPACITY)
+                              {
+                                  fault(lane, ExceptionEnum::Exception::ADR);
+                                  return;
+                              }
+                              m_memory[(ISData::STACK_SECTION_BEGINNING + top + 1) * m_lanes + lane] = return_index;
+                              m_frame_base[m_call_depth[lane] * m_lanes + lane] = top;
+                              m_call_depth[lane]++;
+                              top++; });
+                m_group_index = inst.operand1;
+                return;
+            }
+
+            for_group([&](size_t lane)
+                      {
+                          if (m_call_depth[lane] == 0)
+                          {
+                              fault(lane, ExceptionEnum::Exception::ADR);
+                              return;
+                          }
+                          m_call_depth[lane]--;
+                          const size_t base = m_frame_base[m_call_depth[lane] * m_lanes + lane];
+                          // 程序可能改写了栈上的返回地址
+                          m_index[lane] = m_memory[(ISData::STACK_SECTION_BEGINNING + base + 1) * m_lanes + lane];
+                          // 帧内没有弹出的值一并丢弃
+                          m_stack_top[lane] = base; });
+            diverge();
+        }
+
+        /// @brief 执行系统调用：只支持EXIT，其他调用让线程发生ins异常
+        void system_call()
+        {
+            const DWORD *ax = m_registers[RegisterEnum::GeneralRegister::AX].data();
+            const DWORD *bx = m_registers[RegisterEnum::GeneralRegister::BX].data();
+            for_group([&](size_t lane)
+                      {
+                          if (ax[lane] != CommandEnum::SystemCallNumber::EXIT)
+                          {
+                              fault(lane, ExceptionEnum::Exception::INS);
+                              return;
+                          }
+                          m_exit_codes[lane] = bx[lane];
+                          finish(lane); });
+        }
+    };
+
+    using SIMTVM = BasicSIMTVM<DWORD64>;
+    using SIMTVM32 = BasicSIMTVM<DWORD32>;
+} // namespace svm
+
+#endif
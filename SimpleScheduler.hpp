@@ -0,0 +1,185 @@
+#ifndef __SIMPLE_SCHEDULER_HPP__
+#define __SIMPLE_SCHEDULER_HPP__
+
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <condition_variable>
+#include "SimpleVM.hpp"
+
+namespace svm
+{
+    /// @brief 虚拟机调度器
+    /// 用若干个宿主线程轮流运行多个虚拟机：每次最多运行budget条指令；
+    /// 暂停在通道上的虚拟机（StopEnum::PARKED）不占用线程，直到它等待的通道有了变化才重新排队。
+    /// 通道只会在某个虚拟机运行时变化，所以每次运行结束后检查一遍暂停的虚拟机就不会漏掉唤醒。
+    /// @tparam WordT 机器字类型
+    template <typename WordT>
+    class BasicScheduler
+    {
+    public:
+        /// @brief 机器字类型
+        using DWORD = WordT;
+        using VM = BasicSimpleVM<WordT>;
+
+    private:
+        /// @brief 要运行的虚拟机（不拥有）
+        std::vector<VM *> m_vms;
+        /// @brief 宿主线程数
+        size_t m_threads;
+        /// @brief 每次运行最多执行的指令数
+        uint64_t m_budget;
+
+        /// @brief 保护下面的调度状态
+        std::mutex m_mutex;
+        /// @brief 有虚拟机运行结束时通知等待的线程
+        std::condition_variable m_condition;
+        /// @brief 可以运行的虚拟机
+        std::deque<VM *> m_ready;
+        /// @brief 暂停在通道上的虚拟机
+        std::vector<VM *> m_parked;
+        /// @brief 正在运行的虚拟机个数
+        size_t m_running = 0;
+        /// @brief 还没有结束的虚拟机个数
+        size_t m_remaining = 0;
+        /// @brief 是否发生了死锁（所有没结束的虚拟机都在等待不会再变化的通道）
+        bool m_deadlock = false;
+        /// @brief 运行的次数
+        uint64_t m_slices = 0;
+        /// @brief 暂停在通道上的次数
+        uint64_t m_parks = 0;
+
+    public:
+        /// @brief 构造函数
+        /// @param threads 宿主线程数，为0时使用硬件线程数
+        /// @param budget 每次运行最多执行的指令数
+        BasicScheduler(size_t threads = 1, uint64_t budget = 65536) : m_threads(threads), m_budget(budget)
+        {
+            if (m_threads == 0)
+                m_threads = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+        }
+
+        BasicScheduler(const BasicScheduler &) = delete;
+        BasicScheduler &operator=(const BasicScheduler &) = delete;
+
+    public:
+        /// @brief 添加虚拟机（已经加载好程序），虚拟机必须比调度器活得久
+        /// @param vm 虚拟机
+        virtual void add(VM &vm)
+        {
+            m_vms.push_back(&vm);
+        }
+
+        /// @brief 运行所有虚拟机，直到它们都结束
+        /// @return 是否正常结束（发生死锁时返回false，剩下的虚拟机保持暂停状态）
+        virtual bool run()
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_ready.assign(m_vms.begin(), m_vms.end());
+                m_parked.clear();
+                m_running = 0;
+                m_remaining = m_vms.size();
+                m_deadlock = false;
+            }
+
+            std::vector<std::thread> workers;
+            for (size_t i = 1; i < m_threads; i++)
+                workers.emplace_back([this]()
+                                     { work(); });
+            work();
+            for (size_t i = 0; i < workers.size(); i++)
+                workers.at(i).join();
+            return !m_deadlock;
+        }
+
+    public:
+        /// @brief 获取运行的次数
+        uint64_t get_slices() const
+        {
+            return m_slices;
+        }
+
+        /// @brief 获取暂停在通道上的次数
+        uint64_t get_parks() const
+        {
+            return m_parks;
+        }
+
+    private:
+        /// @brief 工作线程：取出可以运行的虚拟机运行一次，直到所有虚拟机结束
+        void work()
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            while (true)
+            {
+                if (m_remaining == 0 || m_deadlock)
+                    break;
+                if (m_ready.empty())
+                {
+                    // 没有虚拟机在运行，暂停的虚拟机就再也等不到变化了
+                    if (m_running == 0)
+                    {
+                        m_deadlock = true;
+                        break;
+                    }
+                    m_condition.wait(lock);
+                    continue;
+                }
+
+                VM *vm = m_ready.front();
+                m_ready.pop_front();
+                m_running++;
+                m_slices++;
+                lock.unlock();
+
+                vm->set_run_budget(m_budget);
+                vm->run();
+
+                lock.lock();
+                m_running--;
+                switch (vm->get_stop_reason())
+                {
+                case StopEnum::Reason::BUDGET:
+                    m_ready.push_back(vm);
+                    break;
+
+                case StopEnum::Reason::PARKED:
+                    m_parks++;
+                    m_parked.push_back(vm);
+                    break;
+
+                default:
+                    // 程序结束、发生异常或者停在断点上，都不再调度
+                    m_remaining--;
+                    break;
+                }
+                wake_parked();
+                m_condition.notify_all();
+            }
+            m_condition.notify_all();
+        }
+
+        /// @brief 把等待的通道已经变化的虚拟机放回队列
+        void wake_parked()
+        {
+            for (size_t i = 0; i < m_parked.size();)
+            {
+                if (m_parked.at(i)->is_park_ready())
+                {
+                    m_ready.push_back(m_parked.at(i));
+                    m_parked.at(i) = m_parked.back();
+                    m_parked.pop_back();
+                }
+                else
+                    i++;
+            }
+        }
+    };
+
+    using Scheduler = BasicScheduler<DWORD64>;
+    using Scheduler32 = BasicScheduler<DWORD32>;
+} // namespace svm
+
+#endif
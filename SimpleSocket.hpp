@@ -0,0 +1,127 @@
+#ifndef __SIMPLE_SOCKET_HPP__
+#define __SIMPLE_SOCKET_HPP__
+
+#include <string>
+#include <cstring>
+#include <iostream>
+
+// 指标服务和作业服务共用的Unix域套接字操作，只在类Unix系统上提供
+#if defined(__unix__) || defined(__APPLE__)
+#define SVM_UNIX_SOCKETS 1
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#else
+#define SVM_UNIX_SOCKETS 0
+#endif
+
+namespace svm
+{
+#if SVM_UNIX_SOCKETS
+    /// @brief 填写Unix域套接字地址
+    /// @param path 套接字路径
+    /// @param address 地址
+    /// @return 是否成功（路径太长时失败）
+    inline bool unix_socket_address(const std::string &path, sockaddr_un &address)
+    {
+        memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        if (path.size() >= sizeof(address.sun_path))
+            return false;
+        memcpy(address.sun_path, path.c_str(), path.size());
+        return true;
+    }
+
+    /// @brief 在指定路径上监听（已存在的文件会被删除）
+    /// @param path 套接字路径
+    /// @param backlog 等待接受的连接数
+    /// @return 监听的套接字，失败时为-1（原因已经输出）
+    inline int listen_unix_socket(const std::string &path, int backlog)
+    {
+        sockaddr_un address;
+        if (!unix_socket_address(path, address))
+        {
+            std::cout << "Socket path too long:\"" << path << "\"" << std::endl;
+            return -1;
+        }
+
+        const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0)
+        {
+            std::cout << "Unable to create socket" << std::endl;
+            return -1;
+        }
+        unlink(path.c_str());
+        if (bind(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0 || listen(fd, backlog) != 0)
+        {
+            std::cout << "Unable to listen on \"" << path << "\"" << std::endl;
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    /// @brief 连接到指定路径上的服务
+    /// @param path 套接字路径
+    /// @return 连接的套接字，失败时为-1
+    inline int connect_unix_socket(const std::string &path)
+    {
+        sockaddr_un address;
+        if (!unix_socket_address(path, address))
+            return -1;
+        const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0)
+            return -1;
+        if (connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0)
+        {
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    /// @brief 等待并接受一个连接，服务线程用它定期检查是否要退出
+    /// @param fd 监听的套接字
+    /// @param timeout 最多等待的时间（毫秒）
+    /// @return 连接的套接字，超时或者被别的线程抢先接受时为-1
+    inline int accept_unix_socket(int fd, int timeout)
+    {
+        pollfd descriptor = {fd, POLLIN, 0};
+        if (poll(&descriptor, 1, timeout) <= 0)
+            return -1;
+        return accept(fd, nullptr, nullptr);
+    }
+
+    /// @brief 停止监听并删除套接字文件
+    /// @param fd 监听的套接字
+    /// @param path 套接字路径
+    inline void close_unix_socket(int fd, const std::string &path)
+    {
+        close(fd);
+        unlink(path.c_str());
+    }
+
+    /// @brief 把数据完整地写到套接字
+    /// @return 是否成功（对方关闭连接时为false）
+    inline bool send_all(int fd, const char *data, size_t size)
+    {
+#if defined(MSG_NOSIGNAL)
+        const int flags = MSG_NOSIGNAL;
+#else
+        const int flags = 0;
+#endif
+        size_t sent = 0;
+        while (sent < size)
+        {
+            const ssize_t count = send(fd, data + sent, size - sent, flags);
+            if (count <= 0)
+                return false;
+            sent += size_t(count);
+        }
+        return true;
+    }
+#endif
+} // namespace svm
+
+#endif
@@ -0,0 +1,222 @@
+#ifndef __SIMPLE_TRACE_HPP__
+#define __SIMPLE_TRACE_HPP__
+
+#include <atomic>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include "SimpleInst.hpp"
+
+namespace svm
+{
+    /// @brief 执行跟踪记录的类型
+    namespace TraceEnum
+    {
+        enum Kind : uint8_t
+        {
+            /// @brief 开始执行一条指令（index, command）
+            STEP = 0,
+
+            /// @brief 上一条指令改变了寄存器（reg, value），改变了几个寄存器就有几条
+            DELTA,
+
+            /// @brief 系统调用的参数，在STEP之前记录（reg为AX~DX, value）
+            SYSCALL_ARG,
+
+            /// @brief 类型总数
+            KCOUNT,
+        };
+    } // namespace TraceEnum
+
+    /// @brief 一条跟踪记录，固定16字节，直接以二进制形式写入文件
+    struct TraceRecord
+    {
+        /// @brief 指令索引
+        uint32_t index;
+        /// @brief 记录类型，参见TraceEnum::Kind
+        uint8_t kind;
+        /// @brief 指令名
+        uint8_t command;
+        /// @brief 寄存器（DELTA和SYSCALL_ARG）
+        uint8_t reg;
+        uint8_t reserved;
+        /// @brief 寄存器的值（DELTA和SYSCALL_ARG）
+        uint64_t value;
+    };
+
+    static_assert(sizeof(TraceRecord) == 16, "TraceRecord must stay 16 bytes");
+
+    /// @brief 跟踪文件头
+    /// 文件由文件头和record_count条TraceRecord组成，记录按时间顺序排列
+    struct TraceFileHeader
+    {
+        /// @brief 固定为"SVMTRACE"
+        char magic[8];
+        /// @brief 格式版本
+        uint32_t version;
+        /// @brief 虚拟机的机器字位数
+        uint32_t word_bits;
+        /// @brief 文件中的记录条数
+        uint64_t record_count;
+        /// @brief 一共写入过的记录条数（包括已经被覆盖的）
+        uint64_t total_records;
+    };
+
+    /// @brief 执行跟踪记录器
+    /// 记录写入固定容量的环形缓冲区，写满后覆盖最早的记录。
+    /// 只有运行虚拟机的线程写入，写入方不加锁也不等待；
+    /// 其他线程可以随时调用snapshot()读取，读取期间被覆盖的记录会被丢弃。
+    class TraceRecorder
+    {
+    public:
+        /// @brief 跟踪文件格式版本
+        static const uint32_t VERSION = 1;
+
+    private:
+        /// @brief 环形缓冲区
+        std::vector<TraceRecord> m_records;
+        /// @brief 容量减1（容量是2的幂）
+        uint64_t m_mask;
+        /// @brief 已经写入的记录条数（只由写入方修改）
+        std::atomic<uint64_t> m_head{0};
+        /// @brief 虚拟机的机器字位数
+        uint32_t m_word_bits;
+
+    public:
+        /// @brief 构造函数
+        /// @param capacity 最多保留的记录条数，向上取整为2的幂
+        /// @param word_bits 虚拟机的机器字位数
+        TraceRecorder(size_t capacity, uint32_t word_bits) : m_word_bits(word_bits)
+        {
+            size_t size = 1;
+            while (size < capacity)
+                size <<= 1;
+            m_records.resize(size);
+            m_mask = size - 1;
+        }
+        ~TraceRecorder() {}
+
+    public:
+        /// @brief 追加一条记录
+        /// @param index 指令索引
+        /// @param kind 记录类型
+        /// @param command 指令名
+        /// @param reg 寄存器
+        /// @param value 寄存器的值
+        void append(size_t index, TraceEnum::Kind kind, CommandEnum::Command command, uint8_t reg, uint64_t value)
+        {
+            const uint64_t head = m_head.load(std::memory_order_relaxed);
+            TraceRecord &record = m_records[head & m_mask];
+            record.index = static_cast<uint32_t>(index);
+            record.kind = kind;
+            record.command = command;
+            record.reg = reg;
+            record.reserved = 0;
+            record.value = value;
+            m_head.store(head + 1, std::memory_order_release);
+        }
+
+        /// @brief 清空所有记录
+        void clear()
+        {
+            m_head.store(0, std::memory_order_release);
+        }
+
+    public:
+        /// @brief 获取缓冲区中仍然完好的记录（按时间顺序）
+        /// @param total 一共写入过的记录条数
+        /// @return 记录
+        std::vector<TraceRecord> snapshot(uint64_t &total) const
+        {
+            const uint64_t capacity = m_records.size();
+            const uint64_t end = m_head.load(std::memory_order_acquire);
+            uint64_t begin = end > capacity ? end - capacity : 0;
+
+            std::vector<TraceRecord> result;
+            result.reserve(size_t(end - begin));
+            for (uint64_t i = begin; i < end; i++)
+                result.push_back(m_records[i & m_mask]);
+
+            // 复制期间写入方可能又写了一圈，被覆盖的记录不可信，丢掉；
+            // 写入方正在写的第now条和第now - capacity条共用一个位置，所以它也不可信
+            std::atomic_thread_fence(std::memory_order_acquire);
+            const uint64_t now = m_head.load(std::memory_order_relaxed);
+            if (now >= capacity && now - capacity >= begin)
+            {
+                const uint64_t lost = now - capacity - begin + 1;
+                result.erase(result.begin(), result.begin() + size_t(lost < result.size() ? lost : result.size()));
+            }
+
+            total = end;
+            return result;
+        }
+
+        /// @brief 把记录以二进制形式写入流
+        /// @param out 输出流
+        /// @return 是否成功
+        bool dump(std::ostream &out) const
+        {
+            uint64_t total;
+            std::vector<TraceRecord> records = snapshot(total);
+
+            TraceFileHeader header;
+            memcpy(header.magic, "SVMTRACE", sizeof(header.magic));
+            header.version = VERSION;
+            header.word_bits = m_word_bits;
+            header.record_count = records.size();
+            header.total_records = total;
+
+            out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+            out.write(reinterpret_cast<const char *>(records.data()), records.size() * sizeof(TraceRecord));
+            return bool(out);
+        }
+
+        /// @brief 把记录以二进制形式写入文件
+        /// @param filename 文件名
+        /// @return 是否成功
+        bool dump(const std::string &filename) const
+        {
+            std::ofstream fout(filename, std::ios::binary);
+            if (fout.fail())
+            {
+                std::cout << "Unable to open file \"" << filename << "\"" << std::endl;
+                return false;
+            }
+            return dump(fout);
+        }
+
+        /// @brief 从文件读取跟踪记录
+        /// @param filename 文件名
+        /// @param header 文件头
+        /// @param records 记录
+        /// @return 是否成功
+        static bool load(const std::string &filename, TraceFileHeader &header, std::vector<TraceRecord> &records)
+        {
+            std::ifstream fin(filename, std::ios::binary);
+            if (fin.fail())
+            {
+                std::cout << "Unable to open file \"" << filename << "\"" << std::endl;
+                return false;
+            }
+
+            if (!fin.read(reinterpret_cast<char *>(&header), sizeof(header)) || memcmp(header.magic, "SVMTRACE", sizeof(header.magic)) != 0 || header.version != VERSION)
+            {
+                std::cout << "Bad trace file:\"" << filename << "\"" << std::endl;
+                return false;
+            }
+
+            records.resize(size_t(header.record_count));
+            if (!fin.read(reinterpret_cast<char *>(records.data()), records.size() * sizeof(TraceRecord)))
+            {
+                std::cout << "Truncated trace file:\"" << filename << "\"" << std::endl;
+                return false;
+            }
+            return true;
+        }
+    };
+} // namespace svm
+
+#endif
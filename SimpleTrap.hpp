@@ -0,0 +1,105 @@
+#ifndef __SIMPLE_TRAP_HPP__
+#define __SIMPLE_TRAP_HPP__
+
+#include <array>
+#include <mutex>
+#include <vector>
+#include <cstdint>
+#include "SimpleVM.hpp"
+
+namespace svm
+{
+    /// @brief 陷阱队列
+    /// 虚拟机在自己的线程上把陷阱记录放进队列，宿主在方便的时候一次取走，整个过程没有控制台输出。
+    /// 多台虚拟机可以共用一个队列（用记录中的source区分），队列满了之后新的记录被丢弃并计数。
+    /// @tparam WordT 机器字类型
+    template <typename WordT>
+    class BasicTrapQueue : public BasicTrapHandler<WordT>
+    {
+    public:
+        /// @brief 机器字类型
+        using DWORD = WordT;
+        using VM = BasicSimpleVM<WordT>;
+        using TrapRecord = BasicTrapRecord<WordT>;
+
+    private:
+        /// @brief 最多保留的记录数
+        size_t m_capacity;
+        /// @brief 保护下面的记录和计数
+        std::mutex m_mutex;
+        /// @brief 还没有取走的记录
+        std::vector<TrapRecord> m_entries;
+        /// @brief 因为队列满了而丢弃的记录数
+        uint64_t m_dropped = 0;
+        /// @brief 每种陷阱的总次数（包括丢弃的）
+        std::array<uint64_t, TrapEnum::Trap::TCOUNT> m_counts{};
+
+    public:
+        /// @brief 构造函数
+        /// @param capacity 最多保留的记录数
+        BasicTrapQueue(size_t capacity = 1024) : m_capacity(capacity)
+        {
+            m_entries.reserve(capacity);
+        }
+
+        BasicTrapQueue(const BasicTrapQueue &) = delete;
+        BasicTrapQueue &operator=(const BasicTrapQueue &) = delete;
+
+        ~BasicTrapQueue() {}
+
+    public:
+        /// @brief 让虚拟机把陷阱记录放进这个队列
+        /// @param vm 虚拟机
+        /// @param source 这台虚拟机的记录中的source
+        void attach(VM &vm, size_t source = 0)
+        {
+            vm.attach_trap_handler(this, source);
+        }
+
+        /// @brief 放入一条记录（由虚拟机调用）
+        virtual void on_trap(const TrapRecord &record) override
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (record.trap < TrapEnum::Trap::TCOUNT)
+                m_counts[record.trap]++;
+            if (m_entries.size() >= m_capacity)
+            {
+                m_dropped++;
+                return;
+            }
+            m_entries.push_back(record);
+        }
+
+        /// @brief 取走所有记录
+        /// @param entries 取走的记录，原来的内容被替换
+        /// @return 取走的条数
+        size_t drain(std::vector<TrapRecord> &entries)
+        {
+            entries.clear();
+            std::lock_guard<std::mutex> lock(m_mutex);
+            entries.swap(m_entries);
+            m_entries.reserve(m_capacity);
+            return entries.size();
+        }
+
+    public:
+        /// @brief 获取因为队列满了而丢弃的记录数
+        uint64_t get_dropped()
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_dropped;
+        }
+
+        /// @brief 获取某种陷阱的总次数
+        uint64_t get_count(TrapEnum::Trap trap)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_counts.at(trap);
+        }
+    };
+
+    using TrapQueue = BasicTrapQueue<DWORD64>;
+    using TrapQueue32 = BasicTrapQueue<DWORD32>;
+} // namespace svm
+
+#endif
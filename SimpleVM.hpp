@@ -6,48 +6,127 @@
 #include <iostream>
 #include <map>
 #include <stack>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <chrono>
+#include <mutex>
+#include <atomic>
+#include <algorithm>
 #include <memory.h>
 #include "SimpleInst.hpp"
+#include "Utils.hpp"
+#include "SimpleDevice.hpp"
+#include "SimpleMemory.hpp"
+#include "SimpleHeap.hpp"
+#include "SimpleSIMD.hpp"
+#include "SimpleProfiler.hpp"
+#include "SimpleTrace.hpp"
+#include "SimplePerf.hpp"
+#include "SimpleMonitor.hpp"
+#include "SimpleChannel.hpp"
 
 namespace svm
 {
     /// @brief 虚拟机状态
-    struct VMState
+    /// @tparam WordT 机器字类型
+    template <typename WordT>
+    struct BasicVMState
     {
+        /// @brief 机器字类型
+        using DWORD = WordT;
+        /// @brief 向量寄存器的值
+        using VectorValue = BasicVectorValue<WordT>;
+
+        /// @brief 标志寄存器的来源
+        enum FlagSource
+        {
+            /// @brief 标志寄存器已经是最新的
+            FLAGS_READY = 0,
+            /// @brief 由flag_operand1（运算结果）决定
+            FLAGS_RESULT,
+            /// @brief 由flag_operand1和flag_operand2的比较决定
+            FLAGS_COMPARE,
+        };
+
         /// @brief 通用寄存器
-        std::array<DWORD, RegisterEnum::GeneralRegister::GRCOUNT> general_registers;
-        /// @brief 标志寄存器
-        std::array<bool, RegisterEnum::StatusRegister::SRCOUNT> status_registers;
+        std::array<DWORD, RegisterEnum::GeneralRegister::GRCOUNT> general_registers{};
+        /// @brief 标志寄存器（读取前先调用materialize_flags()）
+        std::array<bool, RegisterEnum::StatusRegister::SRCOUNT> status_registers{};
+        /// @brief 向量寄存器
+        std::array<VectorValue, RegisterEnum::VectorRegister::VRCOUNT> vector_registers{};
+        /// @brief 标志寄存器的来源
+        /// 算术逻辑指令只记录结果，真正需要时才计算ZF/SF
+        FlagSource flag_source = FLAGS_READY;
+        /// @brief 上一次运算的结果，或比较的左操作数
+        DWORD flag_operand1 = 0;
+        /// @brief 比较的右操作数
+        DWORD flag_operand2 = 0;
         /// @brief 虚拟机异常状态
         ExceptionEnum::Exception exception = ExceptionEnum::Exception::AOK;
         /// @brief 虚拟机是否正在运行
         bool is_running = false;
 
         /// @brief 构造函数
-        VMState() {}
+        BasicVMState() {}
 
         /// @brief 构造函数
         /// @param from 要被赋予的值
-        VMState(const VMState &from) { operator=(from); }
+        BasicVMState(const BasicVMState &from) { operator=(from); }
 
-        ~VMState() {}
+        ~BasicVMState() {}
 
         /// @brief 构造函数
         /// @param from 要被赋予的值
         /// @return 自身
-        VMState &operator=(const VMState &from)
+        BasicVMState &operator=(const BasicVMState &from)
         {
             general_registers = from.general_registers;
             status_registers = from.status_registers;
+            vector_registers = from.vector_registers;
+            flag_source = from.flag_source;
+            flag_operand1 = from.flag_operand1;
+            flag_operand2 = from.flag_operand2;
             exception = from.exception;
             is_running = from.is_running;
             return *this;
         }
+
+        /// @brief 根据记录的运算结果计算ZF/SF
+        void materialize_flags()
+        {
+            using Signed = typename std::make_signed<DWORD>::type;
+
+            switch (flag_source)
+            {
+            case FLAGS_RESULT:
+                status_registers[RegisterEnum::StatusRegister::ZF] = flag_operand1 == 0;
+                status_registers[RegisterEnum::StatusRegister::SF] = Signed(flag_operand1) < 0;
+                break;
+
+            case FLAGS_COMPARE:
+                // 直接比较而不是看差的符号，这样不会因为溢出而出错
+                status_registers[RegisterEnum::StatusRegister::ZF] = flag_operand1 == flag_operand2;
+                status_registers[RegisterEnum::StatusRegister::SF] = Signed(flag_operand1) < Signed(flag_operand2);
+                break;
+
+            default:
+                break;
+            }
+            flag_source = FLAGS_READY;
+        }
     };
 
     /// @brief 程序的数据
-    struct ProgramData
+    /// @tparam WordT 机器字类型
+    template <typename WordT>
+    struct BasicProgramData
     {
+        /// @brief 机器字类型
+        using DWORD = WordT;
+        /// @brief 指令类型
+        using Instruction = BasicInstruction<WordT>;
+
         /// @brief 程序的指令（text段）
         std::vector<Instruction> instructions;
         /// @brief 程序的数据段（data段和bss段）
@@ -58,43 +137,64 @@ namespace svm
         /// @brief 构造函数
         /// @param insts 指令
         /// @param datas 数据
-        ProgramData(std::vector<Instruction> insts = std::vector<Instruction>(), std::vector<DWORD> datas = std::vector<DWORD>()) : instructions(insts), data(datas), current_instruction_index(0) {}
+        BasicProgramData(std::vector<Instruction> insts = std::vector<Instruction>(), std::vector<DWORD> datas = std::vector<DWORD>()) : instructions(insts), data(datas), current_instruction_index(0) {}
 
         /// @brief 构造函数
         /// @param from 要被赋予的值
-        ProgramData(const ProgramData &from) { operator=(from); }
+        BasicProgramData(const BasicProgramData &from) { operator=(from); }
 
-        ~ProgramData() {}
+        ~BasicProgramData() {}
 
         /// @brief 赋值函数
         /// @param from 要被赋予的值
         /// @return 自身
-        ProgramData &operator=(const ProgramData &from)
+        BasicProgramData &operator=(const BasicProgramData &from)
         {
             instructions = from.instructions;
             data = from.data;
             current_instruction_index = from.current_instruction_index;
             return *this;
         }
+
+        /// @brief 清空程序，保留已经分配的空间
+        void clear()
+        {
+            instructions.clear();
+            data.clear();
+            current_instruction_index = 0;
+        }
     };
 
+    using VMState = BasicVMState<DWORD64>;
+    using VMState32 = BasicVMState<DWORD32>;
+    using ProgramData = BasicProgramData<DWORD64>;
+    using ProgramData32 = BasicProgramData<DWORD32>;
+
     /// @brief 内存数据
+    /// 容量的单位都是机器字，32位时实际占用的内存减半
+    /// @tparam WordT 机器字类型
     /// @tparam m_total_capacity 内存总容量，默认是8KB。
     /// @tparam m_data_capacity 程序数据容量，默认1KB。
     /// @tparam m_stack_capacity 栈总容量，默认是1KB。
-    /// @tparam m_heap_capacity 堆总容量，默认6KB。
-    template <size_t m_total_capacity = 1024, size_t m_data_capacity = 128, size_t m_stack_capacity = 128, size_t m_heap_capacity = 768>
+    /// @tparam m_heap_capacity 堆总容量，默认5.5KB。
+    /// @tparam m_device_capacity 设备（MMIO）区域容量，默认0.5KB。
+    template <typename WordT = DWORD, size_t m_total_capacity = 1024, size_t m_data_capacity = 128, size_t m_stack_capacity = 128, size_t m_heap_capacity = 704, size_t m_device_capacity = 64>
     class InternalStorageData
     {
     public:
+        /// @brief 机器字类型
+        using DWORD = WordT;
+
         /// @brief 内存总容量，默认是8KB。
         static const size_t TOTAL_CAPACITY = m_total_capacity;
         /// @brief 程序数据容量，默认1KB。
         static const size_t DATA_CAPACITY = m_data_capacity;
         /// @brief 栈总容量，默认是1KB。
         static const size_t STACK_CAPACITY = m_stack_capacity;
-        /// @brief 堆总容量，默认6KB。
+        /// @brief 堆总容量，默认5.5KB。
         static const size_t HEAP_CAPACITY = m_heap_capacity;
+        /// @brief 设备（MMIO）区域容量，默认0.5KB。
+        static const size_t DEVICE_CAPACITY = m_device_capacity;
 
         /// @brief 数据段的起始位置
         static const size_t DATA_SECTION_BEGINNING = 0;
@@ -102,23 +202,32 @@ namespace svm
         static const size_t STACK_SECTION_BEGINNING = DATA_SECTION_BEGINNING + DATA_CAPACITY;
         /// @brief 堆的起始位置
         static const size_t HEAP_SECTION_BEGINNING = STACK_SECTION_BEGINNING + STACK_CAPACITY;
+        /// @brief 设备区域的起始位置
+        static const size_t DEVICE_SECTION_BEGINNING = HEAP_SECTION_BEGINNING + HEAP_CAPACITY;
+
+        static_assert(DEVICE_SECTION_BEGINNING + DEVICE_CAPACITY <= TOTAL_CAPACITY, "The sections exceed the total capacity");
+
+        /// @brief 末尾保护页的客户地址（窗口区之后），guest()把更远的地址都截到这里
+        static const size_t GUEST_LIMIT = TOTAL_CAPACITY + GuardedRegion::WINDOW_BYTES / sizeof(WordT);
 
         /// @brief 自身类型
-        using SelfType = InternalStorageData<TOTAL_CAPACITY, DATA_CAPACITY, STACK_CAPACITY, HEAP_CAPACITY>;
+        using SelfType = InternalStorageData<WordT, TOTAL_CAPACITY, DATA_CAPACITY, STACK_CAPACITY, HEAP_CAPACITY, DEVICE_CAPACITY>;
 
     private:
-        /// @brief 虚拟机内存
-        std::array<DWORD, TOTAL_CAPACITY> m_internal_storage;
+        /// @brief 虚拟机内存（两侧都是保护页）
+        GuardedRegion m_region;
+        /// @brief 虚拟机内存的首地址，即m_region.data()
+        DWORD *m_internal_storage;
         /// @brief 栈顶索引
         size_t m_stack_top = 0;
 
     public:
         /// @brief 构造函数
-        InternalStorageData() {}
+        InternalStorageData() : m_region(TOTAL_CAPACITY, sizeof(DWORD)), m_internal_storage(static_cast<DWORD *>(m_region.data())) {}
 
         /// @brief 构造函数
         /// @param from 要被赋予的值
-        InternalStorageData(const SelfType &from) { operator=(from); }
+        InternalStorageData(const SelfType &from) : InternalStorageData() { operator=(from); }
 
         ~InternalStorageData() {}
 
@@ -128,19 +237,40 @@ namespace svm
         /// @return 自身
         SelfType &operator=(const SelfType &from)
         {
-            m_internal_storage = from.m_internal_storage;
+            memcpy(m_internal_storage, from.m_internal_storage, TOTAL_CAPACITY * sizeof(DWORD));
             m_stack_top = from.m_stack_top;
             return *this;
         }
 
+        /// @brief 清空内存和栈顶，不重新分配（映射在内存之后的窗口保留）
+        void clear()
+        {
+            memset(m_internal_storage, 0, TOTAL_CAPACITY * sizeof(DWORD));
+            m_stack_top = 0;
+        }
+
     public:
-        /// @brief 获取虚拟机内存引用
-        /// @return 虚拟机内存的引用
-        std::array<DWORD, TOTAL_CAPACITY> &get_internal_storage()
+        /// @brief 获取虚拟机内存
+        /// @return 虚拟机内存的首地址
+        DWORD *get_internal_storage()
         {
             return m_internal_storage;
         }
 
+        /// @brief 获取虚拟机内存所在的区域
+        /// @return 区域的引用
+        const GuardedRegion &get_region() const
+        {
+            return m_region;
+        }
+
+        /// @brief 获取虚拟机内存所在的区域
+        /// @return 区域的引用
+        GuardedRegion &get_region()
+        {
+            return m_region;
+        }
+
         /// @brief 获取虚拟机栈顶引用
         /// @return 虚拟机栈顶的引用
         size_t &get_stack_top()
@@ -154,7 +284,85 @@ namespace svm
         /// @return 指针
         DWORD *access(size_t pointer)
         {
-            return &m_internal_storage.at(pointer);
+            if (pointer >= TOTAL_CAPACITY)
+                throw std::out_of_range("InternalStorageData::access");
+            return &m_internal_storage[pointer];
+        }
+
+        /// @brief 客户程序访问虚拟机内存
+        /// 有保护页时不做分支检查：超出窗口区的地址（包括64位地址的高位）被截到末尾保护页上，
+        /// 越界访问由SIGSEGV转为ADR异常，这时异常记录中的地址是GUEST_LIMIT；
+        /// 没有保护页时显式检查，越界返回nullptr。
+        /// @param address 客户地址
+        /// @return 指针
+        DWORD *guest(DWORD address)
+        {
+            if (GuardedRegion::GUARD_PAGES)
+                return m_internal_storage + (address < GUEST_LIMIT ? address : GUEST_LIMIT);
+            return address < TOTAL_CAPACITY ? m_internal_storage + address : nullptr;
+        }
+
+        /// @brief 客户程序按字节访问虚拟机内存，检查方式和guest()相同
+        /// @param address 客户字节地址
+        /// @param width 访问的字节数
+        /// @return 指针
+        unsigned char *guest_bytes(DWORD address, size_t width)
+        {
+            unsigned char *bytes = reinterpret_cast<unsigned char *>(m_internal_storage);
+            if (GuardedRegion::GUARD_PAGES)
+                return bytes + (address < GUEST_LIMIT * sizeof(DWORD) ? address : GUEST_LIMIT * sizeof(DWORD));
+            return address <= TOTAL_CAPACITY * sizeof(DWORD) - width ? bytes + address : nullptr;
+        }
+
+        /// @brief 客户程序批量按字节访问虚拟机内存，整个范围只检查一次
+        /// 范围可以延伸到bind_window()映射的窗口中，但不能跨过没有映射的地址
+        /// @param address 客户字节地址
+        /// @param count 长度（单位为字节）
+        /// @return 指针，范围越界时为nullptr
+        unsigned char *guest_byte_range(DWORD address, DWORD count)
+        {
+            const DWORD total = TOTAL_CAPACITY * sizeof(DWORD);
+            if (address > total || count > total - address)
+            {
+                if (count > guest_byte_extent(address))
+                    return nullptr;
+            }
+            return reinterpret_cast<unsigned char *>(m_internal_storage) + address;
+        }
+
+        /// @brief 客户程序批量访问虚拟机内存，整个范围只检查一次
+        /// 范围可以延伸到bind_window()映射的窗口中，但不能跨过没有映射的地址
+        /// @param address 客户地址
+        /// @param count 长度（单位为DWORD）
+        /// @return 指针，范围越界时为nullptr
+        DWORD *guest_range(DWORD address, DWORD count)
+        {
+            if (address > TOTAL_CAPACITY || count > TOTAL_CAPACITY - address)
+            {
+                if (count > guest_extent(address))
+                    return nullptr;
+            }
+            return m_internal_storage + address;
+        }
+
+        /// @brief 从客户地址开始连续可以访问的字节数（内存和紧接着的已映射窗口）
+        /// @param address 客户字节地址
+        /// @return 字节数，地址不可访问时为0
+        size_t guest_byte_extent(DWORD address) const
+        {
+            if (address >= GUEST_LIMIT * sizeof(DWORD))
+                return 0;
+            return m_region.accessible_bytes(size_t(address));
+        }
+
+        /// @brief 从客户地址开始连续可以访问的机器字数（内存和紧接着的已映射窗口）
+        /// @param address 客户地址
+        /// @return 机器字数，地址不可访问时为0
+        size_t guest_extent(DWORD address) const
+        {
+            if (address >= GUEST_LIMIT)
+                return 0;
+            return m_region.accessible_bytes(size_t(address) * sizeof(DWORD)) / sizeof(DWORD);
         }
 
         /// @brief 入栈
@@ -165,7 +373,7 @@ namespace svm
             if (m_stack_top < STACK_CAPACITY - 1)
             {
                 m_stack_top++;
-                m_internal_storage.at(STACK_SECTION_BEGINNING + m_stack_top) = value;
+                m_internal_storage[STACK_SECTION_BEGINNING + m_stack_top] = value;
                 return true;
             }
             else
@@ -181,7 +389,7 @@ namespace svm
         {
             if (m_stack_top > 0)
             {
-                result = m_internal_storage.at(STACK_SECTION_BEGINNING + m_stack_top);
+                result = m_internal_storage[STACK_SECTION_BEGINNING + m_stack_top];
                 m_stack_top--;
                 return true;
             }
@@ -192,34 +400,291 @@ namespace svm
         }
     };
 
+    /// @brief 调用帧
+    /// 虚拟机在宿主侧另外保存一份调用帧，RET用它恢复栈顶，调试器和检查点用它列出调用栈
+    struct CallFrame
+    {
+        /// @brief 返回后要执行的指令索引
+        size_t return_index;
+        /// @brief 进入函数前的栈顶，返回地址就保存在它的上一个位置
+        size_t stack_base;
+    };
+
+    /// @brief 虚拟机暂停的原因（供调试器使用）
+    namespace StopEnum
+    {
+        enum Reason
+        {
+            /// @brief 没有暂停（程序结束、发生异常，或者还没有运行）
+            NONE = 0,
+
+            /// @brief 执行到BRK指令，停在这条指令上
+            BREAKPOINT,
+
+            /// @brief 访问了被保护的内存页（观察点），停在这条指令上，它还没有完成
+            WATCHPOINT,
+
+            /// @brief 通道满了或空了，停在这条SYSCALL上，通道变化后再运行会重新执行它
+            PARKED,
+
+            /// @brief 用完了set_run_budget()设置的指令数，可以继续运行
+            BUDGET,
+        };
+    } // namespace StopEnum
+
+    /// @brief 多核虚拟机中所有核共享的资源
+    struct CoreGroup
+    {
+        /// @brief 串行化系统调用和异常输出（输入输出和堆分配器都不是线程安全的）
+        std::recursive_mutex syscall_mutex;
+        /// @brief 任何一个核发生异常后置位，其他核在下次轮询设备时停止
+        std::atomic<bool> abort{false};
+    };
+
+    /// @brief SPAWN和JOIN指令的执行者（参见SimpleForkJoin.hpp）
+    /// @tparam WordT 机器字类型
+    template <typename WordT>
+    class BasicForkJoinHost
+    {
+    public:
+        /// @brief 子任务结束时交回的寄存器个数（AX、BX、CX、DX）
+        static const size_t RESULT_COUNT = 4;
+
+    public:
+        virtual ~BasicForkJoinHost() {}
+
+    public:
+        /// @brief 创建子任务
+        /// @param registers 子任务开始时的通用寄存器
+        /// @param index 子任务开始执行的指令索引
+        /// @param handle 子任务的句柄
+        /// @return 是否成功
+        virtual bool spawn(const std::array<WordT, RegisterEnum::GeneralRegister::GRCOUNT> &registers, size_t index, WordT &handle) = 0;
+
+        /// @brief 等待子任务结束，之后句柄失效
+        /// @param handle 子任务的句柄
+        /// @param results 子任务结束时的AX、BX、CX、DX
+        /// @return 是否成功（句柄是否有效）
+        virtual bool join(WordT handle, std::array<WordT, RESULT_COUNT> &results) = 0;
+    };
+
+    /// @brief 陷阱的命名空间
+    namespace TrapEnum
+    {
+        /// @brief 陷阱类型，前四种和ExceptionEnum相同
+        enum Trap
+        {
+            /// @brief 执行到HLT指令
+            HLT = ExceptionEnum::Exception::HLT,
+
+            /// @brief 访问的内存地址非法
+            ADR = ExceptionEnum::Exception::ADR,
+
+            /// @brief 指令或系统调用非法
+            INS = ExceptionEnum::Exception::INS,
+
+            /// @brief 除数为0
+            DIV = ExceptionEnum::Exception::DIV,
+
+            /// @brief 用完了set_run_budget()设置的指令数（虚拟机暂停，可以继续运行）
+            BUDGET,
+
+            /// @brief 陷阱类型总数
+            TCOUNT,
+        };
+    } // namespace TrapEnum
+
+    /// @brief 一次陷阱的记录
+    /// @tparam WordT 机器字类型
+    template <typename WordT>
+    struct BasicTrapRecord
+    {
+        /// @brief 陷阱类型
+        TrapEnum::Trap trap;
+        /// @brief 发生陷阱的指令索引
+        size_t index;
+        /// @brief 越界的机器字地址（只有ADR并且使用保护页时才有，否则为0）
+        WordT address;
+        /// @brief 发生时已经执行的指令数
+        uint64_t retired_instructions;
+        /// @brief 是否交给了客户程序的陷阱处理函数（此时虚拟机继续运行）
+        bool vectored;
+        /// @brief 宿主设置接收者时给这台虚拟机的编号，多台虚拟机共用一个接收者时用来区分
+        size_t source;
+    };
+
+    /// @brief 接收陷阱记录的宿主（参见SimpleTrap.hpp）
+    /// 设置之后虚拟机发生异常时不再向控制台输出任何内容
+    /// @tparam WordT 机器字类型
+    template <typename WordT>
+    class BasicTrapHandler
+    {
+    public:
+        virtual ~BasicTrapHandler() {}
+
+    public:
+        /// @brief 处理一次陷阱，在运行虚拟机的线程上调用，不能在这里再运行同一台虚拟机
+        /// @param record 陷阱记录
+        virtual void on_trap(const BasicTrapRecord<WordT> &record) = 0;
+    };
+
     /// @brief 简单的虚拟机类
-    class SimpleVM
+    /// @tparam WordT 机器字类型，决定寄存器、操作数和内存单元的宽度
+    template <typename WordT>
+    class BasicSimpleVM
     {
     public:
-        using ISData = InternalStorageData<>;
-        
+        /// @brief 机器字类型
+        using DWORD = WordT;
+        using Instruction = BasicInstruction<WordT>;
+        using VMState = BasicVMState<WordT>;
+        using ProgramData = BasicProgramData<WordT>;
+        using ISData = InternalStorageData<WordT>;
+        using MMIODevice = BasicMMIODevice<WordT>;
+        using HeapAllocator = BasicHeapAllocator<WordT>;
+        using BulkKernels = BasicBulkKernels<WordT>;
+        using VectorValue = BasicVectorValue<WordT>;
+        using Channel = BasicChannel<WordT>;
+        using ChannelTable = BasicChannelTable<WordT>;
+        using ForkJoinHost = BasicForkJoinHost<WordT>;
+        using TrapRecord = BasicTrapRecord<WordT>;
+        using TrapHandler = BasicTrapHandler<WordT>;
+
+        /// @brief 设备轮询间隔（指令条数，必须是2的幂）
+        static const size_t DEVICE_POLL_INTERVAL = 256;
+        /// @brief 脏块的大小（单位为机器字）
+        static const size_t DIRTY_BLOCK_WORDS = 64;
+        /// @brief 内存的脏块数
+        static const size_t DIRTY_BLOCK_COUNT = (ISData::TOTAL_CAPACITY + DIRTY_BLOCK_WORDS - 1) / DIRTY_BLOCK_WORDS;
+        /// @brief 一条指令最多改变的通用寄存器个数（系统调用和JOIN改变AX~DX）
+        static const size_t TRACED_REGISTER_MAX = 4;
+
     private:
         /// @brief 虚拟机的状态
         VMState m_vm_state;
         /// @brief 要运行的程序
         ProgramData m_program_data;
-        /// @brief 程序运行时的数据
-        ISData m_internal_storage_data;
+        /// @brief 程序运行时的数据的所有权，多核时所有核共享同一份
+        std::shared_ptr<ISData> m_storage;
+        /// @brief 程序运行时的数据，即*m_storage
+        ISData &m_internal_storage_data;
+        /// @brief 多核时所有核共享的资源，单核时为空
+        std::shared_ptr<CoreGroup> m_core_group;
+        /// @brief 栈顶索引，单核时指向ISData中的栈顶，多核时指向本核自己的m_core_stack_top
+        size_t *m_stack_top;
+        /// @brief 多核时本核的栈顶
+        size_t m_core_stack_top = 0;
+        /// @brief 多核时本核自己的栈（单核时为空，栈就是内存中的栈区）
+        std::vector<DWORD> m_core_stack;
+        /// @brief 本核的栈，第i个栈槽是m_stack_memory[i]，容量总是STACK_CAPACITY
+        DWORD *m_stack_memory = nullptr;
+        /// @brief 已映射的设备
+        std::vector<std::shared_ptr<MMIODevice>> m_devices;
+        /// @brief 下一个设备的映射位置
+        size_t m_next_device_base = ISData::DEVICE_SECTION_BEGINNING;
+        /// @brief 距离下次轮询设备还剩的指令条数
+        size_t m_device_poll_countdown = DEVICE_POLL_INTERVAL;
+        /// @brief 宿主侧的调用帧，每个栈帧至少占一个DWORD，所以容量不会超过栈容量
+        std::vector<CallFrame> m_call_frames;
+        /// @brief 性能分析器，为空时不分析
+        std::unique_ptr<Profiler> m_profiler;
+        /// @brief 执行跟踪记录器，为空时不跟踪
+        std::unique_ptr<TraceRecorder> m_trace;
+        /// @brief 发生异常时写入跟踪记录的文件，为空时不写
+        std::string m_trace_dump_file;
+        /// @brief 执行过的指令总数
+        uint64_t m_retired_instructions = 0;
+        /// @brief 执行过的系统调用总数
+        uint64_t m_retired_syscalls = 0;
+        /// @brief 硬件性能计数器，为空时不计数
+        std::unique_ptr<PerfCounters> m_perf;
+        /// @brief 上一次run()的硬件计数结果
+        PerfReport m_perf_report;
+        /// @brief 本次run()开始时的指令数和系统调用数
+        uint64_t m_perf_start_instructions = 0;
+        uint64_t m_perf_start_syscalls = 0;
+        /// @brief 监控槽，为空时不发布快照
+        std::shared_ptr<MonitorSlot> m_monitor;
+        /// @brief 发布快照的间隔（指令条数）
+        uint64_t m_monitor_interval = 0;
+        /// @brief 执行到多少条指令时发布下一份快照
+        uint64_t m_monitor_next = 0;
+        /// @brief 已经发布的快照份数
+        uint64_t m_monitor_publish_count = 0;
+        /// @brief 上一次run()或step()暂停的原因
+        StopEnum::Reason m_stop_reason = StopEnum::Reason::NONE;
+        /// @brief 观察点暂停时被访问的内存位置（单位为机器字）
+        size_t m_stop_address = 0;
+        /// @brief 通道系统调用使用的通道表，为空时通道调用都失败
+        std::shared_ptr<ChannelTable> m_channels;
+        /// @brief 暂停时等待的通道
+        const Channel *m_park_channel = nullptr;
+        /// @brief 暂停前通道的状态，状态变化后才值得再次运行
+        uint64_t m_park_state = 0;
+        /// @brief 每次run()最多执行的指令数，为0时不限制
+        uint64_t m_run_budget = 0;
+        /// @brief 本次run()执行到多少条指令时暂停
+        uint64_t m_budget_end = 0;
+        /// @brief SPAWN和JOIN指令的执行者（不拥有），为空时这两条指令发出ins异常
+        ForkJoinHost *m_fork_join = nullptr;
+        /// @brief 是否在执行子任务：子任务的入口函数执行RET时正常结束
+        bool m_task_mode = false;
+        /// @brief 是否不输出程序结束和异常的信息（嵌入时由调用者读取退出码和异常状态）
+        bool m_quiet = false;
+        /// @brief STDIO输入输出系统调用使用的流（不拥有），默认为std::cin和std::cout
+        std::istream *m_console_input = &std::cin;
+        std::ostream *m_console_output = &std::cout;
+        /// @brief 上次重置之后被写过的内存块，每块一位，restart()只恢复这些块
+        std::array<uint64_t, (DIRTY_BLOCK_COUNT + 63) / 64> m_dirty_blocks{};
+        /// @brief 接收陷阱记录的宿主（不拥有），为空时异常照常输出到控制台
+        TrapHandler *m_trap_handler = nullptr;
+        /// @brief 陷阱记录中的source
+        size_t m_trap_source = 0;
+        /// @brief 客户程序的陷阱处理函数（指令索引，按陷阱类型，为0时没有）
+        std::array<size_t, TrapEnum::Trap::DIV + 1> m_trap_vectors{};
+        /// @brief 是否正在执行陷阱处理函数
+        bool m_in_trap = false;
+        /// @brief 陷阱处理函数返回后调用帧的个数
+        size_t m_trap_frame_depth = 0;
+        /// @brief 最近一次交给处理函数的陷阱
+        TrapRecord m_last_trap{};
+        /// @brief 越界访问的机器字地址（只在保护页捕获时有）
+        DWORD m_fault_address = 0;
 
     public:
-        SimpleVM()
+        BasicSimpleVM() : m_storage(std::make_shared<ISData>()), m_internal_storage_data(*m_storage), m_stack_top(&m_internal_storage_data.get_stack_top())
         {
+            m_stack_memory = m_internal_storage_data.access(ISData::STACK_SECTION_BEGINNING);
             // 相当于初始化
             reset();
         }
-        ~SimpleVM() {}
+
+        /// @brief 构造多核虚拟机中的一个核
+        /// 内存由所有核共享，寄存器、指令索引、栈顶和栈是每个核自己的：
+        /// 每个核的栈都有STACK_CAPACITY个机器字，不在共享内存中，所以核数不受栈区大小的限制
+        /// @param storage 所有核共享的内存
+        /// @param group 所有核共享的资源
+        BasicSimpleVM(std::shared_ptr<ISData> storage, std::shared_ptr<CoreGroup> group)
+            : m_storage(storage), m_internal_storage_data(*m_storage), m_core_group(group), m_stack_top(&m_core_stack_top), m_core_stack(ISData::STACK_CAPACITY, 0)
+        {
+            m_stack_memory = m_core_stack.data();
+            reset();
+        }
+        ~BasicSimpleVM()
+        {
+            enable_monitor(0);
+        }
 
     public:
         /// @brief 加载程序
         virtual void load_program(const ProgramData &program_data)
         {
             m_program_data = program_data;
-            memcpy_s(m_internal_storage_data.access(0), m_internal_storage_data.DATA_CAPACITY * sizeof(DWORD), program_data.data.data(), program_data.data.size() * sizeof(DWORD));
+            if (m_profiler)
+                m_profiler->reset(m_program_data.instructions.size());
+            memcpy(m_internal_storage_data.access(0), program_data.data.data(), std::min(program_data.data.size(), size_t(ISData::DATA_CAPACITY)) * sizeof(DWORD));
+            // 数据段可能还留着上一个程序更长的数据
+            mark_dirty(ISData::DATA_SECTION_BEGINNING, ISData::DATA_CAPACITY);
         }
 
     public:
@@ -227,19 +692,269 @@ namespace svm
         virtual void run()
         {
             m_vm_state.is_running = true;
+            run_guarded<false>();
+        }
+
+        /// @brief 只执行一条指令
+        /// 执行后虚拟机处于暂停状态（is_running为false），可以再调用step()或run()继续
+        /// @return 程序是否还能继续执行（没有结束，也没有发生异常）
+        virtual bool step()
+        {
+            if (m_vm_state.exception != ExceptionEnum::Exception::AOK)
+                return false;
+            m_vm_state.is_running = true;
+            run_guarded<true>();
+            const bool alive = m_vm_state.exception == ExceptionEnum::Exception::AOK && (m_vm_state.is_running || m_stop_reason != StopEnum::Reason::NONE);
+            m_vm_state.is_running = false;
+            return alive;
+        }
+
+        /// @brief 在保护页的保护下执行指令
+        /// @tparam single 是否只执行一条指令
+        template <bool single>
+        void run_guarded()
+        {
+            m_stop_reason = StopEnum::Reason::NONE;
+            m_budget_end = m_retired_instructions + m_run_budget;
+            perf_begin();
+            if (m_monitor)
+                publish_monitor();
+
+#if SVM_GUARD_PAGES
+            // 客户程序越界访问内存时，信号处理函数会跳回这里
+            GuardScope guard(m_internal_storage_data.get_region());
+            if (sigsetjmp(guard.context().env, 0) != 0)
+            {
+                memory_fault(guard.context().fault_address);
+                // 越界访问交给了客户程序的陷阱处理函数时，跳过出错的指令从处理函数继续
+                const bool vectored = m_vm_state.is_running && m_stop_reason == StopEnum::Reason::NONE;
+                if (vectored)
+                    m_program_data.current_instruction_index++;
+                if (!vectored || single)
+                {
+                    perf_end();
+                    if (m_monitor)
+                        publish_monitor();
+                    return;
+                }
+            }
+#endif
+
+            // 开启分析或跟踪时使用单独实例化的循环，都关闭时主循环中不留下任何检查
+#if SVM_PROFILER
+            if (m_profiler)
+            {
+                m_profiler->prepare(m_program_data.instructions.size());
+                if (m_trace)
+                    run_loop<true, true, single>();
+                else
+                    run_loop<true, false, single>();
+            }
+            else if (m_trace)
+                run_loop<false, true, single>();
+            else
+                run_loop<false, false, single>();
+#else
+            if (m_trace)
+                run_loop<false, true, single>();
+            else
+                run_loop<false, false, single>();
+#endif
+
+            service_devices();
+            perf_end();
+            if (m_monitor)
+                publish_monitor();
+        }
+
+        /// @brief 记录客户程序写过的内存，写到窗口中的部分不需要记录
+        /// @param pointer 写入的宿主地址
+        /// @param bytes 写入的字节数
+        void note_write(const void *pointer, size_t bytes)
+        {
+            const size_t offset = static_cast<const unsigned char *>(pointer) - reinterpret_cast<const unsigned char *>(m_internal_storage_data.get_internal_storage());
+            if (offset >= ISData::TOTAL_CAPACITY * sizeof(DWORD) || bytes == 0)
+                return;
+            mark_dirty(offset / sizeof(DWORD), (offset % sizeof(DWORD) + bytes + sizeof(DWORD) - 1) / sizeof(DWORD));
+        }
+
+        /// @brief 把被写过的内存块恢复为刚加载程序时的内容（数据段为程序数据，其余为0），然后清空标记
+        void restore_dirty_blocks()
+        {
+            DWORD *memory = m_internal_storage_data.get_internal_storage();
+            const size_t data_words = std::min(m_program_data.data.size(), size_t(ISData::DATA_CAPACITY));
+            for (size_t block = 0; block < DIRTY_BLOCK_COUNT; block++)
+            {
+                if ((m_dirty_blocks[block / 64] & (uint64_t(1) << (block % 64))) == 0)
+                    continue;
+                const size_t begin = block * DIRTY_BLOCK_WORDS;
+                const size_t end = std::min(begin + DIRTY_BLOCK_WORDS, size_t(ISData::TOTAL_CAPACITY));
+                const size_t copied = std::max(begin, std::min(data_words, end));
+                if (copied > begin)
+                    memcpy(memory + begin, m_program_data.data.data() + begin, (copied - begin) * sizeof(DWORD));
+                memset(memory + copied, 0, (end - copied) * sizeof(DWORD));
+            }
+            m_dirty_blocks.fill(0);
+        }
+
+        /// @brief 处理执行中的内存访问错误
+        /// 落在虚拟机内存里的错误只可能来自调试器保护的页（观察点），此时暂停在这条指令上，
+        /// 其余的都是越界访问
+        /// @param address 出错的宿主地址
+        void memory_fault(const void *address)
+        {
+            size_t offset;
+            if (m_internal_storage_data.get_region().offset_of(address, offset))
+            {
+                m_stop_reason = StopEnum::Reason::WATCHPOINT;
+                m_stop_address = offset / sizeof(DWORD);
+                m_vm_state.is_running = false;
+                return;
+            }
+            m_fault_address = DWORD((static_cast<const unsigned char *>(address) - reinterpret_cast<const unsigned char *>(m_internal_storage_data.get_internal_storage())) / ptrdiff_t(sizeof(DWORD)));
+            exception_adr();
+            m_fault_address = 0;
+        }
+
+        /// @brief 开启硬件计数时开始计数，计数器在运行虚拟机的线程上打开
+        void perf_begin()
+        {
+            if (!m_perf)
+                return;
+            m_perf_start_instructions = m_retired_instructions;
+            m_perf_start_syscalls = m_retired_syscalls;
+            m_perf->start();
+        }
+
+        /// @brief 开启硬件计数时停止计数，并把结果和虚拟机的计数放在一起
+        void perf_end()
+        {
+            if (!m_perf)
+                return;
+            m_perf->stop(m_perf_report);
+            m_perf_report.guest_instructions = m_retired_instructions - m_perf_start_instructions;
+            m_perf_report.guest_syscalls = m_retired_syscalls - m_perf_start_syscalls;
+        }
 
+        /// @brief 执行指令直到停止
+        /// @tparam profiling 是否记录到性能分析器
+        /// @tparam tracing 是否记录执行跟踪
+        /// @tparam single 是否只执行一条指令
+        template <bool profiling, bool tracing, bool single>
+        void run_loop()
+        {
             // 当异常状态处于AOK时运行虚拟机
             while (m_vm_state.exception == ExceptionEnum::Exception::AOK && m_vm_state.is_running)
             { // 判断当前指令索引是否越界
                 if (m_program_data.current_instruction_index >= m_program_data.instructions.size())
                 {
-                    // 越界时触发ADR异常
-                    exception_adr();
+                    // 越界时触发ADR异常，没有出错的指令可以返回，所以不交给客户程序的处理函数
+                    exception_adr(false);
                     break;
                 }
 
-                execute(m_program_data.instructions.at(m_program_data.current_instruction_index));
+                const size_t index = m_program_data.current_instruction_index;
+                const Instruction &inst = m_program_data.instructions.at(index);
+                if (profiling)
+                    m_profiler->record_instruction(index, inst.command);
+
+                // 跟踪时记下这条指令可能改变的寄存器的旧值，执行后只记录值变化了的寄存器
+                size_t traced = 0;
+                size_t traced_count = 0;
+                std::array<DWORD, TRACED_REGISTER_MAX> old_values;
+                if (tracing)
+                {
+                    traced_count = trace_step(index, inst, traced);
+                    for (size_t i = 0; i < traced_count; i++)
+                        old_values[i] = m_vm_state.general_registers[traced + i];
+                }
+
+                execute(inst);
+                m_retired_instructions++;
+
+                if (tracing)
+                {
+                    for (size_t i = 0; i < traced_count; i++)
+                        if (m_vm_state.general_registers[traced + i] != old_values[i])
+                            m_trace->append(index, TraceEnum::Kind::DELTA, inst.command, uint8_t(traced + i), m_vm_state.general_registers[traced + i]);
+                }
+
                 m_program_data.current_instruction_index++;
+
+                // 设备不在每次写内存时检查，而是每隔一段指令统一处理
+                if (--m_device_poll_countdown == 0)
+                {
+                    m_device_poll_countdown = DEVICE_POLL_INTERVAL;
+                    service_devices();
+                    // 快照也在这里发布，开启监控的代价只是每次轮询多一次比较
+                    if (m_monitor && m_retired_instructions >= m_monitor_next)
+                        publish_monitor();
+                    // 其他核发生了异常
+                    if (m_core_group && m_core_group->abort.load(std::memory_order_relaxed))
+                        m_vm_state.is_running = false;
+                    // 用完了指令数，把线程让给调度器中的其他虚拟机
+                    if (m_run_budget != 0 && m_retired_instructions >= m_budget_end && m_vm_state.is_running)
+                    {
+                        m_stop_reason = StopEnum::Reason::BUDGET;
+                        m_vm_state.is_running = false;
+                        if (m_trap_handler)
+                            report_trap(TrapEnum::Trap::BUDGET);
+                    }
+                }
+
+                if (single)
+                    break;
+            }
+        }
+
+        /// @brief 在执行一条指令前写入跟踪记录（系统调用还会记录参数）
+        /// 记录在执行前写入，所以即使指令触发了异常，它也会出现在跟踪记录中
+        /// @param index 指令索引
+        /// @param inst 指令
+        /// @param first 输出这条指令可能改变的第一个通用寄存器
+        /// @return 从first开始可能改变的通用寄存器个数（不超过TRACED_REGISTER_MAX）
+        size_t trace_step(size_t index, const Instruction &inst, size_t &first)
+        {
+            if (inst.command == CommandEnum::Command::SYSCALL)
+            {
+                for (uint8_t reg = RegisterEnum::GeneralRegister::AX; reg <= RegisterEnum::GeneralRegister::DX; reg++)
+                    m_trace->append(index, TraceEnum::Kind::SYSCALL_ARG, inst.command, reg, m_vm_state.general_registers[reg]);
+            }
+            m_trace->append(index, TraceEnum::Kind::STEP, inst.command, RegisterEnum::GeneralRegister::NONE, 0);
+
+            // 系统调用的返回值（例如通道的值和状态）和JOIN取回的结果都在AX~DX中
+            if (inst.command == CommandEnum::Command::SYSCALL || inst.command == CommandEnum::Command::JOIN)
+            {
+                first = RegisterEnum::GeneralRegister::AX;
+                return TRACED_REGISTER_MAX;
+            }
+            first = inst.register1;
+            return inst.register1 < RegisterEnum::GeneralRegister::GRCOUNT ? 1 : 0;
+        }
+
+        /// @brief 把设备映射到设备区域中的下一个空闲位置
+        /// @param device 要映射的设备
+        /// @return 是否成功（设备区域是否还有空间）
+        virtual bool map_device(std::shared_ptr<MMIODevice> device)
+        {
+            if (m_next_device_base + device->size() > ISData::DEVICE_SECTION_BEGINNING + ISData::DEVICE_CAPACITY)
+                return false;
+
+            device->set_base(m_next_device_base);
+            device->attach(m_internal_storage_data.access(m_next_device_base));
+            device->set_console(*m_console_input, *m_console_output);
+            m_next_device_base += device->size();
+            m_devices.push_back(device);
+            return true;
+        }
+
+        /// @brief 轮询所有设备，批量处理程序写入设备内存的数据
+        virtual void service_devices()
+        {
+            for (size_t i = 0; i < m_devices.size(); i++)
+            {
+                MMIODevice &device = *m_devices.at(i);
+                device.service(m_internal_storage_data.access(device.get_base()));
             }
         }
 
@@ -249,6 +964,9 @@ namespace svm
         {
             switch (inst.command)
             {
+            case CommandEnum::Command::NOP:
+                break;
+
             case CommandEnum::Command::HLT:
                 exception_hlt();
                 break;
@@ -258,11 +976,120 @@ namespace svm
                 inst_mov(inst);
                 break;
 
+            case CommandEnum::Command::LOAD:
+            case CommandEnum::Command::STORE:
+                inst_memory(inst);
+                break;
+
+            case CommandEnum::Command::LOADB:
+            case CommandEnum::Command::STOREB:
+            case CommandEnum::Command::LOADH:
+            case CommandEnum::Command::STOREH:
+            case CommandEnum::Command::LOADW:
+            case CommandEnum::Command::STOREW:
+                inst_memory_bytes(inst);
+                break;
+
+            case CommandEnum::Command::PUSH:
+            case CommandEnum::Command::POP:
+                inst_stack(inst);
+                break;
+
+            case CommandEnum::Command::CALL:
+            case CommandEnum::Command::RET:
+                inst_call(inst);
+                break;
+
+            case CommandEnum::Command::MEMCPY:
+            case CommandEnum::Command::MEMSET:
+            case CommandEnum::Command::MEMCMP:
+            case CommandEnum::Command::STRLEN:
+            case CommandEnum::Command::STRLENB:
+                inst_bulk(inst);
+                break;
+
+            case CommandEnum::Command::VLOAD:
+            case CommandEnum::Command::VSTORE:
+            case CommandEnum::Command::VBROADCAST:
+            case CommandEnum::Command::VADD:
+            case CommandEnum::Command::VSUB:
+            case CommandEnum::Command::VMUL:
+            case CommandEnum::Command::VMIN:
+            case CommandEnum::Command::VMAX:
+            case CommandEnum::Command::VCMPEQ:
+            case CommandEnum::Command::VCMPGT:
+            case CommandEnum::Command::VREDADD:
+            case CommandEnum::Command::VREDMIN:
+            case CommandEnum::Command::VREDMAX:
+                inst_vector(inst);
+                break;
+
+            case CommandEnum::Command::ADDRRR:
+            case CommandEnum::Command::ADDRRI:
+            case CommandEnum::Command::SUBRRR:
+            case CommandEnum::Command::SUBRRI:
+            case CommandEnum::Command::MULRRR:
+            case CommandEnum::Command::MULRRI:
+            case CommandEnum::Command::DIVRRR:
+            case CommandEnum::Command::DIVRRI:
+            case CommandEnum::Command::ANDRRR:
+            case CommandEnum::Command::ANDRRI:
+            case CommandEnum::Command::ORRRR:
+            case CommandEnum::Command::ORRRI:
+            case CommandEnum::Command::XORRRR:
+            case CommandEnum::Command::XORRRI:
+            case CommandEnum::Command::SHLRRR:
+            case CommandEnum::Command::SHLRRI:
+            case CommandEnum::Command::SHRRRR:
+            case CommandEnum::Command::SHRRRI:
+            case CommandEnum::Command::CMPRR:
+            case CommandEnum::Command::CMPRI:
+                inst_alu(inst);
+                break;
+
+            case CommandEnum::Command::JMP:
+            case CommandEnum::Command::JE:
+            case CommandEnum::Command::JNE:
+            case CommandEnum::Command::JL:
+            case CommandEnum::Command::JGE:
+            case CommandEnum::Command::JG:
+            case CommandEnum::Command::JLE:
+                inst_jump(inst);
+                break;
+
             case CommandEnum::Command::SYSCALL:
+                m_retired_syscalls++;
+#if SVM_PROFILER
+                if (m_profiler)
+                {
+                    profiled_system_call();
+                    break;
+                }
+#endif
                 if (!system_call())
                     exception_ins();
                 break;
 
+            case CommandEnum::Command::CAS:
+            case CommandEnum::Command::XADD:
+            case CommandEnum::Command::XCHG:
+            case CommandEnum::Command::FENCE:
+                inst_atomic(inst);
+                break;
+
+            case CommandEnum::Command::SPAWN:
+            case CommandEnum::Command::JOIN:
+                inst_fork_join(inst);
+                break;
+
+            case CommandEnum::Command::BRK:
+                // 停在断点上：这条指令不算执行，索引也不前进
+                m_stop_reason = StopEnum::Reason::BREAKPOINT;
+                m_vm_state.is_running = false;
+                m_retired_instructions--;
+                m_program_data.current_instruction_index--;
+                break;
+
             default:
                 exception_ins();
                 break;
@@ -289,71 +1116,792 @@ namespace svm
             }
         }
 
-        /// @brief 当碰到系统调用时，调用此函数
-        /// @return 如果系统调用已经被处理完，则返回true，否则返回false。当传递到execute()时如果仍然为false，则发出INS异常。
-        virtual bool system_call()
+        /// @brief 执行内存读写指令（寄存器+偏移寻址）。如果指令不是LOAD/STORE，直接发出ins异常。
+        /// @param inst 要执行的指令
+        virtual void inst_memory(const Instruction &inst)
         {
-            unsigned long &ax = m_vm_state.general_registers.at(RegisterEnum::GeneralRegister::AX);
-            unsigned long &bx = m_vm_state.general_registers.at(RegisterEnum::GeneralRegister::BX);
-            unsigned long &cx = m_vm_state.general_registers.at(RegisterEnum::GeneralRegister::CX);
-            unsigned long &dx = m_vm_state.general_registers.at(RegisterEnum::GeneralRegister::DX);
-
-            switch (ax)
+            DWORD *pointer = m_internal_storage_data.guest(m_vm_state.general_registers.at(inst.register2) + inst.operand1);
+            // 有保护页时这个判断在编译期就被去掉了
+            if (!GuardedRegion::GUARD_PAGES && pointer == nullptr)
             {
-            case CommandEnum::SystemCallNumber::PRINT_CHAR:
-            case CommandEnum::SystemCallNumber::PRINT_STRING:
-                syscall_print(ax, bx, cx, dx);
-                break;
+                exception_adr();
+                return;
+            }
 
-            case CommandEnum::SystemCallNumber::SCAN_CHAR:
-            case CommandEnum::SystemCallNumber::SCAN_STRING:
-                syscall_scan(ax, bx, cx, dx);
+            switch (inst.command)
+            {
+            case CommandEnum::Command::LOAD:
+                m_vm_state.general_registers.at(inst.register1) = *pointer;
                 break;
 
-            case CommandEnum::SystemCallNumber::EXIT:
-                syscall_exit(bx);
+            case CommandEnum::Command::STORE:
+                *pointer = m_vm_state.general_registers.at(inst.register1);
+                note_write(pointer, sizeof(DWORD));
                 break;
 
             default:
-                return false;
+                exception_ins();
                 break;
             }
-
-            return true;
         }
 
-        /// @brief 系统调用的PRINT类调用
-        /// @param ax AX寄存器的引用
-        /// @param bx BX寄存器的引用
-        /// @param cx CX寄存器的引用
-        /// @param dx DX寄存器的引用
-        virtual void syscall_print(unsigned long &ax, unsigned long &bx, unsigned long &cx, unsigned long &dx)
+        /// @brief 执行按字节寻址的内存读写指令。如果指令不是这类指令，直接发出ins异常。
+        /// @param inst 要执行的指令
+        virtual void inst_memory_bytes(const Instruction &inst)
         {
-            switch (ax)
+            size_t width;
+            switch (inst.command)
             {
-            case CommandEnum::SystemCallNumber::PRINT_CHAR:
-                switch (bx)
-                {
-                case CommandEnum::SystemEnum::STDIO:
-                    std::cout << static_cast<unsigned char>(cx);
-                    break;
-                case CommandEnum::SystemEnum::FILE:
-                    break;
-                default:
-                    exception_ins();
-                    break;
-                }
+            case CommandEnum::Command::LOADB:
+            case CommandEnum::Command::STOREB:
+                width = 1;
                 break;
+            case CommandEnum::Command::LOADH:
+            case CommandEnum::Command::STOREH:
+                width = 2;
+                break;
+            case CommandEnum::Command::LOADW:
+            case CommandEnum::Command::STOREW:
+                width = 4;
+                break;
+            default:
+                exception_ins();
+                return;
+            }
 
-            case CommandEnum::SystemCallNumber::PRINT_STRING:
-                switch (bx)
-                {
-                case CommandEnum::SystemEnum::STDIO:
-                    for (DWORD *ptr = &m_program_data.data.at(cx); *ptr != '\0'; ptr++)
-                    {
-                        std::cout << static_cast<unsigned char>(*ptr);
-                    }
-                    break;
+            unsigned char *pointer = m_internal_storage_data.guest_bytes(m_vm_state.general_registers.at(inst.register2) + inst.operand1, width);
+            if (!GuardedRegion::GUARD_PAGES && pointer == nullptr)
+            {
+                exception_adr();
+                return;
+            }
+
+            DWORD &reg = m_vm_state.general_registers.at(inst.register1);
+            switch (inst.command)
+            {
+            case CommandEnum::Command::LOADB:
+                reg = *pointer;
+                break;
+            case CommandEnum::Command::STOREB:
+                *pointer = static_cast<unsigned char>(reg);
+                note_write(pointer, width);
+                break;
+            case CommandEnum::Command::LOADH:
+            {
+                uint16_t value;
+                memcpy(&value, pointer, sizeof(value));
+                reg = value;
+                break;
+            }
+            case CommandEnum::Command::STOREH:
+            {
+                uint16_t value = static_cast<uint16_t>(reg);
+                memcpy(pointer, &value, sizeof(value));
+                note_write(pointer, width);
+                break;
+            }
+            case CommandEnum::Command::LOADW:
+            {
+                uint32_t value;
+                memcpy(&value, pointer, sizeof(value));
+                reg = value;
+                break;
+            }
+            default:
+            {
+                uint32_t value = static_cast<uint32_t>(reg);
+                memcpy(pointer, &value, sizeof(value));
+                note_write(pointer, width);
+                break;
+            }
+            }
+        }
+
+        /// @brief 执行原子指令。如果指令不是原子指令，直接发出ins异常。
+        /// 内存中的机器字总是按机器字对齐，可以直接当作std::atomic使用
+        /// @param inst 要执行的指令
+        virtual void inst_atomic(const Instruction &inst)
+        {
+            static_assert(sizeof(std::atomic<DWORD>) == sizeof(DWORD) && std::atomic<DWORD>::is_always_lock_free, "Guest words must be usable as lock-free atomics");
+
+            if (inst.command == CommandEnum::Command::FENCE)
+            {
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                return;
+            }
+
+            DWORD *pointer = m_internal_storage_data.guest(m_vm_state.general_registers.at(inst.register2) + inst.operand1);
+            if (!GuardedRegion::GUARD_PAGES && pointer == nullptr)
+            {
+                exception_adr();
+                return;
+            }
+            std::atomic<DWORD> &word = *reinterpret_cast<std::atomic<DWORD> *>(pointer);
+            DWORD &reg = m_vm_state.general_registers.at(inst.register1);
+            note_write(pointer, sizeof(DWORD));
+
+            switch (inst.command)
+            {
+            case CommandEnum::Command::CAS:
+            {
+                const DWORD expected = reg;
+                DWORD observed = expected;
+                word.compare_exchange_strong(observed, m_vm_state.general_registers.at(inst.register3));
+                reg = observed;
+                // 相当于比较原来的值和期望值，成功时ZF为1
+                m_vm_state.flag_source = VMState::FLAGS_COMPARE;
+                m_vm_state.flag_operand1 = observed;
+                m_vm_state.flag_operand2 = expected;
+                break;
+            }
+
+            case CommandEnum::Command::XADD:
+                // 先读出加数，寄存器1和寄存器3可以是同一个
+                reg = word.fetch_add(m_vm_state.general_registers.at(inst.register3));
+                break;
+
+            case CommandEnum::Command::XCHG:
+                reg = word.exchange(reg);
+                break;
+
+            default:
+                exception_ins();
+                break;
+            }
+        }
+
+        /// @brief 执行SPAWN或JOIN指令。没有设置执行者时发出ins异常。
+        /// @param inst 要执行的指令
+        virtual void inst_fork_join(const Instruction &inst)
+        {
+            if (m_fork_join == nullptr)
+            {
+                exception_ins();
+                return;
+            }
+
+            std::array<DWORD, RegisterEnum::GeneralRegister::GRCOUNT> &registers = m_vm_state.general_registers;
+            if (inst.command == CommandEnum::Command::SPAWN)
+            {
+                DWORD handle = 0;
+                if (!m_fork_join->spawn(registers, inst.operand1, handle))
+                {
+                    exception_ins();
+                    return;
+                }
+                registers.at(inst.register1) = handle;
+            }
+            else
+            {
+                std::array<DWORD, ForkJoinHost::RESULT_COUNT> results;
+                if (!m_fork_join->join(registers.at(inst.register1), results))
+                {
+                    exception_adr();
+                    return;
+                }
+                std::copy(results.begin(), results.end(), registers.begin());
+            }
+        }
+
+        /// @brief 执行PUSH/POP指令。如果指令不是PUSH/POP，直接发出ins异常。
+        /// 栈顶必须留在本核的栈内：单核时栈的下面是数据段，上面是堆和设备区，越界写入不会碰到保护页。
+        /// @param inst 要执行的指令
+        virtual void inst_stack(const Instruction &inst)
+        {
+            size_t &top = *m_stack_top;
+            DWORD *slot;
+
+            switch (inst.command)
+            {
+            case CommandEnum::Command::PUSH:
+                if (top + 1 >= ISData::STACK_CAPACITY)
+                {
+                    exception_adr();
+                    return;
+                }
+                // 先写入再移动栈顶，这样写入被观察点打断后可以重新执行
+                slot = m_stack_memory + top + 1;
+                *slot = m_vm_state.general_registers.at(inst.register1);
+                note_write(slot, sizeof(DWORD));
+                top++;
+                break;
+
+            case CommandEnum::Command::POP:
+                if (top == 0)
+                {
+                    exception_adr();
+                    return;
+                }
+                slot = m_stack_memory + top;
+                m_vm_state.general_registers.at(inst.register1) = *slot;
+                top--;
+                break;
+
+            default:
+                exception_ins();
+                break;
+            }
+        }
+
+        /// @brief 执行CALL/RET指令。如果指令不是CALL/RET，直接发出ins异常。
+        /// @param inst 要执行的指令
+        virtual void inst_call(const Instruction &inst)
+        {
+            size_t &top = *m_stack_top;
+
+            switch (inst.command)
+            {
+            case CommandEnum::Command::CALL:
+                if (top + 1 >= ISData::STACK_CAPACITY)
+                {
+                    exception_adr();
+                    return;
+                }
+                // 先写入返回地址再修改栈顶和调用帧，这样写入被观察点打断后可以重新执行
+                m_stack_memory[top + 1] = m_program_data.current_instruction_index + 1;
+                note_write(m_stack_memory + top + 1, sizeof(DWORD));
+                m_call_frames.push_back({m_program_data.current_instruction_index + 1, top});
+                top++;
+                // run()会在执行完后把索引加1
+                m_program_data.current_instruction_index = inst.operand1 - 1;
+                break;
+
+            case CommandEnum::Command::RET:
+            {
+                if (m_call_frames.empty())
+                {
+                    // 子任务从入口函数返回，正常结束
+                    if (m_task_mode)
+                    {
+                        m_vm_state.is_running = false;
+                        return;
+                    }
+                    exception_adr();
+                    return;
+                }
+                const CallFrame frame = m_call_frames.back();
+                m_call_frames.pop_back();
+                // 从陷阱处理函数返回
+                if (m_in_trap && m_call_frames.size() == m_trap_frame_depth)
+                    m_in_trap = false;
+
+                // 返回地址以栈上的值为准，程序可能改写了它
+                m_program_data.current_instruction_index = m_stack_memory[frame.stack_base + 1] - 1;
+                // 帧内没有弹出的值一并丢弃
+                top = frame.stack_base;
+                break;
+            }
+
+            default:
+                exception_ins();
+                break;
+            }
+        }
+
+        /// @brief 执行批量内存指令。如果指令不是批量内存指令，直接发出ins异常。
+        /// @param inst 要执行的指令
+        virtual void inst_bulk(const Instruction &inst)
+        {
+            const BulkKernels &kernels = bulk_kernels<DWORD>();
+            std::array<DWORD, RegisterEnum::GeneralRegister::GRCOUNT> &registers = m_vm_state.general_registers;
+
+            switch (inst.command)
+            {
+            case CommandEnum::Command::MEMCPY:
+            {
+                DWORD count = registers.at(inst.register3);
+                DWORD *dst = m_internal_storage_data.guest_range(registers.at(inst.register1), count);
+                DWORD *src = m_internal_storage_data.guest_range(registers.at(inst.register2), count);
+                if (dst == nullptr || src == nullptr)
+                {
+                    exception_adr();
+                    return;
+                }
+                // 标准库的memmove已经按CPU特性选择了最快的实现
+                memmove(dst, src, count * sizeof(DWORD));
+                note_write(dst, count * sizeof(DWORD));
+                break;
+            }
+
+            case CommandEnum::Command::MEMSET:
+            {
+                DWORD count = registers.at(inst.register3);
+                DWORD *dst = m_internal_storage_data.guest_range(registers.at(inst.register1), count);
+                if (dst == nullptr)
+                {
+                    exception_adr();
+                    return;
+                }
+                kernels.fill(dst, registers.at(inst.register2), count);
+                note_write(dst, count * sizeof(DWORD));
+                break;
+            }
+
+            case CommandEnum::Command::MEMCMP:
+            {
+                DWORD count = registers.at(inst.register3);
+                const DWORD *a = m_internal_storage_data.guest_range(registers.at(inst.register1), count);
+                const DWORD *b = m_internal_storage_data.guest_range(registers.at(inst.register2), count);
+                if (a == nullptr || b == nullptr)
+                {
+                    exception_adr();
+                    return;
+                }
+                size_t index = kernels.mismatch(a, b, count);
+                if (index == count)
+                    registers.at(inst.register1) = 0;
+                else
+                    registers.at(inst.register1) = a[index] > b[index] ? 1 : DWORD(-1);
+                break;
+            }
+
+            case CommandEnum::Command::STRLEN:
+            {
+                DWORD address = registers.at(inst.register2);
+                const size_t extent = m_internal_storage_data.guest_extent(address);
+                const DWORD *src = m_internal_storage_data.guest_range(address, DWORD(extent));
+                size_t length = src == nullptr ? 0 : kernels.find_zero(src, extent);
+                // 找不到结尾的0就说明已经读到内存（或窗口）之外了
+                if (src == nullptr || length == extent)
+                {
+                    exception_adr();
+                    return;
+                }
+                registers.at(inst.register1) = length;
+                break;
+            }
+
+            case CommandEnum::Command::STRLENB:
+            {
+                size_t length;
+                if (!guest_string(registers.at(inst.register2), length))
+                {
+                    exception_adr();
+                    return;
+                }
+                registers.at(inst.register1) = length;
+                break;
+            }
+
+            default:
+                exception_ins();
+                break;
+            }
+        }
+
+        /// @brief 执行向量指令。如果指令不是向量指令，直接发出ins异常。
+        /// @param inst 要执行的指令
+        virtual void inst_vector(const Instruction &inst)
+        {
+            std::array<VectorValue, RegisterEnum::VectorRegister::VRCOUNT> &vectors = m_vm_state.vector_registers;
+            std::array<DWORD, RegisterEnum::GeneralRegister::GRCOUNT> &registers = m_vm_state.general_registers;
+
+            switch (inst.command)
+            {
+            case CommandEnum::Command::VLOAD:
+            case CommandEnum::Command::VSTORE:
+            {
+                DWORD *pointer = m_internal_storage_data.guest_range(registers.at(inst.register2) + inst.operand1, VectorValue::LANES);
+                if (pointer == nullptr)
+                {
+                    exception_adr();
+                    return;
+                }
+                if (inst.command == CommandEnum::Command::VLOAD)
+                    memcpy(vectors.at(inst.register1).lanes, pointer, sizeof(VectorValue));
+                else
+                {
+                    memcpy(pointer, vectors.at(inst.register1).lanes, sizeof(VectorValue));
+                    note_write(pointer, sizeof(VectorValue));
+                }
+                break;
+            }
+
+            case CommandEnum::Command::VBROADCAST:
+            {
+                VectorValue &d = vectors.at(inst.register1);
+                DWORD value = registers.at(inst.register2);
+                for (size_t i = 0; i < VectorValue::LANES; i++)
+                    d.lanes[i] = value;
+                break;
+            }
+
+            case CommandEnum::Command::VADD:
+                simd::vector_add(vectors.at(inst.register1), vectors.at(inst.register2), vectors.at(inst.register3));
+                break;
+
+            case CommandEnum::Command::VSUB:
+                simd::vector_sub(vectors.at(inst.register1), vectors.at(inst.register2), vectors.at(inst.register3));
+                break;
+
+            case CommandEnum::Command::VMUL:
+                simd::vector_mul(vectors.at(inst.register1), vectors.at(inst.register2), vectors.at(inst.register3));
+                break;
+
+            case CommandEnum::Command::VMIN:
+                simd::vector_min(vectors.at(inst.register1), vectors.at(inst.register2), vectors.at(inst.register3));
+                break;
+
+            case CommandEnum::Command::VMAX:
+                simd::vector_max(vectors.at(inst.register1), vectors.at(inst.register2), vectors.at(inst.register3));
+                break;
+
+            case CommandEnum::Command::VCMPEQ:
+                simd::vector_cmpeq(vectors.at(inst.register1), vectors.at(inst.register2), vectors.at(inst.register3));
+                break;
+
+            case CommandEnum::Command::VCMPGT:
+                simd::vector_cmpgt(vectors.at(inst.register1), vectors.at(inst.register2), vectors.at(inst.register3));
+                break;
+
+            case CommandEnum::Command::VREDADD:
+                registers.at(inst.register1) = simd::vector_reduce_add(vectors.at(inst.register2));
+                break;
+
+            case CommandEnum::Command::VREDMIN:
+                registers.at(inst.register1) = simd::vector_reduce_min(vectors.at(inst.register2));
+                break;
+
+            case CommandEnum::Command::VREDMAX:
+                registers.at(inst.register1) = simd::vector_reduce_max(vectors.at(inst.register2));
+                break;
+
+            default:
+                exception_ins();
+                break;
+            }
+        }
+
+        /// @brief 执行算术逻辑指令。如果指令不是算术逻辑指令，直接发出ins异常。
+        /// 只记录结果，不计算标志寄存器。
+        /// @param inst 要执行的指令
+        virtual void inst_alu(const Instruction &inst)
+        {
+            std::array<DWORD, RegisterEnum::GeneralRegister::GRCOUNT> &registers = m_vm_state.general_registers;
+            // 移位数只取低位，避免移位超过机器字宽度
+            const DWORD shift_mask = sizeof(DWORD) * 8 - 1;
+
+            if (inst.command == CommandEnum::Command::CMPRR || inst.command == CommandEnum::Command::CMPRI)
+            {
+                // CMP的两个操作数是寄存器1和寄存器2（或操作数1）
+                m_vm_state.flag_source = VMState::FLAGS_COMPARE;
+                m_vm_state.flag_operand1 = registers.at(inst.register1);
+                m_vm_state.flag_operand2 = inst.command == CommandEnum::Command::CMPRR ? registers.at(inst.register2) : inst.operand1;
+                return;
+            }
+
+            const DWORD lhs = registers.at(inst.register2);
+            DWORD result;
+
+            switch (inst.command)
+            {
+            case CommandEnum::Command::ADDRRR:
+                result = lhs + registers.at(inst.register3);
+                break;
+            case CommandEnum::Command::ADDRRI:
+                result = lhs + inst.operand1;
+                break;
+            case CommandEnum::Command::SUBRRR:
+                result = lhs - registers.at(inst.register3);
+                break;
+            case CommandEnum::Command::SUBRRI:
+                result = lhs - inst.operand1;
+                break;
+            case CommandEnum::Command::MULRRR:
+                result = lhs * registers.at(inst.register3);
+                break;
+            case CommandEnum::Command::MULRRI:
+                result = lhs * inst.operand1;
+                break;
+            case CommandEnum::Command::DIVRRR:
+            case CommandEnum::Command::DIVRRI:
+            {
+                DWORD rhs = inst.command == CommandEnum::Command::DIVRRR ? registers.at(inst.register3) : inst.operand1;
+                if (rhs == 0)
+                {
+                    exception_div();
+                    return;
+                }
+                result = lhs / rhs;
+                break;
+            }
+            case CommandEnum::Command::ANDRRR:
+                result = lhs & registers.at(inst.register3);
+                break;
+            case CommandEnum::Command::ANDRRI:
+                result = lhs & inst.operand1;
+                break;
+            case CommandEnum::Command::ORRRR:
+                result = lhs | registers.at(inst.register3);
+                break;
+            case CommandEnum::Command::ORRRI:
+                result = lhs | inst.operand1;
+                break;
+            case CommandEnum::Command::XORRRR:
+                result = lhs ^ registers.at(inst.register3);
+                break;
+            case CommandEnum::Command::XORRRI:
+                result = lhs ^ inst.operand1;
+                break;
+            case CommandEnum::Command::SHLRRR:
+                result = lhs << (registers.at(inst.register3) & shift_mask);
+                break;
+            case CommandEnum::Command::SHLRRI:
+                result = lhs << (inst.operand1 & shift_mask);
+                break;
+            case CommandEnum::Command::SHRRRR:
+                result = lhs >> (registers.at(inst.register3) & shift_mask);
+                break;
+            case CommandEnum::Command::SHRRRI:
+                result = lhs >> (inst.operand1 & shift_mask);
+                break;
+
+            default:
+                exception_ins();
+                return;
+            }
+
+            registers.at(inst.register1) = result;
+            m_vm_state.flag_source = VMState::FLAGS_RESULT;
+            m_vm_state.flag_operand1 = result;
+        }
+
+        /// @brief 执行跳转指令。如果指令不是跳转指令，直接发出ins异常。
+        /// @param inst 要执行的指令
+        virtual void inst_jump(const Instruction &inst)
+        {
+            bool jump;
+            if (inst.command == CommandEnum::Command::JMP)
+            {
+                jump = true;
+            }
+            else
+            {
+                m_vm_state.materialize_flags();
+                const bool zf = m_vm_state.status_registers[RegisterEnum::StatusRegister::ZF];
+                const bool sf = m_vm_state.status_registers[RegisterEnum::StatusRegister::SF];
+
+                switch (inst.command)
+                {
+                case CommandEnum::Command::JE:
+                    jump = zf;
+                    break;
+                case CommandEnum::Command::JNE:
+                    jump = !zf;
+                    break;
+                case CommandEnum::Command::JL:
+                    jump = sf;
+                    break;
+                case CommandEnum::Command::JGE:
+                    jump = !sf;
+                    break;
+                case CommandEnum::Command::JG:
+                    jump = !zf && !sf;
+                    break;
+                case CommandEnum::Command::JLE:
+                    jump = zf || sf;
+                    break;
+                default:
+                    exception_ins();
+                    return;
+                }
+            }
+
+            // run()会在执行完后把索引加1
+            if (jump)
+                m_program_data.current_instruction_index = inst.operand1 - 1;
+        }
+
+        /// @brief 在虚拟机内存中查找以\0结尾的字节字符串
+        /// @param address 字符串的字节地址
+        /// @param length 字符串的长度（不含\0）
+        /// @return 是否成功（字符串是否完整地在内存中）
+        virtual bool guest_string(DWORD address, size_t &length)
+        {
+            const size_t extent = m_internal_storage_data.guest_byte_extent(address);
+            const unsigned char *src = m_internal_storage_data.guest_byte_range(address, DWORD(extent));
+            if (src == nullptr)
+                return false;
+            // memchr已经是按CPU特性选择的向量化实现
+            const void *end = memchr(src, '\0', extent);
+            if (end == nullptr)
+                return false;
+            length = static_cast<const unsigned char *>(end) - src;
+            return true;
+        }
+
+        /// @brief 开启性能分析时代替system_call()，记录调用号和耗时
+        virtual void profiled_system_call()
+        {
+            // 系统调用可能改写AX，先记下调用号
+            const DWORD number = m_vm_state.general_registers.at(RegisterEnum::GeneralRegister::AX);
+            auto begin = std::chrono::steady_clock::now();
+            const bool handled = system_call();
+            auto end = std::chrono::steady_clock::now();
+            m_profiler->record_syscall(size_t(number), uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count()));
+            if (!handled)
+                exception_ins();
+        }
+
+        /// @brief 当碰到系统调用时，调用此函数
+        /// @return 如果系统调用已经被处理完，则返回true，否则返回false。当传递到execute()时如果仍然为false，则发出INS异常。
+        virtual bool system_call()
+        {
+            // 多核时系统调用逐个执行
+            std::unique_lock<std::recursive_mutex> lock;
+            if (m_core_group)
+                lock = std::unique_lock<std::recursive_mutex>(m_core_group->syscall_mutex);
+
+            DWORD &ax = m_vm_state.general_registers.at(RegisterEnum::GeneralRegister::AX);
+            DWORD &bx = m_vm_state.general_registers.at(RegisterEnum::GeneralRegister::BX);
+            DWORD &cx = m_vm_state.general_registers.at(RegisterEnum::GeneralRegister::CX);
+            DWORD &dx = m_vm_state.general_registers.at(RegisterEnum::GeneralRegister::DX);
+
+            switch (ax)
+            {
+            case CommandEnum::SystemCallNumber::PRINT_CHAR:
+            case CommandEnum::SystemCallNumber::PRINT_STRING:
+                syscall_print(ax, bx, cx, dx);
+                break;
+
+            case CommandEnum::SystemCallNumber::SCAN_CHAR:
+            case CommandEnum::SystemCallNumber::SCAN_STRING:
+                syscall_scan(ax, bx, cx, dx);
+                break;
+
+            case CommandEnum::SystemCallNumber::EXIT:
+                syscall_exit(bx);
+                break;
+
+            case CommandEnum::SystemCallNumber::ALLOC:
+            case CommandEnum::SystemCallNumber::FREE:
+            case CommandEnum::SystemCallNumber::ARENA_ALLOC:
+            case CommandEnum::SystemCallNumber::HEAP_RESET:
+                syscall_heap(ax, bx, cx, dx);
+                break;
+
+            case CommandEnum::SystemCallNumber::SEND:
+            case CommandEnum::SystemCallNumber::RECV:
+            case CommandEnum::SystemCallNumber::SEND_BLOCK:
+            case CommandEnum::SystemCallNumber::RECV_BLOCK:
+            case CommandEnum::SystemCallNumber::CLOSE_CHANNEL:
+                syscall_channel(ax, bx, cx, dx);
+                break;
+
+            case CommandEnum::SystemCallNumber::TRAP_VECTOR:
+            case CommandEnum::SystemCallNumber::TRAP_INFO:
+                syscall_trap(ax, bx, cx, dx);
+                break;
+
+            default:
+                return false;
+                break;
+            }
+
+            return true;
+        }
+
+        /// @brief 系统调用的PRINT类调用
+        /// @param ax AX寄存器的引用
+        /// @param bx BX寄存器的引用
+        /// @param cx CX寄存器的引用
+        /// @param dx DX寄存器的引用
+        virtual void syscall_print(DWORD &ax, DWORD &bx, DWORD &cx, DWORD &dx)
+        {
+            switch (ax)
+            {
+            case CommandEnum::SystemCallNumber::PRINT_CHAR:
+                switch (bx)
+                {
+                case CommandEnum::SystemEnum::STDIO:
+                    *m_console_output << static_cast<unsigned char>(cx);
+                    break;
+                case CommandEnum::SystemEnum::FILE:
+                    break;
+                default:
+                    exception_ins();
+                    break;
+                }
+                break;
+
+            case CommandEnum::SystemCallNumber::PRINT_STRING:
+                switch (bx)
+                {
+                case CommandEnum::SystemEnum::STDIO:
+                {
+                    // 字符串以字节形式紧凑地存放在虚拟机内存中，找到结尾后直接整段输出
+                    size_t length;
+                    if (!guest_string(cx, length))
+                    {
+                        exception_adr();
+                        break;
+                    }
+                    m_console_output->write(reinterpret_cast<const char *>(m_internal_storage_data.guest_byte_range(cx, length)), length);
+                    break;
+                }
+                case CommandEnum::SystemEnum::FILE:
+                    break;
+                default:
+                    exception_ins();
+                    break;
+                }
+                break;
+
+            default:
+                exception_ins();
+                break;
+            }
+        }
+
+        /// @brief 系统调用的SCAN类调用
+        /// @param ax AX寄存器的引用
+        /// @param bx BX寄存器的引用
+        /// @param cx CX寄存器的引用
+        /// @param dx DX寄存器的引用
+        virtual void syscall_scan(DWORD &ax, DWORD &bx, DWORD &cx, DWORD &dx)
+        {
+            switch (ax)
+            {
+            case CommandEnum::SystemCallNumber::SCAN_CHAR:
+                switch (bx)
+                {
+                case CommandEnum::SystemEnum::STDIO:
+                    ax = static_cast<unsigned char>(m_console_input->get());
+                    break;
+                case CommandEnum::SystemEnum::FILE:
+                    break;
+                default:
+                    exception_ins();
+                    break;
+                }
+                break;
+
+            case CommandEnum::SystemCallNumber::SCAN_STRING:
+                switch (bx)
+                {
+                case CommandEnum::SystemEnum::STDIO:
+                {
+                    std::string word;
+                    if (!(*m_console_input >> word))
+                    {
+                        ax = 0;
+                        break;
+                    }
+                    // 缓冲区从堆中分配，字节紧凑存放
+                    HeapAllocator heap(m_internal_storage_data.get_internal_storage(), ISData::HEAP_SECTION_BEGINNING, ISData::HEAP_CAPACITY);
+                    DWORD buffer = heap.allocate_arena((word.size() + sizeof(DWORD)) / sizeof(DWORD));
+                    if (buffer == 0)
+                    {
+                        ax = 0;
+                        break;
+                    }
+                    ax = buffer * sizeof(DWORD);
+                    memcpy(m_internal_storage_data.guest_byte_range(ax, word.size() + 1), word.c_str(), word.size() + 1);
+                    // 分配只改动了BUMP，另外就是写入的缓冲区
+                    mark_dirty(ISData::HEAP_SECTION_BEGINNING + HeapAllocator::BUMP);
+                    mark_dirty(buffer, (word.size() + sizeof(DWORD)) / sizeof(DWORD));
+                    break;
+                }
                 case CommandEnum::SystemEnum::FILE:
                     break;
                 default:
@@ -368,27 +1916,145 @@ namespace svm
             }
         }
 
-        /// @brief 系统调用的SCAN类调用
+        /// @brief 系统调用的堆分配类调用
         /// @param ax AX寄存器的引用
         /// @param bx BX寄存器的引用
         /// @param cx CX寄存器的引用
         /// @param dx DX寄存器的引用
-        virtual void syscall_scan(unsigned long &ax, unsigned long &bx, unsigned long &cx, unsigned long &dx)
+        virtual void syscall_heap(DWORD &ax, DWORD &bx, DWORD &cx, DWORD &dx)
         {
+            HeapAllocator heap(m_internal_storage_data.get_internal_storage(), ISData::HEAP_SECTION_BEGINNING, ISData::HEAP_CAPACITY);
+            // 分配器的状态（BUMP和空闲链表头）在堆的开头，每种调用都可能改动它们；
+            // 除此之外只标记分配器写过的块头和空闲块的链表指针，restart()时不必恢复整个堆
+            mark_dirty(ISData::HEAP_SECTION_BEGINNING, HeapAllocator::BLOCKS);
+
             switch (ax)
             {
-            case CommandEnum::SystemCallNumber::PRINT_CHAR:
-                switch (bx)
+            case CommandEnum::SystemCallNumber::ALLOC:
+                ax = heap.allocate(bx);
+                // 新切出的块写了块头，复用的块的第一个DWORD还是链表指针
+                if (ax != 0)
+                    mark_dirty(ax - 1, 2);
+                break;
+
+            case CommandEnum::SystemCallNumber::FREE:
+                if (heap.free(bx))
                 {
-                case CommandEnum::SystemEnum::STDIO:
-                    std::cout << static_cast<unsigned char>(cx);
-                    break;
-                case CommandEnum::SystemEnum::FILE:
+                    // 链表指针写在块的第一个DWORD
+                    if (bx != 0)
+                        mark_dirty(bx);
+                    ax = CommandEnum::SystemEnum::SUCCESS;
+                }
+                else
+                    ax = CommandEnum::SystemEnum::FAILURE;
+                break;
+
+            case CommandEnum::SystemCallNumber::ARENA_ALLOC:
+                ax = heap.allocate_arena(bx);
+                break;
+
+            case CommandEnum::SystemCallNumber::HEAP_RESET:
+                heap.reset();
+                ax = CommandEnum::SystemEnum::SUCCESS;
+                break;
+
+            default:
+                exception_ins();
+                break;
+            }
+        }
+
+        /// @brief 系统调用的通道类调用
+        /// @param ax AX寄存器的引用
+        /// @param bx BX寄存器的引用
+        /// @param cx CX寄存器的引用
+        /// @param dx DX寄存器的引用
+        virtual void syscall_channel(DWORD &ax, DWORD &bx, DWORD &cx, DWORD &dx)
+        {
+            Channel *channel = m_channels ? m_channels->find(bx) : nullptr;
+            if (channel == nullptr)
+            {
+                if (ax == CommandEnum::SystemCallNumber::RECV)
+                    bx = CommandEnum::SystemEnum::FAILURE;
+                const bool counted = ax == CommandEnum::SystemCallNumber::SEND_BLOCK || ax == CommandEnum::SystemCallNumber::RECV_BLOCK || ax == CommandEnum::SystemCallNumber::RECV;
+                ax = counted ? 0 : CommandEnum::SystemEnum::FAILURE;
+                return;
+            }
+
+            // 先记下状态再尝试，这样尝试之后发生的变化一定能被调度器看到
+            const uint64_t state = channel->state();
+            switch (ax)
+            {
+            case CommandEnum::SystemCallNumber::SEND:
+            {
+                const DWORD value = cx;
+                if (channel->try_send(&value, 1) == 1)
+                    ax = CommandEnum::SystemEnum::SUCCESS;
+                else if (channel->is_closed())
+                    ax = CommandEnum::SystemEnum::FAILURE;
+                else
+                    park(channel, state);
+                break;
+            }
+
+            case CommandEnum::SystemCallNumber::RECV:
+            {
+                DWORD value = 0;
+                // 关闭前发送的数据可能在第一次尝试之后才到达，关闭后要再取一次
+                if (channel->try_receive(&value, 1) == 1 || (channel->is_closed() && channel->try_receive(&value, 1) == 1))
+                {
+                    ax = value;
+                    bx = CommandEnum::SystemEnum::SUCCESS;
+                }
+                else if (channel->is_closed())
+                {
+                    ax = 0;
+                    bx = CommandEnum::SystemEnum::FAILURE;
+                }
+                else
+                    park(channel, state);
+                break;
+            }
+
+            case CommandEnum::SystemCallNumber::SEND_BLOCK:
+            {
+                // 整段数据直接在虚拟机内存和通道之间复制，只检查一次边界
+                const DWORD *values = m_internal_storage_data.guest_range(cx, dx);
+                if (values == nullptr)
+                {
+                    exception_adr();
                     break;
-                default:
-                    exception_ins();
+                }
+                const size_t sent = dx == 0 ? 0 : channel->try_send(values, size_t(dx));
+                if (sent > 0 || dx == 0 || channel->is_closed())
+                    ax = sent;
+                else
+                    park(channel, state);
+                break;
+            }
+
+            case CommandEnum::SystemCallNumber::RECV_BLOCK:
+            {
+                DWORD *values = m_internal_storage_data.guest_range(cx, dx);
+                if (values == nullptr)
+                {
+                    exception_adr();
                     break;
                 }
+                size_t received = dx == 0 ? 0 : channel->try_receive(values, size_t(dx));
+                if (received == 0 && dx != 0 && channel->is_closed())
+                    received = channel->try_receive(values, size_t(dx));
+                note_write(values, received * sizeof(DWORD));
+                if (received > 0 || dx == 0 || channel->is_closed())
+                    ax = received;
+                else
+                    park(channel, state);
+                break;
+            }
+
+            case CommandEnum::SystemCallNumber::CLOSE_CHANNEL:
+                channel->close();
+                ax = CommandEnum::SystemEnum::SUCCESS;
                 break;
 
             default:
@@ -397,8 +2063,59 @@ namespace svm
             }
         }
 
-        virtual void syscall_exit(unsigned long bx)
+        /// @brief 系统调用的陷阱类调用
+        /// @param ax AX寄存器的引用
+        /// @param bx BX寄存器的引用
+        /// @param cx CX寄存器的引用
+        /// @param dx DX寄存器的引用
+        virtual void syscall_trap(DWORD &ax, DWORD &bx, DWORD &cx, DWORD &dx)
+        {
+            (void)dx;
+            switch (ax)
+            {
+            case CommandEnum::SystemCallNumber::TRAP_VECTOR:
+                // HLT是程序主动停止，不能被处理
+                if (bx < TrapEnum::Trap::ADR || bx >= m_trap_vectors.size() || cx >= m_program_data.instructions.size())
+                {
+                    ax = CommandEnum::SystemEnum::FAILURE;
+                    break;
+                }
+                m_trap_vectors[bx] = size_t(cx);
+                ax = CommandEnum::SystemEnum::SUCCESS;
+                break;
+
+            default:
+                ax = m_last_trap.trap;
+                bx = DWORD(m_last_trap.index);
+                cx = m_last_trap.address;
+                break;
+            }
+        }
+
+        /// @brief 暂停在当前的SYSCALL上，等待通道变化
+        /// 和BRK一样，这条指令不算执行，索引也不前进
+        /// @param channel 等待的通道
+        /// @param state 尝试之前通道的状态
+        void park(const Channel *channel, uint64_t state)
+        {
+            m_park_channel = channel;
+            m_park_state = state;
+            m_stop_reason = StopEnum::Reason::PARKED;
+            m_vm_state.is_running = false;
+            m_retired_instructions--;
+            m_retired_syscalls--;
+            m_program_data.current_instruction_index--;
+        }
+
+        virtual void syscall_exit(DWORD bx)
         {
+            // 先把设备中尚未输出的内容处理完
+            service_devices();
+
+            m_vm_state.is_running = false;
+            if (m_quiet)
+                return;
+
             switch (bx)
             {
             case CommandEnum::SystemEnum::SUCCESS:
@@ -416,13 +2133,36 @@ namespace svm
                 std::cout << "Program finished with code:" << bx << std::endl;
                 break;
             }
-
-            m_vm_state.is_running = false;
         }
 
         /// @brief 当发生异常时调用
         virtual void exception()
         {
+            // 多核时一个核发生异常，整台虚拟机都停止
+            std::unique_lock<std::recursive_mutex> lock;
+            if (m_core_group)
+            {
+                m_core_group->abort.store(true, std::memory_order_relaxed);
+                lock = std::unique_lock<std::recursive_mutex>(m_core_group->syscall_mutex);
+            }
+
+            service_devices();
+
+            // 保存异常前的执行跟踪
+            const bool dumped = m_trace && !m_trace_dump_file.empty() && m_trace->dump(m_trace_dump_file);
+            // 中止虚拟机运行
+            m_vm_state.is_running = false;
+            if (m_monitor)
+                publish_monitor();
+            // 交给宿主时不输出任何内容
+            if (m_trap_handler && m_vm_state.exception < ExceptionEnum::Exception::AOK)
+            {
+                report_trap(TrapEnum::Trap(m_vm_state.exception));
+                return;
+            }
+            if (m_quiet)
+                return;
+
             // 分割线
             print_split_line();
 
@@ -447,6 +2187,10 @@ namespace svm
                 std::cout << "Exception:INS" << std::endl;
                 break;
 
+            case ExceptionEnum::Exception::DIV:
+                std::cout << "Exception:DIV" << std::endl;
+                break;
+
             default:
                 std::cout << "Unknown exception:" << m_vm_state.exception << std::endl;
                 break;
@@ -455,8 +2199,8 @@ namespace svm
             // 输出发生异常的指令索引
             // 由于总是会向后一条，所以实际得减1
             std::cout << "when:" << m_program_data.current_instruction_index << std::endl;
-            // 中止虚拟机运行
-            m_vm_state.is_running = false;
+            if (dumped)
+                std::cout << "trace:" << m_trace_dump_file << std::endl;
             std::cout << "VM aborted" << std::endl;
         }
 
@@ -464,8 +2208,64 @@ namespace svm
         virtual void reset()
         {
             m_vm_state = VMState();
-            m_program_data = ProgramData();
-            m_internal_storage_data = ISData();
+            m_program_data.clear();
+            // 多核时内存由所有核共享，只重置本核自己的栈
+            if (m_core_group)
+            {
+                *m_stack_top = 0;
+                std::fill(m_core_stack.begin(), m_core_stack.end(), DWORD(0));
+            }
+            else
+                m_internal_storage_data.clear();
+            m_dirty_blocks.fill(0);
+
+            // 设备的映射保留，但要重新初始化设备寄存器
+            for (size_t i = 0; i < m_devices.size(); i++)
+            {
+                MMIODevice &device = *m_devices.at(i);
+                device.attach(m_internal_storage_data.access(device.get_base()));
+            }
+            m_device_poll_countdown = DEVICE_POLL_INTERVAL;
+            if (m_profiler)
+                m_profiler->reset(0);
+            if (m_trace)
+                m_trace->clear();
+            m_retired_instructions = 0;
+            m_retired_syscalls = 0;
+            m_stop_reason = StopEnum::Reason::NONE;
+            m_task_mode = false;
+            m_call_frames.clear();
+            m_call_frames.reserve(ISData::STACK_CAPACITY);
+            clear_trap_vectors();
+            if (m_monitor)
+                publish_monitor();
+        }
+
+        /// @brief 从头重新运行已经加载的程序，不重新复制指令
+        /// 寄存器、栈和内存（包括堆）恢复到刚加载时的状态，设备、分析器、通道和映射的窗口保留。
+        /// 内存只恢复上次重置之后被写过的块，宿主直接写入内存时要用mark_dirty()告诉虚拟机
+        virtual void restart()
+        {
+            m_vm_state = VMState();
+            m_program_data.current_instruction_index = 0;
+            *m_stack_top = 0;
+            if (!m_core_group)
+            {
+                // 设备寄存器由attach()重新初始化
+                if (!m_devices.empty())
+                    mark_dirty(ISData::DEVICE_SECTION_BEGINNING, ISData::DEVICE_CAPACITY);
+                restore_dirty_blocks();
+                for (size_t i = 0; i < m_devices.size(); i++)
+                {
+                    MMIODevice &device = *m_devices.at(i);
+                    device.attach(m_internal_storage_data.access(device.get_base()));
+                }
+            }
+            m_device_poll_countdown = DEVICE_POLL_INTERVAL;
+            m_stop_reason = StopEnum::Reason::NONE;
+            m_task_mode = false;
+            m_call_frames.clear();
+            clear_trap_vectors();
         }
 
     public:
@@ -478,8 +2278,11 @@ namespace svm
         }
 
         /// @brief 触发ADR异常
-        virtual void exception_adr()
+        /// @param vectored 是否可以交给客户程序的处理函数（指令索引越界时不能）
+        virtual void exception_adr(bool vectored = true)
         {
+            if (vectored && enter_trap_vector(TrapEnum::Trap::ADR))
+                return;
             m_vm_state.exception = ExceptionEnum::Exception::ADR;
             m_vm_state.is_running = false;
             exception();
@@ -488,11 +2291,66 @@ namespace svm
         /// @brief 触发INS异常
         virtual void exception_ins()
         {
+            if (enter_trap_vector(TrapEnum::Trap::INS))
+                return;
             m_vm_state.exception = ExceptionEnum::Exception::INS;
             m_vm_state.is_running = false;
             exception();
         }
 
+        /// @brief 触发DIV异常
+        virtual void exception_div()
+        {
+            if (enter_trap_vector(TrapEnum::Trap::DIV))
+                return;
+            m_vm_state.exception = ExceptionEnum::Exception::DIV;
+            m_vm_state.is_running = false;
+            exception();
+        }
+
+        /// @brief 把陷阱交给客户程序的处理函数：相当于从出错的指令CALL处理函数
+        /// @param trap 陷阱类型
+        /// @return 是否交给了处理函数（否则照常中止）
+        bool enter_trap_vector(TrapEnum::Trap trap)
+        {
+            const size_t handler = m_trap_vectors[trap];
+            size_t &top = *m_stack_top;
+            if (handler == 0 || m_in_trap || top + 1 >= ISData::STACK_CAPACITY)
+                return false;
+
+            const size_t index = m_program_data.current_instruction_index;
+            m_stack_memory[top + 1] = index + 1;
+            note_write(m_stack_memory + top + 1, sizeof(DWORD));
+            m_trap_frame_depth = m_call_frames.size();
+            m_call_frames.push_back({index + 1, top});
+            top++;
+            m_in_trap = true;
+            // run()会在执行完后把索引加1
+            m_program_data.current_instruction_index = handler - 1;
+
+            m_last_trap = {trap, index, trap == TrapEnum::Trap::ADR ? m_fault_address : DWORD(0), m_retired_instructions, true, m_trap_source};
+            if (m_trap_handler)
+                m_trap_handler->on_trap(m_last_trap);
+            return true;
+        }
+
+        /// @brief 把一次没有交给客户程序的陷阱报告给宿主
+        /// @param trap 陷阱类型
+        void report_trap(TrapEnum::Trap trap)
+        {
+            const TrapRecord record = {trap, m_program_data.current_instruction_index, trap == TrapEnum::Trap::ADR ? m_fault_address : DWORD(0), m_retired_instructions, false, m_trap_source};
+            m_trap_handler->on_trap(record);
+        }
+
+        /// @brief 取消客户程序设置的所有陷阱处理函数
+        void clear_trap_vectors()
+        {
+            m_trap_vectors.fill(0);
+            m_in_trap = false;
+            m_trap_frame_depth = 0;
+            m_last_trap = TrapRecord{};
+        }
+
         /// @brief 取消异常
         virtual void exception_aok()
         {
@@ -501,10 +2359,344 @@ namespace svm
         }
 
     public:
+        /// @brief 开启或关闭性能分析，开启时清空之前的计数
+        /// 定义了SVM_NO_PROFILER时分析器不会记录任何数据
+        /// @param enable 是否开启
+        virtual void enable_profiler(bool enable)
+        {
+            if (!enable)
+            {
+                m_profiler.reset();
+                return;
+            }
+            if (!m_profiler)
+                m_profiler.reset(new Profiler());
+            m_profiler->reset(m_program_data.instructions.size());
+        }
+
+        /// @brief 开启或关闭执行跟踪
+        /// @param capacity 环形缓冲区最多保留的记录条数，为0时关闭跟踪
+        /// @param dump_file 发生异常时把跟踪记录写入的文件，为空时不写
+        virtual void enable_trace(size_t capacity, const std::string &dump_file = "")
+        {
+            m_trace_dump_file = dump_file;
+            if (capacity == 0)
+                m_trace.reset();
+            else
+                m_trace.reset(new TraceRecorder(capacity, sizeof(DWORD) * 8));
+        }
+
+        /// @brief 把当前的跟踪记录写入文件
+        /// @param filename 文件名
+        /// @return 是否成功（没有开启跟踪时返回false）
+        virtual bool dump_trace(const std::string &filename)
+        {
+            return m_trace && m_trace->dump(filename);
+        }
+
+        /// @brief 开启或关闭硬件性能计数，开启后每次run()都会计数
+        /// @param enable 是否开启
+        /// @return 是否有可用的计数器（没有时run()仍然会统计客户指令数）
+        virtual bool enable_perf_counters(bool enable)
+        {
+            if (!enable)
+            {
+                m_perf.reset();
+                return false;
+            }
+            if (!m_perf)
+                m_perf.reset(new PerfCounters());
+            return m_perf->any_available();
+        }
+
+        /// @brief 开启或关闭监控，开启后虚拟机定期把状态快照发布到MonitorRegistry
+        /// 快照在轮询设备时发布，所以实际间隔会向上取整为DEVICE_POLL_INTERVAL的倍数；
+        /// run()开始、结束和发生异常时也会发布。
+        /// @param interval 发布间隔（指令条数），为0时关闭监控
+        /// @param name 指标中的虚拟机名字，为空时自动生成
+        virtual void enable_monitor(uint64_t interval, const std::string &name = "")
+        {
+            if (m_monitor)
+            {
+                MonitorRegistry::instance().remove(m_monitor);
+                m_monitor.reset();
+            }
+            m_monitor_interval = interval;
+            if (interval == 0)
+                return;
+            m_monitor = MonitorRegistry::instance().add(name);
+            publish_monitor();
+        }
+
+        /// @brief 把当前状态发布到监控槽（只能在运行虚拟机的线程中调用）
+        void publish_monitor()
+        {
+            MonitorSnapshot snapshot;
+            for (size_t i = 0; i < snapshot.general_registers.size(); i++)
+                snapshot.general_registers[i] = m_vm_state.general_registers[i];
+            m_vm_state.materialize_flags();
+            snapshot.instruction_index = m_program_data.current_instruction_index;
+            snapshot.retired_instructions = m_retired_instructions;
+            snapshot.retired_syscalls = m_retired_syscalls;
+            snapshot.exception = m_vm_state.exception;
+            snapshot.is_running = m_vm_state.is_running;
+            snapshot.zero_flag = m_vm_state.status_registers[RegisterEnum::StatusRegister::ZF];
+            snapshot.sign_flag = m_vm_state.status_registers[RegisterEnum::StatusRegister::SF];
+            snapshot.word_bits = sizeof(DWORD) * 8;
+            snapshot.publish_count = ++m_monitor_publish_count;
+            m_monitor->publish(snapshot);
+            m_monitor_next = m_retired_instructions + m_monitor_interval;
+        }
+
+        /// @brief 获取监控槽
+        /// @return 监控槽的指针，没有开启时为nullptr
+        MonitorSlot *get_monitor()
+        {
+            return m_monitor.get();
+        }
+
+        /// @brief 设置通道表，多个虚拟机使用同一个表时可以通过通道通信
+        /// @param channels 通道表，为空时通道调用都失败
+        virtual void attach_channels(std::shared_ptr<ChannelTable> channels)
+        {
+            m_channels = channels;
+        }
+
+        /// @brief 标记一段内存被宿主写过，下次restart()时恢复
+        /// 客户程序的写入由虚拟机自己标记，只有宿主直接写入内存时才需要调用
+        /// @param address 起始地址（单位为机器字），超出内存的部分忽略
+        /// @param count 长度（单位为机器字）
+        void mark_dirty(size_t address, size_t count = 1)
+        {
+            if (count == 0 || address >= ISData::TOTAL_CAPACITY)
+                return;
+            const size_t last = (address + std::min(count, ISData::TOTAL_CAPACITY - address) - 1) / DIRTY_BLOCK_WORDS;
+            for (size_t block = address / DIRTY_BLOCK_WORDS; block <= last; block++)
+                m_dirty_blocks[block / 64] |= uint64_t(1) << (block % 64);
+        }
+
+        /// @brief 标记整个内存被宿主写过
+        void mark_all_dirty()
+        {
+            mark_dirty(0, ISData::TOTAL_CAPACITY);
+        }
+
+        /// @brief 设置是否不输出程序结束和异常的信息
+        /// @param quiet 是否不输出
+        void set_quiet(bool quiet)
+        {
+            m_quiet = quiet;
+        }
+
+        /// @brief 设置STDIO输入输出系统调用和控制台设备使用的流，例如把一次运行的输入输出接到内存或套接字上
+        /// 流由调用者拥有，必须比这次运行活得长；restart()不会恢复默认的流
+        /// @param input 输入流
+        /// @param output 输出流
+        void set_console(std::istream &input, std::ostream &output)
+        {
+            m_console_input = &input;
+            m_console_output = &output;
+            for (size_t i = 0; i < m_devices.size(); i++)
+                m_devices.at(i)->set_console(input, output);
+        }
+
+        /// @brief 恢复默认的std::cin和std::cout
+        void reset_console()
+        {
+            set_console(std::cin, std::cout);
+        }
+
+        /// @brief 把共享内存文件映射为客户内存之后的一个窗口，客户程序用LOAD/STORE直接访问，不需要复制
+        /// 窗口位于TOTAL_CAPACITY之后的保护页区域。批量内存指令、字符串和通道的批量收发也可以访问窗口，
+        /// 但整个范围必须落在内存和首尾相接的窗口里（不能跨过没有映射的地址）
+        /// @param fd 共享内存文件（例如memfd），映射从文件开头开始
+        /// @param address 窗口的客户地址，必须不小于TOTAL_CAPACITY，并且离TOTAL_CAPACITY是get_window_alignment()的倍数
+        /// @param words 窗口大小（单位为机器字，向上取整到页）
+        /// @return 是否成功（不使用保护页时总是失败）
+        virtual bool bind_window(int fd, DWORD address, size_t words)
+        {
+            if (address < ISData::TOTAL_CAPACITY || (address - ISData::TOTAL_CAPACITY) % get_window_alignment() != 0)
+                return false;
+            return m_internal_storage_data.get_region().map_window(fd, size_t(address) * sizeof(DWORD), words * sizeof(DWORD));
+        }
+
+        /// @brief 取消bind_window()映射的窗口，窗口所在的地址重新成为保护页
+        /// @param address 窗口的客户地址
+        /// @param words 窗口大小（单位为机器字）
+        /// @return 是否成功
+        virtual bool unbind_window(DWORD address, size_t words)
+        {
+            if (address < ISData::TOTAL_CAPACITY || (address - ISData::TOTAL_CAPACITY) % get_window_alignment() != 0)
+                return false;
+            return m_internal_storage_data.get_region().unmap_window(size_t(address) * sizeof(DWORD), words * sizeof(DWORD));
+        }
+
+        /// @brief 获取窗口地址的对齐要求
+        /// @return 对齐（单位为机器字，即一页的机器字数）
+        static size_t get_window_alignment()
+        {
+            return GuardedRegion::page_size() / sizeof(DWORD);
+        }
+
+        /// @brief 设置接收陷阱记录的宿主
+        /// 设置之后异常不再输出到控制台，而是连同预算用完、交给客户程序处理的陷阱一起交给宿主
+        /// @param handler 宿主（不拥有，必须比虚拟机活得久），为空时恢复输出到控制台
+        /// @param source 这台虚拟机的陷阱记录中的source
+        virtual void attach_trap_handler(TrapHandler *handler, size_t source = 0)
+        {
+            m_trap_handler = handler;
+            m_trap_source = source;
+        }
+
+        /// @brief 获取最近一次交给客户程序处理函数的陷阱
+        /// @return 陷阱记录
+        const TrapRecord &get_last_trap() const
+        {
+            return m_last_trap;
+        }
+
+        /// @brief 设置SPAWN和JOIN指令的执行者
+        /// @param host 执行者（不拥有，必须比虚拟机活得久），为空时这两条指令发出ins异常
+        virtual void attach_fork_join(ForkJoinHost *host)
+        {
+            m_fork_join = host;
+        }
+
+        /// @brief 准备执行一个子任务：设置通用寄存器，从指定的指令开始，清空栈和返回地址栈
+        /// 之后调用run()执行，入口函数执行RET时正常结束
+        /// @param registers 通用寄存器
+        /// @param index 开始执行的指令索引
+        virtual void enter(const std::array<DWORD, RegisterEnum::GeneralRegister::GRCOUNT> &registers, size_t index)
+        {
+            m_vm_state.general_registers = registers;
+            m_vm_state.flag_source = VMState::FLAGS_READY;
+            m_vm_state.status_registers.fill(false);
+            m_vm_state.exception = ExceptionEnum::Exception::AOK;
+            m_program_data.current_instruction_index = index;
+            *m_stack_top = 0;
+            m_call_frames.clear();
+            m_stop_reason = StopEnum::Reason::NONE;
+            m_task_mode = true;
+            clear_trap_vectors();
+        }
+
+        /// @brief 获取通道表
+        /// @return 通道表的指针，没有设置时为nullptr
+        ChannelTable *get_channels()
+        {
+            return m_channels.get();
+        }
+
+        /// @brief 设置每次run()最多执行的指令数，用完后暂停（StopEnum::BUDGET）
+        /// 只在轮询设备时检查，所以实际执行的指令数会向上取整为DEVICE_POLL_INTERVAL的倍数
+        /// @param instructions 指令数，为0时不限制
+        void set_run_budget(uint64_t instructions)
+        {
+            m_run_budget = instructions;
+        }
+
+        /// @brief 判断暂停在通道上的虚拟机是否值得再次运行（通道已经变化）
+        /// @return 是否值得再次运行，没有暂停在通道上时总是true
+        bool is_park_ready() const
+        {
+            return m_stop_reason != StopEnum::Reason::PARKED || m_park_channel->state() != m_park_state;
+        }
+
+        /// @brief 获取上一次run()或step()暂停的原因
+        StopEnum::Reason get_stop_reason() const
+        {
+            return m_stop_reason;
+        }
+
+        /// @brief 获取观察点暂停时被访问的内存位置
+        /// @return 位置（单位为机器字，和LOAD/STORE的地址相同）
+        size_t get_stop_address() const
+        {
+            return m_stop_address;
+        }
+
+        /// @brief 获取上一次run()的硬件计数结果
+        /// @return 结果的引用
+        const PerfReport &get_perf_report() const
+        {
+            return m_perf_report;
+        }
+
+        /// @brief 获取执行过的指令总数
+        uint64_t get_retired_instructions() const
+        {
+            return m_retired_instructions;
+        }
+
+        /// @brief 获取执行过的系统调用总数
+        uint64_t get_retired_syscalls() const
+        {
+            return m_retired_syscalls;
+        }
+
+        /// @brief 恢复执行过的指令数和系统调用数（从检查点恢复时使用）
+        void restore_retired_counts(uint64_t instructions, uint64_t syscalls)
+        {
+            m_retired_instructions = instructions;
+            m_retired_syscalls = syscalls;
+        }
+
+        /// @brief 获取宿主侧的调用帧
+        /// @return 调用帧的引用
+        std::vector<CallFrame> &get_call_frames()
+        {
+            return m_call_frames;
+        }
+
+        /// @brief 获取客户程序的陷阱处理函数（指令索引，按陷阱类型，为0时没有）
+        /// @return 处理函数表的引用
+        std::array<size_t, TrapEnum::Trap::DIV + 1> &get_trap_vectors()
+        {
+            return m_trap_vectors;
+        }
+
+        /// @brief 是否正在执行陷阱处理函数
+        bool is_in_trap() const
+        {
+            return m_in_trap;
+        }
+
+        /// @brief 获取陷阱处理函数返回后调用帧的个数
+        size_t get_trap_frame_depth() const
+        {
+            return m_trap_frame_depth;
+        }
+
+        /// @brief 恢复陷阱处理函数的执行状态（从检查点恢复时使用）
+        /// @param in_trap 是否正在执行陷阱处理函数
+        /// @param frame_depth 处理函数返回后调用帧的个数
+        /// @param last_trap 最近一次交给处理函数的陷阱
+        void restore_trap_state(bool in_trap, size_t frame_depth, const TrapRecord &last_trap)
+        {
+            m_in_trap = in_trap;
+            m_trap_frame_depth = frame_depth;
+            m_last_trap = last_trap;
+        }
+
+        /// @brief 获取执行跟踪记录器
+        /// @return 记录器的指针，没有开启时为nullptr
+        TraceRecorder *get_trace()
+        {
+            return m_trace.get();
+        }
+
+        /// @brief 获取性能分析器
+        /// @return 分析器的指针，没有开启时为nullptr
+        Profiler *get_profiler()
+        {
+            return m_profiler.get();
+        }
+
         /// @brief 获取虚拟机的状态
-        /// @return 虚拟机状态的引用
+        /// @return 虚拟机状态的引用（标志寄存器已经计算好）
         VMState &get_vm_state()
         {
+            m_vm_state.materialize_flags();
             return m_vm_state;
         }
 
@@ -522,6 +2714,9 @@ namespace svm
             return m_internal_storage_data;
         }
     };
+
+    using SimpleVM = BasicSimpleVM<DWORD64>;
+    using SimpleVM32 = BasicSimpleVM<DWORD32>;
 } // namespace svm
 
 #endif
\ No newline at end of file
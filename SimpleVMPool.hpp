@@ -0,0 +1,140 @@
+#ifndef __SIMPLE_VM_POOL_HPP__
+#define __SIMPLE_VM_POOL_HPP__
+
+#include <mutex>
+#include <vector>
+#include <memory>
+#include "SimpleVM.hpp"
+
+namespace svm
+{
+    /// @brief 虚拟机池
+    /// 所有虚拟机都加载同一个程序。创建虚拟机要预留整个客户地址空间，代价比运行一个短程序高得多，
+    /// 所以用完的虚拟机不销毁，而是用restart()恢复被写过的内存块后放回池中，下次直接交给调用者。
+    /// 池可以在多个线程中同时使用，每台虚拟机同一时间只属于一个调用者。
+    /// @tparam WordT 机器字类型
+    template <typename WordT>
+    class BasicVMPool
+    {
+    public:
+        /// @brief 机器字类型
+        using DWORD = WordT;
+        using VM = BasicSimpleVM<WordT>;
+        using ProgramData = typename VM::ProgramData;
+
+    private:
+        /// @brief 所有虚拟机加载的程序
+        ProgramData m_program;
+        /// @brief 最多保留的空闲虚拟机数
+        size_t m_max_idle;
+        /// @brief 新建的虚拟机是否不输出程序结束和异常的信息
+        bool m_quiet;
+
+        /// @brief 保护下面的空闲列表和计数
+        std::mutex m_mutex;
+        /// @brief 空闲的虚拟机，都已经可以直接运行
+        std::vector<std::unique_ptr<VM>> m_idle;
+        /// @brief 还存在的虚拟机数（空闲的和被取出的）
+        size_t m_live = 0;
+        /// @brief 从池中取出的总次数
+        size_t m_acquired = 0;
+
+    public:
+        /// @brief 构造函数
+        /// @param program 所有虚拟机加载的程序
+        /// @param prewarm 预先创建的虚拟机数
+        /// @param max_idle 最多保留的空闲虚拟机数，多出来的在放回时销毁
+        /// @param quiet 新建的虚拟机是否不输出程序结束和异常的信息
+        BasicVMPool(const ProgramData &program, size_t prewarm = 0, size_t max_idle = 64, bool quiet = true)
+            : m_program(program), m_max_idle(std::max(max_idle, prewarm)), m_quiet(quiet)
+        {
+            for (size_t i = 0; i < prewarm; i++)
+                m_idle.push_back(create());
+        }
+
+        BasicVMPool(const BasicVMPool &) = delete;
+        BasicVMPool &operator=(const BasicVMPool &) = delete;
+
+        ~BasicVMPool() {}
+
+    public:
+        /// @brief 取出一台可以直接运行的虚拟机，池空时新建一台
+        /// @return 虚拟机，用完后交给release()
+        std::unique_ptr<VM> acquire()
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_acquired++;
+                if (!m_idle.empty())
+                {
+                    std::unique_ptr<VM> vm = std::move(m_idle.back());
+                    m_idle.pop_back();
+                    return vm;
+                }
+            }
+            return create();
+        }
+
+        /// @brief 放回用完的虚拟机
+        /// 重置在调用者的线程上、锁外完成，这样acquire()拿到的总是干净的虚拟机。
+        /// 设备、运行预算等设置不会被重置，调用者改过的话要自己改回来。
+        /// @param vm 从这个池中取出的虚拟机
+        void release(std::unique_ptr<VM> vm)
+        {
+            if (!vm)
+                return;
+            vm->restart();
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_idle.size() < m_max_idle)
+                m_idle.push_back(std::move(vm));
+            else
+                m_live--;
+        }
+
+    public:
+        /// @brief 获取池中空闲的虚拟机数
+        size_t get_idle_count()
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_idle.size();
+        }
+
+        /// @brief 获取还存在的虚拟机总数（空闲的和被取出的）
+        size_t get_live_count()
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_live;
+        }
+
+        /// @brief 获取从池中取出的总次数
+        size_t get_acquired_count()
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_acquired;
+        }
+
+        /// @brief 获取所有虚拟机加载的程序
+        const ProgramData &get_program() const
+        {
+            return m_program;
+        }
+
+    private:
+        /// @brief 新建一台加载好程序的虚拟机
+        std::unique_ptr<VM> create()
+        {
+            std::unique_ptr<VM> vm(new VM());
+            vm->set_quiet(m_quiet);
+            vm->load_program(m_program);
+            vm->restart();
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_live++;
+            return vm;
+        }
+    };
+
+    using VMPool = BasicVMPool<DWORD64>;
+    using VMPool32 = BasicVMPool<DWORD32>;
+} // namespace svm
+
+#endif
@@ -7,6 +7,7 @@
 #include <fstream>
 #include <iostream>
 #include <algorithm>
+#include "SimpleInst.hpp"
 
 #define STR(x) #x
 #define UTIL_GREGISTER_NAME(reg)               \
@@ -16,6 +17,12 @@
 
 namespace svm
 {
+    // 定义在SimpleVM.hpp中，这里的函数模板只在实例化时才用到它们的成员
+    template <typename WordT>
+    struct BasicVMState;
+    template <typename WordT>
+    struct BasicProgramData;
+
     bool load_from_file(const std::string &filename, std::vector<std::string> &result)
     {
         std::ifstream fin;
@@ -101,6 +108,7 @@ namespace svm
         {
             if (container.at(result) == value)
                 return result;
+            result++;
         }
         return result;
     }
@@ -135,14 +143,16 @@ namespace svm
     /// @brief 打印通用寄存器
     /// @param reg 寄存器索引
     /// @param end 结束符，默认为\n
-    void print_gregister(const VMState &vm_state, RegisterEnum::GeneralRegister reg, std::string end = "\n")
+    template <typename WordT>
+    void print_gregister(const BasicVMState<WordT> &vm_state, RegisterEnum::GeneralRegister reg, std::string end = "\n")
     {
         std::cout << get_gregister_name(reg) << ":" << vm_state.general_registers.at(reg) << end;
     }
 
     /// @brief 打印所有通用寄存器
     /// @param end 结束符，默认为\n
-    void print_all_gregisters(const VMState &vm_state, std::string end = "\n")
+    template <typename WordT>
+    void print_all_gregisters(const BasicVMState<WordT> &vm_state, std::string end = "\n")
     {
         for (size_t i = 0; i < RegisterEnum::GeneralRegister::GRCOUNT; i++)
         {
@@ -162,14 +172,16 @@ namespace svm
     /// @brief 打印标志寄存器
     /// @param reg 寄存器索引
     /// @param end 结束符，默认为\n
-    void print_sregister(const VMState &vm_state, RegisterEnum::StatusRegister reg, std::string end = "\n")
+    template <typename WordT>
+    void print_sregister(const BasicVMState<WordT> &vm_state, RegisterEnum::StatusRegister reg, std::string end = "\n")
     {
         std::cout << get_sregister_name(reg) << ":" << vm_state.status_registers.at(reg) << end;
     }
 
     /// @brief 打印所有标志寄存器
     /// @param end 结束符，默认为\n
-    void print_all_sregisters(const VMState &vm_state, std::string end = "\n")
+    template <typename WordT>
+    void print_all_sregisters(const BasicVMState<WordT> &vm_state, std::string end = "\n")
     {
         for (size_t i = 0; i < RegisterEnum::StatusRegister::SRCOUNT; i++)
         {
@@ -179,7 +191,8 @@ namespace svm
     }
 
     /// @brief 打印所有寄存器
-    void print_all_registers(const VMState &vm_state)
+    template <typename WordT>
+    void print_all_registers(const BasicVMState<WordT> &vm_state)
     {
         print_split_line();
         print_all_gregisters(vm_state, "\t");
@@ -198,18 +211,21 @@ namespace svm
     /// @brief 打印指令
     /// @param inst 要被打印的指令
     /// @param end 结束符，默认为\n
-    void print_instruction(Instruction inst, std::string end = "\n")
+    template <typename WordT>
+    void print_instruction(const BasicInstruction<WordT> &inst, std::string end = "\n")
     {
         std::cout << get_command_name(inst.command) << "\t"
                   << get_gregister_name(inst.register1) << "\t"
                   << get_gregister_name(inst.register2) << "\t"
+                  << get_gregister_name(inst.register3) << "\t"
                   << inst.operand1 << "\t"
                   << inst.operand2 << "\t"
                   << end;
     }
 
     /// @brief 打印所有指令
-    void print_all_instructions(const ProgramData &program_data)
+    template <typename WordT>
+    void print_all_instructions(const BasicProgramData<WordT> &program_data)
     {
         print_split_line();
         for (size_t i = 0; i < program_data.instructions.size(); i++)
@@ -0,0 +1,199 @@
+// 函数调用性能测试
+// 编译：g++ -O2 -std=c++17 -I.. call_benchmark.cpp -o call_benchmark
+// 用法：call_benchmark [调用树深度，默认20] [fib的n，默认25] [ackermann(2, n)的n，默认16]
+
+#include <chrono>
+#include <cstdlib>
+#include "../SimpleEXE.hpp"
+
+using namespace svm;
+
+/// @brief 生成一棵满二叉调用树：f(k)调用两次f(k-1)，f(0)直接返回
+/// @param depth 调用树深度
+/// @return 程序
+ProgramData make_call_tree(size_t depth)
+{
+    std::vector<Instruction> insts;
+    // 入口：调用f(depth)，然后退出
+    const size_t entry_size = 4;
+    // f(k)（k>0）占5条指令，f(0)占1条，f(k)从 entry_size + (depth - k) * 5 开始
+    auto function_index = [&](size_t k)
+    { return DWORD(entry_size + (depth - k) * 5); };
+
+    insts.push_back(Instruction(CommandEnum::Command::CALL, RegisterEnum::GeneralRegister::NONE, function_index(depth)));
+    insts.push_back(Instruction(CommandEnum::Command::MOVRI, RegisterEnum::GeneralRegister::AX, CommandEnum::SystemCallNumber::EXIT));
+    insts.push_back(Instruction(CommandEnum::Command::MOVRI, RegisterEnum::GeneralRegister::BX, CommandEnum::SystemEnum::SUCCESS));
+    insts.push_back(Instruction(CommandEnum::Command::SYSCALL));
+
+    for (size_t k = depth; k > 0; k--)
+    {
+        insts.push_back(Instruction(CommandEnum::Command::PUSH, RegisterEnum::GeneralRegister::AX, RegisterEnum::GeneralRegister::NONE));
+        insts.push_back(Instruction(CommandEnum::Command::CALL, RegisterEnum::GeneralRegister::NONE, function_index(k - 1)));
+        insts.push_back(Instruction(CommandEnum::Command::CALL, RegisterEnum::GeneralRegister::NONE, function_index(k - 1)));
+        insts.push_back(Instruction(CommandEnum::Command::POP, RegisterEnum::GeneralRegister::AX, RegisterEnum::GeneralRegister::NONE));
+        insts.push_back(Instruction(CommandEnum::Command::RET));
+    }
+    insts.push_back(Instruction(CommandEnum::Command::RET));
+
+    return ProgramData(insts);
+}
+
+/// @brief 生成递归计算斐波那契数的程序：AX为n，结果在DX中
+/// @param n 参数
+/// @return 程序
+ProgramData make_fib(size_t n)
+{
+    using R = RegisterEnum::GeneralRegister;
+    using C = CommandEnum::Command;
+    const DWORD fib = 6;
+    const DWORD base = fib + 12;
+
+    std::vector<Instruction> insts;
+    insts.push_back(Instruction(C::MOVRI, R::AX, DWORD(n)));
+    insts.push_back(Instruction(C::CALL, R::NONE, fib));
+    insts.push_back(Instruction(C::MOVRR, R::DX, R::BX));
+    insts.push_back(Instruction(C::MOVRI, R::AX, CommandEnum::SystemCallNumber::EXIT));
+    insts.push_back(Instruction(C::MOVRI, R::BX, CommandEnum::SystemEnum::SUCCESS));
+    insts.push_back(Instruction(C::SYSCALL));
+
+    // fib: if (n < 2) return n; return fib(n - 1) + fib(n - 2);
+    insts.push_back(Instruction(C::CMPRI, R::AX, 2));
+    insts.push_back(Instruction(C::JL, R::NONE, R::NONE, base, 0));
+    insts.push_back(Instruction(C::PUSH, R::AX, R::NONE));
+    insts.push_back(Instruction(C::SUBRRI, R::AX, R::AX, 1, 0));
+    insts.push_back(Instruction(C::CALL, R::NONE, fib));
+    insts.push_back(Instruction(C::POP, R::AX, R::NONE));
+    insts.push_back(Instruction(C::PUSH, R::BX, R::NONE));
+    insts.push_back(Instruction(C::SUBRRI, R::AX, R::AX, 2, 0));
+    insts.push_back(Instruction(C::CALL, R::NONE, fib));
+    insts.push_back(Instruction(C::POP, R::CX, R::NONE));
+    insts.push_back(Instruction(C::ADDRRR, R::BX, R::BX, R::CX));
+    insts.push_back(Instruction(C::RET));
+    insts.push_back(Instruction(C::MOVRR, R::BX, R::AX));
+    insts.push_back(Instruction(C::RET));
+
+    return ProgramData(insts);
+}
+
+/// @brief 生成重复计算阿克曼函数的程序：AX为m，BX为n，结果在DX中
+/// 栈很小，递归深度有限，所以在循环中重复计算
+/// @param m 参数m
+/// @param n 参数n
+/// @param repeat 重复次数
+/// @return 程序
+ProgramData make_ackermann(size_t m, size_t n, size_t repeat)
+{
+    using R = RegisterEnum::GeneralRegister;
+    using C = CommandEnum::Command;
+    const DWORD loop = 1;
+    const DWORD ack = 10;
+    const DWORD n_zero = ack + 4;
+    const DWORD general = n_zero + 6;
+
+    std::vector<Instruction> insts;
+    insts.push_back(Instruction(C::MOVRI, R::EX, DWORD(repeat)));
+    insts.push_back(Instruction(C::MOVRI, R::AX, DWORD(m)));
+    insts.push_back(Instruction(C::MOVRI, R::BX, DWORD(n)));
+    insts.push_back(Instruction(C::CALL, R::NONE, ack));
+    // SUB已经记录了结果，JNE直接使用，不需要CMP
+    insts.push_back(Instruction(C::SUBRRI, R::EX, R::EX, 1, 0));
+    insts.push_back(Instruction(C::JNE, R::NONE, R::NONE, loop, 0));
+    insts.push_back(Instruction(C::MOVRR, R::DX, R::BX));
+    insts.push_back(Instruction(C::MOVRI, R::AX, CommandEnum::SystemCallNumber::EXIT));
+    insts.push_back(Instruction(C::MOVRI, R::BX, CommandEnum::SystemEnum::SUCCESS));
+    insts.push_back(Instruction(C::SYSCALL));
+
+    // ack: if (m == 0) return n + 1;
+    insts.push_back(Instruction(C::CMPRI, R::AX, 0));
+    insts.push_back(Instruction(C::JNE, R::NONE, R::NONE, n_zero, 0));
+    insts.push_back(Instruction(C::ADDRRI, R::BX, R::BX, 1, 0));
+    insts.push_back(Instruction(C::RET));
+    // if (n == 0) return ack(m - 1, 1);
+    insts.push_back(Instruction(C::CMPRI, R::BX, 0));
+    insts.push_back(Instruction(C::JNE, R::NONE, R::NONE, general, 0));
+    insts.push_back(Instruction(C::SUBRRI, R::AX, R::AX, 1, 0));
+    insts.push_back(Instruction(C::MOVRI, R::BX, 1));
+    insts.push_back(Instruction(C::CALL, R::NONE, ack));
+    insts.push_back(Instruction(C::RET));
+    // return ack(m - 1, ack(m, n - 1));
+    insts.push_back(Instruction(C::PUSH, R::AX, R::NONE));
+    insts.push_back(Instruction(C::SUBRRI, R::BX, R::BX, 1, 0));
+    insts.push_back(Instruction(C::CALL, R::NONE, ack));
+    insts.push_back(Instruction(C::POP, R::AX, R::NONE));
+    insts.push_back(Instruction(C::SUBRRI, R::AX, R::AX, 1, 0));
+    insts.push_back(Instruction(C::CALL, R::NONE, ack));
+    insts.push_back(Instruction(C::RET));
+
+    return ProgramData(insts);
+}
+
+/// @brief 计算ackermann(m, n)的调用次数
+size_t ackermann_calls(size_t m, size_t n, size_t &result)
+{
+    if (m == 0)
+    {
+        result = n + 1;
+        return 1;
+    }
+    if (n == 0)
+        return 1 + ackermann_calls(m - 1, 1, result);
+    size_t calls = 1 + ackermann_calls(m, n - 1, result);
+    return calls + ackermann_calls(m - 1, result, result);
+}
+
+/// @brief 运行5次程序，取最快的一次
+/// @param name 测试名
+/// @param program 程序
+/// @param calls 程序中的函数调用次数
+/// @param result 结果所在的寄存器
+void measure(const std::string &name, const ProgramData &program, double calls, RegisterEnum::GeneralRegister result)
+{
+    double best = 0;
+    DWORD value = 0;
+    for (int round = 0; round < 5; round++)
+    {
+        SimpleVM vm;
+        vm.load_program(program);
+
+        auto begin = std::chrono::steady_clock::now();
+        vm.run();
+        auto end = std::chrono::steady_clock::now();
+
+        double seconds = std::chrono::duration<double>(end - begin).count();
+        if (calls / seconds > best)
+            best = calls / seconds;
+        if (result != RegisterEnum::GeneralRegister::NONE)
+            value = vm.get_vm_state().general_registers.at(result);
+    }
+
+    std::cout << name << std::endl;
+    std::cout << "calls:" << size_t(calls) << std::endl;
+    std::cout << "calls/s:" << size_t(best) << std::endl;
+    if (result != RegisterEnum::GeneralRegister::NONE)
+        std::cout << "result:" << value << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+    size_t depth = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 20;
+    size_t fib_n = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 25;
+    size_t ack_n = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 16;
+
+    measure("call tree depth:" + std::to_string(depth), make_call_tree(depth), double((size_t(1) << (depth + 1)) - 1), RegisterEnum::GeneralRegister::NONE);
+
+    // fib(n)的调用次数为2 * fib(n + 1) - 1
+    size_t a = 0, b = 1;
+    for (size_t i = 0; i < fib_n + 1; i++)
+    {
+        size_t c = a + b;
+        a = b;
+        b = c;
+    }
+    measure("fib:" + std::to_string(fib_n), make_fib(fib_n), double(2 * a - 1), RegisterEnum::GeneralRegister::DX);
+
+    const size_t ack_repeat = 1000;
+    size_t ack_result;
+    size_t ack_calls = ackermann_calls(2, ack_n, ack_result);
+    measure("ackermann:2," + std::to_string(ack_n), make_ackermann(2, ack_n, ack_repeat), double(ack_calls * ack_repeat), RegisterEnum::GeneralRegister::DX);
+    return 0;
+}
@@ -0,0 +1,116 @@
+/* C接口的调用开销测试：复用同一个虚拟机反复运行一个很短的程序，以及通过映射的缓冲区处理宿主数据
+ * 编译：g++ -O2 -std=c++17 -shared -fPIC -I.. ../capi/simplevm.cpp -o libsimplevm.so
+ *       gcc -O2 -I../capi embed_benchmark.c -L. -lsimplevm -Wl,-rpath,. -o embed_benchmark
+ * 用法：embed_benchmark [调用次数，默认1000000] [缓冲区的机器字数，默认65536]
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "simplevm.h"
+
+/* BX = AX + BX，然后退出 */
+static const char add_program[] =
+    "section text\n"
+    "ADDRRR BX, AX, BX\n"
+    "MOVRI AX, 4\n"
+    "SYSCALL\n";
+
+/* 对DX开始的AX个机器字求和，结果写到这些字之后并作为退出码 */
+static const char sum_program[] =
+    "section text\n"
+    "MOVRI CX, 0\n"
+    "loop:\n"
+    "LOAD EX, DX, 0\n"
+    "ADDRRR CX, CX, EX\n"
+    "ADDRRI DX, DX, 1\n"
+    "SUBRRI AX, AX, 1\n"
+    "JNE loop\n"
+    "STORE CX, DX, 0\n"
+    "MOVRR BX, CX\n"
+    "MOVRI AX, 4\n"
+    "SYSCALL\n";
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char *argv[])
+{
+    size_t calls = argc > 1 ? strtoul(argv[1], NULL, 10) : 1000000;
+    size_t words = argc > 2 ? strtoul(argv[2], NULL, 10) : 65536;
+
+    svm_program *program = NULL;
+    svm_vm *vm = NULL;
+    if (svm_program_parse(add_program, strlen(add_program), &program, NULL) != SVM_OK || svm_vm_create(program, &vm) != SVM_OK)
+        return 1;
+
+    /* 每次调用：重置、设置参数、运行、读取结果 */
+    uint64_t check = 0;
+    double begin = now();
+    for (size_t i = 0; i < calls; i++)
+    {
+        svm_vm_reset(vm);
+        svm_vm_set_register(vm, 0, i);
+        svm_vm_set_register(vm, 1, 1);
+        if (svm_vm_run(vm, 0) != SVM_STOP_EXIT)
+            return 1;
+        check += svm_vm_get_register(vm, 1);
+    }
+    double seconds = now() - begin;
+    printf("calls:%zu\n", calls);
+    printf("ns/call:%.1f\n", seconds * 1e9 / calls);
+    printf("check:%s\n", check == (uint64_t)calls * (calls + 1) / 2 ? "ok" : "failed");
+    svm_vm_destroy(vm);
+    svm_program_free(program);
+
+    /* 宿主写入缓冲区，客户程序直接读取并把结果写回缓冲区 */
+    svm_buffer *buffer = NULL;
+    if (svm_program_parse(sum_program, strlen(sum_program), &program, NULL) != SVM_OK || svm_vm_create(program, &vm) != SVM_OK ||
+        svm_buffer_create((words + 1) * svm_vm_word_size(vm), &buffer) != SVM_OK)
+        return 1;
+    const uint64_t window = svm_vm_window_base(vm);
+    if (svm_vm_bind_buffer(vm, buffer, window) != SVM_OK)
+    {
+        printf("bind failed\n");
+        return 1;
+    }
+
+    uint64_t *data = (uint64_t *)svm_buffer_data(buffer);
+    uint64_t expected = 0;
+    for (size_t i = 0; i < words; i++)
+    {
+        data[i] = i * 3 + 1;
+        expected += data[i];
+    }
+
+    const size_t rounds = 100;
+    begin = now();
+    for (size_t i = 0; i < rounds; i++)
+    {
+        svm_vm_reset(vm);
+        svm_vm_set_register(vm, 0, words);
+        svm_vm_set_register(vm, 3, window);
+        if (svm_vm_run(vm, 0) != SVM_STOP_EXIT)
+        {
+            printf("exception:%d\n", svm_vm_exception(vm));
+            return 1;
+        }
+    }
+    seconds = now() - begin;
+    printf("window words:%zu\n", words);
+    printf("ns/word:%.2f\n", seconds * 1e9 / (rounds * words));
+    printf("result:%s\n", svm_vm_get_register(vm, 1) == expected && data[words] == expected ? "ok" : "failed");
+
+    svm_vm_unbind_buffer(vm, buffer, window);
+    svm_buffer_free(buffer);
+    svm_vm_destroy(vm);
+    svm_program_free(program);
+    return 0;
+}
@@ -0,0 +1,151 @@
+// 作业服务的吞吐量和延迟测试：多个连接同时向main --serve提交同一个作业，统计每个作业从发送到收到END的时间
+// 编译：g++ -O2 -std=c++17 -pthread -I.. job_benchmark.cpp -o job_benchmark
+// 用法：先运行 main --serve /tmp/svm.sock，然后 job_benchmark /tmp/svm.sock [作业数，默认20000] [连接数，默认4] [程序文件，默认为内置的回显程序]
+// 最后给出同一个作业在本进程中每次重新解析、新建虚拟机运行的时间，作为每个作业启动一个进程时的下限。
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include "../SimpleJobServer.hpp"
+
+using namespace svm;
+
+/// @brief 把输入原样输出，读到结尾后以输出的字符数作为退出码
+static const char echo_program[] =
+    "section text\n"
+    "MOVRI DX, 0\n"
+    "loop:\n"
+    "MOVRI AX, 2\n"
+    "MOVRI BX, 2\n"
+    "SYSCALL\n"
+    "CMPRI AX, 255\n"
+    "JE done\n"
+    "MOVRR CX, AX\n"
+    "MOVRI AX, 0\n"
+    "MOVRI BX, 2\n"
+    "SYSCALL\n"
+    "ADDRRI DX, DX, 1\n"
+    "JMP loop\n"
+    "done:\n"
+    "MOVRR BX, DX\n"
+    "MOVRI AX, 4\n"
+    "SYSCALL\n";
+
+/// @brief 排好序的延迟中的百分位
+static double percentile(const std::vector<double> &sorted, double fraction)
+{
+    if (sorted.empty())
+        return 0;
+    return sorted[std::min(sorted.size() - 1, size_t(fraction * sorted.size()))];
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        printf("usage: job_benchmark socket [jobs] [connections] [program]\n");
+        return 1;
+    }
+    const std::string socket_path = argv[1];
+    const size_t jobs = argc > 2 ? strtoul(argv[2], NULL, 10) : 20000;
+    const size_t connections = std::max<size_t>(argc > 3 ? strtoul(argv[3], NULL, 10) : 4, 1);
+
+    JobRequest request;
+    if (argc > 4)
+        request.path = argv[4];
+    else
+    {
+        request.image = echo_program;
+        request.input = "hello, job server\n";
+    }
+
+    // 先提交一次，让服务解析程序并预热虚拟机池
+    {
+        JobClient client;
+        std::string output;
+        JobResult result;
+        if (!client.connect(socket_path) || !client.submit(request, output, result))
+        {
+            printf("unable to submit to \"%s\"\n", socket_path.c_str());
+            return 1;
+        }
+        if (result.status == JobEnum::Status::ERROR)
+        {
+            printf("error:%s\n", result.message.c_str());
+            return 1;
+        }
+        printf("status:%s code:%llu instructions:%llu output bytes:%zu\n", JobEnum::status_name(result.status),
+               (unsigned long long)result.exit_code, (unsigned long long)result.retired_instructions, output.size());
+    }
+
+    std::vector<std::vector<double>> latencies(connections);
+    std::vector<size_t> failures(connections, 0);
+    std::vector<std::thread> threads;
+    const auto begin = std::chrono::steady_clock::now();
+    for (size_t t = 0; t < connections; t++)
+        threads.emplace_back([&, t]()
+                             {
+            JobClient client;
+            if (!client.connect(socket_path))
+            {
+                failures[t] = jobs / connections;
+                return;
+            }
+            std::string output;
+            JobResult result;
+            for (size_t i = t; i < jobs; i += connections)
+            {
+                const auto start = std::chrono::steady_clock::now();
+                if (!client.submit(request, output, result) || result.status == JobEnum::Status::ERROR)
+                {
+                    failures[t]++;
+                    continue;
+                }
+                latencies[t].push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+            } });
+    for (std::thread &thread : threads)
+        thread.join();
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+    std::vector<double> all;
+    size_t failed = 0;
+    for (size_t t = 0; t < connections; t++)
+    {
+        all.insert(all.end(), latencies[t].begin(), latencies[t].end());
+        failed += failures[t];
+    }
+    std::sort(all.begin(), all.end());
+    printf("jobs:%zu connections:%zu failed:%zu\n", all.size(), connections, failed);
+    printf("jobs/s:%.0f\n", all.size() / seconds);
+    printf("latency us p50:%.1f p99:%.1f max:%.1f\n", percentile(all, 0.5), percentile(all, 0.99), all.empty() ? 0.0 : all.back());
+
+    // 对照：每个作业都重新解析程序、新建虚拟机（不包括启动进程本身）
+    if (request.path.empty())
+    {
+        const size_t cold_jobs = std::min<size_t>(jobs, 200);
+        const auto cold_begin = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < cold_jobs; i++)
+        {
+            std::vector<std::string> lines;
+            std::istringstream sstr(request.image);
+            std::string line;
+            while (std::getline(sstr, line))
+                lines.push_back(line);
+            EXEParser parser;
+            parser.parse_lines(lines);
+            SimpleVM vm;
+            std::istringstream input(request.input);
+            std::ostringstream output;
+            vm.set_quiet(true);
+            vm.set_console(input, output);
+            vm.load_program(parser.get_program());
+            vm.run();
+        }
+        const double cold = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - cold_begin).count();
+        printf("cold in-process us/job:%.1f\n", cold / cold_jobs);
+    }
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,134 @@
+// 锁步执行（SIMT）性能测试：同一个程序跑很多组输入，比较逐个使用SimpleVM和一次使用SIMTVM
+// 编译：g++ -O2 -std=c++17 -I.. simt_benchmark.cpp -o simt_benchmark
+// 用法：simt_benchmark [输入组数，默认4096] [哈希循环次数，默认2000]
+
+#include <chrono>
+#include <cstdlib>
+#include <sstream>
+#include "../SimpleEXE.hpp"
+#include "../SimpleSIMT.hpp"
+
+using namespace svm;
+
+/// @brief 生成xorshift哈希程序：AX为输入，循环rounds次，退出码为结果（所有输入的控制流都相同）
+/// @param rounds 循环次数
+/// @return 程序
+ProgramData make_hash(size_t rounds)
+{
+    using R = RegisterEnum::GeneralRegister;
+    using C = CommandEnum::Command;
+    const DWORD loop = 1;
+
+    std::vector<Instruction> insts;
+    insts.push_back(Instruction(C::MOVRI, R::CX, DWORD(rounds)));
+    insts.push_back(Instruction(C::SHLRRI, R::DX, R::AX, 13, 0));
+    insts.push_back(Instruction(C::XORRRR, R::AX, R::AX, R::DX));
+    insts.push_back(Instruction(C::SHRRRI, R::DX, R::AX, 7, 0));
+    insts.push_back(Instruction(C::XORRRR, R::AX, R::AX, R::DX));
+    insts.push_back(Instruction(C::SHLRRI, R::DX, R::AX, 17, 0));
+    insts.push_back(Instruction(C::XORRRR, R::AX, R::AX, R::DX));
+    insts.push_back(Instruction(C::SUBRRI, R::CX, R::CX, 1, 0));
+    insts.push_back(Instruction(C::JNE, R::NONE, R::NONE, loop, 0));
+    insts.push_back(Instruction(C::MOVRR, R::BX, R::AX));
+    insts.push_back(Instruction(C::MOVRI, R::AX, CommandEnum::SystemCallNumber::EXIT));
+    insts.push_back(Instruction(C::SYSCALL));
+
+    return ProgramData(insts);
+}
+
+/// @brief 生成计算考拉兹序列步数的程序：AX为输入，退出码为步数（每个输入的循环次数和分支都不同）
+/// @return 程序
+ProgramData make_collatz()
+{
+    using R = RegisterEnum::GeneralRegister;
+    using C = CommandEnum::Command;
+    const DWORD loop = 1;
+    const DWORD odd = 8;
+    const DWORD count = 6;
+    const DWORD done = 11;
+
+    std::vector<Instruction> insts;
+    insts.push_back(Instruction(C::MOVRI, R::BX, 0));
+    // while (n != 1) { n = n & 1 ? 3 * n + 1 : n / 2; steps++; }
+    insts.push_back(Instruction(C::CMPRI, R::AX, 1));
+    insts.push_back(Instruction(C::JE, R::NONE, R::NONE, done, 0));
+    insts.push_back(Instruction(C::ANDRRI, R::CX, R::AX, 1, 0));
+    insts.push_back(Instruction(C::JNE, R::NONE, R::NONE, odd, 0));
+    insts.push_back(Instruction(C::SHRRRI, R::AX, R::AX, 1, 0));
+    insts.push_back(Instruction(C::ADDRRI, R::BX, R::BX, 1, 0));
+    insts.push_back(Instruction(C::JMP, R::NONE, R::NONE, loop, 0));
+    insts.push_back(Instruction(C::MULRRI, R::AX, R::AX, 3, 0));
+    insts.push_back(Instruction(C::ADDRRI, R::AX, R::AX, 1, 0));
+    insts.push_back(Instruction(C::JMP, R::NONE, R::NONE, count, 0));
+    insts.push_back(Instruction(C::MOVRI, R::AX, CommandEnum::SystemCallNumber::EXIT));
+    insts.push_back(Instruction(C::SYSCALL));
+
+    return ProgramData(insts);
+}
+
+/// @brief 分别用SimpleVM和SIMTVM运行所有输入，检查结果相同并输出吞吐量
+/// @param name 测试名
+/// @param program 程序
+/// @param inputs 每组输入（AX）
+void measure(const std::string &name, const ProgramData &program, const std::vector<DWORD> &inputs)
+{
+    // SimpleVM每次退出都会输出一行，测试时丢掉
+    std::ostringstream sink;
+    std::streambuf *console = std::cout.rdbuf(sink.rdbuf());
+    std::vector<DWORD> expected(inputs.size());
+    uint64_t instructions = 0;
+    SimpleVM vm;
+    auto begin = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < inputs.size(); i++)
+    {
+        vm.reset();
+        vm.load_program(program);
+        vm.get_vm_state().general_registers.at(RegisterEnum::GeneralRegister::AX) = inputs.at(i);
+        vm.run();
+        expected.at(i) = vm.get_vm_state().general_registers.at(RegisterEnum::GeneralRegister::BX);
+        instructions += vm.get_retired_instructions();
+    }
+    auto end = std::chrono::steady_clock::now();
+    std::cout.rdbuf(console);
+    const double scalar_seconds = std::chrono::duration<double>(end - begin).count();
+
+    SIMTVM simt(inputs.size());
+    begin = std::chrono::steady_clock::now();
+    simt.load_program(program);
+    simt.get_registers(RegisterEnum::GeneralRegister::AX) = inputs;
+    simt.run();
+    end = std::chrono::steady_clock::now();
+    const double simt_seconds = std::chrono::duration<double>(end - begin).count();
+
+    size_t mismatches = 0;
+    for (size_t i = 0; i < inputs.size(); i++)
+    {
+        if (simt.get_exception(i) != ExceptionEnum::Exception::AOK || simt.get_exit_code(i) != expected.at(i))
+            mismatches++;
+    }
+
+    std::cout << name << std::endl;
+    std::cout << "lanes:" << inputs.size() << std::endl;
+    std::cout << "instructions:" << instructions << std::endl;
+    std::cout << "SimpleVM instructions/s:" << size_t(instructions / scalar_seconds) << std::endl;
+    std::cout << "SIMTVM instructions/s:" << size_t(simt.get_retired_instructions() / simt_seconds) << std::endl;
+    std::cout << "speedup:" << scalar_seconds / simt_seconds << std::endl;
+    std::cout << "lockstep efficiency:" << double(simt.get_retired_instructions()) / (double(simt.get_issued_instructions()) * inputs.size()) << std::endl;
+    std::cout << "mismatches:" << mismatches << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+    size_t lanes = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 4096;
+    size_t rounds = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 2000;
+
+    std::vector<DWORD> inputs(lanes);
+    for (size_t i = 0; i < lanes; i++)
+        inputs.at(i) = DWORD(i) * 2654435761u + 1;
+    measure("hash rounds:" + std::to_string(rounds), make_hash(rounds), inputs);
+
+    for (size_t i = 0; i < lanes; i++)
+        inputs.at(i) = DWORD(i) + 1;
+    measure("collatz", make_collatz(), inputs);
+    return 0;
+}
@@ -0,0 +1,428 @@
+// 虚拟机、解析器和汇编器的吞吐量测试
+// 编译：g++ -O2 -std=c++17 -I.. suite_benchmark.cpp -o suite_benchmark
+// 用法：suite_benchmark [--quick] [--output 结果.json] [--baseline 基准.json] [--threshold 百分比，默认5]
+// 结果以JSON输出（每个测试项一行），给出--baseline时和之前保存的结果逐项比较，
+// 有测试项变慢超过阈值时返回1。
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <sstream>
+#include <streambuf>
+#include <sys/resource.h>
+#include "../SimpleEXE.hpp"
+#include "../SimpleVMPool.hpp"
+
+using namespace svm;
+
+/// @brief 一个测试项的结果
+struct BenchmarkResult
+{
+    /// @brief 测试项名称
+    std::string name;
+    /// @brief 结果
+    double value;
+    /// @brief 单位
+    std::string unit;
+    /// @brief 是否越大越好
+    bool higher_is_better;
+};
+
+/// @brief 丢弃所有输出的流缓冲区，测试时替换std::cout的缓冲区
+class NullBuffer : public std::streambuf
+{
+protected:
+    virtual int overflow(int ch) override
+    {
+        return ch;
+    }
+
+    virtual std::streamsize xsputn(const char *, std::streamsize count) override
+    {
+        return count;
+    }
+};
+
+/// @brief 在作用域内丢弃std::cout的输出
+class SilenceOutput
+{
+private:
+    NullBuffer m_null;
+    std::streambuf *m_previous;
+
+public:
+    SilenceOutput() : m_previous(std::cout.rdbuf(&m_null)) {}
+    ~SilenceOutput()
+    {
+        std::cout.rdbuf(m_previous);
+    }
+};
+
+/// @brief 重复运行直到总时间足够长，返回最快一次的耗时
+/// @param function 要测试的函数
+/// @param min_seconds 最短总时间
+/// @return 最快一次的耗时（秒）
+double measure(const std::function<void()> &function, double min_seconds = 0.2)
+{
+    double best = 1e30;
+    double total = 0;
+    for (int round = 0; round < 3 || total < min_seconds; round++)
+    {
+        auto begin = std::chrono::steady_clock::now();
+        function();
+        auto end = std::chrono::steady_clock::now();
+        double seconds = std::chrono::duration<double>(end - begin).count();
+        total += seconds;
+        if (seconds < best)
+            best = seconds;
+    }
+    return best;
+}
+
+/// @brief 程序结束部分：EXIT(SUCCESS)
+void append_exit(std::vector<Instruction> &insts)
+{
+    insts.push_back(Instruction(CommandEnum::Command::MOVRI, RegisterEnum::GeneralRegister::AX, CommandEnum::SystemCallNumber::EXIT));
+    insts.push_back(Instruction(CommandEnum::Command::MOVRI, RegisterEnum::GeneralRegister::BX, CommandEnum::SystemEnum::SUCCESS));
+    insts.push_back(Instruction(CommandEnum::Command::SYSCALL));
+}
+
+/// @brief 生成一段没有跳转的MOV指令流
+/// @param count 指令条数
+/// @return 程序
+ProgramData make_mov_stream(size_t count)
+{
+    std::vector<Instruction> insts;
+    for (size_t i = 0; i < count; i++)
+    {
+        RegisterEnum::GeneralRegister reg = RegisterEnum::GeneralRegister(2 + i % 20);
+        if (i % 2 == 0)
+            insts.push_back(Instruction(CommandEnum::Command::MOVRI, reg, DWORD(i)));
+        else
+            insts.push_back(Instruction(CommandEnum::Command::MOVRR, reg, RegisterEnum::GeneralRegister(2 + (i + 7) % 20)));
+    }
+    append_exit(insts);
+    return ProgramData(insts);
+}
+
+/// @brief 生成逐个字符输出的程序
+/// @param count 输出的字符数
+/// @return 程序
+ProgramData make_print_chars(size_t count)
+{
+    std::vector<Instruction> insts;
+    insts.push_back(Instruction(CommandEnum::Command::MOVRI, RegisterEnum::GeneralRegister::BX, CommandEnum::SystemEnum::STDIO));
+    for (size_t i = 0; i < count; i++)
+    {
+        insts.push_back(Instruction(CommandEnum::Command::MOVRI, RegisterEnum::GeneralRegister::AX, CommandEnum::SystemCallNumber::PRINT_CHAR));
+        insts.push_back(Instruction(CommandEnum::Command::MOVRI, RegisterEnum::GeneralRegister::CX, DWORD('a' + i % 26)));
+        insts.push_back(Instruction(CommandEnum::Command::SYSCALL));
+    }
+    append_exit(insts);
+    return ProgramData(insts);
+}
+
+/// @brief 生成多次输出同一个字符串的程序
+/// @param count 输出次数
+/// @param length 字符串长度
+/// @return 程序
+ProgramData make_print_strings(size_t count, size_t length)
+{
+    std::vector<unsigned char> bytes(length + 1, 'x');
+    bytes.back() = '\0';
+    std::vector<DWORD> data((bytes.size() + sizeof(DWORD) - 1) / sizeof(DWORD), 0);
+    memcpy(data.data(), bytes.data(), bytes.size());
+
+    std::vector<Instruction> insts;
+    insts.push_back(Instruction(CommandEnum::Command::MOVRI, RegisterEnum::GeneralRegister::BX, CommandEnum::SystemEnum::STDIO));
+    insts.push_back(Instruction(CommandEnum::Command::MOVRI, RegisterEnum::GeneralRegister::CX, 0));
+    for (size_t i = 0; i < count; i++)
+    {
+        insts.push_back(Instruction(CommandEnum::Command::MOVRI, RegisterEnum::GeneralRegister::AX, CommandEnum::SystemCallNumber::PRINT_STRING));
+        insts.push_back(Instruction(CommandEnum::Command::SYSCALL));
+    }
+    append_exit(insts);
+    return ProgramData(insts, data);
+}
+
+/// @brief 生成汇编器的输入
+/// @param count 指令条数
+/// @return 文本段
+std::vector<std::vector<std::string>> make_assembly(size_t count)
+{
+    std::vector<std::vector<std::string>> text;
+    for (size_t i = 0; i < count; i++)
+    {
+        const std::string reg = gregister_name_list.at(i % 20);
+        switch (i % 4)
+        {
+        case 0:
+            text.push_back({"MOV", reg, std::to_string(i)});
+            break;
+        case 1:
+            text.push_back({"MOV", reg, gregister_name_list.at((i + 3) % 20)});
+            break;
+        case 2:
+            text.push_back({"ADD", reg, reg, std::to_string(i % 100)});
+            break;
+        default:
+            text.push_back({"LOAD", reg, "AX", std::to_string(i % 64)});
+            break;
+        }
+    }
+    text.push_back({"MOV", "AX", "4"});
+    text.push_back({"MOV", "BX", "0"});
+    text.push_back({"SYSCALL"});
+    return text;
+}
+
+/// @brief 获取文件大小
+size_t file_size(const std::string &filename)
+{
+    std::ifstream fin(filename, std::ios::binary | std::ios::ate);
+    return fin ? size_t(fin.tellg()) : 0;
+}
+
+/// @brief 获取进程的峰值内存占用（KB）
+long peak_rss_kb()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#if defined(__APPLE__)
+    return usage.ru_maxrss / 1024;
+#else
+    return usage.ru_maxrss;
+#endif
+}
+
+/// @brief 运行所有测试项
+/// @param quick 是否只运行最小的规模
+/// @return 结果
+std::vector<BenchmarkResult> run_all(bool quick)
+{
+    std::vector<BenchmarkResult> results;
+    const std::vector<size_t> scales = quick ? std::vector<size_t>{1000} : std::vector<size_t>{1000, 10000, 100000};
+
+    // 虚拟机执行没有跳转的指令流
+    for (size_t scale : scales)
+    {
+        const size_t count = scale * 10;
+        ProgramData program = make_mov_stream(count);
+        SimpleVM vm;
+        double seconds = measure([&]()
+                                 {
+                                     SilenceOutput silence;
+                                     vm.reset();
+                                     vm.load_program(program);
+                                     vm.run(); });
+        results.push_back({"vm.mov_stream." + std::to_string(count), (count + 3) / seconds, "inst/s", true});
+    }
+
+    // 系统调用密集的输出
+    for (size_t scale : scales)
+    {
+        ProgramData program = make_print_chars(scale);
+        SimpleVM vm;
+        double seconds = measure([&]()
+                                 {
+                                     SilenceOutput silence;
+                                     vm.reset();
+                                     vm.load_program(program);
+                                     vm.run(); });
+        results.push_back({"vm.print_char." + std::to_string(scale), scale / seconds, "syscall/s", true});
+
+        const size_t length = 64;
+        ProgramData strings = make_print_strings(scale, length);
+        seconds = measure([&]()
+                          {
+                              SilenceOutput silence;
+                              vm.reset();
+                              vm.load_program(strings);
+                              vm.run(); });
+        results.push_back({"vm.print_string." + std::to_string(scale), scale * length / seconds / 1e6, "MB/s", true});
+    }
+
+    // 汇编器和解析器
+    const std::string filename = "suite_benchmark.sexe";
+    for (size_t scale : scales)
+    {
+        std::vector<std::vector<std::string>> text = make_assembly(scale * 10);
+        double seconds = measure([&]()
+                                 {
+                                     EXEGenerator generator;
+                                     generator.generate(std::vector<std::vector<std::string>>(), text, filename); });
+        const double megabytes = file_size(filename) / 1e6;
+        results.push_back({"asm.generate." + std::to_string(scale * 10), megabytes / seconds, "MB/s", true});
+
+        seconds = measure([&]()
+                          {
+                              EXEParser parser;
+                              parser.parse(filename); });
+        results.push_back({"exe.parse." + std::to_string(scale * 10), megabytes / seconds, "MB/s", true});
+    }
+    std::remove(filename.c_str());
+
+    // 虚拟机的创建和重置
+    {
+        const size_t count = 200;
+        double seconds = measure([&]()
+                                 {
+                                     for (size_t i = 0; i < count; i++)
+                                     {
+                                         SimpleVM vm;
+                                     } });
+        results.push_back({"vm.create", seconds / count * 1e9, "ns", false});
+
+        SimpleVM vm;
+        seconds = measure([&]()
+                          {
+                              for (size_t i = 0; i < count; i++)
+                                  vm.reset(); });
+        results.push_back({"vm.reset", seconds / count * 1e9, "ns", false});
+
+        // 复用已经加载好的虚拟机：只恢复被写过的内存块
+        ProgramData program = make_mov_stream(100);
+        vm.set_quiet(true);
+        vm.load_program(program);
+        seconds = measure([&]()
+                          {
+                              for (size_t i = 0; i < count; i++)
+                              {
+                                  vm.restart();
+                                  vm.run();
+                              } });
+        results.push_back({"vm.restart_run", seconds / count * 1e9, "ns", false});
+
+        VMPool pool(program, 1);
+        seconds = measure([&]()
+                          {
+                              for (size_t i = 0; i < count; i++)
+                              {
+                                  std::unique_ptr<SimpleVM> pooled = pool.acquire();
+                                  pooled->run();
+                                  pool.release(std::move(pooled));
+                              } });
+        results.push_back({"vm.pool_run", seconds / count * 1e9, "ns", false});
+    }
+
+    results.push_back({"process.peak_rss", double(peak_rss_kb()), "KB", false});
+    return results;
+}
+
+/// @brief 以JSON输出结果（每个测试项一行，便于比较）
+void write_json(std::ostream &out, const std::vector<BenchmarkResult> &results)
+{
+    out << "{\"results\":[" << std::endl;
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const BenchmarkResult &result = results.at(i);
+        out << "{\"name\":\"" << result.name << "\",\"value\":" << std::setprecision(10) << result.value
+            << ",\"unit\":\"" << result.unit << "\",\"higher_is_better\":" << (result.higher_is_better ? "true" : "false") << "}"
+            << (i + 1 < results.size() ? "," : "") << std::endl;
+    }
+    out << "]}" << std::endl;
+}
+
+/// @brief 读取write_json()写出的结果
+/// @param filename 文件名
+/// @param results 结果
+/// @return 是否成功
+bool read_json(const std::string &filename, std::vector<BenchmarkResult> &results)
+{
+    std::vector<std::string> lines;
+    if (!load_from_file(filename, lines))
+        return false;
+
+    // 只需要读自己写出的格式：每个测试项一行
+    auto field = [](const std::string &line, const std::string &key) -> std::string
+    {
+        size_t begin = line.find("\"" + key + "\":");
+        if (begin == std::string::npos)
+            return "";
+        begin += key.size() + 3;
+        if (line.at(begin) == '"')
+            return line.substr(begin + 1, line.find('"', begin + 1) - begin - 1);
+        return line.substr(begin, line.find_first_of(",}", begin) - begin);
+    };
+
+    results.clear();
+    for (size_t i = 0; i < lines.size(); i++)
+    {
+        const std::string name = field(lines.at(i), "name");
+        if (name.empty())
+            continue;
+        results.push_back({name, std::stod(field(lines.at(i), "value")), field(lines.at(i), "unit"), field(lines.at(i), "higher_is_better") == "true"});
+    }
+    return true;
+}
+
+/// @brief 和基准比较
+/// @param results 本次结果
+/// @param baseline 基准
+/// @param threshold 允许变慢的百分比
+/// @return 是否没有超过阈值的退化
+bool compare(const std::vector<BenchmarkResult> &results, const std::vector<BenchmarkResult> &baseline, double threshold)
+{
+    bool success = true;
+    std::cout << std::left << std::setw(28) << "Benchmark" << std::right << std::setw(16) << "Baseline" << std::setw(16) << "Current" << std::setw(10) << "Change" << std::endl;
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const BenchmarkResult &current = results.at(i);
+        auto iter = std::find_if(baseline.begin(), baseline.end(), [&](const BenchmarkResult &result)
+                                 { return result.name == current.name; });
+        if (iter == baseline.end() || iter->value == 0)
+            continue;
+
+        // 正数表示变好
+        double change = (current.value / iter->value - 1) * 100;
+        if (!current.higher_is_better)
+            change = -change;
+        const bool regressed = change < -threshold && current.name.compare(0, 8, "process.") != 0;
+        success = success && !regressed;
+
+        std::cout << std::left << std::setw(28) << current.name << std::right << std::fixed << std::setprecision(1)
+                  << std::setw(16) << iter->value << std::setw(16) << current.value
+                  << std::setw(9) << change << "%" << (regressed ? "  REGRESSION" : "") << std::endl;
+    }
+    return success;
+}
+
+int main(int argc, char *argv[])
+{
+    bool quick = false;
+    std::string output;
+    std::string baseline_file;
+    double threshold = 5;
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string arg = argv[i];
+        if (arg == "--quick")
+            quick = true;
+        else if (arg == "--output" && i + 1 < argc)
+            output = argv[++i];
+        else if (arg == "--baseline" && i + 1 < argc)
+            baseline_file = argv[++i];
+        else if (arg == "--threshold" && i + 1 < argc)
+            threshold = std::stod(argv[++i]);
+    }
+
+    std::vector<BenchmarkResult> results = run_all(quick);
+
+    if (!output.empty())
+    {
+        std::ofstream fout(output);
+        write_json(fout, results);
+    }
+
+    if (baseline_file.empty())
+    {
+        write_json(std::cout, results);
+        return 0;
+    }
+
+    std::vector<BenchmarkResult> baseline;
+    if (!read_json(baseline_file, baseline))
+        return 2;
+    return compare(results, baseline, threshold) ? 0 : 1;
+}
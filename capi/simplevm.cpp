@@ -0,0 +1,498 @@
+// SimpleVM的C语言接口实现
+// 编译：g++ -O2 -std=c++17 -shared -fPIC -I.. simplevm.cpp -o libsimplevm.so
+
+#include <new>
+#include <limits>
+#include <sstream>
+#include <memory>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "SimpleEXE.hpp"
+#include "simplevm.h"
+
+using namespace svm;
+
+/// @brief 已经解析的程序，按机器字的位数只使用其中一份
+struct svm_program
+{
+    /// @brief 机器字的位数
+    unsigned word_bits = 64;
+    /// @brief 64位程序
+    BasicProgramData<DWORD64> program64;
+    /// @brief 32位程序
+    BasicProgramData<DWORD32> program32;
+};
+
+/// @brief 虚拟机上下文，和机器字类型无关的部分
+struct svm_vm
+{
+    virtual ~svm_vm() {}
+
+    virtual void reset() = 0;
+    virtual bool set_register(unsigned reg, uint64_t value) = 0;
+    virtual uint64_t get_register(unsigned reg) const = 0;
+    virtual int run(uint64_t budget) = 0;
+    virtual int exception() const = 0;
+    virtual uint64_t retired_instructions() const = 0;
+    virtual void set_trap_callback(svm_trap_callback callback, void *user) = 0;
+    virtual void *memory(size_t &words) = 0;
+    virtual void mark_dirty(uint64_t address, size_t words) = 0;
+    virtual void fail() = 0;
+    virtual size_t word_size() const = 0;
+    virtual uint64_t window_base() const = 0;
+    virtual uint64_t window_alignment() const = 0;
+    virtual bool bind(int fd, uint64_t address, size_t bytes) = 0;
+    virtual bool unbind(uint64_t address, size_t bytes) = 0;
+};
+
+/// @brief 共享内存缓冲区
+struct svm_buffer
+{
+    /// @brief 共享内存文件
+    int fd = -1;
+    /// @brief 宿主中的映射
+    void *data = nullptr;
+    /// @brief 大小（单位为字节，页的整数倍）
+    size_t size = 0;
+};
+
+namespace
+{
+    /// @brief 虚拟机上下文
+    /// @tparam WordT 机器字类型
+    template <typename WordT>
+    class BasicContext : public svm_vm, public BasicTrapHandler<WordT>
+    {
+    public:
+        using VM = BasicSimpleVM<WordT>;
+        using ISData = typename VM::ISData;
+
+    private:
+        /// @brief 虚拟机
+        VM m_vm;
+        /// @brief 程序已经结束或发生异常，需要重置后才能再运行
+        bool m_finished = false;
+        /// @brief 陷阱回调
+        svm_trap_callback m_trap_callback = nullptr;
+        /// @brief 陷阱回调的参数
+        void *m_trap_user = nullptr;
+
+    public:
+        BasicContext(const BasicProgramData<WordT> &program)
+        {
+            m_vm.set_quiet(true);
+            m_vm.load_program(program);
+        }
+
+    public:
+        virtual void reset() override
+        {
+            m_vm.restart();
+            m_finished = false;
+        }
+
+        virtual bool set_register(unsigned reg, uint64_t value) override
+        {
+            if (reg >= RegisterEnum::GeneralRegister::GRCOUNT)
+                return false;
+            m_vm.get_vm_state().general_registers[reg] = WordT(value);
+            return true;
+        }
+
+        virtual uint64_t get_register(unsigned reg) const override
+        {
+            if (reg >= RegisterEnum::GeneralRegister::GRCOUNT)
+                return 0;
+            return const_cast<VM &>(m_vm).get_vm_state().general_registers[reg];
+        }
+
+        virtual int run(uint64_t budget) override
+        {
+            if (!m_finished)
+            {
+                m_vm.set_run_budget(budget);
+                m_vm.run();
+            }
+
+            const ExceptionEnum::Exception exception = m_vm.get_vm_state().exception;
+            if (exception == ExceptionEnum::Exception::HLT)
+            {
+                m_finished = true;
+                return SVM_STOP_HALT;
+            }
+            if (exception != ExceptionEnum::Exception::AOK)
+            {
+                m_finished = true;
+                return SVM_STOP_EXCEPTION;
+            }
+            switch (m_vm.get_stop_reason())
+            {
+            case StopEnum::Reason::NONE:
+                m_finished = true;
+                return SVM_STOP_EXIT;
+
+            case StopEnum::Reason::BUDGET:
+                return SVM_STOP_BUDGET;
+
+            default:
+                return SVM_STOP_BREAKPOINT;
+            }
+        }
+
+        virtual int exception() const override
+        {
+            return const_cast<VM &>(m_vm).get_vm_state().exception;
+        }
+
+        virtual uint64_t retired_instructions() const override
+        {
+            return m_vm.get_retired_instructions();
+        }
+
+        virtual void set_trap_callback(svm_trap_callback callback, void *user) override
+        {
+            m_trap_callback = callback;
+            m_trap_user = user;
+            m_vm.attach_trap_handler(callback ? this : nullptr);
+        }
+
+        virtual void on_trap(const BasicTrapRecord<WordT> &record) override
+        {
+            const svm_trap trap = {int(record.trap), record.vectored ? 1 : 0, record.index, record.address, record.retired_instructions};
+            m_trap_callback(this, &trap, m_trap_user);
+        }
+
+        virtual void *memory(size_t &words) override
+        {
+            words = ISData::TOTAL_CAPACITY;
+            return m_vm.get_internal_storage_data().get_internal_storage();
+        }
+
+        virtual void mark_dirty(uint64_t address, size_t words) override
+        {
+            if (address < ISData::TOTAL_CAPACITY)
+                m_vm.mark_dirty(size_t(address), words);
+        }
+
+        virtual void fail() override
+        {
+            m_finished = true;
+        }
+
+        virtual size_t word_size() const override
+        {
+            return sizeof(WordT);
+        }
+
+        virtual uint64_t window_base() const override
+        {
+            return ISData::TOTAL_CAPACITY;
+        }
+
+        virtual uint64_t window_alignment() const override
+        {
+            return VM::get_window_alignment();
+        }
+
+        virtual bool bind(int fd, uint64_t address, size_t bytes) override
+        {
+            if (address > std::numeric_limits<WordT>::max())
+                return false;
+            return m_vm.bind_window(fd, WordT(address), bytes / sizeof(WordT));
+        }
+
+        virtual bool unbind(uint64_t address, size_t bytes) override
+        {
+            if (address > std::numeric_limits<WordT>::max())
+                return false;
+            return m_vm.unbind_window(WordT(address), bytes / sizeof(WordT));
+        }
+    };
+
+    /// @brief 解析程序的每一行
+    /// @param lines 程序的每一行
+    /// @param program 输出的程序
+    /// @param word_bits 输出的机器字位数，可以为nullptr
+    /// @return 返回码
+    int parse_program(const std::vector<std::string> &lines, svm_program **program, unsigned *word_bits)
+    {
+        std::unique_ptr<svm_program> result(new (std::nothrow) svm_program());
+        if (!result)
+            return SVM_ERROR_SYSTEM;
+
+        result->word_bits = unsigned(detect_word_bits(lines));
+        if (result->word_bits == 32)
+        {
+            BasicEXEParser<DWORD32> parser;
+            if (!parser.parse_lines(lines))
+                return SVM_ERROR_PROGRAM;
+            result->program32 = parser.get_program();
+        }
+        else if (result->word_bits == 64)
+        {
+            BasicEXEParser<DWORD64> parser;
+            if (!parser.parse_lines(lines))
+                return SVM_ERROR_PROGRAM;
+            result->program64 = parser.get_program();
+        }
+        else
+            return SVM_ERROR_PROGRAM;
+
+        if (word_bits)
+            *word_bits = result->word_bits;
+        *program = result.release();
+        return SVM_OK;
+    }
+} // namespace
+
+extern "C"
+{
+    int svm_program_load(const char *filename, svm_program **program, unsigned *word_bits)
+    {
+        if (!filename || !program)
+            return SVM_ERROR_ARGUMENT;
+        try
+        {
+            std::vector<std::string> lines;
+            if (!load_from_file(filename, lines))
+                return SVM_ERROR_PROGRAM;
+            return parse_program(lines, program, word_bits);
+        }
+        catch (...)
+        {
+            return SVM_ERROR_PROGRAM;
+        }
+    }
+
+    int svm_program_parse(const char *text, size_t length, svm_program **program, unsigned *word_bits)
+    {
+        if (!text || !program)
+            return SVM_ERROR_ARGUMENT;
+        try
+        {
+            std::vector<std::string> lines;
+            std::istringstream sstr(std::string(text, length));
+            std::string line;
+            while (std::getline(sstr, line))
+                lines.push_back(line);
+            return parse_program(lines, program, word_bits);
+        }
+        catch (...)
+        {
+            return SVM_ERROR_PROGRAM;
+        }
+    }
+
+    void svm_program_free(svm_program *program)
+    {
+        delete program;
+    }
+
+    int svm_vm_create(const svm_program *program, svm_vm **vm)
+    {
+        if (!program || !vm)
+            return SVM_ERROR_ARGUMENT;
+        try
+        {
+            if (program->word_bits == 32)
+                *vm = new BasicContext<DWORD32>(program->program32);
+            else
+                *vm = new BasicContext<DWORD64>(program->program64);
+            return SVM_OK;
+        }
+        catch (...)
+        {
+            return SVM_ERROR_SYSTEM;
+        }
+    }
+
+    void svm_vm_destroy(svm_vm *vm)
+    {
+        delete vm;
+    }
+
+    int svm_vm_reset(svm_vm *vm)
+    {
+        if (!vm)
+            return SVM_ERROR_ARGUMENT;
+        try
+        {
+            vm->reset();
+            return SVM_OK;
+        }
+        catch (...)
+        {
+            vm->fail();
+            return SVM_ERROR_SYSTEM;
+        }
+    }
+
+    int svm_vm_set_register(svm_vm *vm, unsigned reg, uint64_t value)
+    {
+        if (!vm || !vm->set_register(reg, value))
+            return SVM_ERROR_ARGUMENT;
+        return SVM_OK;
+    }
+
+    uint64_t svm_vm_get_register(const svm_vm *vm, unsigned reg)
+    {
+        return vm ? vm->get_register(reg) : 0;
+    }
+
+    int svm_vm_run(svm_vm *vm, uint64_t budget)
+    {
+        if (!vm)
+            return SVM_ERROR_ARGUMENT;
+        try
+        {
+            return vm->run(budget);
+        }
+        catch (...)
+        {
+            // 虚拟机停在不确定的状态，要先重置才能再运行
+            vm->fail();
+            return SVM_ERROR_SYSTEM;
+        }
+    }
+
+    int svm_vm_exception(const svm_vm *vm)
+    {
+        return vm ? vm->exception() : SVM_EXCEPTION_AOK;
+    }
+
+    void svm_vm_set_trap_callback(svm_vm *vm, svm_trap_callback callback, void *user)
+    {
+        if (vm)
+            vm->set_trap_callback(callback, user);
+    }
+
+    uint64_t svm_vm_retired_instructions(const svm_vm *vm)
+    {
+        return vm ? vm->retired_instructions() : 0;
+    }
+
+    void *svm_vm_memory(svm_vm *vm, size_t *words)
+    {
+        size_t size = 0;
+        void *memory = vm ? vm->memory(size) : nullptr;
+        if (words)
+            *words = size;
+        return memory;
+    }
+
+    int svm_vm_mark_dirty(svm_vm *vm, uint64_t address, size_t words)
+    {
+        if (!vm)
+            return SVM_ERROR_ARGUMENT;
+        vm->mark_dirty(address, words);
+        return SVM_OK;
+    }
+
+    size_t svm_vm_word_size(const svm_vm *vm)
+    {
+        return vm ? vm->word_size() : 0;
+    }
+
+    uint64_t svm_vm_window_base(const svm_vm *vm)
+    {
+        return vm ? vm->window_base() : 0;
+    }
+
+    uint64_t svm_vm_window_alignment(const svm_vm *vm)
+    {
+        return vm ? vm->window_alignment() : 0;
+    }
+
+    int svm_buffer_create(size_t bytes, svm_buffer **buffer)
+    {
+        if (bytes == 0 || !buffer)
+            return SVM_ERROR_ARGUMENT;
+        const int fd = memfd_create("svm_buffer", MFD_CLOEXEC);
+        if (fd < 0)
+            return SVM_ERROR_SYSTEM;
+        const size_t page = GuardedRegion::page_size();
+        if (ftruncate(fd, off_t((bytes + page - 1) / page * page)) != 0)
+        {
+            close(fd);
+            return SVM_ERROR_SYSTEM;
+        }
+        const int result = svm_buffer_import(fd, bytes, buffer);
+        close(fd);
+        return result;
+    }
+
+    int svm_buffer_import(int fd, size_t bytes, svm_buffer **buffer)
+    {
+        if (fd < 0 || bytes == 0 || !buffer)
+            return SVM_ERROR_ARGUMENT;
+        const size_t page = GuardedRegion::page_size();
+        std::unique_ptr<svm_buffer> result(new (std::nothrow) svm_buffer());
+        if (!result)
+            return SVM_ERROR_SYSTEM;
+        result->size = (bytes + page - 1) / page * page;
+        result->fd = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+        if (result->fd < 0)
+            return SVM_ERROR_SYSTEM;
+        result->data = mmap(nullptr, result->size, PROT_READ | PROT_WRITE, MAP_SHARED, result->fd, 0);
+        if (result->data == MAP_FAILED)
+        {
+            close(result->fd);
+            return SVM_ERROR_SYSTEM;
+        }
+        *buffer = result.release();
+        return SVM_OK;
+    }
+
+    void svm_buffer_free(svm_buffer *buffer)
+    {
+        if (!buffer)
+            return;
+        munmap(buffer->data, buffer->size);
+        close(buffer->fd);
+        delete buffer;
+    }
+
+    void *svm_buffer_data(const svm_buffer *buffer)
+    {
+        return buffer ? buffer->data : nullptr;
+    }
+
+    size_t svm_buffer_size(const svm_buffer *buffer)
+    {
+        return buffer ? buffer->size : 0;
+    }
+
+    int svm_buffer_fd(const svm_buffer *buffer)
+    {
+        return buffer ? buffer->fd : -1;
+    }
+
+    int svm_vm_bind_buffer(svm_vm *vm, const svm_buffer *buffer, uint64_t address)
+    {
+        if (!vm || !buffer)
+            return SVM_ERROR_ARGUMENT;
+        try
+        {
+            return vm->bind(buffer->fd, address, buffer->size) ? SVM_OK : SVM_ERROR_WINDOW;
+        }
+        catch (...)
+        {
+            return SVM_ERROR_SYSTEM;
+        }
+    }
+
+    int svm_vm_unbind_buffer(svm_vm *vm, const svm_buffer *buffer, uint64_t address)
+    {
+        if (!vm || !buffer)
+            return SVM_ERROR_ARGUMENT;
+        try
+        {
+            return vm->unbind(address, buffer->size) ? SVM_OK : SVM_ERROR_WINDOW;
+        }
+        catch (...)
+        {
+            return SVM_ERROR_SYSTEM;
+        }
+    }
+}
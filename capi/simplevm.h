@@ -0,0 +1,170 @@
+/* SimpleVM的C语言接口
+ * 编译动态库：g++ -O2 -std=c++17 -shared -fPIC -I.. simplevm.cpp -o libsimplevm.so
+ * 其他语言通过这个头文件声明的函数嵌入虚拟机，只依赖C调用约定。
+ *
+ * 使用方式：
+ *   1. svm_program_load()/svm_program_parse()解析一次程序，得到只读的svm_program，可以给任意多个虚拟机共享；
+ *   2. svm_vm_create()创建虚拟机（上下文），之后反复 svm_vm_reset() -> svm_vm_set_register() -> svm_vm_run() -> svm_vm_get_register()，
+ *      重置不会重新复制程序，也不会重新分配内存；
+ *   3. 大块输入输出放在svm_buffer中，用svm_vm_bind_buffer()映射到客户地址空间，客户程序用LOAD/STORE直接读写，宿主和客户看到的是同一份内存。
+ *
+ * 同一个虚拟机不能同时在多个线程中使用，不同的虚拟机互不影响。
+ * 函数失败时返回SVM_ERROR_*（负数）。虚拟机不输出程序结束和异常的信息，由调用者读取退出码和异常类型。
+ */
+
+#ifndef __SIMPLEVM_H__
+#define __SIMPLEVM_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    /* 已经解析的程序（只读，可以在线程间共享） */
+    typedef struct svm_program svm_program;
+    /* 虚拟机上下文 */
+    typedef struct svm_vm svm_vm;
+    /* 可以映射到客户地址空间的宿主内存 */
+    typedef struct svm_buffer svm_buffer;
+
+    /* 通用寄存器个数，寄存器编号0为AX，1为BX，依次到25为ZX */
+#define SVM_REGISTER_COUNT 26
+
+    /* 返回码 */
+    enum svm_status
+    {
+        /* 成功 */
+        SVM_OK = 0,
+        /* 参数为空或超出范围 */
+        SVM_ERROR_ARGUMENT = -1,
+        /* 文件无法打开或程序无法解析 */
+        SVM_ERROR_PROGRAM = -2,
+        /* 内存不足或系统调用失败 */
+        SVM_ERROR_SYSTEM = -3,
+        /* 窗口地址不在客户内存之后的窗口区（256MiB）内或者没有对齐，或者虚拟机编译时没有使用保护页 */
+        SVM_ERROR_WINDOW = -4
+    };
+
+    /* svm_vm_run()的停止原因 */
+    enum svm_stop
+    {
+        /* 程序通过EXIT系统调用结束，退出码在BX中 */
+        SVM_STOP_EXIT = 0,
+        /* 执行到HLT指令 */
+        SVM_STOP_HALT = 1,
+        /* 发生异常，svm_vm_exception()给出异常类型 */
+        SVM_STOP_EXCEPTION = 2,
+        /* 用完了指令预算，再次调用svm_vm_run()会继续执行 */
+        SVM_STOP_BUDGET = 3,
+        /* 执行到BRK指令，再次调用svm_vm_run()会继续执行 */
+        SVM_STOP_BREAKPOINT = 4
+    };
+
+    /* 异常类型，和虚拟机的ExceptionEnum相同 */
+    enum svm_exception
+    {
+        SVM_EXCEPTION_HLT = 0,
+        SVM_EXCEPTION_ADR = 1,
+        SVM_EXCEPTION_INS = 2,
+        SVM_EXCEPTION_DIV = 3,
+        SVM_EXCEPTION_AOK = 4
+    };
+
+    /* 陷阱类型：前四种和svm_exception相同，另外还有用完指令预算 */
+    enum svm_trap_kind
+    {
+        SVM_TRAP_HLT = 0,
+        SVM_TRAP_ADR = 1,
+        SVM_TRAP_INS = 2,
+        SVM_TRAP_DIV = 3,
+        SVM_TRAP_BUDGET = 4
+    };
+
+    /* 一次陷阱的记录 */
+    typedef struct svm_trap
+    {
+        /* 陷阱类型（svm_trap_kind） */
+        int kind;
+        /* 是否交给了客户程序的陷阱处理函数（此时虚拟机继续运行） */
+        int vectored;
+        /* 发生陷阱的指令索引 */
+        uint64_t index;
+        /* 越界的机器字地址（只有ADR时才有，否则为0） */
+        uint64_t address;
+        /* 发生时已经执行的指令数 */
+        uint64_t retired_instructions;
+    } svm_trap;
+
+    /* 陷阱回调，在调用svm_vm_run()的线程上执行，不能在回调中再运行同一个虚拟机 */
+    typedef void (*svm_trap_callback)(svm_vm *vm, const svm_trap *trap, void *user);
+
+    /* 从EXE文件读取程序，word_bits返回机器字的位数（32或64），可以为NULL */
+    int svm_program_load(const char *filename, svm_program **program, unsigned *word_bits);
+    /* 从内存中的EXE文本解析程序（不需要以0结尾） */
+    int svm_program_parse(const char *text, size_t length, svm_program **program, unsigned *word_bits);
+    /* 释放程序，还在使用它的虚拟机不受影响 */
+    void svm_program_free(svm_program *program);
+
+    /* 创建虚拟机并加载程序，机器字的位数和程序相同 */
+    int svm_vm_create(const svm_program *program, svm_vm **vm);
+    /* 销毁虚拟机，已经映射的缓冲区不受影响 */
+    void svm_vm_destroy(svm_vm *vm);
+    /* 让程序从头开始：寄存器、栈和内存恢复到刚加载时的状态（只恢复被写过的块），映射的缓冲区保留
+     * 返回SVM_OK，内部出错时返回SVM_ERROR_SYSTEM */
+    int svm_vm_reset(svm_vm *vm);
+
+    /* 设置通用寄存器，32位虚拟机只保留低32位 */
+    int svm_vm_set_register(svm_vm *vm, unsigned reg, uint64_t value);
+    /* 读取通用寄存器，编号超出范围时返回0 */
+    uint64_t svm_vm_get_register(const svm_vm *vm, unsigned reg);
+
+    /* 运行虚拟机，budget为本次最多执行的指令数（0表示不限），实际的检查粒度为256条指令
+     * 返回svm_stop，参数不合法时返回SVM_ERROR_ARGUMENT，内部出错（例如内存不足）时返回SVM_ERROR_SYSTEM；
+     * 程序结束、发生异常或内部出错后要先svm_vm_reset()才能再运行 */
+    int svm_vm_run(svm_vm *vm, uint64_t budget);
+    /* 获取异常类型（svm_exception） */
+    int svm_vm_exception(const svm_vm *vm);
+    /* 设置陷阱回调，callback为NULL时取消 */
+    void svm_vm_set_trap_callback(svm_vm *vm, svm_trap_callback callback, void *user);
+    /* 获取累计执行的指令数 */
+    uint64_t svm_vm_retired_instructions(const svm_vm *vm);
+
+    /* 获取客户内存的首地址和大小（单位为机器字），宿主可以直接读写
+     * svm_vm_reset()只恢复被写过的块：宿主通过这个指针写入后要用svm_vm_mark_dirty()标记写过的范围 */
+    void *svm_vm_memory(svm_vm *vm, size_t *words);
+    /* 标记宿主直接写过的客户内存（address和words的单位为机器字），下一次svm_vm_reset()会恢复它们，超出内存的部分忽略 */
+    int svm_vm_mark_dirty(svm_vm *vm, uint64_t address, size_t words);
+    /* 获取机器字的字节数（4或8） */
+    size_t svm_vm_word_size(const svm_vm *vm);
+    /* 获取第一个可以映射缓冲区的客户地址，也就是客户内存的大小 */
+    uint64_t svm_vm_window_base(const svm_vm *vm);
+    /* 获取映射缓冲区的地址对齐（单位为机器字），客户地址离svm_vm_window_base()必须是它的整数倍 */
+    uint64_t svm_vm_window_alignment(const svm_vm *vm);
+
+    /* 创建缓冲区（共享内存，初始为0），bytes向上取整到页 */
+    int svm_buffer_create(size_t bytes, svm_buffer **buffer);
+    /* 使用已有的共享内存文件（例如其他进程传来的memfd）创建缓冲区，fd被复制一份，调用者仍然拥有原来的fd */
+    int svm_buffer_import(int fd, size_t bytes, svm_buffer **buffer);
+    /* 释放缓冲区，已经映射到虚拟机中的部分仍然有效，直到取消映射 */
+    void svm_buffer_free(svm_buffer *buffer);
+    /* 获取缓冲区在宿主中的首地址 */
+    void *svm_buffer_data(const svm_buffer *buffer);
+    /* 获取缓冲区大小（单位为字节） */
+    size_t svm_buffer_size(const svm_buffer *buffer);
+    /* 获取缓冲区的共享内存文件 */
+    int svm_buffer_fd(const svm_buffer *buffer);
+
+    /* 把整个缓冲区映射到客户地址address（单位为机器字）开始的窗口，窗口中原来的映射被替换
+     * 窗口必须整个落在svm_vm_window_base()之后的256MiB之内 */
+    int svm_vm_bind_buffer(svm_vm *vm, const svm_buffer *buffer, uint64_t address);
+    /* 取消映射，客户再访问这段地址会发生ADR异常 */
+    int svm_vm_unbind_buffer(svm_vm *vm, const svm_buffer *buffer, uint64_t address);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -1,5 +1,126 @@
 #include <iostream>
 #include "SimpleEXE.hpp"
+#include "SimpleImageCache.hpp"
+#include "SimpleMultiCore.hpp"
+#include "SimpleForkJoin.hpp"
+#include "SimpleJobServer.hpp"
+
+template <typename WordT>
+bool load_program_file(const std::string &filename, const std::string &cache_directory, svm::BasicProgramData<WordT> &program)
+{
+    // 指定了缓存目录时，源文件没有变化就直接使用上次解析的结果
+    if (cache_directory.empty())
+    {
+        svm::BasicEXEParser<WordT> parser;
+        const bool success = parser.parse(filename);
+        program = parser.get_program();
+        return success;
+    }
+    svm::BasicImageCache<WordT> cache(cache_directory);
+    return cache.load(filename, program);
+}
+
+template <typename WordT>
+int run_multi_core(const std::string &filename, size_t cores, const std::string &cache_directory)
+{
+    svm::BasicMultiCoreVM<WordT> vm(cores);
+    svm::BasicProgramData<WordT> program;
+    const bool success = load_program_file(filename, cache_directory, program);
+    std::cout << success << std::endl;
+    if (success)
+    {
+        vm.load_program(program);
+        vm.run();
+        svm::print_split_line();
+        std::cout << "cores:" << vm.get_core_count() << " instructions:" << vm.get_retired_instructions() << std::endl;
+    }
+    return 0;
+}
+
+template <typename WordT>
+int run_fork_join(const std::string &filename, size_t workers, const std::string &cache_directory)
+{
+    svm::BasicForkJoinVM<WordT> vm(workers);
+    svm::BasicProgramData<WordT> program;
+    const bool success = load_program_file(filename, cache_directory, program);
+    std::cout << success << std::endl;
+    if (success)
+    {
+        vm.load_program(program);
+        vm.run();
+        svm::print_split_line();
+        std::cout << "workers:" << vm.get_worker_count() << " tasks:" << vm.get_spawned() << " instructions:" << vm.get_retired_instructions() << std::endl;
+    }
+    return 0;
+}
+
+template <typename WordT>
+int run_program(const std::string &filename, bool profile, const std::string &profile_json, bool perf, const std::string &metrics_socket, const std::string &cache_directory)
+{
+    svm::BasicSimpleVM<WordT> vm;
+    // 运行期间可以用nc -U或Prometheus从套接字读取虚拟机的指标
+    svm::MetricsServer metrics;
+    if (!metrics_socket.empty() && metrics.start(metrics_socket))
+        vm.enable_monitor(4096, filename);
+    vm.map_device(std::make_shared<svm::BasicConsoleDevice<WordT>>());
+    vm.enable_profiler(profile);
+    if (perf && !vm.enable_perf_counters(true))
+        std::cout << "Hardware performance counters are unavailable" << std::endl;
+    svm::BasicProgramData<WordT> program;
+    const bool success = load_program_file(filename, cache_directory, program);
+    std::cout << success << std::endl;
+    if (success)
+    {
+        vm.load_program(program);
+        vm.run();
+        print_all_instructions(vm.get_program_data());
+
+        if (profile)
+        {
+            svm::print_split_line();
+            vm.get_profiler()->print_report(std::cout, vm.get_program_data().instructions);
+            if (!profile_json.empty())
+            {
+                std::ofstream fout(profile_json);
+                vm.get_profiler()->write_json(fout, vm.get_program_data().instructions);
+            }
+        }
+
+        if (perf)
+        {
+            svm::print_split_line();
+            vm.get_perf_report().print(std::cout);
+        }
+    }
+    return 0;
+}
+
+int run_job_server(const std::string &socket_path, size_t workers, size_t prewarm, uint64_t budget)
+{
+#if SVM_JOB_SERVER
+    // 先屏蔽退出信号，工作线程继承屏蔽字，只有主线程在sigwait()中收到信号
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+    svm::JobServer server;
+    server.set_cache(prewarm, 64);
+    server.set_limits(budget, 0);
+    if (!server.start(socket_path, workers))
+        return 1;
+    std::cout << "Serving jobs on \"" << socket_path << "\"" << std::endl;
+    int signal_number = 0;
+    sigwait(&signals, &signal_number);
+    server.stop();
+    std::cout << "jobs:" << server.get_job_count() << " programs:" << server.get_program_count() << " cache hits:" << server.get_cache_hits() << std::endl;
+    return 0;
+#else
+    std::cout << "Job server is not supported on this platform" << std::endl;
+    return 1;
+#endif
+}
 
 int main(int argc, char *argv[])
 {
@@ -12,15 +133,74 @@ int main(int argc, char *argv[])
     svm::EXEGenerator generator;
     generator.generate(std::vector<std::vector<std::string>>(), program, "test.sexe");*/
 
-    svm::SimpleVM vm;
-    svm::EXEParser parser;
-    bool success = parser.parse("test.sexe");
-    std::cout << success << std::endl;
-    if (success)
+    // 用法：main [--perf] [--profile [JSON报告文件]] [--metrics 套接字路径] [--cache 缓存目录] [--cores 核数（0为所有核）] [--workers 工作核数（0为所有核）]
+    //       main --serve 套接字路径 [--workers 同时服务的连接数] [--pool 每个程序预热的虚拟机数] [--budget 每个作业最多执行的指令数]
+    bool perf = false;
+    bool profile = false;
+    std::string profile_json;
+    std::string metrics_socket;
+    std::string cache_directory;
+    // 指定核数时用多核虚拟机运行，此时不支持分析和监控
+    bool multi_core = false;
+    size_t cores = 0;
+    // 指定工作核数时用分叉-汇合虚拟机运行（程序使用SPAWN/JOIN）
+    bool fork_join = false;
+    size_t workers = 0;
+    // 指定套接字时作为作业服务一直运行，直到收到SIGINT或SIGTERM
+    std::string serve_socket;
+    size_t prewarm = 1;
+    // 默认给每个作业一个有限的预算，--budget 0表示不限
+    uint64_t budget = svm::JOB_DEFAULT_BUDGET;
+    for (int i = 1; i < argc; i++)
     {
-        vm.load_program(parser.get_program());
-        vm.run();
-        print_all_instructions(vm.get_program_data());
+        const std::string arg = argv[i];
+        if (arg == "--perf")
+            perf = true;
+        else if (arg == "--metrics" && i + 1 < argc)
+            metrics_socket = argv[++i];
+        else if (arg == "--cache" && i + 1 < argc)
+            cache_directory = argv[++i];
+        else if (arg == "--cores" && i + 1 < argc)
+        {
+            multi_core = true;
+            cores = std::stoul(argv[++i]);
+        }
+        else if (arg == "--workers" && i + 1 < argc)
+        {
+            fork_join = true;
+            workers = std::stoul(argv[++i]);
+        }
+        else if (arg == "--serve" && i + 1 < argc)
+            serve_socket = argv[++i];
+        else if (arg == "--pool" && i + 1 < argc)
+            prewarm = std::stoul(argv[++i]);
+        else if (arg == "--budget" && i + 1 < argc)
+            budget = std::stoull(argv[++i]);
+        else if (arg == "--profile")
+        {
+            profile = true;
+            if (i + 1 < argc && argv[i + 1][0] != '-')
+                profile_json = argv[++i];
+        }
     }
-    return 0;
+
+    if (!serve_socket.empty())
+        return run_job_server(serve_socket, workers, prewarm, budget);
+
+    // 程序文件头的bits声明决定使用哪种宽度的虚拟机
+    if (multi_core)
+    {
+        if (svm::detect_word_bits("test.sexe") == 32)
+            return run_multi_core<svm::DWORD32>("test.sexe", cores, cache_directory);
+        return run_multi_core<svm::DWORD64>("test.sexe", cores, cache_directory);
+    }
+    if (fork_join)
+    {
+        if (svm::detect_word_bits("test.sexe") == 32)
+            return run_fork_join<svm::DWORD32>("test.sexe", workers, cache_directory);
+        return run_fork_join<svm::DWORD64>("test.sexe", workers, cache_directory);
+    }
+    if (svm::detect_word_bits("test.sexe") == 32)
+        return run_program<svm::DWORD32>("test.sexe", profile, profile_json, perf, metrics_socket, cache_directory);
+    return run_program<svm::DWORD64>("test.sexe", profile, profile_json, perf, metrics_socket, cache_directory);
 }
\ No newline at end of file
@@ -0,0 +1,1376 @@
+// 功能测试：逐项运行小程序并检查结果，有失败时返回非0
+// 编译：g++ -O2 -std=c++17 -pthread -I.. vm_test.cpp -o vm_test
+// 用法：vm_test（检查点和作业服务的测试会在/tmp下创建临时文件）
+
+#include <cstdio>
+#include <sstream>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "../SimpleEXE.hpp"
+#include "../SimpleDevice.hpp"
+#include "../SimpleScheduler.hpp"
+#include "../SimpleSIMT.hpp"
+#include "../SimpleDebugger.hpp"
+#include "../SimpleMultiCore.hpp"
+#include "../SimpleForkJoin.hpp"
+#include "../SimpleCheckpoint.hpp"
+#include "../SimpleImageCache.hpp"
+#include "../SimpleJobServer.hpp"
+#include "../SimpleVMPool.hpp"
+// 整个库都在头文件中，C接口的实现直接编译进来，不需要另外链接
+#include "../capi/simplevm.cpp"
+
+using namespace svm;
+
+/// @brief 失败的检查数
+static size_t failures = 0;
+
+/// @brief 检查条件，失败时输出位置
+#define CHECK(condition)                                                           \
+    do                                                                             \
+    {                                                                              \
+        if (!(condition))                                                          \
+        {                                                                          \
+            printf("  %s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+            failures++;                                                            \
+        }                                                                          \
+    } while (0)
+
+/// @brief 解析EXE文本
+/// @param text 程序
+/// @return 程序，解析失败时没有指令
+static ProgramData parse(const std::string &text)
+{
+    std::vector<std::string> lines;
+    std::istringstream sstr(text);
+    std::string line;
+    while (std::getline(sstr, line))
+        lines.push_back(line);
+    EXEParser parser;
+    if (!parser.parse_lines(lines))
+        return ProgramData();
+    return parser.get_program();
+}
+
+/// @brief 运行程序直到结束或暂停，控制台接到字符串上
+/// @param vm 虚拟机
+/// @param text 程序
+/// @param input 程序读到的内容
+/// @return 程序的输出
+static std::string run(SimpleVM &vm, const std::string &text, const std::string &input = "")
+{
+    std::istringstream in(input);
+    std::ostringstream out;
+    vm.set_quiet(true);
+    vm.set_console(in, out);
+    vm.load_program(parse(text));
+    vm.run();
+    vm.reset_console();
+    return out.str();
+}
+
+/// @brief 获取通用寄存器
+static DWORD reg(SimpleVM &vm, RegisterEnum::GeneralRegister r)
+{
+    return vm.get_vm_state().general_registers.at(r);
+}
+
+/// @brief 锁步执行分支各不相同的程序，每个通道的结果和逐个用SimpleVM运行相同
+static void test_simt_divergence()
+{
+    const std::string collatz = "section text\n"
+                                "MOVRI BX, 0\n"
+                                "loop:\n"
+                                "CMPRI AX, 1\n"
+                                "JE done\n"
+                                "ANDRRI CX, AX, 1\n"
+                                "JNE odd\n"
+                                "SHRRRI AX, AX, 1\n"
+                                "count:\n"
+                                "ADDRRI BX, BX, 1\n"
+                                "JMP loop\n"
+                                "odd:\n"
+                                "MULRRI AX, AX, 3\n"
+                                "ADDRRI AX, AX, 1\n"
+                                "JMP count\n"
+                                "done:\n"
+                                "MOVRI AX, 4\n"
+                                "SYSCALL\n";
+    const ProgramData program = parse(collatz);
+    const size_t lanes = 64;
+
+    SIMTVM simt(lanes);
+    simt.load_program(program);
+    for (size_t i = 0; i < lanes; i++)
+        simt.get_register(i, RegisterEnum::GeneralRegister::AX) = DWORD(i + 1);
+    simt.run();
+
+    SimpleVM vm;
+    vm.set_quiet(true);
+    size_t mismatches = 0;
+    for (size_t i = 0; i < lanes; i++)
+    {
+        vm.reset();
+        vm.load_program(program);
+        vm.get_vm_state().general_registers.at(RegisterEnum::GeneralRegister::AX) = DWORD(i + 1);
+        vm.run();
+        if (simt.get_exception(i) != ExceptionEnum::Exception::AOK || simt.get_exit_code(i) != reg(vm, RegisterEnum::GeneralRegister::BX))
+            mismatches++;
+    }
+    CHECK(mismatches == 0);
+    CHECK(simt.get_exit_code(26) == 111);
+    CHECK(simt.get_regroups() > 0);
+    CHECK(simt.get_issued_instructions() < simt.get_retired_instructions());
+}
+
+/// @brief 还没有分支时就有线程出错，剩下的线程照常执行到结束
+static void test_simt_fault_before_branch()
+{
+    const ProgramData program = parse("section text\n"
+                                      "DIVRRR CX, BX, AX\n"
+                                      "MOVRR BX, CX\n"
+                                      "MOVRI AX, 4\n"
+                                      "SYSCALL\n");
+    SIMTVM simt(4);
+    simt.load_program(program);
+    for (size_t i = 0; i < 4; i++)
+    {
+        simt.get_register(i, RegisterEnum::GeneralRegister::AX) = DWORD(i);
+        simt.get_register(i, RegisterEnum::GeneralRegister::BX) = 12;
+    }
+    simt.run();
+    CHECK(simt.get_exception(0) == ExceptionEnum::Exception::DIV);
+    for (size_t i = 1; i < 4; i++)
+    {
+        CHECK(simt.get_exception(i) == ExceptionEnum::Exception::AOK);
+        CHECK(simt.get_exit_code(i) == 12 / i);
+    }
+}
+
+/// @brief 陷阱交给客户程序的处理函数，处理函数返回后从出错的下一条指令继续
+static void test_trap_vector()
+{
+    SimpleVM vm;
+    run(vm, "section text\n"
+            "MOVRI AX, 14\n"
+            "MOVRI BX, 3\n"
+            "MOVRI CX, handler\n"
+            "SYSCALL\n"
+            "MOVRI AX, 0\n"
+            "MOVRI BX, 12\n"
+            "DIVRRR CX, BX, AX\n"
+            "MOVRR BX, DX\n"
+            "MOVRI AX, 4\n"
+            "SYSCALL\n"
+            "handler:\n"
+            "MOVRI AX, 15\n"
+            "SYSCALL\n"
+            "MULRRI DX, AX, 100\n"
+            "ADDRRR DX, DX, BX\n"
+            "RET\n");
+    CHECK(vm.get_vm_state().exception == ExceptionEnum::Exception::AOK);
+    CHECK(reg(vm, RegisterEnum::GeneralRegister::BX) == 306);
+    CHECK(vm.get_last_trap().trap == TrapEnum::Trap::DIV);
+    CHECK(vm.get_last_trap().index == 6);
+
+    // 处理函数中再出错时照常中止
+    SimpleVM nested;
+    run(nested, "section text\n"
+                "MOVRI AX, 14\n"
+                "MOVRI BX, 1\n"
+                "MOVRI CX, handler\n"
+                "SYSCALL\n"
+                "MOVRI BX, 1099511627776\n"
+                "LOAD AX, BX\n"
+                "MOVRI DX, 1\n"
+                "handler:\n"
+                "LOAD AX, BX\n"
+                "RET\n");
+    CHECK(nested.get_vm_state().exception == ExceptionEnum::Exception::ADR);
+    CHECK(reg(nested, RegisterEnum::GeneralRegister::DX) == 0);
+}
+
+/// @brief 跳到程序之外时没有可以返回的指令，不交给处理函数
+static void test_trap_vector_pc_fault()
+{
+    SimpleVM vm;
+    run(vm, "section text\n"
+            "MOVRI AX, 14\n"
+            "MOVRI BX, 1\n"
+            "MOVRI CX, handler\n"
+            "SYSCALL\n"
+            "JMP 100\n"
+            "handler:\n"
+            "MOVRI DX, 1\n"
+            "RET\n");
+    CHECK(vm.get_vm_state().exception == ExceptionEnum::Exception::ADR);
+    CHECK(!vm.get_vm_state().is_running);
+    CHECK(reg(vm, RegisterEnum::GeneralRegister::DX) == 0);
+}
+
+/// @brief 检查点保存客户程序设置的陷阱处理函数，恢复后照样交给处理函数
+static void test_trap_vector_checkpoint()
+{
+    const ProgramData program = parse("section text\n"
+                                      "MOVRI AX, 14\n"
+                                      "MOVRI BX, 3\n"
+                                      "MOVRI CX, handler\n"
+                                      "SYSCALL\n"
+                                      "MOVRI CX, 5000\n"
+                                      "loop:\n"
+                                      "SUBRRI CX, CX, 1\n"
+                                      "JNE loop\n"
+                                      "DIVRRR AX, BX, CX\n"
+                                      "MOVRR BX, DX\n"
+                                      "MOVRI AX, 4\n"
+                                      "SYSCALL\n"
+                                      "handler:\n"
+                                      "MOVRI DX, 77\n"
+                                      "RET\n");
+    const std::string filename = "/tmp/svm_test_" + std::to_string(getpid()) + ".trap.ckpt";
+
+    SimpleVM vm;
+    vm.set_quiet(true);
+    vm.load_program(program);
+    vm.set_run_budget(1000);
+    vm.run();
+    CHECK(vm.get_stop_reason() == StopEnum::Reason::BUDGET);
+    Checkpoint checkpoint(filename);
+    CHECK(checkpoint.save(vm));
+
+    SimpleVM restored;
+    restored.set_quiet(true);
+    restored.load_program(program);
+    CHECK(checkpoint.restore(restored));
+    restored.run();
+    CHECK(restored.get_vm_state().exception == ExceptionEnum::Exception::AOK);
+    CHECK(reg(restored, RegisterEnum::GeneralRegister::BX) == 77);
+    remove(filename.c_str());
+}
+
+/// @brief 通过套接字提交作业：正常退出、用完预算、异常和无法解析的程序
+static void test_job_protocol()
+{
+#if SVM_JOB_SERVER
+    const std::string path = "/tmp/svm_test_" + std::to_string(getpid()) + ".sock";
+    JobServer server;
+    CHECK(server.start(path, 2));
+
+    JobClient client;
+    CHECK(client.connect(path));
+    std::string output;
+    JobResult result;
+
+    JobRequest echo;
+    echo.image = "section text\n"
+                 "MOVRI DX, 0\n"
+                 "loop:\n"
+                 "MOVRI AX, 2\n"
+                 "MOVRI BX, 2\n"
+                 "SYSCALL\n"
+                 "CMPRI AX, 255\n"
+                 "JE done\n"
+                 "MOVRR CX, AX\n"
+                 "MOVRI AX, 0\n"
+                 "MOVRI BX, 2\n"
+                 "SYSCALL\n"
+                 "ADDRRI DX, DX, 1\n"
+                 "JMP loop\n"
+                 "done:\n"
+                 "MOVRR BX, DX\n"
+                 "MOVRI AX, 4\n"
+                 "SYSCALL\n";
+    for (const std::string input : {"hello", "job protocol\n"})
+    {
+        echo.input = input;
+        CHECK(client.submit(echo, output, result));
+        CHECK(result.status == JobEnum::Status::EXIT);
+        CHECK(output == input);
+        CHECK(result.exit_code == input.size());
+    }
+
+    JobRequest spin;
+    spin.image = "section text\nloop:\nJMP loop\n";
+    spin.budget = 10000;
+    CHECK(client.submit(spin, output, result));
+    CHECK(result.status == JobEnum::Status::BUDGET);
+
+    JobRequest fault;
+    fault.image = "section text\nMOVRI BX, 1099511627776\nLOAD AX, BX\n";
+    CHECK(client.submit(fault, output, result));
+    CHECK(result.status == JobEnum::Status::EXCEPTION);
+    CHECK(result.exception == ExceptionEnum::Exception::ADR);
+
+    JobRequest broken;
+    broken.image = "section text\nNOSUCH AX, BX\n";
+    CHECK(client.submit(broken, output, result));
+    CHECK(result.status == JobEnum::Status::ERROR);
+
+    // 缓存中有多个程序时每个作业都运行自己的程序
+    for (size_t i = 0; i < 4; i++)
+    {
+        JobRequest exit_code;
+        exit_code.image = "section text\nMOVRI AX, 4\nMOVRI BX, " + std::to_string(i % 2 + 40) + "\nSYSCALL\n";
+        CHECK(client.submit(exit_code, output, result));
+        CHECK(result.status == JobEnum::Status::EXIT);
+        CHECK(result.exit_code == i % 2 + 40);
+    }
+
+    client.disconnect();
+    server.stop();
+    CHECK(server.get_job_count() >= 4);
+#endif
+}
+
+/// @brief 预先设置寄存器，运行几条指令后用EXIT结束
+/// @param vm 虚拟机，上一次运行的异常会被清除
+/// @param text 指令，结果要放在AX和BX以外的寄存器中
+/// @param values 依次是AX、BX、CX、DX的初值
+static void run_with(SimpleVM &vm, const std::string &text, std::initializer_list<DWORD> values)
+{
+    vm.set_quiet(true);
+    vm.load_program(parse("section text\n" + text + "MOVRI AX, 4\nMOVRI BX, 0\nSYSCALL\n"));
+    vm.get_vm_state().exception = ExceptionEnum::Exception::AOK;
+    DWORD reg = RegisterEnum::GeneralRegister::AX;
+    for (DWORD value : values)
+        vm.get_vm_state().general_registers.at(reg++) = value;
+    vm.run();
+}
+
+/// @brief MEMSET/MEMCPY/MEMCMP/STRLEN在各种长度（包括向量化之后剩下的尾部）上的结果
+static void test_bulk_memory()
+{
+    const DWORD base = 300;
+    const DWORD lengths[] = {1, 2, 3, 4, 5, 7, 8, 9, 15, 16, 17, 31, 33, 100};
+    for (DWORD length : lengths)
+    {
+        SimpleVM vm;
+        run_with(vm, "MEMSET BX, CX, DX\n"
+                     "ADDRRI AX, BX, 200\n"
+                     "MEMCPY AX, BX, DX\n"
+                     "MOVRR EX, BX\n"
+                     "MEMCMP EX, AX, DX\n",
+                 {0, base, 0x5A, length});
+        DWORD *memory = vm.get_internal_storage_data().get_internal_storage();
+        CHECK(vm.get_vm_state().exception == ExceptionEnum::Exception::AOK);
+        CHECK(memory[base - 1] == 0 && memory[base + length] == 0);
+        CHECK(memory[base] == 0x5A && memory[base + length - 1] == 0x5A);
+        CHECK(memory[base + 200 + length - 1] == 0x5A && memory[base + 200 + length] == 0);
+        CHECK(reg(vm, RegisterEnum::GeneralRegister::EX) == 0);
+
+        // 只有最后一个不同，MEMCMP要找到它
+        memory[base + 200 + length - 1] = 0x5B;
+        run_with(vm, "MEMCMP EX, BX, DX\n", {0, base + 200, 0, length, base});
+        CHECK(reg(vm, RegisterEnum::GeneralRegister::EX) == DWORD(-1));
+
+        // STRLEN：第一个0在length处
+        run_with(vm, "STRLEN FX, BX\n", {0, base});
+        CHECK(reg(vm, RegisterEnum::GeneralRegister::FX) == length);
+    }
+
+    // 越过内存末尾的范围整个被拒绝，不会写一半
+    SimpleVM vm;
+    const DWORD total = SimpleVM::ISData::TOTAL_CAPACITY;
+    run_with(vm, "MEMSET BX, CX, DX\n", {0, total - 4, 7, 5});
+    CHECK(vm.get_vm_state().exception == ExceptionEnum::Exception::ADR);
+    CHECK(vm.get_internal_storage_data().get_internal_storage()[total - 4] == 0);
+
+    // 一直到内存末尾都没有0
+    SimpleVM unterminated;
+    std::fill_n(unterminated.get_internal_storage_data().get_internal_storage() + total - 8, 8, DWORD(1));
+    run_with(unterminated, "STRLEN FX, BX\n", {0, total - 8});
+    CHECK(unterminated.get_vm_state().exception == ExceptionEnum::Exception::ADR);
+}
+
+/// @brief 批量指令可以在bind_window()映射的1MiB窗口上整段执行
+static void test_bulk_memory_window()
+{
+#if SVM_GUARD_PAGES && defined(__linux__)
+    const size_t bytes = size_t(1) << 20;
+    const DWORD words = DWORD(bytes / sizeof(DWORD));
+    const int fd = memfd_create("svm_test", MFD_CLOEXEC);
+    CHECK(fd >= 0 && ftruncate(fd, off_t(bytes)) == 0);
+    DWORD *host = static_cast<DWORD *>(mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0));
+    CHECK(host != MAP_FAILED);
+
+    const DWORD window = SimpleVM::ISData::TOTAL_CAPACITY;
+    SimpleVM vm;
+    CHECK(vm.bind_window(fd, window, words));
+    run_with(vm, "MEMSET BX, CX, DX\n"
+                 "ADDRRR AX, BX, DX\n"
+                 "MEMCPY AX, BX, DX\n"
+                 "MOVRR EX, BX\n"
+                 "MEMCMP EX, AX, DX\n"
+                 "MOVRI CX, 0\n"
+                 "STORE CX, BX, 10\n"
+                 "STRLEN FX, BX\n",
+             {0, window, 3, words / 2});
+    CHECK(vm.get_vm_state().exception == ExceptionEnum::Exception::AOK);
+    CHECK(reg(vm, RegisterEnum::GeneralRegister::EX) == 0);
+    CHECK(reg(vm, RegisterEnum::GeneralRegister::FX) == 10);
+    CHECK(host[0] == 3 && host[words / 2 - 1] == 3 && host[words / 2] == 3 && host[words - 1] == 3);
+
+    // 从内存跨进窗口（首尾相接）可以，越过窗口末尾不行
+    run_with(vm, "MEMSET BX, CX, DX\n", {0, window - 2, 9, 4});
+    CHECK(vm.get_vm_state().exception == ExceptionEnum::Exception::AOK);
+    CHECK(host[0] == 9 && host[1] == 9 && host[2] == 3);
+    run_with(vm, "MEMSET BX, CX, DX\n", {0, window + words - 1, 9, 2});
+    CHECK(vm.get_vm_state().exception == ExceptionEnum::Exception::ADR);
+    CHECK(host[words - 1] == 3);
+
+    CHECK(vm.unbind_window(window, words));
+    run_with(vm, "MEMSET BX, CX, DX\n", {0, window, 9, 1});
+    CHECK(vm.get_vm_state().exception == ExceptionEnum::Exception::ADR);
+    munmap(host, bytes);
+    close(fd);
+#endif
+}
+
+/// @brief 递归求1+2+...+CX，每层调用占用返回地址和一个PUSH，共两个DWORD
+static const char *const recursive_sum = "section text\n"
+                                         "MOVRI BX, 0\n"
+                                         "CALL sum\n"
+                                         "MOVRI AX, 4\n"
+                                         "SYSCALL\n"
+                                         "sum:\n"
+                                         "CMPRI CX, 0\n"
+                                         "JE base\n"
+                                         "PUSH CX\n"
+                                         "SUBRRI CX, CX, 1\n"
+                                         "CALL sum, 2\n"
+                                         "POP CX\n"
+                                         "ADDRRR BX, BX, CX\n"
+                                         "base:\n"
+                                         "RET\n";
+
+/// @brief CALL/RET和帧内的PUSH/POP都逐个检查栈的边界
+static void test_call_ret()
+{
+    const ProgramData program = parse(recursive_sum);
+    CHECK(!program.instructions.empty());
+    const DWORD depths[] = {0, 1, 10, 60, 200};
+    for (DWORD depth : depths)
+    {
+        SimpleVM vm;
+        vm.set_quiet(true);
+        vm.load_program(program);
+        vm.get_vm_state().general_registers.at(RegisterEnum::GeneralRegister::CX) = depth;
+        vm.run();
+        // 栈区有STACK_CAPACITY个DWORD，200层放不下，在某个PUSH或CALL处越界
+        if (depth * 2 < SimpleVM::ISData::STACK_CAPACITY)
+        {
+            CHECK(vm.get_vm_state().exception == ExceptionEnum::Exception::AOK);
+            CHECK(reg(vm, RegisterEnum::GeneralRegister::BX) == depth * (depth + 1) / 2);
+        }
+        else
+            CHECK(vm.get_vm_state().exception == ExceptionEnum::Exception::ADR);
+    }
+
+    // SIMT的各个通道递归深度不同，结果和SimpleVM相同
+    SIMTVM simt(4);
+    simt.load_program(program);
+    for (size_t i = 0; i < 4; i++)
+        simt.get_register(i, RegisterEnum::GeneralRegister::CX) = depths[i + 1];
+    simt.run();
+    for (size_t i = 0; i < 3; i++)
+    {
+        CHECK(simt.get_exception(i) == ExceptionEnum::Exception::AOK);
+        CHECK(simt.get_exit_code(i) == depths[i + 1] * (depths[i + 1] + 1) / 2);
+    }
+    CHECK(simt.get_exception(3) == ExceptionEnum::Exception::ADR);
+
+    // 没有调用就RET，栈是空的
+    SimpleVM empty;
+    run(empty, "section text\nRET\n");
+    CHECK(empty.get_vm_state().exception == ExceptionEnum::Exception::ADR);
+}
+
+/// @brief 内存之内的读写正常，超出内存的读写（包括64位地址的高位）触发ADR异常
+static void test_guard_page()
+{
+    SimpleVM vm;
+    run(vm, "section text\n"
+            "MOVRI BX, 300\n"
+            "MOVRI CX, 42\n"
+            "STORE CX, BX, 2\n"
+            "LOAD AX, BX, 2\n"
+            "MOVRR DX, AX\n"
+            "MOVRI AX, 4\n"
+            "MOVRI BX, 0\n"
+            "SYSCALL\n");
+    CHECK(vm.get_vm_state().exception == ExceptionEnum::Exception::AOK);
+    CHECK(reg(vm, RegisterEnum::GeneralRegister::DX) == 42);
+
+    // 刚好超出内存（落在保护页上）和远远超出内存的地址，按字、按字节和原子指令
+    const DWORD addresses[] = {DWORD(SimpleVM::ISData::TOTAL_CAPACITY), DWORD(1) << 40};
+    const char *const accesses[] = {"STORE CX, BX\n", "LOADB CX, BX\n", "XCHG CX, BX\n"};
+    for (DWORD address : addresses)
+    {
+        for (const char *access : accesses)
+        {
+            // 按字节寻址时把字地址换算成字节地址
+            const DWORD byte_address = access[4] == 'B' ? address * sizeof(DWORD) : address;
+            SimpleVM faulting;
+            run(faulting, "section text\n"
+                          "MOVRI BX, " + std::to_string(byte_address) + "\n" +
+                          access +
+                          "MOVRI DX, 1\n");
+            CHECK(faulting.get_vm_state().exception == ExceptionEnum::Exception::ADR);
+            CHECK(reg(faulting, RegisterEnum::GeneralRegister::DX) == 0);
+        }
+    }
+}
+
+/// @brief 不属于虚拟机的SIGSEGV交给原来的处理方式；原来是忽略时也要结束进程，而不是一直重新执行出错的指令
+static void test_host_segv()
+{
+#if SVM_GUARD_PAGES
+    const pid_t child = fork();
+    if (child == 0)
+    {
+        alarm(5);
+        install_guard_signal_handler();
+        previous_segv_action().sa_handler = SIG_IGN;
+        previous_segv_action().sa_flags = 0;
+        volatile int *volatile null = nullptr;
+        *null = 1;
+        _exit(0);
+    }
+    int status = 0;
+    CHECK(child > 0 && waitpid(child, &status, 0) == child);
+    CHECK(WIFSIGNALED(status) && WTERMSIG(status) == SIGSEGV);
+#endif
+}
+
+/// @brief 从池中取出的虚拟机和新建的一样：restart()恢复了程序和堆系统调用写过的所有内存
+static void test_pool_restart()
+{
+    // 64个DWORD的块让后面的块头和空闲链表指针落到下一个脏块里，竞技场分配再把SCAN_STRING的缓冲区推到更后面的块里；
+    // 这些块只有堆系统调用写过
+    const ProgramData program = parse("section text\n"
+                                      "MOVRI AX, 5\n"
+                                      "MOVRI BX, 64\n"
+                                      "SYSCALL\n"
+                                      "MOVRR CX, AX\n"
+                                      "MOVRI AX, 5\n"
+                                      "MOVRI BX, 1\n"
+                                      "SYSCALL\n"
+                                      "MOVRR DX, AX\n"
+                                      "MOVRI AX, 6\n"
+                                      "MOVRR BX, CX\n"
+                                      "SYSCALL\n"
+                                      "MOVRI AX, 6\n"
+                                      "MOVRR BX, DX\n"
+                                      "SYSCALL\n"
+                                      "MOVRI AX, 7\n"
+                                      "MOVRI BX, 100\n"
+                                      "SYSCALL\n"
+                                      "MOVRI AX, 3\n"
+                                      "MOVRI BX, 2\n"
+                                      "SYSCALL\n"
+                                      "MOVRR EX, AX\n"
+                                      "MOVRI AX, 4\n"
+                                      "SYSCALL\n");
+    CHECK(!program.instructions.empty());
+
+    SimpleVM fresh;
+    fresh.load_program(program);
+    const DWORD *initial = fresh.get_internal_storage_data().get_internal_storage();
+
+    VMPool pool(program, 1, 1);
+    for (int round = 0; round < 3; round++)
+    {
+        std::unique_ptr<SimpleVM> vm = pool.acquire();
+        const DWORD *memory = vm->get_internal_storage_data().get_internal_storage();
+        CHECK(std::equal(memory, memory + SimpleVM::ISData::TOTAL_CAPACITY, initial));
+
+        std::istringstream in("hello");
+        std::ostringstream out;
+        vm->set_console(in, out);
+        vm->run();
+        vm->reset_console();
+        CHECK(vm->get_vm_state().exception == ExceptionEnum::Exception::AOK);
+        CHECK(reg(*vm, RegisterEnum::GeneralRegister::DX) == SimpleVM::ISData::HEAP_SECTION_BEGINNING + HeapAllocator::BLOCKS + 66);
+        CHECK(std::string(reinterpret_cast<const char *>(memory) + reg(*vm, RegisterEnum::GeneralRegister::EX)) == "hello");
+        pool.release(std::move(vm));
+    }
+    CHECK(pool.get_idle_count() == 1);
+}
+
+/// @brief 控制台设备输出到set_console()设置的流
+static void test_console_device()
+{
+    SimpleVM vm;
+    auto device = std::make_shared<ConsoleDevice>(8);
+    CHECK(vm.map_device(device));
+    std::istringstream in;
+    std::ostringstream out;
+    vm.set_console(in, out);
+
+    // 环形缓冲区绕回的情况
+    DWORD *memory = vm.get_internal_storage_data().access(device->get_base());
+    memory[ConsoleDevice::BUFFER + 6] = 'o';
+    memory[ConsoleDevice::BUFFER + 7] = 'k';
+    memory[ConsoleDevice::BUFFER + 0] = '!';
+    memory[ConsoleDevice::HEAD] = 6;
+    memory[ConsoleDevice::TAIL] = 1;
+    memory[ConsoleDevice::DOORBELL] = 1;
+    vm.service_devices();
+    CHECK(out.str() == "ok!");
+    CHECK(memory[ConsoleDevice::HEAD] == 1);
+    CHECK(memory[ConsoleDevice::DOORBELL] == 0);
+
+    // 程序自己写缓冲区和门铃，结束时虚拟机处理剩下的输出
+    out.str("");
+    vm.reset();
+    vm.set_quiet(true);
+    vm.load_program(parse("section text\n"
+                          "MOVRI BX, " + std::to_string(device->get_base()) + "\n"
+                          "MOVRI CX, 104\n"
+                          "STORE CX, BX, " + std::to_string(ConsoleDevice::BUFFER) + "\n"
+                          "MOVRI CX, 105\n"
+                          "STORE CX, BX, " + std::to_string(ConsoleDevice::BUFFER + 1) + "\n"
+                          "MOVRI CX, 2\n"
+                          "STORE CX, BX, " + std::to_string(ConsoleDevice::TAIL) + "\n"
+                          "MOVRI CX, 1\n"
+                          "STORE CX, BX, " + std::to_string(ConsoleDevice::DOORBELL) + "\n"
+                          "MOVRI AX, 4\n"
+                          "MOVRI BX, 0\n"
+                          "SYSCALL\n"));
+    vm.run();
+    vm.reset_console();
+    CHECK(vm.get_vm_state().exception == ExceptionEnum::Exception::AOK);
+    CHECK(out.str() == "hi");
+}
+
+/// @brief ALLOC/FREE复用同级别的块，超出堆的分配失败
+static void test_allocator()
+{
+    SimpleVM vm;
+    run(vm, "section text\n"
+            "MOVRI AX, 5\n"
+            "MOVRI BX, 3\n"
+            "SYSCALL\n"
+            "MOVRR DX, AX\n"
+            "MOVRI AX, 6\n"
+            "MOVRR BX, DX\n"
+            "SYSCALL\n"
+            "MOVRI AX, 5\n"
+            "MOVRI BX, 4\n"
+            "SYSCALL\n"
+            "MOVRR CX, AX\n"
+            "MOVRI AX, 5\n"
+            "MOVRI BX, 100000\n"
+            "SYSCALL\n"
+            "MOVRR EX, AX\n"
+            "MOVRI AX, 4\n"
+            "MOVRI BX, 0\n"
+            "SYSCALL\n");
+    const DWORD first = reg(vm, RegisterEnum::GeneralRegister::DX);
+    CHECK(vm.get_vm_state().exception == ExceptionEnum::Exception::AOK);
+    CHECK(first > SimpleVM::ISData::HEAP_SECTION_BEGINNING);
+    CHECK(first < SimpleVM::ISData::HEAP_SECTION_BEGINNING + SimpleVM::ISData::HEAP_CAPACITY);
+    CHECK(reg(vm, RegisterEnum::GeneralRegister::CX) == first);
+    CHECK(reg(vm, RegisterEnum::GeneralRegister::EX) == 0);
+
+    std::vector<DWORD> memory(64, 0);
+    HeapAllocator heap(memory.data(), 0, memory.size());
+    const DWORD a = heap.allocate(2);
+    const DWORD b = heap.allocate(2);
+    CHECK(a != 0 && b != 0 && a != b);
+    CHECK(heap.free(a));
+    CHECK(!heap.free(DWORD(memory.size())));
+    CHECK(heap.allocate(1) != a);
+    CHECK(heap.allocate(2) == a);
+    heap.reset();
+    CHECK(heap.allocate(2) == a);
+
+    // 被程序改坏的链表头不会被当成块返回
+    memory[HeapAllocator::FREE_LISTS + 3] = 9999;
+    CHECK(heap.allocate(8) != 9999);
+
+    // 竞技场分配没有块头，HEAP_RESET之后从头开始
+    SimpleVM arena;
+    run(arena, "section text\n"
+               "MOVRI AX, 7\n"
+               "MOVRI BX, 10\n"
+               "SYSCALL\n"
+               "MOVRR CX, AX\n"
+               "MOVRI AX, 7\n"
+               "MOVRI BX, 10\n"
+               "SYSCALL\n"
+               "MOVRR DX, AX\n"
+               "MOVRI AX, 8\n"
+               "SYSCALL\n"
+               "MOVRI AX, 7\n"
+               "MOVRI BX, 10\n"
+               "SYSCALL\n"
+               "MOVRR EX, AX\n"
+               "MOVRI AX, 4\n"
+               "MOVRI BX, 0\n"
+               "SYSCALL\n");
+    CHECK(arena.get_vm_state().exception == ExceptionEnum::Exception::AOK);
+    CHECK(reg(arena, RegisterEnum::GeneralRegister::CX) == SimpleVM::ISData::HEAP_SECTION_BEGINNING + HeapAllocator::BLOCKS);
+    CHECK(reg(arena, RegisterEnum::GeneralRegister::DX) == reg(arena, RegisterEnum::GeneralRegister::CX) + 10);
+    CHECK(reg(arena, RegisterEnum::GeneralRegister::EX) == reg(arena, RegisterEnum::GeneralRegister::CX));
+}
+
+/// @brief 向量指令逐通道的结果和按有符号数逐个计算的结果相同
+static void test_vector_ops()
+{
+    using Vector = SimpleVM::VectorValue;
+    const size_t lanes = Vector::LANES;
+    const DWORD a = 300, b = a + lanes, out = 400;
+    SimpleVM vm;
+    DWORD *memory = vm.get_internal_storage_data().get_internal_storage();
+    for (size_t i = 0; i < lanes; i++)
+    {
+        memory[a + i] = DWORD(int64_t(i) * 7 - 9);
+        memory[b + i] = DWORD(5 - int64_t(i) * 3);
+    }
+    run(vm, "section text\n"
+            "MOVRI BX, " + std::to_string(a) + "\n"
+            "MOVRI CX, " + std::to_string(out) + "\n"
+            "VLOAD V0, BX\n"
+            "VLOAD V1, BX, " + std::to_string(lanes) + "\n"
+            "VADD V2, V0, V1\n"
+            "VSTORE V2, CX\n"
+            "VSUB V2, V0, V1\n"
+            "VSTORE V2, CX, " + std::to_string(lanes) + "\n"
+            "VMUL V2, V0, V1\n"
+            "VSTORE V2, CX, " + std::to_string(lanes * 2) + "\n"
+            "VMIN V2, V0, V1\n"
+            "VSTORE V2, CX, " + std::to_string(lanes * 3) + "\n"
+            "VMAX V2, V0, V1\n"
+            "VSTORE V2, CX, " + std::to_string(lanes * 4) + "\n"
+            "VCMPGT V2, V0, V1\n"
+            "VSTORE V2, CX, " + std::to_string(lanes * 5) + "\n"
+            "VCMPEQ V2, V0, V0\n"
+            "VSTORE V2, CX, " + std::to_string(lanes * 6) + "\n"
+            "VREDADD DX, V0\n"
+            "VREDMIN EX, V0\n"
+            "VREDMAX FX, V1\n"
+            "MOVRI GX, 11\n"
+            "VBROADCAST V3, GX\n"
+            "VSTORE V3, CX, " + std::to_string(lanes * 7) + "\n"
+            "MOVRI AX, 4\n"
+            "MOVRI BX, 0\n"
+            "SYSCALL\n");
+    CHECK(vm.get_vm_state().exception == ExceptionEnum::Exception::AOK);
+
+    using Signed = std::make_signed<DWORD>::type;
+    Signed sum = 0, low = Signed(memory[a]), high = Signed(memory[b]);
+    size_t mismatches = 0;
+    for (size_t i = 0; i < lanes; i++)
+    {
+        const Signed x = Signed(memory[a + i]), y = Signed(memory[b + i]);
+        const DWORD expected[] = {DWORD(x + y), DWORD(x - y), DWORD(x * y), DWORD(std::min(x, y)), DWORD(std::max(x, y)),
+                                  x > y ? ~DWORD(0) : 0, ~DWORD(0), 11};
+        for (size_t k = 0; k < 8; k++)
+        {
+            if (memory[out + k * lanes + i] != expected[k])
+                mismatches++;
+        }
+        sum += x;
+        low = std::min(low, x);
+        high = std::max(high, y);
+    }
+    CHECK(mismatches == 0);
+    CHECK(reg(vm, RegisterEnum::GeneralRegister::DX) == DWORD(sum));
+    CHECK(reg(vm, RegisterEnum::GeneralRegister::EX) == DWORD(low));
+    CHECK(reg(vm, RegisterEnum::GeneralRegister::FX) == DWORD(high));
+
+    // 向量的最后一个通道超出内存
+    SimpleVM faulting;
+    run(faulting, "section text\n"
+                  "MOVRI BX, " + std::to_string(SimpleVM::ISData::TOTAL_CAPACITY - lanes + 1) + "\n"
+                  "VLOAD V0, BX\n"
+                  "MOVRI DX, 1\n");
+    CHECK(faulting.get_vm_state().exception == ExceptionEnum::Exception::ADR);
+    CHECK(reg(faulting, RegisterEnum::GeneralRegister::DX) == 0);
+}
+
+/// @brief 运算和比较只记录操作数，条件跳转和读取时才计算标志
+static void test_lazy_flags()
+{
+    SimpleVM vm;
+    run(vm, "section text\n"
+            "MOVRI BX, 1\n"
+            "MOVRI AX, 5\n"
+            "SUBRRI AX, AX, 5\n"
+            "JNE fail\n"
+            "MOVRI BX, 2\n"
+            "CMPRI AX, 1\n"
+            "JGE fail\n"
+            "MOVRI BX, 3\n"
+            "MOVRI CX, 7\n"
+            "CMPRR CX, AX\n"
+            "JLE fail\n"
+            "MOVRI BX, 0\n"
+            "MOVRI CX, 1\n"
+            "CMPRI CX, 3\n"
+            "fail:\n"
+            "MOVRR DX, BX\n"
+            "MOVRI AX, 4\n"
+            "SYSCALL\n");
+    CHECK(reg(vm, RegisterEnum::GeneralRegister::DX) == 0);
+
+    auto &state = vm.get_vm_state();
+    state.materialize_flags();
+    CHECK(!state.status_registers[RegisterEnum::StatusRegister::ZF]);
+    CHECK(state.status_registers[RegisterEnum::StatusRegister::SF]);
+}
+
+/// @brief 断点停在指令执行之前，观察点停在写入完成之前，调试器析构后程序恢复原样
+static void test_debugger()
+{
+    SimpleVM vm;
+    vm.set_quiet(true);
+    vm.load_program(parse("section text\n"
+                          "MOVRI DX, 0\n"
+                          "MOVRI BX, 500\n"
+                          "loop:\n"
+                          "ADDRRI DX, DX, 1\n"
+                          "STORE DX, BX\n"
+                          "CMPRI DX, 5\n"
+                          "JL loop\n"
+                          "MOVRI AX, 4\n"
+                          "MOVRI BX, 0\n"
+                          "SYSCALL\n"));
+    {
+        Debugger debugger(vm);
+        CHECK(debugger.set_breakpoint(3));
+        CHECK(!debugger.set_breakpoint(100));
+        CHECK(debugger.resume() == DebugEnum::Event::BREAKPOINT);
+        CHECK(debugger.get_index() == 3);
+        CHECK(debugger.get_register(RegisterEnum::GeneralRegister::DX) == 1);
+        CHECK(debugger.disassemble_current().compare(0, 5, "STORE") == 0);
+
+        DWORD value = 0;
+        CHECK(debugger.resume() == DebugEnum::Event::BREAKPOINT);
+        CHECK(debugger.get_register(RegisterEnum::GeneralRegister::DX) == 2);
+        CHECK(debugger.read_memory(500, value) && value == 1);
+        CHECK(debugger.step() == DebugEnum::Event::STEP);
+        CHECK(debugger.get_index() == 4);
+        CHECK(debugger.read_memory(500, value) && value == 2);
+        CHECK(debugger.remove_breakpoint(3));
+
+#if SVM_GUARD_PAGES
+        CHECK(debugger.add_watchpoint(500));
+        CHECK(debugger.resume() == DebugEnum::Event::WATCHPOINT);
+        CHECK(debugger.get_watch_address() == 500);
+        CHECK(debugger.get_index() == 3);
+        CHECK(debugger.read_memory(500, value) && value == 2);
+        CHECK(debugger.remove_watchpoint(500));
+#endif
+        CHECK(debugger.set_breakpoint(6));
+        CHECK(debugger.resume() == DebugEnum::Event::BREAKPOINT);
+        CHECK(debugger.get_register(RegisterEnum::GeneralRegister::DX) == 5);
+    }
+    CHECK(vm.get_program_data().instructions.at(6).command == CommandEnum::Command::MOVRI);
+    vm.run();
+    CHECK(vm.get_vm_state().exception == ExceptionEnum::Exception::AOK);
+    CHECK(!vm.get_vm_state().is_running);
+}
+
+/// @brief 运行到一半保存（第二次增量保存），恢复到新虚拟机后运行的结果和原来的相同
+static void test_checkpoint_round_trip()
+{
+    const std::string sum = "section text\n"
+                            "MOVRI CX, 0\n"
+                            "MOVRI DX, 0\n"
+                            "MOVRI BX, 300\n"
+                            "loop:\n"
+                            "ADDRRR DX, DX, CX\n"
+                            "STORE DX, BX\n"
+                            "ADDRRI CX, CX, 1\n"
+                            "CMPRI CX, 5000\n"
+                            "JL loop\n"
+                            "LOAD BX, BX\n"
+                            "MOVRI AX, 4\n"
+                            "SYSCALL\n";
+    const ProgramData program = parse(sum);
+    const std::string filename = "/tmp/svm_test_" + std::to_string(getpid()) + ".ckpt";
+
+    SimpleVM vm;
+    vm.set_quiet(true);
+    vm.load_program(program);
+    vm.set_run_budget(1000);
+    vm.run();
+    CHECK(vm.get_stop_reason() == StopEnum::Reason::BUDGET);
+
+    Checkpoint checkpoint(filename);
+    CHECK(checkpoint.save(vm));
+    const size_t full_pages = checkpoint.get_pages_written();
+    vm.run();
+    CHECK(checkpoint.save(vm));
+    CHECK(checkpoint.get_pages_written() < full_pages);
+    const DWORD saved_cx = reg(vm, RegisterEnum::GeneralRegister::CX);
+
+    vm.set_run_budget(0);
+    vm.run();
+    CHECK(reg(vm, RegisterEnum::GeneralRegister::BX) == 12497500);
+
+    SimpleVM restored;
+    restored.set_quiet(true);
+    restored.load_program(program);
+    Checkpoint reader(filename);
+    CHECK(reader.restore(restored));
+    CHECK(reg(restored, RegisterEnum::GeneralRegister::CX) == saved_cx);
+    restored.run();
+    CHECK(restored.get_vm_state().exception == ExceptionEnum::Exception::AOK);
+    CHECK(reg(restored, RegisterEnum::GeneralRegister::BX) == 12497500);
+
+    // 程序不同时拒绝恢复
+    SimpleVM other;
+    other.set_quiet(true);
+    other.load_program(parse("section text\nMOVRI AX, 4\nSYSCALL\n"));
+    CHECK(!reader.restore(other));
+
+    // 文件被截断时拒绝恢复，虚拟机保持原样
+    CHECK(truncate(filename.c_str(), 64) == 0);
+    SimpleVM truncated;
+    truncated.set_quiet(true);
+    truncated.load_program(program);
+    CHECK(!reader.restore(truncated));
+    CHECK(reg(truncated, RegisterEnum::GeneralRegister::CX) == 0);
+    remove(filename.c_str());
+}
+
+/// @brief 判断两个程序的指令和数据是否完全相同
+static bool same_program(const ProgramData &a, const ProgramData &b)
+{
+    if (a.instructions.size() != b.instructions.size() || a.data != b.data)
+        return false;
+    for (size_t i = 0; i < a.instructions.size(); i++)
+    {
+        const Instruction &x = a.instructions.at(i);
+        const Instruction &y = b.instructions.at(i);
+        if (x.command != y.command || x.register1 != y.register1 || x.register2 != y.register2 ||
+            x.register3 != y.register3 || x.operand1 != y.operand1 || x.operand2 != y.operand2)
+            return false;
+    }
+    return true;
+}
+
+/// @brief 第二次加载命中缓存，得到的程序和解析的相同；损坏的缓存文件被当作未命中
+static void test_image_cache()
+{
+    const std::string directory = "/tmp/svm_test_" + std::to_string(getpid()) + ".cache";
+    const std::string filename = directory + ".exe";
+    const std::string source = "section text\n"
+                               "MOVRI CX, 10\n"
+                               "loop:\n"
+                               "ADDRRR BX, BX, CX\n"
+                               "SUBRRI CX, CX, 1\n"
+                               "JNE loop\n"
+                               "MOVRI AX, 4\n"
+                               "SYSCALL\n";
+    std::ofstream(filename, std::ios::binary) << source;
+    const ProgramData expected = parse(source);
+
+    ImageCache cache(directory);
+    ProgramData program;
+    CHECK(cache.load(filename, program));
+    CHECK(cache.get_misses() == 1 && cache.get_hits() == 0);
+    CHECK(same_program(program, expected));
+
+    ProgramData cached;
+    CHECK(cache.load(filename, cached));
+    CHECK(cache.get_hits() == 1);
+    CHECK(same_program(cached, expected));
+
+    auto images = [&]()
+    {
+        std::vector<std::filesystem::path> paths;
+        for (const auto &entry : std::filesystem::directory_iterator(directory))
+        {
+            if (entry.path().extension() == ".simg")
+                paths.push_back(entry.path());
+        }
+        return paths;
+    };
+
+    // 把缓存文件的最后一个字节改掉，校验和不再对应
+    CHECK(images().size() == 1);
+    for (const auto &path : images())
+    {
+        std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+        file.seekg(-1, std::ios::end);
+        const char last = char(file.get() ^ 0x5A);
+        file.seekp(-1, std::ios::end);
+        file.put(last);
+    }
+    ProgramData reparsed;
+    CHECK(cache.load(filename, reparsed));
+    CHECK(cache.get_misses() == 2);
+    CHECK(same_program(reparsed, expected));
+
+    // 超出上限时淘汰
+    ImageCache tiny(directory, 0);
+    tiny.evict();
+    CHECK(images().empty());
+
+    std::filesystem::remove_all(directory);
+    remove(filename.c_str());
+}
+
+/// @brief 多个核用XADD计数，用CAS/XCHG实现的自旋锁保护普通的读-改-写，结果都不丢失
+static void test_multi_core()
+{
+    const ProgramData program = parse("section text\n"
+                                      "MOVRI BX, 300\n"
+                                      "MOVRI CX, 1000\n"
+                                      "MOVRI DX, 1\n"
+                                      "loop:\n"
+                                      "XADD EX, BX, DX\n"
+                                      "lock:\n"
+                                      "MOVRI FX, 0\n"
+                                      "MOVRI GX, 1\n"
+                                      "CAS FX, BX, GX, 2\n"
+                                      "JNE lock\n"
+                                      "LOAD HX, BX, 1\n"
+                                      "ADDRRI HX, HX, 1\n"
+                                      "STORE HX, BX, 1\n"
+                                      "MOVRI GX, 0\n"
+                                      "XCHG GX, BX, 2\n"
+                                      "SUBRRI CX, CX, 1\n"
+                                      "JNE loop\n"
+                                      "MOVRI AX, 4\n"
+                                      "MOVRI BX, 0\n"
+                                      "SYSCALL\n");
+    MultiCoreVM vm(4);
+    for (size_t i = 0; i < vm.get_core_count(); i++)
+        vm.get_core(i).set_quiet(true);
+    vm.load_program(program);
+    vm.run();
+    CHECK(vm.get_exception() == ExceptionEnum::Exception::AOK);
+    const DWORD *memory = vm.get_internal_storage_data().get_internal_storage();
+    CHECK(memory[300] == 4000);
+    CHECK(memory[301] == 4000);
+    CHECK(memory[302] == 0);
+
+    // 单核时同样可用：CAS失败时ZF为0，寄存器1得到内存中原来的值
+    SimpleVM single;
+    single.get_internal_storage_data().get_internal_storage()[300] = 9;
+    run(single, "section text\n"
+                "MOVRI BX, 300\n"
+                "MOVRI CX, 1\n"
+                "MOVRI DX, 2\n"
+                "CAS CX, BX, DX\n"
+                "JE fail\n"
+                "MOVRR EX, CX\n"
+                "MOVRI CX, 9\n"
+                "CAS CX, BX, DX\n"
+                "JNE fail\n"
+                "MOVRI FX, 1\n"
+                "fail:\n"
+                "MOVRI AX, 4\n"
+                "MOVRI BX, 0\n"
+                "SYSCALL\n");
+    CHECK(reg(single, RegisterEnum::GeneralRegister::EX) == 9);
+    CHECK(reg(single, RegisterEnum::GeneralRegister::FX) == 1);
+    CHECK(single.get_internal_storage_data().get_internal_storage()[300] == 2);
+}
+
+/// @brief 生产者和消费者通过容量很小的通道传递1到100，由调度器交替运行
+static void test_channels()
+{
+    const std::string producer = "section text\n"
+                                 "MOVRI DX, 1\n"
+                                 "loop:\n"
+                                 "MOVRI AX, 9\n"
+                                 "MOVRI BX, 0\n"
+                                 "MOVRR CX, DX\n"
+                                 "SYSCALL\n"
+                                 "ADDRRI DX, DX, 1\n"
+                                 "CMPRI DX, 101\n"
+                                 "JL loop\n"
+                                 "MOVRI AX, 13\n"
+                                 "MOVRI BX, 0\n"
+                                 "SYSCALL\n"
+                                 "MOVRI AX, 4\n"
+                                 "MOVRI BX, 0\n"
+                                 "SYSCALL\n";
+    const std::string consumer = "section text\n"
+                                 "MOVRI DX, 0\n"
+                                 "loop:\n"
+                                 "MOVRI AX, 10\n"
+                                 "MOVRI BX, 0\n"
+                                 "SYSCALL\n"
+                                 "CMPRI BX, 0\n"
+                                 "JNE done\n"
+                                 "ADDRRR DX, DX, AX\n"
+                                 "JMP loop\n"
+                                 "done:\n"
+                                 "MOVRR BX, DX\n"
+                                 "MOVRI AX, 4\n"
+                                 "SYSCALL\n";
+
+    auto channels = std::make_shared<ChannelTable>();
+    CHECK(channels->create(4) == 0);
+    SimpleVM vms[2];
+    const std::string *programs[2] = {&producer, &consumer};
+    Scheduler scheduler(2, 64);
+    for (size_t i = 0; i < 2; i++)
+    {
+        vms[i].set_quiet(true);
+        vms[i].attach_channels(channels);
+        vms[i].load_program(parse(*programs[i]));
+        scheduler.add(vms[i]);
+    }
+    CHECK(scheduler.run());
+    CHECK(vms[0].get_vm_state().exception == ExceptionEnum::Exception::AOK);
+    CHECK(vms[1].get_vm_state().exception == ExceptionEnum::Exception::AOK);
+    CHECK(reg(vms[1], RegisterEnum::GeneralRegister::BX) == 5050);
+    CHECK(scheduler.get_parks() > 0);
+
+    // 批量收发：每次最多放下通道容量那么多，剩下的由程序再次发送
+    const std::string block_producer = "section text\n"
+                                       "MOVRI CX, 300\n"
+                                       "MOVRI DX, 20\n"
+                                       "loop:\n"
+                                       "MOVRI AX, 11\n"
+                                       "MOVRI BX, 1\n"
+                                       "SYSCALL\n"
+                                       "ADDRRR CX, CX, AX\n"
+                                       "SUBRRR DX, DX, AX\n"
+                                       "JNE loop\n"
+                                       "MOVRI AX, 13\n"
+                                       "MOVRI BX, 1\n"
+                                       "SYSCALL\n"
+                                       "MOVRI AX, 4\n"
+                                       "MOVRI BX, 0\n"
+                                       "SYSCALL\n";
+    const std::string block_consumer = "section text\n"
+                                       "MOVRI CX, 500\n"
+                                       "MOVRI DX, 8\n"
+                                       "loop:\n"
+                                       "MOVRI AX, 12\n"
+                                       "MOVRI BX, 1\n"
+                                       "SYSCALL\n"
+                                       "CMPRI AX, 0\n"
+                                       "JE done\n"
+                                       "ADDRRR CX, CX, AX\n"
+                                       "JMP loop\n"
+                                       "done:\n"
+                                       "MOVRR EX, CX\n"
+                                       "MOVRI AX, 4\n"
+                                       "MOVRI BX, 0\n"
+                                       "SYSCALL\n";
+    CHECK(channels->create(6) == 1);
+    SimpleVM block_vms[2];
+    const std::string *block_programs[2] = {&block_producer, &block_consumer};
+    Scheduler block_scheduler(2, 64);
+    for (size_t i = 0; i < 2; i++)
+    {
+        block_vms[i].set_quiet(true);
+        block_vms[i].attach_channels(channels);
+        block_vms[i].load_program(parse(*block_programs[i]));
+        block_scheduler.add(block_vms[i]);
+    }
+    DWORD *source = block_vms[0].get_internal_storage_data().get_internal_storage();
+    for (DWORD i = 0; i < 20; i++)
+        source[300 + i] = i + 1;
+    CHECK(block_scheduler.run());
+    CHECK(block_vms[0].get_vm_state().exception == ExceptionEnum::Exception::AOK);
+    CHECK(block_vms[1].get_vm_state().exception == ExceptionEnum::Exception::AOK);
+    CHECK(reg(block_vms[1], RegisterEnum::GeneralRegister::EX) == 520);
+    const DWORD *target = block_vms[1].get_internal_storage_data().get_internal_storage();
+    CHECK(std::equal(target + 500, target + 520, source + 300));
+
+    BasicMPMCChannel<DWORD> channel(4);
+    const DWORD values[] = {1, 2, 3, 4, 5};
+    DWORD received[5] = {};
+    CHECK(channel.try_send(values, 5) == 4);
+    CHECK(channel.try_receive(received, 5) == 4);
+    CHECK(received[0] == 1 && received[3] == 4);
+    channel.close();
+    CHECK(channel.try_send(values, 1) == 0);
+}
+
+/// @brief 主程序创建8个子任务再逐个汇合，取回子任务的AX并看到它们写入的内存；子任务中的SPAWN是ins异常
+static void test_fork_join()
+{
+    const ProgramData program = parse("section text\n"
+                                      "MOVRI CX, 0\n"
+                                      "MOVRI DX, 0\n"
+                                      "spawn:\n"
+                                      "MOVRR AX, CX\n"
+                                      "SPAWN EX, child\n"
+                                      "PUSH EX\n"
+                                      "ADDRRI CX, CX, 1\n"
+                                      "CMPRI CX, 8\n"
+                                      "JL spawn\n"
+                                      "join:\n"
+                                      "POP EX\n"
+                                      "MOVRR FX, DX\n"
+                                      "MOVRR GX, CX\n"
+                                      "JOIN EX\n"
+                                      "ADDRRR DX, FX, AX\n"
+                                      "SUBRRI CX, GX, 1\n"
+                                      "JNE join\n"
+                                      "MOVRR BX, DX\n"
+                                      "MOVRI AX, 4\n"
+                                      "SYSCALL\n"
+                                      "child:\n"
+                                      "MOVRI BX, 300\n"
+                                      "ADDRRR BX, BX, AX\n"
+                                      "STORE AX, BX\n"
+                                      "MULRRR AX, AX, AX\n"
+                                      "RET\n");
+    ForkJoinVM vm(3);
+    vm.get_main().set_quiet(true);
+    // 工作线程常驻，重置后再运行一次（重置也清零子任务计数）
+    for (int round = 0; round < 2; round++)
+    {
+        vm.reset();
+        vm.load_program(program);
+        vm.run();
+        CHECK(vm.get_exception() == ExceptionEnum::Exception::AOK);
+        CHECK(reg(vm.get_main(), RegisterEnum::GeneralRegister::BX) == 140);
+        const DWORD *memory = vm.get_internal_storage_data().get_internal_storage();
+        for (DWORD i = 0; i < 8; i++)
+            CHECK(memory[300 + i] == i);
+    }
+    CHECK(vm.get_spawned() == 8);
+
+    ForkJoinVM nested(2);
+    nested.get_main().set_quiet(true);
+    nested.load_program(parse("section text\n"
+                              "SPAWN EX, child\n"
+                              "JOIN EX\n"
+                              "MOVRI AX, 4\n"
+                              "SYSCALL\n"
+                              "child:\n"
+                              "SPAWN EX, child\n"
+                              "RET\n"));
+    nested.run();
+    CHECK(nested.get_exception() == ExceptionEnum::Exception::INS);
+}
+
+/// @brief 陷阱回调记下的最后一次陷阱
+static svm_trap last_capi_trap;
+
+/// @brief 陷阱回调
+static void record_capi_trap(svm_vm *, const svm_trap *trap, void *user)
+{
+    last_capi_trap = *trap;
+    ++*static_cast<int *>(user);
+}
+
+/// @brief C接口：解析、运行、预算、异常和陷阱回调、重置，以及映射缓冲区后客户程序直接读取宿主写入的数据
+static void test_capi()
+{
+    const std::string sum = "section text\n"
+                            "MOVRI DX, 0\n"
+                            "loop:\n"
+                            "CMPRI BX, 0\n"
+                            "JE done\n"
+                            "LOAD CX, AX\n"
+                            "ADDRRR DX, DX, CX\n"
+                            "ADDRRI AX, AX, 1\n"
+                            "SUBRRI BX, BX, 1\n"
+                            "JMP loop\n"
+                            "done:\n"
+                            "DIVRRR EX, DX, FX\n"
+                            "MOVRR BX, DX\n"
+                            "MOVRI AX, 4\n"
+                            "SYSCALL\n";
+    svm_program *program = nullptr;
+    unsigned bits = 0;
+    CHECK(svm_program_parse("section text\nNOSUCH AX\n", 23, &program, &bits) == SVM_ERROR_PROGRAM);
+    CHECK(svm_program_parse(sum.data(), sum.size(), &program, &bits) == SVM_OK);
+    CHECK(bits == 64);
+    svm_vm *vm = nullptr;
+    CHECK(svm_vm_create(program, &vm) == SVM_OK);
+    CHECK(svm_vm_set_register(vm, SVM_REGISTER_COUNT, 0) == SVM_ERROR_ARGUMENT);
+
+    // 客户内存中的数据：宿主写入后标记为脏，重置时恢复
+    size_t words = 0;
+    uint64_t *memory = static_cast<uint64_t *>(svm_vm_memory(vm, &words));
+    CHECK(memory != nullptr && words == SimpleVM::ISData::TOTAL_CAPACITY);
+    for (size_t i = 0; i < 100; i++)
+        memory[300 + i] = i + 1;
+    CHECK(svm_vm_mark_dirty(vm, 300, 100) == SVM_OK);
+
+    int traps = 0;
+    svm_vm_set_trap_callback(vm, record_capi_trap, &traps);
+    CHECK(svm_vm_set_register(vm, 0, 300) == SVM_OK);
+    CHECK(svm_vm_set_register(vm, 1, 100) == SVM_OK);
+    CHECK(svm_vm_set_register(vm, 5, 1) == SVM_OK);
+    // 预算只在轮询设备时检查，会向上取整为DEVICE_POLL_INTERVAL的倍数，这个程序要执行七百多条指令
+    CHECK(svm_vm_run(vm, 300) == SVM_STOP_BUDGET);
+    CHECK(traps == 1 && last_capi_trap.kind == SVM_TRAP_BUDGET);
+    CHECK(svm_vm_run(vm, 0) == SVM_STOP_EXIT);
+    CHECK(svm_vm_get_register(vm, 1) == 5050);
+
+    // 重置后寄存器清零，被宿主标记过的内存恢复为程序加载时的内容
+    CHECK(svm_vm_reset(vm) == SVM_OK);
+    CHECK(svm_vm_get_register(vm, 1) == 0);
+    CHECK(memory[300] == 0);
+    CHECK(svm_vm_run(vm, 0) == SVM_STOP_EXCEPTION);
+    CHECK(svm_vm_exception(vm) == SVM_EXCEPTION_DIV);
+    CHECK(traps == 2 && last_capi_trap.kind == SVM_TRAP_DIV && !last_capi_trap.vectored);
+
+#if SVM_GUARD_PAGES
+    // 缓冲区映射到窗口区，客户程序直接读取宿主写入的数据
+    svm_buffer *buffer = nullptr;
+    CHECK(svm_buffer_create(4096, &buffer) == SVM_OK);
+    uint64_t *data = static_cast<uint64_t *>(svm_buffer_data(buffer));
+    const size_t count = svm_buffer_size(buffer) / sizeof(uint64_t);
+    for (size_t i = 0; i < count; i++)
+        data[i] = i;
+    const uint64_t address = svm_vm_window_base(vm);
+    CHECK(svm_vm_bind_buffer(vm, buffer, address + 1) == SVM_ERROR_WINDOW);
+    CHECK(svm_vm_bind_buffer(vm, buffer, address) == SVM_OK);
+    CHECK(svm_vm_reset(vm) == SVM_OK);
+    svm_vm_set_register(vm, 0, address);
+    svm_vm_set_register(vm, 1, count);
+    svm_vm_set_register(vm, 5, 1);
+    CHECK(svm_vm_run(vm, 0) == SVM_STOP_EXIT);
+    CHECK(svm_vm_get_register(vm, 1) == count * (count - 1) / 2);
+    CHECK(svm_vm_unbind_buffer(vm, buffer, address) == SVM_OK);
+    svm_buffer_free(buffer);
+#endif
+
+    svm_vm_destroy(vm);
+    svm_program_free(program);
+}
+
+int main()
+{
+    const std::pair<const char *, void (*)()> tests[] = {
+        {"console device", test_console_device},
+        {"guard page", test_guard_page},
+        {"host segv", test_host_segv},
+        {"call ret", test_call_ret},
+        {"allocator", test_allocator},
+        {"bulk memory", test_bulk_memory},
+        {"bulk memory window", test_bulk_memory_window},
+        {"vector ops", test_vector_ops},
+        {"lazy flags", test_lazy_flags},
+        {"debugger", test_debugger},
+        {"checkpoint round trip", test_checkpoint_round_trip},
+        {"image cache", test_image_cache},
+        {"multi core", test_multi_core},
+        {"channels", test_channels},
+        {"fork join", test_fork_join},
+        {"simt divergence", test_simt_divergence},
+        {"simt fault before branch", test_simt_fault_before_branch},
+        {"c api", test_capi},
+        {"pool restart", test_pool_restart},
+        {"trap vector", test_trap_vector},
+        {"trap vector pc fault", test_trap_vector_pc_fault},
+        {"trap vector checkpoint", test_trap_vector_checkpoint},
+        {"job protocol", test_job_protocol},
+    };
+    for (const auto &test : tests)
+    {
+        const size_t before = failures;
+        test.second();
+        printf("%s: %s\n", test.first, failures == before ? "ok" : "FAILED");
+    }
+    printf("failures:%zu\n", failures);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,82 @@
+// 执行跟踪解码工具
+// 编译：g++ -O2 -std=c++17 -I.. trace_decode.cpp -o trace_decode
+// 用法：trace_decode 跟踪文件 [程序文件]
+// 给出程序文件时，每条指令后面附上反汇编
+
+#include <iostream>
+#include "../SimpleEXE.hpp"
+
+using namespace svm;
+
+/// @brief 读取程序并反汇编所有指令
+/// @param filename 程序文件名
+/// @param result 每条指令的反汇编文本
+/// @return 是否成功
+template <typename WordT>
+bool disassemble_program(const std::string &filename, std::vector<std::string> &result)
+{
+    BasicEXEParser<WordT> parser;
+    if (!parser.parse(filename))
+        return false;
+
+    const BasicProgramData<WordT> program = parser.get_program();
+    result.clear();
+    for (size_t i = 0; i < program.instructions.size(); i++)
+        result.push_back(disassemble(program.instructions.at(i)));
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        std::cout << "Usage: trace_decode <trace file> [program file]" << std::endl;
+        return 1;
+    }
+
+    TraceFileHeader header;
+    std::vector<TraceRecord> records;
+    if (!TraceRecorder::load(argv[1], header, records))
+        return 1;
+
+    std::vector<std::string> listing;
+    if (argc > 2)
+    {
+        bool success = header.word_bits == 32 ? disassemble_program<DWORD32>(argv[2], listing) : disassemble_program<DWORD64>(argv[2], listing);
+        if (!success)
+            return 1;
+    }
+
+    std::cout << "word bits:" << header.word_bits << std::endl;
+    std::cout << "records:" << header.record_count << std::endl;
+    std::cout << "overwritten:" << header.total_records - header.record_count << std::endl;
+    print_split_line();
+
+    for (size_t i = 0; i < records.size(); i++)
+    {
+        const TraceRecord &record = records.at(i);
+        const std::string reg = record.reg < gregister_name_list.size() ? gregister_name_list.at(record.reg) : "?";
+        switch (record.kind)
+        {
+        case TraceEnum::Kind::STEP:
+            std::cout << record.index << "\t" << (record.command < command_name_list.size() ? command_name_list.at(record.command) : "?");
+            if (record.index < listing.size())
+                std::cout << "\t" << listing.at(record.index);
+            std::cout << std::endl;
+            break;
+
+        case TraceEnum::Kind::DELTA:
+            std::cout << "\t" << reg << " = " << record.value << std::endl;
+            break;
+
+        case TraceEnum::Kind::SYSCALL_ARG:
+            std::cout << "\targ " << reg << " = " << record.value << std::endl;
+            break;
+
+        default:
+            std::cout << "\tunknown record kind:" << int(record.kind) << std::endl;
+            break;
+        }
+    }
+    return 0;
+}